@@ -1,6 +1,8 @@
 #ifndef RB_BIN_TREE_RB_TREE_H
 #define RB_BIN_TREE_RB_TREE_H
 
+#include <cstdint>
+#include <functional>
 #include <iostream>
 #include <initializer_list>
 #include <limits>
@@ -26,12 +28,17 @@ std::is_same_v: Это утилита из <type_traits>, которая про
 типа одинаковыми. В вашем случае она используется для проверки, является ли тип T 
 простым типом или структурой с ключом.*/
 
+#include "../key_order.h"
+
 namespace rb_tree {
 
 enum COLOR { RED, BLACK };
 
 template <typename T1, typename T2>
 struct dataMap {
+  using key_type = T1;
+  using mapped_type = T2;
+
   T1 key;
   T2 data;
   // Операторы сравнения для dataMap
@@ -50,53 +57,150 @@ struct dataMap {
   }
 };
 
+/*Ключ элемента дерева: для простых типов - сам элемент, для dataMap - поле
+key. Дерево сравнивает только ключи, поэтому для поиска в dataMap не нужно
+собирать временный элемент с данными по умолчанию.*/
 template <typename T>
-struct Node {
+struct KeyOf {
+  using type = T;
+  static constexpr bool plain = true;
+  static const T &get(const T &value) { return value; }
+};
+
+template <typename T1, typename T2>
+struct KeyOf<dataMap<T1, T2>> {
+  using type = T1;
+  static constexpr bool plain = false;
+  static const T1 &get(const dataMap<T1, T2> &value) { return value.key; }
+};
+
+// Правила сравнения ключей общие с binary_tree::BinaryTree (key_order.h)
+using binary_tree::has_compare;
+using binary_tree::is_std_less;
+using binary_tree::is_transparent;
+using binary_tree::KeyOrder;
+using binary_tree::three_way;
+using binary_tree::transparent_t;
+
+/*Нити - ссылки на соседей по порядку ключей, только у узлов дерева с
+Threaded == true. Без нитей база пустая и узел не растет.*/
+template <typename N, bool Threaded>
+struct NodeThreads {};
+
+template <typename N>
+struct NodeThreads<N, true> {
+  N *prev = nullptr, *next = nullptr;
+};
+
+/*Связи узла. Цвет хранится в младшем бите указателя на отца: узел выровнен
+хотя бы по границе указателя, поэтому этот бит у адреса всегда нулевой.*/
+template <typename N, bool Threaded = false>
+struct NodeLinks : NodeThreads<N, Threaded> {
+  N *left = nullptr, *right = nullptr;
+
+  N *parent() const {
+    return reinterpret_cast<N *>(parent_color & ~std::uintptr_t(1));
+  }
+  COLOR color() const { return COLOR(parent_color & 1); }
+  void setParent(N *ptr) {
+    parent_color = reinterpret_cast<std::uintptr_t>(ptr) | (parent_color & 1);
+  }
+  void setColor(COLOR value) {
+    parent_color = (parent_color & ~std::uintptr_t(1)) | value;
+  }
+
+ private:
+  // Новый узел красный (RED == 0) и без отца
+  std::uintptr_t parent_color = 0;
+};
+
+template <typename T, bool Threaded = false>
+struct Node : NodeLinks<Node<T, Threaded>, Threaded> {
   T data;
-  Node *left = nullptr, *right = nullptr, *parent = nullptr;
-  COLOR nodeColor = RED;
 
   // Конструктор для простых типов данных
   Node(const T &data) : data(data) {}
 };
 
-template <typename T1, typename T2>
-struct Node<dataMap<T1, T2>> {
+template <typename T1, typename T2, bool Threaded>
+struct Node<dataMap<T1, T2>, Threaded>
+    : NodeLinks<Node<dataMap<T1, T2>, Threaded>, Threaded> {
   dataMap<T1, T2> data;
-  Node *left = nullptr, *right = nullptr, *parent = nullptr;
-  COLOR nodeColor = RED;
   // Конструктор для dataMap
   Node(const dataMap<T1, T2> &data) : data(data) {}
 };
 
-template <typename T>
+/*Threaded == true связывает узлы нитями по порядку ключей: ++ и -- у
+итераторов делают один переход по ссылке вместо подъема к отцам.*/
+template <typename T, typename Compare = std::less<typename KeyOf<T>::type>,
+          bool Threaded = false>
 class RB_Tree {
  private:
-  Node<T> *root = nullptr;
+  Node<T, Threaded> *root = nullptr;
   size_t tree_size = 0;
+  Compare comp;
   
-  Node<T> *grandfather(Node<T> *ptr);
-  Node<T> *uncle(Node<T> *ptr);
-  void rotateRight(Node<T> *ptr);
-  void rotateLeft(Node<T> *ptr);
-  void balanceTree(Node<T> *ptr);
-  void balanceTree_1(Node<T> *ptr);
-  void balanceTree_2(Node<T> *ptr);
-  void push(Node<T> *startnode,  const T data);
-  void push(const T data);
-  void push(Node<T> *startnode, Node <T> *ptr);
-  Node<T> *findNode(Node<T> *node, const T &volum);
-  void printTree(Node<T> *node, int indent = 0) const;
-  void clear(Node<T> *node);
-  void colorChange(Node<T> *ptr);
-  Node<T> *copyTree(Node<T>* node, Node<T>* parent = nullptr);
-  void mergeRecursive(Node<T>* node);
-  void removeRoot(Node<T> *node);
-  int nodeCounting(Node<T>* node);
+  Node<T, Threaded> *grandfather(Node<T, Threaded> *ptr);
+  Node<T, Threaded> *uncle(Node<T, Threaded> *ptr);
+  void rotateRight(Node<T, Threaded> *ptr);
+  void rotateLeft(Node<T, Threaded> *ptr);
+  void lift(Node<T, Threaded> *ptr);
+  void replaceNode(Node<T, Threaded> *ptr, Node<T, Threaded> *child);
+  bool isBlack(const Node<T, Threaded> *ptr) const;
+  void eraseBalance(Node<T, Threaded> *ptr, Node<T, Threaded> *father);
+  void remove(Node<T, Threaded> *ptr);
+  void balanceTree(Node<T, Threaded> *ptr);
+  void balanceTree_1(Node<T, Threaded> *ptr);
+  void balanceTree_2(Node<T, Threaded> *ptr);
+  Node<T, Threaded> *descendUnique(Node<T, Threaded> *startnode,
+                                   const typename KeyOf<T>::type &key,
+                                   Node<T, Threaded> *&father,
+                                   int &right) const;
+  Node<T, Threaded> *link(Node<T, Threaded> *father, int right,
+                          Node<T, Threaded> *newnode);
+  Node<T, Threaded> *push(Node<T, Threaded> *startnode,  const T data);
+  Node<T, Threaded> *push(const T data);
+  template <typename K>
+  Node<T, Threaded> *findNode(Node<T, Threaded> *node, const K &key) const;
+  template <typename K>
+  Node<T, Threaded> *lowerNode(const K &key) const;
+  template <typename K>
+  size_t eraseKey(const K &key);
+  // a < b и знак сравнения a и b в порядке Compare
+  template <typename A, typename B>
+  bool key_less(const A &a, const B &b) const {
+    return KeyOrder<Compare>::less(comp, a, b);
+  }
+  template <typename A, typename B>
+  int order(const A &a, const B &b) const {
+    return KeyOrder<Compare>::compare(comp, a, b);
+  }
+  void printTree(Node<T, Threaded> *node, int indent = 0) const;
+  void clear(Node<T, Threaded> *node);
+  static void swapColors(Node<T, Threaded> *a, Node<T, Threaded> *b);
+  Node<T, Threaded> *copyTree(Node<T, Threaded>* node,
+                              Node<T, Threaded>* parent = nullptr);
+  void mergeRecursive(Node<T, Threaded>* node);
+  int checkSubtree(const Node<T, Threaded> *node,
+                   const Node<T, Threaded> *father,
+                   const Node<T, Threaded> *&prev) const;
+  // Нити: сшивка соседей и прошивка всего дерева после копирования
+  static void chain(Node<T, Threaded> *prev, Node<T, Threaded> *next);
+  static Node<T, Threaded> *threadSubtree(Node<T, Threaded> *node,
+                                          Node<T, Threaded> *prev);
+  void threadAll();
+  static void prefetch(const Node<T, Threaded> *node);
+  template <typename It, typename Visit>
+  static void scan(It first, It last, size_t distance, Visit &visit);
 
  public:
 
   using size_type = size_t;
+  using key_type = typename KeyOf<T>::type;
+  using key_compare = Compare;
+
+  // На сколько узлов вперед обходы подгружают память
+  static constexpr size_type prefetch_distance = 8;
 
   //Конструктор по умолчанию
   RB_Tree() = default;
@@ -108,14 +212,21 @@ class RB_Tree {
     }
   }
 
+  // Пустое дерево с заданным порядком ключей
+  explicit RB_Tree(const Compare &compare) : comp(compare) {}
+
   //Конструктор копирования
-  RB_Tree(const RB_Tree& other) {
+  RB_Tree(const RB_Tree& other)
+      : tree_size(other.tree_size), comp(other.comp) {
     root = copyTree(other.root);
+    threadAll();
   }
 
   //Конструктор перемещения
-  RB_Tree(RB_Tree&& other) noexcept : root(other.root) {
+  RB_Tree(RB_Tree&& other) noexcept
+      : root(other.root), tree_size(other.tree_size), comp(other.comp) {
     other.root = nullptr;
+    other.tree_size = 0;
   }
 
   //Перегрузка оператора присваивания для перемещения объекта
@@ -123,7 +234,10 @@ class RB_Tree {
     if (this != &other) {
       clear(root);
       root = other.root;
+      tree_size = other.tree_size;
+      comp = other.comp;
       other.root = nullptr;
+      other.tree_size = 0;
     }
     return *this;
   }
@@ -131,22 +245,43 @@ class RB_Tree {
   //Деструктор
   ~RB_Tree();
 
-  Node<T> *find(const T &volum);
+  Node<T, Threaded> *find(const T &volum);
   void remove(const T &volum);
   void print();
 
+  key_compare key_comp() const { return comp; }
+
+  /*Поиск по ключу. С прозрачным компаратором (std::less<> и т. п.) ключ
+  может быть любого сравнимого с key_type типа, например std::string_view
+  для ключей std::string, и временный ключ не создается.*/
+  template <typename K, transparent_t<Compare, K> = 0>
+  Node<T, Threaded> *find(const K &key);
+
+  bool contains(const key_type &key) const;
+  template <typename K, transparent_t<Compare, K> = 0>
+  bool contains(const K &key) const;
+
+  size_type count(const key_type &key) const;
+  template <typename K, transparent_t<Compare, K> = 0>
+  size_type count(const K &key) const;
+
+  // Удаляет элемент с ключом key, возвращает число удаленных элементов
+  size_type erase(const key_type &key);
+  template <typename K, transparent_t<Compare, K> = 0>
+  size_type erase(const K &key);
+
   // Метод at для доступа к элементу с проверкой границ
-  template <typename K = T, typename std::enable_if_t<std::is_same_v<K, T>, int> = 0>
+  template <typename K = T, typename std::enable_if_t<KeyOf<K>::plain, int> = 0>
   T& at(const T& key);
 
-  template <typename K = T, typename std::enable_if_t<!std::is_same_v<K, T>, int> = 0>
+  template <typename K = T, typename std::enable_if_t<!KeyOf<K>::plain, int> = 0>
   T& at(const typename K::key_type& key);
 
   // Оператор [] для доступа или вставки элемента
-  template <typename K = T, typename std::enable_if_t<std::is_same_v<K, T>, int> = 0>
+  template <typename K = T, typename std::enable_if_t<KeyOf<K>::plain, int> = 0>
   T& operator[](const T& key);
 
-  template <typename K = T, typename std::enable_if_t<!std::is_same_v<K, T>, int> = 0>
+  template <typename K = T, typename std::enable_if_t<!KeyOf<K>::plain, int> = 0>
   T& operator[](const typename K::key_type& key);
 
   // Методы для доступа к информации о наполнении контейнера
@@ -154,11 +289,18 @@ class RB_Tree {
   size_type size();
   size_type max_size();
 
+  /*Проверка инвариантов дерева за O(n), для тестов: ссылки на отцов
+  согласованы, ключи строго возрастают, корень черный, у красного узла нет
+  красных сыновей, черная высота всех путей одинакова, размер совпадает с
+  числом узлов.*/
+  bool valid() const;
+
   class iterator {
     private:
-      Node<T>* current;
+      Node<T, Threaded>* current;
+      friend class RB_Tree;
     public:
-      iterator(Node<T> *node);
+      iterator(Node<T, Threaded> *node);
 
       //Префиксный оператор++
       iterator& operator++();
@@ -188,9 +330,10 @@ class RB_Tree {
 
   class const_iterator {
     private:
-      const Node<T>* current;
+      const Node<T, Threaded>* current;
+      friend class RB_Tree;
     public:
-      const_iterator(const Node<T> *node);
+      const_iterator(const Node<T, Threaded> *node);
 
       // Префиксный оператор++
       const_iterator& operator++();
@@ -223,132 +366,212 @@ class RB_Tree {
   const_iterator begin() const;
   const_iterator end() const;
 
+  // Первый элемент с ключом не меньше key
+  iterator lower_bound(const key_type &key);
+  const_iterator lower_bound(const key_type &key) const;
+  template <typename K, transparent_t<Compare, K> = 0>
+  iterator lower_bound(const K &key);
+  template <typename K, transparent_t<Compare, K> = 0>
+  const_iterator lower_bound(const K &key) const;
+
   // Метод для удаления элемента по итератору
   void erase(iterator pos);
 
   // Метод для обмена содержимым с другим деревом
-  void swap(RB_Tree<T>& other);
+  void swap(RB_Tree<T, Compare, Threaded>& other);
 
   // Сливает два контейнера
-  void merge(RB_Tree<T>&  other);
+  void merge(RB_Tree<T, Compare, Threaded>&  other);
+
+  /*Вызывает visit(data) для всех элементов по возрастанию ключей. Узел,
+  стоящий на distance шагов впереди, заранее подгружается в кэш; с нитями
+  его адрес известен без чтения отцов, так что подгрузка успевает раньше.*/
+  template <typename Visit>
+  void for_each(Visit visit, size_type distance = prefetch_distance);
+  template <typename Visit>
+  void for_each(Visit visit, size_type distance = prefetch_distance) const;
  
 };
 
-template <typename T>
-RB_Tree<T>::~RB_Tree() {
+template <typename T, typename Compare, bool Threaded>
+RB_Tree<T, Compare, Threaded>::~RB_Tree() {
   clear(root);
 }
 
-template <typename T>
-Node<T> *RB_Tree<T>::grandfather(Node<T> *ptr) {
-  if (ptr == nullptr || ptr->parent == nullptr) return nullptr;
-  return ptr->parent->parent;
+template <typename T, typename Compare, bool Threaded>
+Node<T, Threaded> *
+RB_Tree<T, Compare, Threaded>::grandfather(Node<T, Threaded> *ptr) {
+  if (ptr == nullptr || ptr->parent() == nullptr) return nullptr;
+  return ptr->parent()->parent();
 }
 
-template <typename T>
-Node<T> *RB_Tree<T>::uncle(Node<T> *ptr) {
-  Node<T> *gf = grandfather(ptr);
+template <typename T, typename Compare, bool Threaded>
+Node<T, Threaded> *
+RB_Tree<T, Compare, Threaded>::uncle(Node<T, Threaded> *ptr) {
+  Node<T, Threaded> *gf = grandfather(ptr);
   if (ptr == nullptr || gf == nullptr) return nullptr;
-  Node<T> *result = (gf->left == ptr->parent ? gf->right : gf->left);
+  Node<T, Threaded> *result =
+      (gf->left == ptr->parent() ? gf->right : gf->left);
   return result;
 }
 
-template <typename T>
-void RB_Tree<T>::rotateRight(Node<T> *ptr) {
-  std::swap(ptr->nodeColor, ptr->parent->nodeColor);
-  Node<T> *father = ptr->parent;
-  father->left = ptr->right;
-  ptr->parent = father->parent;
-  ptr->right = father;
-  father->parent = ptr;
-  if (father->left) father->left->parent = father;
-  if (ptr->parent){
-    if(ptr->parent->left == father) ptr->parent->left = ptr;
-    else ptr->parent->right = ptr;
-  } else root = ptr;
+template <typename T, typename Compare, bool Threaded>
+void RB_Tree<T, Compare, Threaded>::rotateRight(Node<T, Threaded> *ptr) {
+  swapColors(ptr, ptr->parent());
+  lift(ptr);
 }
 
-template <typename T>
-void RB_Tree<T>::rotateLeft(Node<T> *ptr) {
-  std::swap(ptr->nodeColor, ptr->parent->nodeColor);
-  Node<T> *father = ptr->parent;
-  father->right = ptr->left;
-  ptr->parent = father->parent;
-  ptr->left = father;
-  father->parent = ptr;
-  if (father->right) father->right->parent = father;
-  if (ptr->parent){
-    if(ptr->parent->left == father) ptr->parent->left = ptr;
-    else ptr->parent->right = ptr;
-  } else root = ptr;
+template <typename T, typename Compare, bool Threaded>
+void RB_Tree<T, Compare, Threaded>::rotateLeft(Node<T, Threaded> *ptr) {
+  swapColors(ptr, ptr->parent());
+  lift(ptr);
 }
 
-template <typename T>
-void RB_Tree<T>::balanceTree(Node<T> *ptr) {
-  Node<T> *un = uncle(ptr);
-  Node<T> *gf = grandfather(ptr);
-  if (un && un->nodeColor == RED) {
+// Поворот без перекраски: поднимает узел ptr на место его родителя
+template <typename T, typename Compare, bool Threaded>
+void RB_Tree<T, Compare, Threaded>::lift(Node<T, Threaded> *ptr) {
+  Node<T, Threaded> *father = ptr->parent();
+  if (father->left == ptr) {
+    father->left = ptr->right;
+    if (ptr->right) ptr->right->setParent(father);
+    ptr->right = father;
+  } else {
+    father->right = ptr->left;
+    if (ptr->left) ptr->left->setParent(father);
+    ptr->left = father;
+  }
+  replaceNode(father, ptr);
+  father->setParent(ptr);
+}
+
+// Ставит поддерево child на место узла ptr
+template <typename T, typename Compare, bool Threaded>
+void RB_Tree<T, Compare, Threaded>::replaceNode(Node<T, Threaded> *ptr,
+                                                Node<T, Threaded> *child) {
+  if (child) child->setParent(ptr->parent());
+  if (!ptr->parent()) root = child;
+  else if (ptr->parent()->left == ptr) ptr->parent()->left = child;
+  else ptr->parent()->right = child;
+}
+
+// Пустой лист (nullptr) считается черным
+template <typename T, typename Compare, bool Threaded>
+bool
+RB_Tree<T, Compare, Threaded>::isBlack(const Node<T, Threaded> *ptr) const {
+  return ptr == nullptr || ptr->color() == BLACK;
+}
+
+template <typename T, typename Compare, bool Threaded>
+void RB_Tree<T, Compare, Threaded>::balanceTree(Node<T, Threaded> *ptr) {
+  Node<T, Threaded> *un = uncle(ptr);
+  Node<T, Threaded> *gf = grandfather(ptr);
+  if (un && un->color() == RED) {
     // перекраска
-    un->nodeColor = BLACK;
-    ptr->parent->nodeColor = BLACK;
+    un->setColor(BLACK);
+    ptr->parent()->setColor(BLACK);
     if (gf != root) {
-      gf->nodeColor = RED;
-      if (gf->parent->nodeColor == RED) balanceTree(gf);
+      gf->setColor(RED);
+      if (gf->parent()->color() == RED) balanceTree(gf);
     }
   } else if(gf){
-    if(gf->right == ptr->parent) balanceTree_1(ptr);
+    if(gf->right == ptr->parent()) balanceTree_1(ptr);
     else balanceTree_2(ptr);
   }
 }
 
-template <typename T>
-void RB_Tree<T>::balanceTree_1(Node<T> *ptr) {
-  Node<T> *father = ptr->parent;
+template <typename T, typename Compare, bool Threaded>
+void RB_Tree<T, Compare, Threaded>::balanceTree_1(Node<T, Threaded> *ptr) {
+  Node<T, Threaded> *father = ptr->parent();
   if (father->left == ptr) {
     father->left = ptr->right;
-    if(ptr->right) ptr->right->parent = father;
+    if(ptr->right) ptr->right->setParent(father);
     ptr->right = father;
-    ptr->parent = father->parent;
-    father->parent->right = ptr;
-    father->parent = ptr;
+    ptr->setParent(father->parent());
+    father->parent()->right = ptr;
+    father->setParent(ptr);
     rotateLeft(ptr);
   } else rotateLeft(father);
 }
 
-template <typename T>
-void RB_Tree<T>::balanceTree_2(Node<T> *ptr) {
-  Node<T> *father = ptr->parent;
+template <typename T, typename Compare, bool Threaded>
+void RB_Tree<T, Compare, Threaded>::balanceTree_2(Node<T, Threaded> *ptr) {
+  Node<T, Threaded> *father = ptr->parent();
   if (father->right == ptr) {
     father->right = ptr->left;
-    if(ptr->left) ptr->left->parent = father;
+    if(ptr->left) ptr->left->setParent(father);
     ptr->left = father;
-    ptr->parent = father->parent;
-    father->parent->left = ptr;
-    father->parent = ptr;
+    ptr->setParent(father->parent());
+    father->parent()->left = ptr;
+    father->setParent(ptr);
     rotateRight(ptr);
   } else rotateRight(father);
 }
 
-template <typename T>
-Node<T> *RB_Tree<T>::findNode(Node<T> *node, const T &volum) {
-  if (node == nullptr || node->data == volum) {
+/*Сравниваются только ключи: key может быть ключом, а не целым элементом.
+Если знак получается за одно сравнение, спуск останавливается на первом
+равном ключе. Иначе на каждом уровне одно сравнение key_less: ищется
+первый ключ не меньше key, и в конце он один раз проверяется на равенство.*/
+template <typename T, typename Compare, bool Threaded>
+template <typename K>
+Node<T, Threaded> *
+RB_Tree<T, Compare, Threaded>::findNode(Node<T, Threaded> *node,
+                                        const K &key) const {
+  using Key = typename KeyOf<T>::type;
+  if constexpr (KeyOrder<Compare>::template three_way<K, Key>) {
+    while (node) {
+      int sign = order(key, KeyOf<T>::get(node->data));
+      if (sign == 0) break;
+      node = sign < 0 ? node->left : node->right;
+    }
     return node;
   }
+  Node<T, Threaded> *result = nullptr;
+  while (node) {
+    if (key_less(KeyOf<T>::get(node->data), key)) {
+      node = node->right;
+    } else {
+      result = node;
+      node = node->left;
+    }
+  }
+  if (result && key_less(key, KeyOf<T>::get(result->data))) result = nullptr;
+  return result;
+}
 
-  if (volum < node->data) {
-    return findNode(node->left, volum);
-  } else {
-    return findNode(node->right, volum);
+template <typename T, typename Compare, bool Threaded>
+template <typename K>
+Node<T, Threaded> *
+RB_Tree<T, Compare, Threaded>::lowerNode(const K &key) const {
+  Node<T, Threaded> *result = nullptr;
+  Node<T, Threaded> *node = root;
+  while (node) {
+    if (key_less(KeyOf<T>::get(node->data), key)) {
+      node = node->right;
+    } else {
+      result = node;
+      node = node->left;
+    }
   }
+  return result;
 }
 
-template <typename T>
-void RB_Tree<T>::printTree(Node<T> *node, int indent) const {
+template <typename T, typename Compare, bool Threaded>
+template <typename K>
+size_t RB_Tree<T, Compare, Threaded>::eraseKey(const K &key) {
+  Node<T, Threaded> *node = findNode(root, key);
+  if (!node) return 0;
+  remove(node);
+  return 1;
+}
+
+template <typename T, typename Compare, bool Threaded>
+void RB_Tree<T, Compare, Threaded>::printTree(Node<T, Threaded> *node,
+                                              int indent) const {
   if (node) {
     printTree(node->right, indent + 1);
     for (int i = 0; i < indent; ++i) std::cout << ".";
     std::cout << node->data << ":"
-              << (node->nodeColor == BLACK ? "BLACK" : "RED") << std::endl;
+              << (node->color() == BLACK ? "BLACK" : "RED") << std::endl;
     printTree(node->left, indent + 1);
   }
 }
@@ -356,7 +579,7 @@ void RB_Tree<T>::printTree(Node<T> *node, int indent) const {
 // Этот подход к удалению узла и его потомков
 // рабочий, но требует больших затрат памяти
 /*template <typename T> 
-void RB_Tree<T>::clear(Node<T> *node) {
+void RB_Tree<T, Compare, Threaded>::clear(Node<T, Threaded> *node) {
   if (node) {
     clear(node->left);
     clear(node->right);
@@ -366,12 +589,12 @@ void RB_Tree<T>::clear(Node<T> *node) {
 
 // Более эффективный подход к удалению, требует меньше
 // памяти, т.к. сразу подтирает узел.
-template <typename T>
-void RB_Tree<T>::clear(Node<T> *node) {
+template <typename T, typename Compare, bool Threaded>
+void RB_Tree<T, Compare, Threaded>::clear(Node<T, Threaded> *node) {
   if (node) {
     // Сохраняем потомков текущего узла
-    Node<T> *leftChild = node->left;
-    Node<T> *rightChild = node->right;
+    Node<T, Threaded> *leftChild = node->left;
+    Node<T, Threaded> *rightChild = node->right;
 
     // Удаляем текущий узел
     delete node;
@@ -386,350 +609,482 @@ void RB_Tree<T>::clear(Node<T> *node) {
   }
 }
 
-// вставка
-template <typename T>
-void RB_Tree<T>::push(Node<T> *startnode,  const T data) {
-  Node<T> *newnode = startnode;
-  Node<T> *father = nullptr;
-  int right = 0;
-  while (newnode != nullptr) {
-    father = newnode;
-    std:: cout << data << std::endl;
-    std:: cout << newnode->data << std::endl;
-    if (data > newnode->data) {
-      newnode = newnode->right;
-      right = 1;
-    } else if(data < newnode->data){
-      newnode = newnode->left;
-      right = 0;
-    } else return;
-  }
-
-  newnode = new Node<T>(data);
-  newnode->parent = father;
+/*Спуск для вставки: одно сравнение ключей на уровень. Возвращает узел с
+ключом key или nullptr и тогда отца и сторону для нового узла. Повтор
+ключа при обычном Compare проверяется один раз у ближайшего меньшего или
+равного узла.*/
+template <typename T, typename Compare, bool Threaded>
+Node<T, Threaded> *
+RB_Tree<T, Compare, Threaded>::descendUnique(Node<T, Threaded> *startnode,
+                                             const typename KeyOf<T>::type &key,
+                                             Node<T, Threaded> *&father,
+                                             int &right) const {
+  Node<T, Threaded> *node = startnode;
+  Node<T, Threaded> *candidate = nullptr;
+  father = nullptr;
+  right = 0;
+  while (node != nullptr) {
+    if constexpr (KeyOrder<Compare>::template three_way<
+                      typename KeyOf<T>::type, typename KeyOf<T>::type>) {
+      int sign = order(key, KeyOf<T>::get(node->data));
+      if (sign == 0) return node;
+      right = sign > 0;
+    } else {
+      right = !key_less(key, KeyOf<T>::get(node->data));
+      if (right) candidate = node;
+    }
+    father = node;
+    node = right ? node->right : node->left;
+  }
+  if (candidate && !key_less(KeyOf<T>::get(candidate->data), key))
+    return candidate;
+  return nullptr;
+}
+
+// Подвешивает новый узел к father (справа при right == 1) и балансирует
+template <typename T, typename Compare, bool Threaded>
+Node<T, Threaded> *
+RB_Tree<T, Compare, Threaded>::link(Node<T, Threaded> *father, int right,
+                                    Node<T, Threaded> *newnode) {
+  newnode->setParent(father);
+  if constexpr (Threaded) {
+    // Новый лист встает в список между соседями по порядку
+    if (father) {
+      Node<T, Threaded> *after = right == 1 ? father->next : father;
+      Node<T, Threaded> *before = right == 1 ? father : father->prev;
+      chain(before, newnode);
+      chain(newnode, after);
+    }
+  }
   if (father) {
     if (right == 1) father->right = newnode;
     else father->left = newnode;
-    if (newnode->parent->nodeColor == RED) balanceTree(newnode);
+    if (newnode->parent()->color() == RED) balanceTree(newnode);
   } else {
-    newnode->nodeColor = BLACK;
+    newnode->setColor(BLACK);
     root = newnode;
   }
   ++tree_size;
+  return newnode;
 }
 
-template <typename T>
-void RB_Tree<T>::push(const T data) {
-  push(root, data);
+// вставка за один спуск: возвращает новый узел или узел с тем же ключом
+template <typename T, typename Compare, bool Threaded>
+Node<T, Threaded> *
+RB_Tree<T, Compare, Threaded>::push(Node<T, Threaded> *startnode,
+                                    const T data) {
+  Node<T, Threaded> *father = nullptr;
+  int right = 0;
+  Node<T, Threaded> *found =
+      descendUnique(startnode, KeyOf<T>::get(data), father, right);
+  if (found) return found;
+  return link(father, right, new Node<T, Threaded>(data));
 }
 
-template <typename T>
-void RB_Tree<T>::push(Node<T> *startnode, Node <T> *ptr){
-  T data = ptr->data;
-  COLOR curren_color = ptr->nodeColor;
-  push(startnode, data);
-  Node<T> *newnode = find(data);
-  if(newnode->nodeColor != curren_color) colorChange(ptr);
-  if(ptr->right){
-    newnode->right = ptr->right;
-    ptr->right->parent = newnode;
-  }
-  if(ptr->left){
-    newnode->left = ptr->left;
-    ptr->left->parent = newnode;
-  }
-  delete ptr;
+template <typename T, typename Compare, bool Threaded>
+Node<T, Threaded> *RB_Tree<T, Compare, Threaded>::push(const T data) {
+  return push(root, data);
 }
 
-template <typename T>
-Node<T> *RB_Tree<T>::find(const T &volum) {
-  Node<T> *result = findNode(root, volum);
+template <typename T, typename Compare, bool Threaded>
+Node<T, Threaded> *RB_Tree<T, Compare, Threaded>::find(const T &volum) {
+  Node<T, Threaded> *result = findNode(root, KeyOf<T>::get(volum));
   return result;
 }
 
-template <typename T>
-void RB_Tree<T>::colorChange(Node<T> *ptr){
-  if(ptr) {
-    ptr->nodeColor = (ptr->nodeColor == RED ? BLACK: RED);
-    colorChange(ptr->left);
-    colorChange(ptr->right);
-  }
+template <typename T, typename Compare, bool Threaded>
+template <typename K, transparent_t<Compare, K>>
+Node<T, Threaded> *RB_Tree<T, Compare, Threaded>::find(const K &key) {
+  return findNode(root, key);
 }
 
-template <typename T>
-void RB_Tree<T>::print() {
+template <typename T, typename Compare, bool Threaded>
+bool RB_Tree<T, Compare, Threaded>::contains(const key_type &key) const {
+  return findNode(root, key) != nullptr;
+}
+
+template <typename T, typename Compare, bool Threaded>
+template <typename K, transparent_t<Compare, K>>
+bool RB_Tree<T, Compare, Threaded>::contains(const K &key) const {
+  return findNode(root, key) != nullptr;
+}
+
+template <typename T, typename Compare, bool Threaded>
+typename RB_Tree<T, Compare, Threaded>::size_type
+RB_Tree<T, Compare, Threaded>::count(const key_type &key) const {
+  return contains(key);
+}
+
+template <typename T, typename Compare, bool Threaded>
+template <typename K, transparent_t<Compare, K>>
+typename RB_Tree<T, Compare, Threaded>::size_type
+RB_Tree<T, Compare, Threaded>::count(const K &key) const {
+  return contains(key);
+}
+
+template <typename T, typename Compare, bool Threaded>
+typename RB_Tree<T, Compare, Threaded>::size_type
+RB_Tree<T, Compare, Threaded>::erase(const key_type &key) {
+  return eraseKey(key);
+}
+
+template <typename T, typename Compare, bool Threaded>
+template <typename K, transparent_t<Compare, K>>
+typename RB_Tree<T, Compare, Threaded>::size_type
+RB_Tree<T, Compare, Threaded>::erase(const K &key) {
+  return eraseKey(key);
+}
+
+template <typename T, typename Compare, bool Threaded>
+void RB_Tree<T, Compare, Threaded>::swapColors(Node<T, Threaded> *a,
+                                               Node<T, Threaded> *b) {
+  COLOR color = a->color();
+  a->setColor(b->color());
+  b->setColor(color);
+}
+
+template <typename T, typename Compare, bool Threaded>
+void RB_Tree<T, Compare, Threaded>::print() {
   printTree(root);
 }
 
-template <typename T>
-Node<T>* RB_Tree<T>::copyTree(Node<T>* node, Node<T>* parent) {
+template <typename T, typename Compare, bool Threaded>
+Node<T, Threaded>*
+RB_Tree<T, Compare, Threaded>::copyTree(Node<T, Threaded>* node,
+                                        Node<T, Threaded>* parent) {
     if (!node) return nullptr;
-    Node<T>* newNode = new Node<T>(node->data);
-    newNode->nodeColor = node->nodeColor;
-    newNode->parent = parent;
+    Node<T, Threaded>* newNode = new Node<T, Threaded>(node->data);
+    newNode->setColor(node->color());
+    newNode->setParent(parent);
     newNode->left = copyTree(node->left, newNode);
     newNode->right = copyTree(node->right, newNode);
     return newNode;
 }
 
-template <typename T>
-template <typename K, typename std::enable_if_t<std::is_same_v<K, T>, int>>
-T& RB_Tree<T>::at(const T& key) {
-  Node<T>* node = findNode(root, key);
+template <typename T, typename Compare, bool Threaded>
+template <typename K, typename std::enable_if_t<KeyOf<K>::plain, int>>
+T& RB_Tree<T, Compare, Threaded>::at(const T& key) {
+  Node<T, Threaded>* node = findNode(root, key);
   if (node == nullptr) {
     throw std::out_of_range("Key not found");
   }
   return node->data;
 }
 
-template <typename T>
-template <typename K, typename std::enable_if_t<!std::is_same_v<K, T>, int>>
-T& RB_Tree<T>::at(const typename K::key_type& key) {
-  Node<T>* node = findNode(root, T(key, T()));
+template <typename T, typename Compare, bool Threaded>
+template <typename K, typename std::enable_if_t<!KeyOf<K>::plain, int>>
+T& RB_Tree<T, Compare, Threaded>::at(const typename K::key_type& key) {
+  Node<T, Threaded>* node = findNode(root, key);
   if (node == nullptr) {
     throw std::out_of_range("Key not found");
   }
   return node->data;
 }
 
-template <typename T>
-template <typename K, typename std::enable_if_t<std::is_same_v<K, T>, int>>
-T& RB_Tree<T>::operator[](const T& key) {
-  Node<T>* node = findNode(root, key);
-  if (node == nullptr) {
-    push(key);
-    node = findNode(root, key);
-  }
-  return node->data;
+template <typename T, typename Compare, bool Threaded>
+template <typename K, typename std::enable_if_t<KeyOf<K>::plain, int>>
+T& RB_Tree<T, Compare, Threaded>::operator[](const T& key) {
+  return push(root, key)->data;
 }
 
-template <typename T>
-template <typename K, typename std::enable_if_t<!std::is_same_v<K, T>, int>>
-T& RB_Tree<T>::operator[](const typename K::key_type& key) {
-  Node<T>* node = findNode(root, T(key, T()));
+template <typename T, typename Compare, bool Threaded>
+template <typename K, typename std::enable_if_t<!KeyOf<K>::plain, int>>
+T& RB_Tree<T, Compare, Threaded>::operator[](const typename K::key_type& key) {
+  // Один спуск по ключу, элемент с данными по умолчанию строится только
+  // для нового ключа
+  Node<T, Threaded> *father = nullptr;
+  int right = 0;
+  Node<T, Threaded> *node = descendUnique(root, key, father, right);
   if (node == nullptr) {
-    push(T(key, T()));
-    node = findNode(root, T(key, T()));
+    node = link(father, right,
+                new Node<T, Threaded>(T{key, typename K::mapped_type()}));
   }
   return node->data;
 }
 
 // Определение метода empty
-template <typename T>
-bool RB_Tree<T>::empty() {
+template <typename T, typename Compare, bool Threaded>
+bool RB_Tree<T, Compare, Threaded>::empty() {
   return tree_size == 0;
 }
 
 // Определение метода size
-template <typename T>
-typename RB_Tree<T>::size_type RB_Tree<T>::size() {
+template <typename T, typename Compare, bool Threaded>
+typename RB_Tree<T, Compare, Threaded>::size_type
+RB_Tree<T, Compare, Threaded>::size() {
   return tree_size;
 }
 
 // Определение метода max_size
-template <typename T>
-typename RB_Tree<T>::size_type RB_Tree<T>::max_size() {
-  return std::numeric_limits<size_type>::max() / sizeof(Node<T>) / 2;
+template <typename T, typename Compare, bool Threaded>
+typename RB_Tree<T, Compare, Threaded>::size_type
+RB_Tree<T, Compare, Threaded>::max_size() {
+  return std::numeric_limits<size_type>::max() / sizeof(Node<T, Threaded>) / 2;
 }
 
 // Определения методов и операторов класса iterator
-template <typename T>
-RB_Tree<T>::iterator::iterator(Node<T> *node) : current(node) {}
-
-template <typename T>
-typename RB_Tree<T>::iterator& RB_Tree<T>::iterator::operator++() {
+template <typename T, typename Compare, bool Threaded>
+RB_Tree<T, Compare, Threaded>::iterator::iterator(
+    Node<T, Threaded> *node) : current(node) {}
+
+template <typename T, typename Compare, bool Threaded>
+typename RB_Tree<T, Compare, Threaded>::iterator&
+RB_Tree<T, Compare, Threaded>::iterator::operator++() {
+  if constexpr (Threaded) {
+    current = current->next;
+    return *this;
+  }
   if(current->right){
     current = current->right;
     while(current->left) current = current->left;
   } else {
-    Node<T> *father = current->parent;
+    Node<T, Threaded> *father = current->parent();
     while(father && current == father->right){
       current = father;
-      father = father->parent;
+      father = father->parent();
     }
     current = father;
   }
   return *this;
 }
 
-template <typename T>
-typename RB_Tree<T>::iterator& RB_Tree<T>::iterator::operator--() {
+template <typename T, typename Compare, bool Threaded>
+typename RB_Tree<T, Compare, Threaded>::iterator&
+RB_Tree<T, Compare, Threaded>::iterator::operator--() {
+  if constexpr (Threaded) {
+    current = current->prev;
+    return *this;
+  }
   if(current->left) {
     current = current->left;
     while(current->right) current = current->right;
   } else {
-    Node<T> *father = current->parent;
+    Node<T, Threaded> *father = current->parent();
     while(father && current == father->left){
       current = father;
-      father = father->parent;
+      father = father->parent();
     }
     current = father;
   }
   return *this;
 }
 
-template <typename T>
-typename RB_Tree<T>::iterator RB_Tree<T>::iterator::operator++(int) {
+template <typename T, typename Compare, bool Threaded>
+typename RB_Tree<T, Compare, Threaded>::iterator
+RB_Tree<T, Compare, Threaded>::iterator::operator++(int) {
   iterator temp = *this;
   ++(*this);
   return temp;
 }
 
-template <typename T>
-typename RB_Tree<T>::iterator RB_Tree<T>::iterator::operator--(int) {
+template <typename T, typename Compare, bool Threaded>
+typename RB_Tree<T, Compare, Threaded>::iterator
+RB_Tree<T, Compare, Threaded>::iterator::operator--(int) {
   iterator temp = *this;
   --(*this);
   return temp;
 }
 
-template <typename T>
-bool RB_Tree<T>::iterator::operator==(const iterator &other) const {
+template <typename T, typename Compare, bool Threaded>
+bool RB_Tree<T, Compare, Threaded>::iterator::operator==(
+    const iterator &other) const {
   return current == other.current;
 }
 
-template <typename T>
-bool RB_Tree<T>::iterator::operator!=(const iterator &other) const {
+template <typename T, typename Compare, bool Threaded>
+bool RB_Tree<T, Compare, Threaded>::iterator::operator!=(
+    const iterator &other) const {
   return current != other.current;
 }
 
-template <typename T>
-bool RB_Tree<T>::iterator::operator>(const iterator &other) const {
+template <typename T, typename Compare, bool Threaded>
+bool RB_Tree<T, Compare, Threaded>::iterator::operator>(
+    const iterator &other) const {
   return current->data > other.current->data;
 }
 
-template <typename T>
-bool RB_Tree<T>::iterator::operator<(const iterator &other) const {
+template <typename T, typename Compare, bool Threaded>
+bool RB_Tree<T, Compare, Threaded>::iterator::operator<(
+    const iterator &other) const {
   return current->data < other.current->data;
 }
 
-template <typename T>
-T& RB_Tree<T>::iterator::operator*() const {
+template <typename T, typename Compare, bool Threaded>
+T& RB_Tree<T, Compare, Threaded>::iterator::operator*() const {
   return current->data;
 }
 
-template <typename T>
-T* RB_Tree<T>::iterator::operator->() const {
+template <typename T, typename Compare, bool Threaded>
+T* RB_Tree<T, Compare, Threaded>::iterator::operator->() const {
   return &current->data;
 }
 
 // Определения методов и операторов класса const_iterator
-template <typename T>
-RB_Tree<T>::const_iterator::const_iterator(const Node<T> *node) : current(node) {}
-
-template <typename T>
-typename RB_Tree<T>::const_iterator& RB_Tree<T>::const_iterator::operator++() {
+template <typename T, typename Compare, bool Threaded>
+RB_Tree<T, Compare, Threaded>::const_iterator::const_iterator(
+    const Node<T, Threaded> *node) : current(node) {}
+
+template <typename T, typename Compare, bool Threaded>
+typename RB_Tree<T, Compare, Threaded>::const_iterator&
+RB_Tree<T, Compare, Threaded>::const_iterator::operator++() {
+  if constexpr (Threaded) {
+    current = current->next;
+    return *this;
+  }
   if(current->right){
     current = current->right;
     while(current->left) current = current->left;
   } else {
-    const Node<T> *father = current->parent;
+    const Node<T, Threaded> *father = current->parent();
     while(father && current == father->right){
       current = father;
-      father = father->parent;
+      father = father->parent();
     }
     current = father;
   }
   return *this;
 }
 
-template <typename T>
-typename RB_Tree<T>::const_iterator& RB_Tree<T>::const_iterator::operator--() {
+template <typename T, typename Compare, bool Threaded>
+typename RB_Tree<T, Compare, Threaded>::const_iterator&
+RB_Tree<T, Compare, Threaded>::const_iterator::operator--() {
+  if constexpr (Threaded) {
+    current = current->prev;
+    return *this;
+  }
   if(current->left) {
     current = current->left;
     while(current->right) current = current->right;
   } else {
-    const Node<T> *father = current->parent;
+    const Node<T, Threaded> *father = current->parent();
     while(father && current == father->left){
       current = father;
-      father = father->parent;
+      father = father->parent();
     }
     current = father;
   }
   return *this;
 }
 
-template <typename T>
-typename RB_Tree<T>::const_iterator RB_Tree<T>::const_iterator::operator++(int) {
+template <typename T, typename Compare, bool Threaded>
+typename RB_Tree<T, Compare, Threaded>::const_iterator
+RB_Tree<T, Compare, Threaded>::const_iterator::operator++(int) {
   const_iterator temp = *this;
   ++(*this);
   return temp;
 }
 
-template <typename T>
-typename RB_Tree<T>::const_iterator RB_Tree<T>::const_iterator::operator--(int) {
+template <typename T, typename Compare, bool Threaded>
+typename RB_Tree<T, Compare, Threaded>::const_iterator
+RB_Tree<T, Compare, Threaded>::const_iterator::operator--(int) {
   const_iterator temp = *this;
   --(*this);
   return temp;
 }
 
-template <typename T>
-bool RB_Tree<T>::const_iterator::operator==(const const_iterator &other) const {
+template <typename T, typename Compare, bool Threaded>
+bool RB_Tree<T, Compare, Threaded>::const_iterator::operator==(
+    const const_iterator &other) const {
   return current == other.current;
 }
 
-template <typename T>
-bool RB_Tree<T>::const_iterator::operator!=(const const_iterator &other) const {
+template <typename T, typename Compare, bool Threaded>
+bool RB_Tree<T, Compare, Threaded>::const_iterator::operator!=(
+    const const_iterator &other) const {
   return current != other.current;
 }
 
-template <typename T>
-bool RB_Tree<T>::const_iterator::operator>(const const_iterator &other) const {
+template <typename T, typename Compare, bool Threaded>
+bool RB_Tree<T, Compare, Threaded>::const_iterator::operator>(
+    const const_iterator &other) const {
   return current->data > other.current->data;
 }
 
-template <typename T>
-bool RB_Tree<T>::const_iterator::operator<(const const_iterator &other) const {
+template <typename T, typename Compare, bool Threaded>
+bool RB_Tree<T, Compare, Threaded>::const_iterator::operator<(
+    const const_iterator &other) const {
   return current->data < other.current->data;
 }
 
-template <typename T>
-const T& RB_Tree<T>::const_iterator::operator*() const {
+template <typename T, typename Compare, bool Threaded>
+const T& RB_Tree<T, Compare, Threaded>::const_iterator::operator*() const {
   return current->data;
 }
 
-template <typename T>
-const T* RB_Tree<T>::const_iterator::operator->() const {
+template <typename T, typename Compare, bool Threaded>
+const T* RB_Tree<T, Compare, Threaded>::const_iterator::operator->() const {
   return &current->data;
 }
 
 // Определения методов begin и end
-template <typename T>
-typename RB_Tree<T>::iterator RB_Tree<T>::begin() {
-  Node<T> *node = root;
+template <typename T, typename Compare, bool Threaded>
+typename RB_Tree<T, Compare, Threaded>::iterator
+RB_Tree<T, Compare, Threaded>::begin() {
+  Node<T, Threaded> *node = root;
   while (node && node->left) {
     node = node->left;
   }
   return iterator(node);
 }
 
-template <typename T>
-typename RB_Tree<T>::iterator RB_Tree<T>::end() {
+template <typename T, typename Compare, bool Threaded>
+typename RB_Tree<T, Compare, Threaded>::iterator
+RB_Tree<T, Compare, Threaded>::end() {
   return iterator(nullptr);
 }
 
-template <typename T>
-typename RB_Tree<T>::const_iterator RB_Tree<T>::begin() const {
-  const Node<T> *node = root;
+template <typename T, typename Compare, bool Threaded>
+typename RB_Tree<T, Compare, Threaded>::const_iterator
+RB_Tree<T, Compare, Threaded>::begin() const {
+  const Node<T, Threaded> *node = root;
   while (node && node->left) {
     node = node->left;
   }
   return const_iterator(node);
 }
 
-template <typename T>
-typename RB_Tree<T>::const_iterator RB_Tree<T>::end() const {
+template <typename T, typename Compare, bool Threaded>
+typename RB_Tree<T, Compare, Threaded>::const_iterator
+RB_Tree<T, Compare, Threaded>::end() const {
   return const_iterator(nullptr);
 }
 
+template <typename T, typename Compare, bool Threaded>
+typename RB_Tree<T, Compare, Threaded>::iterator
+RB_Tree<T, Compare, Threaded>::lower_bound(const key_type &key) {
+  return iterator(lowerNode(key));
+}
+
+template <typename T, typename Compare, bool Threaded>
+typename RB_Tree<T, Compare, Threaded>::const_iterator
+RB_Tree<T, Compare, Threaded>::lower_bound(const key_type &key) const {
+  return const_iterator(lowerNode(key));
+}
+
+template <typename T, typename Compare, bool Threaded>
+template <typename K, transparent_t<Compare, K>>
+typename RB_Tree<T, Compare, Threaded>::iterator
+RB_Tree<T, Compare, Threaded>::lower_bound(const K &key) {
+  return iterator(lowerNode(key));
+}
+
+template <typename T, typename Compare, bool Threaded>
+template <typename K, transparent_t<Compare, K>>
+typename RB_Tree<T, Compare, Threaded>::const_iterator
+RB_Tree<T, Compare, Threaded>::lower_bound(const K &key) const {
+  return const_iterator(lowerNode(key));
+}
+
 // Определение метода erase
-template <typename T>
-void RB_Tree<T>::erase(iterator pos) {
+template <typename T, typename Compare, bool Threaded>
+void RB_Tree<T, Compare, Threaded>::erase(iterator pos) {
   if (pos == end()) return;
-  remove(pos->data);
+  remove(pos.current);
 }
 
-template <typename T>
-void RB_Tree<T>::swap(RB_Tree<T>& other) {
+template <typename T, typename Compare, bool Threaded>
+void RB_Tree<T, Compare, Threaded>::swap(RB_Tree<T, Compare, Threaded>& other) {
+  std::swap(comp, other.comp);
   // Меняем местами корни деревьев
   std::swap(root, other.root);
   // Меняем местами размеры деревьев
@@ -748,26 +1103,43 @@ void RB_Tree<T>::swap(RB_Tree<T>& other) {
 для потомков. Таким образом мы реализуем слияние двух деревьев и 
 автоматическое удаления второго дерева.
 */
-template <typename T>
-void RB_Tree<T>::merge(RB_Tree<T>& other) {
+template <typename T, typename Compare, bool Threaded>
+void
+RB_Tree<T, Compare, Threaded>::merge(RB_Tree<T, Compare, Threaded>& other) {
+    // Слияние с самим собой ничего не меняет
+    if (this == &other) return;
+
     // Если текущее дерево меньше, меняем деревья местами
     if (this->size() < other.size()) {
         std::swap(this->root, other.root);
         std::swap(this->tree_size, other.tree_size);
     }
 
-    // Вставляем элементы из другого дерева в текущее дерево
-    mergeRecursive(other.root);
+    // Вставляем элементы из другого дерева в текущее дерево. С нитями
+    // узлы идут списком: следующий известен до удаления текущего, а узлы
+    // впереди подгружаются заранее
+    if constexpr (Threaded) {
+        auto insert = [this](Node<T, Threaded> *node) {
+            push(node->data);
+            delete node;
+        };
+        iterator first(other.root);
+        while (first.current && first.current->left)
+            first.current = first.current->left;
+        scan(first, iterator(nullptr), prefetch_distance, insert);
+    } else {
+        mergeRecursive(other.root);
+    }
     other.root = nullptr; // Обнуляем корень второго дерева
     other.tree_size = 0;  // Обнуляем размер второго дерева
 }
 
-template <typename T>
-void RB_Tree<T>::mergeRecursive(Node<T>* node) {
+template <typename T, typename Compare, bool Threaded>
+void RB_Tree<T, Compare, Threaded>::mergeRecursive(Node<T, Threaded>* node) {
     if (node) {
         // Сохраняем потомков текущего узла
-        Node<T>* leftChild = node->left;
-        Node<T>* rightChild = node->right;
+        Node<T, Threaded>* leftChild = node->left;
+        Node<T, Threaded>* rightChild = node->right;
 
         // Вставляем текущий узел в текущее дерево
         push(node->data);
@@ -788,69 +1160,221 @@ void RB_Tree<T>::mergeRecursive(Node<T>* node) {
 с автоматическим удалением второго дерева, всегда используя текущее дерево в 
 качестве основного.*/
 
-template <typename T>
-void RB_Tree<T>::remove(const T &volume){
-  Node<T> *ptr = find(volume);
-  if(!ptr) return;
-  if(ptr != root){
-
-    if(ptr->parent->left == ptr) ptr->parent->left = nullptr;
-    else ptr->parent->right = nullptr;
-    
-    Node<T>* leftChild = ptr->left;
-    Node<T>* rightChild = ptr->right;
+template <typename T, typename Compare, bool Threaded>
+void RB_Tree<T, Compare, Threaded>::chain(Node<T, Threaded> *prev,
+                                          Node<T, Threaded> *next) {
+  if constexpr (Threaded) {
+    if (prev) prev->next = next;
+    if (next) next->prev = prev;
+  }
+}
 
-    delete ptr;
-    --tree_size;
+// Прошивает поддерево по порядку вслед за prev, возвращает его последний узел.
+// Правый край идет циклом, рекурсия только налево
+template <typename T, typename Compare, bool Threaded>
+Node<T, Threaded> *
+RB_Tree<T, Compare, Threaded>::threadSubtree(Node<T, Threaded> *node,
+                                             Node<T, Threaded> *prev) {
+  while (node) {
+    if (node->left) prev = threadSubtree(node->left, prev);
+    chain(prev, node);
+    prev = node;
+    node = node->right;
+  }
+  return prev;
+}
 
-    if(leftChild){
-      mergeRecursive(leftChild);
-      //leftChild = nullptr;
+// Список по порядку открыт с обоих концов: prev первого и next последнего
+// узла пустые, как end() у итераторов
+template <typename T, typename Compare, bool Threaded>
+void RB_Tree<T, Compare, Threaded>::threadAll() {
+  if constexpr (Threaded) {
+    Node<T, Threaded> *last = threadSubtree(root, nullptr);
+    if (root) {
+      Node<T, Threaded> *first = root;
+      while (first->left) first = first->left;
+      first->prev = nullptr;
+      last->next = nullptr;
     }
-    if(rightChild){
-      mergeRecursive(rightChild);
-      //rightChild = nullptr;
+  }
+}
+
+template <typename T, typename Compare, bool Threaded>
+void RB_Tree<T, Compare, Threaded>::prefetch(const Node<T, Threaded> *node) {
+#if defined(__GNUC__)
+  if (node) __builtin_prefetch(node);
+#else
+  (void)node;
+#endif
+}
+
+// Обход [first, last) с подгрузкой узла на distance шагов впереди. first
+// сдвигается до вызова visit, поэтому visit может освободить свой узел
+template <typename T, typename Compare, bool Threaded>
+template <typename It, typename Visit>
+void RB_Tree<T, Compare, Threaded>::scan(It first, It last, size_t distance,
+                                         Visit &visit) {
+  It ahead = first;
+  for (size_t i = 0; i < distance && ahead != last; ++i) ++ahead;
+  while (first != last) {
+    if (ahead != last) {
+      prefetch(ahead.current);
+      ++ahead;
     }
-  } else removeRoot(ptr);
+    auto *node = first.current;
+    ++first;
+    visit(node);
+  }
 }
 
-/*Второй случай, когда удаляем узел, который является корнем особый:
-при этом образуются два поддерева, левое и правое. Логика должна быть
-такая же, как в случае слияния двух деревьев. Только для ускорения
-процесса слияния необходимо определить поддерево с максимальным размером,
-чтобы в него вставлять узлы поддерева с минимаальным размером.
-Для этого нужен метод подсчета узлов в дереве. И достаточно посчитать
-колличество тольк в одном дереве, т.к. во втором его можно вычислить*/
+template <typename T, typename Compare, bool Threaded>
+template <typename Visit>
+void RB_Tree<T, Compare, Threaded>::for_each(Visit visit, size_type distance) {
+  auto call = [&visit](Node<T, Threaded> *node) { visit(node->data); };
+  scan(begin(), end(), distance, call);
+}
 
-template <typename T>
-void RB_Tree<T>::removeRoot(Node<T> *node){
-  Node<T> *left_root = root->left;
-  Node<T> *right_root = root->right;
-  if(left_root) left_root->parent = nullptr;
-  if(right_root) right_root->parent = nullptr;
-  if(nodeCounting(left_root) >= tree_size / 2){
-    left_root->nodeColor = BLACK;  
-    root = left_root;
-    delete node;
-    --tree_size;
-    mergeRecursive(right_root);
+template <typename T, typename Compare, bool Threaded>
+template <typename Visit>
+void RB_Tree<T, Compare, Threaded>::for_each(Visit visit,
+                                             size_type distance) const {
+  auto call = [&visit](const Node<T, Threaded> *node) { visit(node->data); };
+  scan(begin(), end(), distance, call);
+}
+
+// Черная высота поддерева node с учетом пустых листьев или -1, если
+// инвариант нарушен. prev - предыдущий по порядку узел перед поддеревом
+template <typename T, typename Compare, bool Threaded>
+int RB_Tree<T, Compare, Threaded>::checkSubtree(
+    const Node<T, Threaded> *node, const Node<T, Threaded> *father,
+    const Node<T, Threaded> *&prev) const {
+  if (!node) return 1;
+  if (node->parent() != father) return -1;
+  if (node->color() == RED && father && father->color() == RED) return -1;
+  int left = checkSubtree(node->left, node, prev);
+  if (left < 0) return -1;
+  if (prev && !key_less(KeyOf<T>::get(prev->data), KeyOf<T>::get(node->data)))
+    return -1;
+  prev = node;
+  int right = checkSubtree(node->right, node, prev);
+  if (right != left) return -1;
+  return left + (node->color() == BLACK);
+}
+
+template <typename T, typename Compare, bool Threaded>
+bool RB_Tree<T, Compare, Threaded>::valid() const {
+  if (!root) return tree_size == 0;
+  if (root->color() != BLACK) return false;
+  const Node<T, Threaded> *prev = nullptr;
+  if (checkSubtree(root, nullptr, prev) < 0) return false;
+  size_type count = 0;
+  for (auto it = begin(); it != end(); ++it) ++count;
+  return count == tree_size;
+}
+
+template <typename T, typename Compare, bool Threaded>
+void RB_Tree<T, Compare, Threaded>::remove(const T &volume){
+  remove(find(volume));
+}
+
+/*Удаление узла на месте: если у узла два потомка, на его место
+перевешивается следующий по порядку узел (минимальный в правом поддереве),
+после чего удаляемый узел имеет не более одного потомка и просто вырезается.
+Поддеревья не перестраиваются и узлы не перевыделяются, а черная высота
+восстанавливается поворотами и перекраской в eraseBalance за O(log n).*/
+template <typename T, typename Compare, bool Threaded>
+void RB_Tree<T, Compare, Threaded>::remove(Node<T, Threaded> *ptr){
+  if(!ptr) return;
+  if constexpr (Threaded) chain(ptr->prev, ptr->next);
+  Node<T, Threaded> *child = nullptr;
+  Node<T, Threaded> *father = nullptr;
+  if(ptr->left && ptr->right){
+    Node<T, Threaded> *next = ptr->right;
+    while(next->left) next = next->left;
+    child = next->right;
+    if(next->parent() == ptr){
+      father = next;
+    } else {
+      father = next->parent();
+      father->left = child;
+      if(child) child->setParent(father);
+      next->right = ptr->right;
+      ptr->right->setParent(next);
+    }
+    next->left = ptr->left;
+    ptr->left->setParent(next);
+    replaceNode(ptr, next);
+    // next занимает место ptr вместе с его цветом
+    swapColors(next, ptr);
   } else {
-    right_root->nodeColor = BLACK;  
-    root = right_root;
-    delete node;
-    --tree_size;
-    mergeRecursive(left_root);
+    child = ptr->left ? ptr->left : ptr->right;
+    father = ptr->parent();
+    replaceNode(ptr, child);
   }
+  if(ptr->color() == BLACK) eraseBalance(child, father);
+  delete ptr;
+  --tree_size;
 }
 
-template <typename T>
-int RB_Tree<T>::nodeCounting(Node<T>* node){
-    // Если узел равен nullptr, возвращаем 0
-    if (node == nullptr) {
-        return 0;
+// Восстановление черной высоты после удаления черного узла,
+// ptr - узел, занявший место удаленного (может быть nullptr)
+template <typename T, typename Compare, bool Threaded>
+void RB_Tree<T, Compare, Threaded>::eraseBalance(Node<T, Threaded> *ptr,
+                                                 Node<T, Threaded> *father){
+  while(ptr != root && isBlack(ptr)){
+    if(ptr == father->left){
+      Node<T, Threaded> *brother = father->right;
+      if(brother->color() == RED){
+        brother->setColor(BLACK);
+        father->setColor(RED);
+        lift(brother);
+        brother = father->right;
+      }
+      if(isBlack(brother->left) && isBlack(brother->right)){
+        brother->setColor(RED);
+        ptr = father;
+        father = ptr->parent();
+      } else {
+        if(isBlack(brother->right)){
+          brother->left->setColor(BLACK);
+          brother->setColor(RED);
+          lift(brother->left);
+          brother = father->right;
+        }
+        brother->setColor(father->color());
+        father->setColor(BLACK);
+        brother->right->setColor(BLACK);
+        lift(brother);
+        ptr = root;
+      }
+    } else {
+      Node<T, Threaded> *brother = father->left;
+      if(brother->color() == RED){
+        brother->setColor(BLACK);
+        father->setColor(RED);
+        lift(brother);
+        brother = father->left;
+      }
+      if(isBlack(brother->left) && isBlack(brother->right)){
+        brother->setColor(RED);
+        ptr = father;
+        father = ptr->parent();
+      } else {
+        if(isBlack(brother->left)){
+          brother->right->setColor(BLACK);
+          brother->setColor(RED);
+          lift(brother->right);
+          brother = father->left;
+        }
+        brother->setColor(father->color());
+        father->setColor(BLACK);
+        brother->left->setColor(BLACK);
+        lift(brother);
+        ptr = root;
+      }
     }
-    // Возвращаем количество узлов в текущем поддереве
-    return 1 + nodeCounting(node->left) + nodeCounting(node->right);
+  }
+  if(ptr) ptr->setColor(BLACK);
 }
 
 } // namespace rb_tree
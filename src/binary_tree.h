@@ -1,123 +1,567 @@
 #ifndef BINATY_TREE_H
 #define BINATY_TREE_H
 
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <future>
 #include <iostream>
+#include <iterator>
 #include <limits>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "key_order.h"
+#include "slab_pool.h"
 
 namespace binary_tree {
 
 enum COLOR { RED, BLACK };
 
+/*Значение узла: пара (ключ, данные) для словаря и один ключ для множества
+(T2 = void). Итераторы отдают ссылку на это значение, поэтому обход ничего
+не копирует.*/
 template <typename T1, typename T2>
-struct Node {
-  T1 key;
-  T2 data;
-  Node *left = nullptr, *right = nullptr, *parent = nullptr;
-  COLOR nodeColor = RED;
+struct NodeValue {
+  using type = std::pair<const T1, T2>;
+  static const T1 &key(const type &value) { return value.first; }
+};
+
+template <typename T1>
+struct NodeValue<T1, void> {
+  using type = const T1;
+  static const T1 &key(const type &value) { return value; }
+};
+
+/*Нити - ссылки на соседей по порядку ключей. Они есть только у узлов
+дерева с Threaded == true: тогда шаг итератора - один переход по ссылке
+вместо подъема к отцам. Без нитей база пустая и узел не растет.*/
+template <typename N, bool Threaded>
+struct NodeThreads {};
+
+template <typename N>
+struct NodeThreads<N, true> {
+  N *prev = nullptr, *next = nullptr;
+};
 
-  // Конструктор для Node
-  Node(const T1 &key, const T2 &data) : key(key), data(data) {}
+template <typename T1, typename T2, bool Threaded = false>
+struct Node : NodeThreads<Node<T1, T2, Threaded>, Threaded> {
+  using value_type = typename NodeValue<T1, T2>::type;
+
+  value_type value;
+  Node *left = nullptr, *right = nullptr;
+  // Число элементов в поддереве с корнем в этом узле (с учетом его веса)
+  size_t subtree = 1;
+
+  // Ключ и данные строятся из своих аргументов без промежуточных копий
+  template <typename K, typename... Args, typename U = T2,
+            std::enable_if_t<!std::is_void_v<U>, int> = 0>
+  Node(std::in_place_t, K &&key, Args &&...args)
+      : value(std::piecewise_construct,
+              std::forward_as_tuple(std::forward<K>(key)),
+              std::forward_as_tuple(std::forward<Args>(args)...)) {}
+
+  template <typename K, typename U = T2,
+            std::enable_if_t<std::is_void_v<U>, int> = 0>
+  Node(std::in_place_t, K &&key) : value(std::forward<K>(key)) {}
+
+  // Копия значения другого узла
+  explicit Node(const value_type &other) : value(other) {}
+
+  const T1 &key() const { return NodeValue<T1, T2>::key(value); }
+
+  // Данные узла словаря; у множества их нет
+  template <typename U = T2>
+  U &data() {
+    return value.second;
+  }
+  template <typename U = T2>
+  const U &data() const {
+    return value.second;
+  }
+
+  /*Цвет хранится в младшем бите указателя на отца: узел выровнен хотя бы
+  по границе указателя, поэтому этот бит у адреса всегда нулевой. Отдельное
+  поле цвета с выравниванием добавляло бы к узлу 8 байт.*/
+  Node *parent() const {
+    return reinterpret_cast<Node *>(parent_color & ~std::uintptr_t(1));
+  }
+  COLOR color() const { return COLOR(parent_color & 1); }
+  void setParent(Node *ptr) {
+    parent_color = reinterpret_cast<std::uintptr_t>(ptr) | (parent_color & 1);
+  }
+  void setColor(COLOR paint) {
+    parent_color = (parent_color & ~std::uintptr_t(1)) | paint;
+  }
 
   // Операторы сравнения для Node
-  bool operator<(const Node<T1, T2> &other) const { return key < other.key; }
-  bool operator>(const Node<T1, T2> &other) const { return key > other.key; }
-  bool operator==(const Node<T1, T2> &other) const { return key == other.key; }
-  bool operator!=(const Node<T1, T2> &other) const { return key != other.key; }
+  bool operator<(const Node &other) const { return key() < other.key(); }
+  bool operator>(const Node &other) const { return key() > other.key(); }
+  bool operator==(const Node &other) const { return key() == other.key(); }
+  bool operator!=(const Node &other) const { return key() != other.key(); }
 
   // Перегрузка оператора вывода для Node
-  friend std::ostream &operator<<(std::ostream &os, const Node<T1, T2> &node) {
-    os << "Key: " << node.key << ", Data: " << node.data;
+  friend std::ostream &operator<<(std::ostream &os, const Node &node) {
+    os << "Key: " << node.key();
+    if constexpr (!std::is_void_v<T2>) os << ", Data: " << node.data();
     return os;
   }
+
+ private:
+  // Новый узел красный (RED == 0) и без отца
+  std::uintptr_t parent_color = 0;
 };
 
-template <typename T1, typename T2>
+/*Узел, вынутый из дерева вместе с копией распределителя (node handle из
+C++17). Пока узел вне дерева, ключ можно изменить через key(). Вставка
+handle в дерево с равным распределителем только перевешивает указатели, без
+выделения памяти и копирования элементов. Непустой handle при уничтожении
+сам удаляет узел.*/
+template <typename T1, typename T2, typename Allocator, bool Threaded = false>
+class NodeHandle {
+ private:
+  using node_allocator = typename std::allocator_traits<
+      Allocator>::template rebind_alloc<Node<T1, T2, Threaded>>;
+  using node_traits = std::allocator_traits<node_allocator>;
+
+  template <typename, typename, typename, typename, bool>
+  friend class BinaryTree;
+
+  Node<T1, T2, Threaded> *node = nullptr;
+  std::optional<node_allocator> alloc;
+
+  // Отдает узел дереву, handle становится пустым
+  Node<T1, T2, Threaded> *release() {
+    Node<T1, T2, Threaded> *result = node;
+    node = nullptr;
+    alloc.reset();
+    return result;
+  }
+
+  void reset() {
+    if (node) {
+      node_traits::destroy(*alloc, node);
+      node_traits::deallocate(*alloc, node, 1);
+      node = nullptr;
+    }
+    alloc.reset();
+  }
+
+ public:
+  using key_type = T1;
+  using mapped_type = T2;
+  using allocator_type = Allocator;
+
+  NodeHandle() = default;
+
+  NodeHandle(NodeHandle &&other) noexcept
+      : node(other.node), alloc(std::move(other.alloc)) {
+    other.node = nullptr;
+    other.alloc.reset();
+  }
+
+  NodeHandle &operator=(NodeHandle &&other) noexcept {
+    if (this != &other) {
+      // polymorphic_allocator не присваивается, поэтому emplace
+      reset();
+      node = other.node;
+      if (other.alloc) alloc.emplace(std::move(*other.alloc));
+      other.node = nullptr;
+      other.alloc.reset();
+    }
+    return *this;
+  }
+
+  ~NodeHandle() { reset(); }
+
+  bool empty() const { return node == nullptr; }
+  explicit operator bool() const { return node != nullptr; }
+  allocator_type get_allocator() const { return allocator_type(*alloc); }
+
+  /*Ключ и данные узла; для множеств значение элемента - это ключ. В
+  дереве ключ константен, а вне дерева его можно изменить перед вставкой,
+  как у node handle из стандартной библиотеки.*/
+  key_type &key() const { return const_cast<key_type &>(node->key()); }
+  template <typename U = T2>
+  U &mapped() const {
+    return node->data();
+  }
+  key_type &value() const { return key(); }
+
+  void swap(NodeHandle &other) noexcept {
+    NodeHandle temp(std::move(other));
+    other = std::move(*this);
+    *this = std::move(temp);
+  }
+};
+
+// Результат вставки node handle, как insert_return_type в C++17: если ключ
+// уже был, узел остается в node, а position указывает на найденный элемент
+template <typename Iterator, typename NodeType>
+struct InsertReturn {
+  Iterator position;
+  bool inserted;
+  NodeType node;
+};
+
+/*Compare упорядочивает ключи, как в std::map. Прозрачный компаратор
+(std::less<> и т. п., с вложенным типом is_transparent) сравнивает ключ с
+любым сравнимым с ним типом: find, lower_bound и остальные поиски тогда
+принимают, например, std::string_view для ключей std::string без создания
+временного ключа. При Threaded == true узлы хранят ссылки prev и next на
+соседей по порядку, замкнутые в кольцо через заглавный узел: ++ и -- у
+итераторов делают ровно один переход, а узел растет на два указателя.*/
+template <typename T1, typename T2,
+          typename Allocator = std::allocator<std::pair<const T1, T2>>,
+          typename Compare = std::less<T1>, bool Threaded = false>
 class BinaryTree {
  private:
-  Node<T1, T2> *root = nullptr;
-  Node<T1, T2> *endNode = nullptr;
-  size_t tree_size = 0;
-
-  Node<T1, T2> *grandfather(Node<T1, T2> *ptr);
-  Node<T1, T2> *uncle(Node<T1, T2> *ptr);
-  void rotateRight(Node<T1, T2> *ptr);
-  void rotateLeft(Node<T1, T2> *ptr);
-  void balanceTree(Node<T1, T2> *ptr);
-  void balanceTree_1(Node<T1, T2> *ptr);
-  void balanceTree_2(Node<T1, T2> *ptr);
-  void push(Node<T1, T2> *startnode, const T1 &key, const T2 &data);
-  Node<T1, T2> *findNode(Node<T1, T2> *node, const T1 &key) const;
-  void printTree(Node<T1, T2> *node, int indent = 0) const;
-  void clear(Node<T1, T2> *node);
-  void colorChange(Node<T1, T2> *ptr);
-  void copyRecursive(const Node<T1, T2>* node, const Node<T1, T2>* end);
-  void pushRecursive(Node<T1, T2> *node);
-  void removeRoot(Node<T1, T2> *node);
-  int nodeCounting(Node<T1, T2> *node);
-  Node<T1, T2> *lastNode();  // Метод для нахождения последнего узла
-  void updateEndNode();
-  void repainting(Node<T1, T2> *ptr);
-  bool checkAlternation(Node<T1, T2> *ptr);
-  Node<T1, T2>* findMultiNode(Node<T1, T2> *node, const T1 &key) const;
+  // Узлы выделяются распределителем, перепривязанным к типу узла
+  using node_allocator = typename std::allocator_traits<
+      Allocator>::template rebind_alloc<Node<T1, T2, Threaded>>;
+  using node_traits = std::allocator_traits<node_allocator>;
+
+  node_allocator alloc;
+  Compare comp;
+  Node<T1, T2, Threaded> *root = nullptr;
+  // Заглавный узел: parent - корень, left - минимальный узел,
+  // right - максимальный узел. Он же служит позицией end()
+  Node<T1, T2, Threaded> *header = nullptr;
+
+  Node<T1, T2, Threaded> *grandfather(Node<T1, T2, Threaded> *ptr);
+  Node<T1, T2, Threaded> *uncle(Node<T1, T2, Threaded> *ptr);
+  void rotate(Node<T1, T2, Threaded> *ptr);
+  void lift(Node<T1, T2, Threaded> *ptr);
+  void replaceNode(Node<T1, T2, Threaded> *ptr, Node<T1, T2, Threaded> *child);
+  bool isBlack(const Node<T1, T2, Threaded> *ptr) const;
+  static void swapColors(Node<T1, T2, Threaded> *a, Node<T1, T2, Threaded> *b);
+  void eraseBalance(Node<T1, T2, Threaded> *ptr,
+                    Node<T1, T2, Threaded> *father);
+  bool balanceTree(Node<T1, T2, Threaded> *ptr);
+  void balanceTree_1(Node<T1, T2, Threaded> *ptr);
+  void balanceTree_2(Node<T1, T2, Threaded> *ptr);
+  Node<T1, T2, Threaded> *descend(Node<T1, T2, Threaded> *startnode,
+                                  const T1 &key, int &right) const;
+  Node<T1, T2, Threaded> *descendUnique(const T1 &key,
+                                        Node<T1, T2, Threaded> *&father,
+                                        int &right) const;
+  template <typename K, typename... Args>
+  Node<T1, T2, Threaded> *push(Node<T1, T2, Threaded> *startnode, K &&key,
+                               Args &&...args);
+  Node<T1, T2, Threaded> *link(Node<T1, T2, Threaded> *father, int right,
+                               Node<T1, T2, Threaded> *newnode);
+  void unlink(Node<T1, T2, Threaded> *ptr);
+  template <typename K>
+  Node<T1, T2, Threaded> *findNode(Node<T1, T2, Threaded> *node,
+                                   const K &key) const;
+  // Знак сравнения a и b: за одно сравнение, если Compare это позволяет
+  template <typename A, typename B>
+  int order(const A &a, const B &b) const {
+    return KeyOrder<Compare>::compare(comp, a, b);
+  }
+  void printTree(Node<T1, T2, Threaded> *node, int indent = 0) const;
+  void clear(Node<T1, T2, Threaded> *node);
+  Node<T1, T2, Threaded> *cloneTree(const Node<T1, T2, Threaded> *node,
+                                    Node<T1, T2, Threaded> *father,
+                                    unsigned threads);
+  void copyFrom(const BinaryTree &other);
+  template <typename K, typename... Args>
+  Node<T1, T2, Threaded> *createNode(K &&key, Args &&...args);
+  Node<T1, T2, Threaded> *copyNode(const Node<T1, T2, Threaded> *node);
+  template <typename Item>
+  Node<T1, T2, Threaded> *createItem(Item &&item);
+  template <typename Absorb>
+  void absorbNode(Node<T1, T2, Threaded> *kept, Node<T1, T2, Threaded> *node,
+                  Absorb &absorb);
+  void destroyNode(Node<T1, T2, Threaded> *node);
+  void createHeader();
+  void resetHeader();
+  static size_t subtreeSize(const Node<T1, T2, Threaded> *ptr);
+  static bool isHeader(const Node<T1, T2, Threaded> *ptr);
+  template <typename N>
+  static N *select(N *node, size_t k, size_t &offset);
+  static void chain(Node<T1, T2, Threaded> *prev,
+                    Node<T1, T2, Threaded> *next);
+  static Node<T1, T2, Threaded> *threadSubtree(Node<T1, T2, Threaded> *node,
+                                               Node<T1, T2, Threaded> *prev);
+  void threadAll();
+  static void prefetch(const Node<T1, T2, Threaded> *node);
+  template <typename It, typename Visit>
+  static void scan(It first, It last, size_t distance, Visit &visit);
+  Node<T1, T2, Threaded> *linkBalanced(
+      std::vector<Node<T1, T2, Threaded> *> &nodes, size_t lo, size_t hi,
+      Node<T1, T2, Threaded> *father, int depth, int red_depth);
+
+  // Поддерево, отрезанное от дерева: корень черный и без отца,
+  // height - число черных узлов на пути от корня до листа
+  struct Part {
+    Node<T1, T2, Threaded> *node = nullptr;
+    size_t height = 0;
+  };
+  static Part makePart(Node<T1, T2, Threaded> *node, size_t height);
+  static void cutRoot(Part whole, Part &left, Part &right);
+  Part detachAll();
+  void attach(Part whole);
+  Part joinParts(Part left, Node<T1, T2, Threaded> *mid, Part right);
+  Part joinParts(Part left, Part right);
+  void splitPart(Part whole, const T1 &key, Part &left,
+                 Node<T1, T2, Threaded> *&mid, Part &right);
+  Node<T1, T2, Threaded> *splitLast(Part whole, Part &rest);
+  void splitBelow(Part whole, const T1 &key, Part &left, Part &right);
+  template <typename Resolve>
+  Part combineParts(Part a, Part b, bool keep_a, bool keep_b,
+                    Resolve &resolve);
+  template <typename Resolve>
+  void combine(BinaryTree &other, bool keep_a, bool keep_b, Resolve resolve);
+  template <typename Weight>
+  int checkSubtree(const Node<T1, T2, Threaded> *node,
+                   const Node<T1, T2, Threaded> *father,
+                   const Node<T1, T2, Threaded> *&prev, Weight &weight) const;
 
  public:
   using size_type = size_t;
+  using allocator_type = Allocator;
+  using node_type = NodeHandle<T1, T2, Allocator, Threaded>;
 
   // Конструктор по умолчанию
   BinaryTree() = default;
 
+  // Пустое дерево с заданным распределителем
+  explicit BinaryTree(const Allocator &allocator) : alloc(allocator) {}
+
+  // Пустое дерево с заданным порядком ключей
+  explicit BinaryTree(const Compare &compare,
+                      const Allocator &allocator = Allocator())
+      : alloc(allocator), comp(compare) {}
+
   // Конструктор со списком инициализирования
-  BinaryTree(std::initializer_list<std::pair<T1, T2>> const &items) {
-    for (const auto &item : items) {
-      push(item.first, item.second);
-    }
+  BinaryTree(std::initializer_list<std::pair<T1, T2>> const &items,
+             const Allocator &allocator = Allocator())
+      : alloc(allocator) {
+    assign_sorted(items.begin(), items.end());
+  }
+
+  // Конструктор из диапазона пар (ключ, данные)
+  template <typename InputIt, typename = typename std::iterator_traits<
+                                  InputIt>::iterator_category>
+  BinaryTree(InputIt first, InputIt last,
+             const Allocator &allocator = Allocator())
+      : alloc(allocator) {
+    assign_sorted(first, last);
   }
 
-  // Конструктор копирования
-  BinaryTree(const BinaryTree &other) {
-    copyRecursive(other.root, other.endNode);
-    tree_size = other.tree_size;
-    updateEndNode();
+  /*Поддеревья не меньше этого размера копируются в отдельных потоках.
+  Только для std::allocator: ресурсы pmr (например, monotonic_buffer_resource)
+  не обязаны быть потокобезопасными.*/
+  static constexpr size_type parallel_copy_min = 1 << 15;
+
+  // На сколько узлов вперед обходы заранее подгружают узлы в кэш
+  static constexpr size_type prefetch_distance = 8;
+
+  // Конструктор копирования: повторяет форму и цвета исходного дерева
+  BinaryTree(const BinaryTree &other)
+      : alloc(node_traits::select_on_container_copy_construction(
+            other.alloc)),
+        comp(other.comp) {
+    copyFrom(other);
+  }
+
+  BinaryTree(const BinaryTree &other, const Allocator &allocator)
+      : alloc(allocator), comp(other.comp) {
+    copyFrom(other);
+  }
+
+  // Оператор присваивания копированием
+  BinaryTree &operator=(const BinaryTree &other) {
+    if (this != &other) {
+      clear();
+      if constexpr (node_traits::propagate_on_container_copy_assignment::
+                        value) {
+        if (alloc != other.alloc && header) {
+          destroyNode(header);
+          header = nullptr;
+        }
+        alloc = other.alloc;
+      }
+      comp = other.comp;
+      copyFrom(other);
+    }
+    return *this;
   }
 
   // Конструктор перемещения
   BinaryTree(BinaryTree &&other) noexcept
-      : root(other.root), endNode(other.endNode), tree_size(other.tree_size) {
+      : alloc(std::move(other.alloc)),
+        comp(other.comp),
+        root(other.root),
+        header(other.header) {
     other.root = nullptr;
-    other.endNode = nullptr;
-    other.tree_size = 0;
+    other.header = nullptr;
   }
 
-  // Перегрузка оператора присваивания для перемещения объекта
-  BinaryTree &operator=(BinaryTree &&other) noexcept {
+  /*Перегрузка оператора присваивания для перемещения объекта. Узлы
+  забираются, если распределитель переходит вместе с ними или распределители
+  равны, иначе элементы копируются в свою память.*/
+  BinaryTree &operator=(BinaryTree &&other) noexcept(
+      node_traits::propagate_on_container_move_assignment::value ||
+      node_traits::is_always_equal::value) {
     if (this != &other) {
       clear();  // Очищаем текущее дерево
+      comp = other.comp;
+      if constexpr (node_traits::propagate_on_container_move_assignment::
+                        value) {
+        if (header) destroyNode(header);
+        header = nullptr;
+        alloc = std::move(other.alloc);
+      } else if (alloc != other.alloc) {
+        copyFrom(other);
+        other.clear();
+        return *this;
+      }
       std::swap(root, other.root);
-      std::swap(endNode, other.endNode);
-      std::swap(tree_size, other.tree_size);
+      std::swap(header, other.header);
     }
     return *this;
   }
 
+  allocator_type get_allocator() const { return allocator_type(alloc); }
+  Compare key_comp() const { return comp; }
+
+  // a < b в порядке Compare, обычного или трехстороннего
+  template <typename A, typename B>
+  bool key_less(const A &a, const B &b) const {
+    return KeyOrder<Compare>::less(comp, a, b);
+  }
+
   // Деструктор
   ~BinaryTree();
 
-  Node<T1, T2> *find(const T1 &key) const;
-  void remove(Node<T1, T2> *ptr);
+  /*Поиски принимают ключ любого типа K, сравнимого с T1 через Compare.
+  Контейнеры передают сюда K, отличный от T1, только при прозрачном
+  компараторе, иначе аргумент один раз приводится к T1.*/
+  template <typename K>
+  Node<T1, T2, Threaded> *find(const K &key) const;
+
+  /*Границы за один спуск от корня, O(log n). Если подходящего узла нет,
+  возвращается заглавный узел, то есть позиция end()*/
+  // Первый узел с ключом не меньше key
+  template <typename K>
+  Node<T1, T2, Threaded> *lower_bound(const K &key) const;
+  // Первый узел с ключом больше key
+  template <typename K>
+  Node<T1, T2, Threaded> *upper_bound(const K &key) const;
+  // Последний узел с ключом не больше key
+  template <typename K>
+  Node<T1, T2, Threaded> *floor(const K &key) const;
+  void remove(Node<T1, T2, Threaded> *ptr);
   void print();
-  void push(const T1 &key, const T2 &data);
-
-  // Методы для доступа к информации о наполнении контейнера
+  /*Вставка узла с ключом key и данными, построенными из args. Ключ и
+  данные перемещаются в узел, если переданы как rvalue. Возвращает новый
+  узел.*/
+  template <typename K, typename... Args>
+  Node<T1, T2, Threaded> *push(K &&key, Args &&...args);
+  /*Вставка уникального ключа за один спуск от корня. Возвращает новый
+  узел или уже существующий узел с таким ключом (тогда inserted == false,
+  а args не используются и остаются нетронутыми).*/
+  template <typename K, typename... Args>
+  Node<T1, T2, Threaded> *pushUnique(bool &inserted, K &&key, Args &&...args);
+  // То же рядом с узлом hint: при верной подсказке без спуска от корня
+  template <typename K, typename... Args>
+  Node<T1, T2, Threaded> *pushHint(const Node<T1, T2, Threaded> *hint,
+                                   bool &inserted, K &&key, Args &&...args);
+
+  /*extract вынимает узел из дерева без удаления и копирования, pushNode
+  вставляет узел из handle обратно, если его ключа еще нет (иначе handle
+  не меняется), за один спуск. Если распределитель handle не равен
+  распределителю дерева, элемент перемещается в новый узел из своей
+  памяти.*/
+  node_type extract(Node<T1, T2, Threaded> *ptr);
+  Node<T1, T2, Threaded> *pushNode(node_type &handle, bool &inserted);
+  // Новый узел вне дерева, сразу в handle
+  template <typename K, typename... Args>
+  node_type makeNode(K &&key, Args &&...args);
+
+  /*Заменяет содержимое дерева элементами [first, last) за O(n): узлы
+  создаются за один проход и связываются в идеально сбалансированное дерево.
+  Упорядоченность входа проверяется на лету, неупорядоченный вход сначала
+  сортируется. get превращает элемент диапазона в пару (ключ, данные), а для
+  множества (T2 = void) - в ключ. Для равных ключей
+  absorb(данные_оставленного, данные_дубликата) решает судьбу дубликата и
+  возвращает, на сколько элементов вырос вес оставленного узла; по
+  умолчанию остается первый из равных.*/
+  template <typename InputIt>
+  void assign_sorted(InputIt first, InputIt last);
+  template <typename InputIt, typename Get>
+  void assign_sorted(InputIt first, InputIt last, Get get);
+  template <typename InputIt, typename Get, typename Absorb>
+  void assign_sorted(InputIt first, InputIt last, Get get, Absorb absorb);
+
+  // Минимальный и максимальный узлы за O(1), nullptr для пустого дерева
+  Node<T1, T2, Threaded> *front() const;
+  Node<T1, T2, Threaded> *back() const;
+
+  /*Порядковые статистики за O(log n). Каждый узел хранит размер своего
+  поддерева, поэтому элементы считаются с учетом веса узла: по умолчанию
+  вес равен 1, а контейнер, хранящий в узле несколько элементов (multiset),
+  меняет его через addWeight.*/
+  // Узел с элементом номер k (с нуля), offset - номер элемента внутри узла
+  Node<T1, T2, Threaded> *nth(size_type k, size_type &offset) const;
+  Node<T1, T2, Threaded> *nth(size_type k) const;
+  // Количество элементов с ключом меньше key
+  template <typename K>
+  size_type rank(const K &key) const;
+  // Количество элементов с ключом из полуинтервала [lo, hi)
+  template <typename K>
+  size_type count_range(const K &lo, const K &hi) const;
+  // Изменяет вес узла ptr на delta элементов
+  void addWeight(Node<T1, T2, Threaded> *ptr, std::ptrdiff_t delta);
+  // Номер первого элемента узла ptr, для end() - общее число элементов
+  static size_type position(const Node<T1, T2, Threaded> *ptr);
+  // Узел, отстоящий на k элементов от первого элемента узла ptr
+  template <typename N>
+  static N *advance(N *ptr, size_type k, size_type &offset);
+
+  // Методы для доступа к информации о наполнении контейнера,
+  // size() - число элементов с учетом весов узлов
   bool empty() const;
   size_type size() const;
   size_type max_size() const;
 
+  /*Проверка инвариантов за O(n), для тестов: заглавный узел хранит корень,
+  минимальный и максимальный узлы, ссылки на отцов согласованы, ключи
+  строго возрастают, корень черный, у красного узла нет красных сыновей,
+  черная высота всех путей одинакова, а размер поддерева в точности равен
+  сумме размеров сыновей и веса узла. weight(узел) - ожидаемый вес, по
+  умолчанию 1. С нитями (Threaded) кольцо prev/next через заглавный узел
+  идет в порядке ключей.*/
+  bool valid() const;
+  template <typename Weight>
+  bool valid(Weight weight) const;
+
+  /*Двунаправленные итераторы в стиле стандартной библиотеки: operator*
+  возвращает ссылку на значение узла (std::pair<const T1, T2> или ключ
+  множества), operator-> - указатель на него, node() - сам узел.*/
   class iterator {
    private:
-    Node<T1, T2> *current;
+    Node<T1, T2, Threaded> *current;
 
    public:
-    iterator(Node<T1, T2> *node);
+    using iterator_category = std::bidirectional_iterator_tag;
+    using value_type =
+        std::remove_const_t<typename Node<T1, T2, Threaded>::value_type>;
+    using difference_type = std::ptrdiff_t;
+    using pointer = typename Node<T1, T2, Threaded>::value_type *;
+    using reference = typename Node<T1, T2, Threaded>::value_type &;
+
+    iterator(Node<T1, T2, Threaded> *node = nullptr);
+
+    Node<T1, T2, Threaded> *node() const { return current; }
 
     // Префиксный оператор++
     iterator &operator++();
@@ -131,6 +575,9 @@ class BinaryTree {
     // Постфиксный оператор--
     iterator operator--(int);
 
+    // Сдвиг на k элементов вперед за O(log n)
+    iterator operator+(size_type k) const;
+
     // Операторы сравнения
     bool operator==(const iterator &other) const;
     bool operator!=(const iterator &other) const;
@@ -138,18 +585,28 @@ class BinaryTree {
     bool operator<(const iterator &other) const;
 
     // Оператор разыменования
-    std::pair<T1, T2> operator*() const;
+    reference operator*() const;
 
     // Оператор доступа к члену
-    Node<T1, T2> *operator->() const;
+    pointer operator->() const;
   };
 
   class const_iterator {
    private:
-    const Node<T1, T2> *current;
+    const Node<T1, T2, Threaded> *current;
 
    public:
-    const_iterator(const Node<T1, T2> *node);
+    using iterator_category = std::bidirectional_iterator_tag;
+    using value_type =
+        std::remove_const_t<typename Node<T1, T2, Threaded>::value_type>;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const typename Node<T1, T2, Threaded>::value_type *;
+    using reference = const typename Node<T1, T2, Threaded>::value_type &;
+
+    const_iterator(const Node<T1, T2, Threaded> *node = nullptr);
+    const_iterator(const iterator &other);
+
+    const Node<T1, T2, Threaded> *node() const { return current; }
 
     // Префиксный оператор++
     const_iterator &operator++();
@@ -163,6 +620,9 @@ class BinaryTree {
     // Постфиксный оператор--
     const_iterator operator--(int);
 
+    // Сдвиг на k элементов вперед за O(log n)
+    const_iterator operator+(size_type k) const;
+
     // Операторы сравнения
     bool operator==(const const_iterator &other) const;
     bool operator!=(const const_iterator &other) const;
@@ -170,10 +630,10 @@ class BinaryTree {
     bool operator<(const const_iterator &other) const;
 
     // Оператор разыменования
-    std::pair<const T1, const T2> operator*() const;
+    reference operator*() const;
 
     // Оператор доступа к члену
-    const Node<T1, T2> *operator->() const;
+    pointer operator->() const;
   };
 
   // Методы для получения итераторов
@@ -182,190 +642,329 @@ class BinaryTree {
   const_iterator begin() const;
   const_iterator end() const;
 
+  /*Обход всех элементов по возрастанию ключей: visit(значение) для каждого
+  узла. Узел на distance шагов впереди заранее подгружается в кэш, 0
+  отключает предвыборку.*/
+  template <typename Visit>
+  void for_each(Visit visit, size_type distance = prefetch_distance);
+  template <typename Visit>
+  void for_each(Visit visit, size_type distance = prefetch_distance) const;
+
   // Метод для удаления элемента по итератору
   void erase(iterator pos);
 
   // Метод для обмена содержимым с другим деревом
-  void swap(BinaryTree<T1, T2> &other);
-
-  // Сливает два контейнера
-  void merge(BinaryTree<T1, T2> &other);
+  void swap(BinaryTree &other);
+
+  /*Сливает два контейнера: забирает из other узлы с ключами, которых нет в
+  *this, для общих ключей остаются данные *this. Это объединение set_union:
+  узлы переходят без копирования, other становится пустым.*/
+  void merge(BinaryTree &other);
+
+  /*Операции над множествами ключей за O(m log(n/m + 1)), где m <= n -
+  размеры деревьев. Деревья разрезаются и склеиваются (split/join), узлы
+  обоих деревьев переиспользуются без копирования, other остается пустым.
+  Ключи в каждом дереве должны быть уникальны. Для ключа, найденного в обоих
+  деревьях, resolve(данные_this, данные_other) возвращает новый вес узла
+  из *this, 0 - удалить ключ; у множества (T2 = void) resolve вызывается
+  без аргументов. По умолчанию вес равен 1 в объединении и пересечении и 0
+  в разностях. Нити (Threaded) после склейки проставляются заново за
+  O(n + m).*/
+  template <typename Resolve>
+  void set_union(BinaryTree &other, Resolve resolve);
+  void set_union(BinaryTree &other);
+  template <typename Resolve>
+  void set_intersection(BinaryTree &other, Resolve resolve);
+  void set_intersection(BinaryTree &other);
+  template <typename Resolve>
+  void set_difference(BinaryTree &other, Resolve resolve);
+  void set_difference(BinaryTree &other);
+  template <typename Resolve>
+  void symmetric_difference(BinaryTree &other, Resolve resolve);
+  void symmetric_difference(BinaryTree &other);
+
+  /*Разрезание и склейка за O(log n), узлы переходят между деревьями без
+  копирования. split оставляет в *this ключи меньше key и возвращает дерево
+  с остальными ключами. join забирает все узлы other, other становится
+  пустым. Если ключи other лежат целиком левее или правее ключей *this
+  (проверка за O(1) по кэшу минимума и максимума), деревья склеиваются
+  за O(log n); иначе join сводится к set_union с тем же resolve.*/
+  BinaryTree split(const T1 &key);
+  template <typename Resolve>
+  void join(BinaryTree &other, Resolve resolve);
+  void join(BinaryTree &other);
 
   // Метод для проверки наличия элемента
-  bool contains(const T1 &key) const;
+  template <typename K>
+  bool contains(const K &key) const;
 
-  // очистка дерева
+  /*очистка дерева. Если узлы лежат в собственном пуле slab_allocator и не
+  требуют деструкторов, пул сбрасывается целиком без обхода дерева, при этом
+  становится недействительным и итератор end()*/
   void clear();
+
+  // Готовит память под n новых узлов (для slab_allocator, иначе ничего)
+  void reserve(size_type n);
 };
 
-template <typename T1, typename T2>
-BinaryTree<T1, T2>::~BinaryTree() {
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+BinaryTree<T1, T2, Allocator, Compare, Threaded>::~BinaryTree() {
   clear();
-  if (root) delete root;
-  if (endNode) delete endNode;
+  if (header) destroyNode(header);
 }
 
-template <typename T1, typename T2>
-Node<T1, T2> *BinaryTree<T1, T2>::grandfather(Node<T1, T2> *ptr) {
-  if (ptr == nullptr || ptr->parent == nullptr) return nullptr;
-  return ptr->parent->parent;
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+Node<T1, T2, Threaded> *
+BinaryTree<T1, T2, Allocator, Compare, Threaded>::grandfather(
+    Node<T1, T2, Threaded> *ptr) {
+  if (ptr == nullptr || ptr->parent() == nullptr) return nullptr;
+  return ptr->parent()->parent();
 }
 
-template <typename T1, typename T2>
-Node<T1, T2> *BinaryTree<T1, T2>::uncle(Node<T1, T2> *ptr) {
-  Node<T1, T2> *gf = grandfather(ptr);
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+Node<T1, T2, Threaded> *BinaryTree<T1, T2, Allocator, Compare, Threaded>::uncle(
+    Node<T1, T2, Threaded> *ptr) {
+  Node<T1, T2, Threaded> *gf = grandfather(ptr);
   if (ptr == nullptr || gf == nullptr) return nullptr;
-  Node<T1, T2> *result = (gf->left == ptr->parent ? gf->right : gf->left);
+  Node<T1, T2, Threaded> *result =
+      (gf->left == ptr->parent() ? gf->right : gf->left);
   return result;
 }
 
-template <typename T1, typename T2>
-void BinaryTree<T1, T2>::rotateRight(Node<T1, T2> *ptr) {
-  std::swap(ptr->nodeColor, ptr->parent->nodeColor);
-  Node<T1, T2> *father = ptr->parent;
-  father->left = ptr->right;
-  ptr->parent = father->parent;
-  ptr->right = father;
-  father->parent = ptr;
-  if (father->left) father->left->parent = father;
-  if (ptr->parent) {
-    if (ptr->parent->left == father)
-      ptr->parent->left = ptr;
-    else
-      ptr->parent->right = ptr;
-  } else  root = ptr;
-  repainting(ptr);
+// Поворот с перекраской: ptr меняется цветом с отцом и поднимается на его
+// место, влево или вправо - по тому, каким сыном он был
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+void BinaryTree<T1, T2, Allocator, Compare, Threaded>::rotate(
+    Node<T1, T2, Threaded> *ptr) {
+  swapColors(ptr, ptr->parent());
+  lift(ptr);
 }
 
-template <typename T1, typename T2>
-void BinaryTree<T1, T2>::rotateLeft(Node<T1, T2> *ptr) {
-  std::swap(ptr->nodeColor, ptr->parent->nodeColor);
-  Node<T1, T2> *father = ptr->parent;
-  father->right = ptr->left;
-  ptr->parent = father->parent;
-  ptr->left = father;
-  father->parent = ptr;
-  if (father->right) father->right->parent = father;
-  if (ptr->parent) {
-    if (ptr->parent->left == father)
-      ptr->parent->left = ptr;
-    else
-      ptr->parent->right = ptr;
-  } else root = ptr;
-  repainting(ptr);
+// Поворот без перекраски: поднимает узел ptr на место его родителя
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+void BinaryTree<T1, T2, Allocator, Compare, Threaded>::lift(
+    Node<T1, T2, Threaded> *ptr) {
+  Node<T1, T2, Threaded> *father = ptr->parent();
+  size_type whole = father->subtree;
+  size_type own =
+      whole - subtreeSize(father->left) - subtreeSize(father->right);
+  if (father->left == ptr) {
+    father->left = ptr->right;
+    if (ptr->right) ptr->right->setParent(father);
+    ptr->right = father;
+  } else {
+    father->right = ptr->left;
+    if (ptr->left) ptr->left->setParent(father);
+    ptr->left = father;
+  }
+  replaceNode(father, ptr);
+  father->setParent(ptr);
+  // ptr занял место отца и теперь содержит все его поддерево
+  father->subtree =
+      own + subtreeSize(father->left) + subtreeSize(father->right);
+  ptr->subtree = whole;
 }
 
-template <typename T1, typename T2>
-bool BinaryTree<T1, T2>::checkAlternation(Node<T1, T2> *ptr) {
-  bool result = false;
-  if(ptr->left && ptr->left->nodeColor == BLACK && ptr->left != endNode) result = true;
-  if(ptr->right && ptr->right->nodeColor == BLACK && ptr->right != endNode) result = true;
-  return result;
+// Ставит поддерево child на место узла ptr
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+void BinaryTree<T1, T2, Allocator, Compare, Threaded>::replaceNode(
+    Node<T1, T2, Threaded> *ptr, Node<T1, T2, Threaded> *child) {
+  if (child) child->setParent(ptr->parent());
+  if (ptr == root) {
+    root = child;
+    header->setParent(child);
+  } else if (ptr->parent()->left == ptr)
+    ptr->parent()->left = child;
+  else
+    ptr->parent()->right = child;
 }
 
-template <typename T1, typename T2>
-void BinaryTree<T1, T2>::repainting(Node<T1, T2> *ptr) {
-  if(ptr->left && ptr->right){
-    if(ptr->left->nodeColor == RED && ptr->right->nodeColor == RED){
-      if(checkAlternation(ptr->left) || checkAlternation(ptr->right)) return;
-      ptr->left->nodeColor = BLACK;
-      ptr->right->nodeColor = BLACK;
-      if(ptr != root) {
-        ptr->nodeColor = RED;
-        if(ptr->parent->nodeColor == RED) balanceTree(ptr);
-      }
-    }
-  }
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+void BinaryTree<T1, T2, Allocator, Compare, Threaded>::swapColors(
+    Node<T1, T2, Threaded> *a, Node<T1, T2, Threaded> *b) {
+  COLOR color = a->color();
+  a->setColor(b->color());
+  b->setColor(color);
 }
 
-template <typename T1, typename T2>
-void BinaryTree<T1, T2>::balanceTree(Node<T1, T2> *ptr) {
-  Node<T1, T2> *un = uncle(ptr);
-  Node<T1, T2> *gf = grandfather(ptr);
-  if (un && un->nodeColor == RED) {
-    // перекраска
-    repainting(gf);
-  } else if (gf) {
-    if (gf->right == ptr->parent)
-      balanceTree_1(ptr);
-    else
-      balanceTree_2(ptr);
+// Пустой лист (nullptr) считается черным
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+bool BinaryTree<T1, T2, Allocator, Compare, Threaded>::isBlack(
+    const Node<T1, T2, Threaded> *ptr) const {
+  return ptr == nullptr || ptr->color() == BLACK;
+}
+
+// Балансировка после вставки: ptr и его отец красные
+// Возвращает true, если перекраска дошла до корня и черная высота выросла
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+bool BinaryTree<T1, T2, Allocator, Compare, Threaded>::balanceTree(
+    Node<T1, T2, Threaded> *ptr) {
+  while (ptr != root && ptr->parent()->color() == RED) {
+    Node<T1, T2, Threaded> *un = uncle(ptr);
+    Node<T1, T2, Threaded> *gf = grandfather(ptr);
+    if (un && un->color() == RED) {
+      // перекраска
+      un->setColor(BLACK);
+      ptr->parent()->setColor(BLACK);
+      gf->setColor(RED);
+      ptr = gf;
+    } else {
+      if (gf->right == ptr->parent())
+        balanceTree_1(ptr);
+      else
+        balanceTree_2(ptr);
+      break;
+    }
   }
+  bool grown = root->color() == RED;
+  root->setColor(BLACK);
+  return grown;
 }
 
-template <typename T1, typename T2>
-void BinaryTree<T1, T2>::balanceTree_1(Node<T1, T2> *ptr) {
-  Node<T1, T2> *father = ptr->parent;
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+void BinaryTree<T1, T2, Allocator, Compare, Threaded>::balanceTree_1(
+    Node<T1, T2, Threaded> *ptr) {
+  Node<T1, T2, Threaded> *father = ptr->parent();
   if (father->left == ptr) {
-    father->left = ptr->right;
-    if (ptr->right) ptr->right->parent = father;
-    ptr->right = father;
-    ptr->parent = father->parent;
-    father->parent->right = ptr;
-    father->parent = ptr;
-    rotateLeft(ptr);
+    lift(ptr);
+    rotate(ptr);
   } else
-    rotateLeft(father);
+    rotate(father);
 }
 
-template <typename T1, typename T2>
-void BinaryTree<T1, T2>::balanceTree_2(Node<T1, T2> *ptr) {
-  Node<T1, T2> *father = ptr->parent;
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+void BinaryTree<T1, T2, Allocator, Compare, Threaded>::balanceTree_2(
+    Node<T1, T2, Threaded> *ptr) {
+  Node<T1, T2, Threaded> *father = ptr->parent();
   if (father->right == ptr) {
-    father->right = ptr->left;
-    if (ptr->left) ptr->left->parent = father;
-    ptr->left = father;
-    ptr->parent = father->parent;
-    father->parent->left = ptr;
-    father->parent = ptr;
-    rotateRight(ptr);
+    lift(ptr);
+    rotate(ptr);
   } else
-    rotateRight(father);
+    rotate(father);
 }
 
-template <typename T1, typename T2>
-Node<T1, T2> *BinaryTree<T1, T2>::findMultiNode(Node<T1, T2> *node,
-                                           const T1 &key) const {
-  Node<T1, T2> * result = node;
-  if(node->left){
-    if(findNode(node->left, key)) return findNode(node->left, key);
+/*Один спуск: ищем первый узел с ключом не меньше key и проверяем, что он
+равен key, среди равных ключей находится самый левый. Если знак сравнения
+получается за одно сравнение (трехсторонний Compare, строки), спуск
+заканчивается на первом равном ключе: контейнеры хранят ключи без повторов.*/
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+template <typename K>
+Node<T1, T2, Threaded> *
+BinaryTree<T1, T2, Allocator, Compare, Threaded>::findNode(
+    Node<T1, T2, Threaded> *node, const K &key) const {
+  if constexpr (KeyOrder<Compare>::template three_way<K, T1>) {
+    // Знак за одно сравнение: спуск останавливается на первом равном ключе
+    while (node) {
+      int sign = order(key, node->key());
+      if (sign == 0) break;
+      node = sign < 0 ? node->left : node->right;
+    }
+    return node;
+  }
+  Node<T1, T2, Threaded> *result = nullptr;
+  while (node) {
+    if (key_less(node->key(), key)) {
+      node = node->right;
+    } else {
+      result = node;
+      node = node->left;
+    }
   }
+  if (result && key_less(key, result->key())) result = nullptr;
   return result;
 }
 
-template <typename T1, typename T2>
-Node<T1, T2> *BinaryTree<T1, T2>::findNode(Node<T1, T2> *node,
-                                           const T1 &key) const {                                          
-  if (node == nullptr) return node;
-  if (key == node->key) return findMultiNode(node, key);
-  if (key < node->key) {
-    return findNode(node->left, key);
-  } else {
-    return findNode(node->right, key);
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+template <typename K>
+Node<T1, T2, Threaded> *
+BinaryTree<T1, T2, Allocator, Compare, Threaded>::lower_bound(
+    const K &key) const {
+  Node<T1, T2, Threaded> *result = header;
+  Node<T1, T2, Threaded> *node = root;
+  while (node) {
+    if (key_less(node->key(), key)) {
+      node = node->right;
+    } else {
+      result = node;
+      node = node->left;
+    }
   }
+  return result;
 }
 
-template <typename T1, typename T2>
-void BinaryTree<T1, T2>::printTree(Node<T1, T2> *node, int indent) const {
-  if (!node) return;
-  if (node != endNode) {
-    printTree(node->right, indent + 1);
-    for (int i = 0; i < indent; ++i) std::cout << ".";
-    std::cout << node->key << ":"
-              << (node->nodeColor == BLACK ? "BLACK" : "RED") << std::endl;
-    printTree(node->left, indent + 1);
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+template <typename K>
+Node<T1, T2, Threaded> *
+BinaryTree<T1, T2, Allocator, Compare, Threaded>::upper_bound(
+    const K &key) const {
+  Node<T1, T2, Threaded> *result = header;
+  Node<T1, T2, Threaded> *node = root;
+  while (node) {
+    if (key_less(key, node->key())) {
+      result = node;
+      node = node->left;
+    } else {
+      node = node->right;
+    }
   }
+  return result;
 }
 
-template <typename T1, typename T2>
-void BinaryTree<T1, T2>::clear(Node<T1, T2> *node) {
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+template <typename K>
+Node<T1, T2, Threaded> *
+BinaryTree<T1, T2, Allocator, Compare, Threaded>::floor(const K &key) const {
+  Node<T1, T2, Threaded> *result = header;
+  Node<T1, T2, Threaded> *node = root;
+  while (node) {
+    if (key_less(key, node->key())) {
+      node = node->left;
+    } else {
+      result = node;
+      node = node->right;
+    }
+  }
+  return result;
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+void BinaryTree<T1, T2, Allocator, Compare, Threaded>::printTree(
+    Node<T1, T2, Threaded> *node, int indent) const {
+  if (!node) return;
+  printTree(node->right, indent + 1);
+  for (int i = 0; i < indent; ++i) std::cout << ".";
+  std::cout << node->key() << ":"
+            << (node->color() == BLACK ? "BLACK" : "RED") << std::endl;
+  printTree(node->left, indent + 1);
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+void BinaryTree<T1, T2, Allocator, Compare, Threaded>::clear(
+    Node<T1, T2, Threaded> *node) {
   if (node) {
     // Сохраняем потомков текущего узла
-    Node<T1, T2> *leftChild = node->left;
-    Node<T1, T2> *rightChild = node->right;
+    Node<T1, T2, Threaded> *leftChild = node->left;
+    Node<T1, T2, Threaded> *rightChild = node->right;
 
     // Удаляем текущий узел
-    delete node;
+    destroyNode(node);
 
     // Рекурсивно вызываем clear для левого поддерева
     clear(leftChild);
@@ -375,491 +974,1737 @@ void BinaryTree<T1, T2>::clear(Node<T1, T2> *node) {
   }
 }
 
-template <typename T1, typename T2>
-void BinaryTree<T1, T2>::clear() {
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+void BinaryTree<T1, T2, Allocator, Compare, Threaded>::clear() {
+  if constexpr (is_slab_allocator<node_allocator>::value &&
+                std::is_trivially_destructible_v<Node<T1, T2, Threaded>>) {
+    if (alloc.unique()) {
+      alloc.release();
+      root = nullptr;
+      header = nullptr;
+      return;
+    }
+  }
   clear(root);
-  if (root) root = nullptr;
-  if (endNode) endNode = nullptr;
-  tree_size = 0;
+  root = nullptr;
+  if (header) resetHeader();
 }
 
-template <typename T1, typename T2>
-void BinaryTree<T1, T2>::push(Node<T1, T2> *startnode, const T1 &key,
-                              const T2 &data) {
-  Node<T1, T2> *newnode = startnode;
-  Node<T1, T2> *father = nullptr;
-  int right = 0;
-  while (newnode != nullptr && newnode != endNode) {
+// Отец нового узла с ключом key и сторона, куда его подвесить
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+Node<T1, T2, Threaded> *
+BinaryTree<T1, T2, Allocator, Compare, Threaded>::descend(
+    Node<T1, T2, Threaded> *startnode, const T1 &key, int &right) const {
+  Node<T1, T2, Threaded> *newnode = startnode;
+  Node<T1, T2, Threaded> *father = nullptr;
+  right = 0;
+  while (newnode != nullptr) {
     father = newnode;
-    if (key > newnode->key) {
-      newnode = newnode->right;
-      right = 1;
-    } else if (key < newnode->key) {
-      newnode = newnode->left;
-      right = 0;
-    } else {
-      if (nodeCounting(newnode->left) >= nodeCounting(newnode->right)) {
-        newnode = newnode->right;
-        right = 1;
-      } else {
-        newnode = newnode->left;
-        right = 0;
-      }
+    // Одно сравнение на уровень: равный ключ ставим правее существующих
+    right = !key_less(key, newnode->key());
+    newnode = right ? newnode->right : newnode->left;
+  }
+  return father;
+}
+
+/*Спуск для вставки уникального ключа: возвращает узел с ключом key или
+nullptr и тогда отца и сторону для нового узла. Как и в findNode, на
+уровень приходится одно сравнение: трехсторонний Compare останавливается
+на равном ключе, иначе запоминается последний узел с ключом не больше key
+и в конце один раз проверяется на равенство.*/
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+Node<T1, T2, Threaded> *
+BinaryTree<T1, T2, Allocator, Compare, Threaded>::descendUnique(
+    const T1 &key, Node<T1, T2, Threaded> *&father, int &right) const {
+  Node<T1, T2, Threaded> *node = root;
+  father = nullptr;
+  right = 0;
+  if constexpr (KeyOrder<Compare>::template three_way<T1, T1>) {
+    while (node) {
+      int sign = order(key, node->key());
+      if (sign == 0) return node;
+      father = node;
+      right = sign > 0;
+      node = right ? node->right : node->left;
     }
+    return nullptr;
+  }
+  Node<T1, T2, Threaded> *candidate = nullptr;
+  while (node) {
+    father = node;
+    right = !key_less(key, node->key());
+    if (right) candidate = node;
+    node = right ? node->right : node->left;
   }
-  // if(newnode == endNode) endNode = nullptr;
-  newnode = new Node<T1, T2>(key, data);
+  if (candidate && !key_less(candidate->key(), key)) return candidate;
+  return nullptr;
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+template <typename K, typename... Args>
+Node<T1, T2, Threaded> *
+BinaryTree<T1, T2, Allocator, Compare, Threaded>::pushUnique(bool &inserted,
+                                                             K &&key,
+                                                             Args &&...args) {
+  if constexpr (!std::is_same_v<std::decay_t<K>, T1>) {
+    return pushUnique(inserted, T1(std::forward<K>(key)),
+                      std::forward<Args>(args)...);
+  } else {
+    if (!header) createHeader();
+    Node<T1, T2, Threaded> *father = nullptr;
+    int right = 0;
+    Node<T1, T2, Threaded> *found = descendUnique(key, father, right);
+    inserted = !found;
+    if (found) return found;
+    return link(father, right,
+                createNode(std::forward<K>(key), std::forward<Args>(args)...));
+  }
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+template <typename K, typename... Args>
+Node<T1, T2, Threaded> *BinaryTree<T1, T2, Allocator, Compare, Threaded>::push(
+    Node<T1, T2, Threaded> *startnode, K &&key, Args &&...args) {
+  if (!header) createHeader();
+  int right = 0;
+  Node<T1, T2, Threaded> *father = descend(startnode, key, right);
+  return link(father, right,
+              createNode(std::forward<K>(key), std::forward<Args>(args)...));
+}
+
+/*Подвешивает узел newnode к father (справа при right == 1) и балансирует.
+Предки получают весь вес newnode: узел, вставленный из node handle
+multiset, может хранить несколько элементов. Нить newnode вплетается перед
+соседом справа: перед father у левого сына, перед father->next у правого.*/
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+Node<T1, T2, Threaded> *BinaryTree<T1, T2, Allocator, Compare, Threaded>::link(
+    Node<T1, T2, Threaded> *father, int right,
+    Node<T1, T2, Threaded> *newnode) {
   if (father) {
-    newnode->parent = father;
-    newnode->nodeColor = RED;
-    if (right == 1)
+    for (Node<T1, T2, Threaded> *ptr = father; ptr != header;
+         ptr = ptr->parent())
+      ptr->subtree += newnode->subtree;
+    newnode->setParent(father);
+    newnode->setColor(RED);
+    if (right == 1) {
       father->right = newnode;
-    else
+      if (father == header->right) header->right = newnode;
+    } else {
       father->left = newnode;
-    if (father->nodeColor == RED) balanceTree(newnode);
-    else repainting(father);
+      if (father == header->left) header->left = newnode;
+    }
+    if constexpr (Threaded) {
+      Node<T1, T2, Threaded> *after = right == 1 ? father->next : father;
+      chain(after->prev, newnode);
+      chain(newnode, after);
+    }
+    if (father->color() == RED) balanceTree(newnode);
   } else {
-    newnode->nodeColor = BLACK;
+    newnode->setColor(BLACK);
+    newnode->setParent(header);
     root = newnode;
+    header->setParent(newnode);
+    header->left = newnode;
+    header->right = newnode;
+    chain(header, newnode);
+    chain(newnode, header);
   }
-  updateEndNode();
-  ++tree_size;
-  //print();
-  //std::cout<<std::endl;
+  return newnode;
 }
 
-template <typename T1, typename T2>
-void BinaryTree<T1, T2>::push(const T1 &key, const T2 &data) {
-  push(root, key, data);
+// Ключ другого типа один раз приводится к T1: спуск сравнивает только T1
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+template <typename K, typename... Args>
+Node<T1, T2, Threaded> *
+BinaryTree<T1, T2, Allocator, Compare, Threaded>::push(K &&key,
+                                                       Args &&...args) {
+  if constexpr (std::is_same_v<std::decay_t<K>, T1>)
+    return push(root, std::forward<K>(key), std::forward<Args>(args)...);
+  else
+    return push(root, T1(std::forward<K>(key)), std::forward<Args>(args)...);
 }
 
-template <typename T1, typename T2>
-Node<T1, T2> *BinaryTree<T1, T2>::find(const T1 &key) const {
-  Node<T1, T2> *result = findNode(root, key);
-  return result;
+/*Вставка с подсказкой: если key лежит строго между узлом-подсказкой и его
+соседом, у одного из них обязательно есть свободное место для нового листа,
+и спуск от корня не нужен. Соседа находит шаг итератора (амортизированно
+O(1)). При неверной подсказке выполняется обычная вставка. Узел создается,
+только когда ключа в дереве нет.*/
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+template <typename K, typename... Args>
+Node<T1, T2, Threaded> *
+BinaryTree<T1, T2, Allocator, Compare, Threaded>::pushHint(
+    const Node<T1, T2, Threaded> *hint, bool &inserted, K &&key,
+    Args &&...args) {
+  if constexpr (!std::is_same_v<std::decay_t<K>, T1>) {
+    return pushHint(hint, inserted, T1(std::forward<K>(key)),
+                    std::forward<Args>(args)...);
+  } else {
+    auto attach = [&](Node<T1, T2, Threaded> *father, int right) {
+      return link(father, right, createNode(std::forward<K>(key),
+                                            std::forward<Args>(args)...));
+    };
+    Node<T1, T2, Threaded> *pos = const_cast<Node<T1, T2, Threaded> *>(hint);
+    inserted = true;
+    if (!header) createHeader();
+    if (!root) return attach(nullptr, 0);
+    if (pos == nullptr || pos == header) {
+      // Подсказка end(): ключ больше максимального
+      if (key_less(header->right->key(), key)) return attach(header->right, 1);
+    } else if (key_less(key, pos->key())) {
+      if (pos == header->left) return attach(pos, 0);
+      iterator before(pos);
+      --before;
+      if (key_less(before.node()->key(), key)) {
+        if (before.node()->right) return attach(pos, 0);
+        return attach(before.node(), 1);
+      }
+    } else if (key_less(pos->key(), key)) {
+      if (pos == header->right) return attach(pos, 1);
+      iterator after(pos);
+      ++after;
+      if (key_less(key, after.node()->key())) {
+        if (pos->right) return attach(after.node(), 0);
+        return attach(pos, 1);
+      }
+    } else {
+      inserted = false;
+      return pos;
+    }
+    return pushUnique(inserted, std::forward<K>(key),
+                      std::forward<Args>(args)...);
+  }
 }
 
-template <typename T1, typename T2>
-void BinaryTree<T1, T2>::colorChange(Node<T1, T2> *ptr) {
-  if (ptr) {
-    ptr->nodeColor = (ptr->nodeColor == RED ? BLACK : RED);
-    colorChange(ptr->left);
-    colorChange(ptr->right);
+/*Узел выходит из дерева со своим весом и без связей, как только что
+созданный. Память узла переходит к handle.*/
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+typename BinaryTree<T1, T2, Allocator, Compare, Threaded>::node_type
+BinaryTree<T1, T2, Allocator, Compare, Threaded>::extract(
+    Node<T1, T2, Threaded> *ptr) {
+  if (!ptr || ptr == header) return node_type();
+  size_type own = ptr->subtree - subtreeSize(ptr->left) -
+                  subtreeSize(ptr->right);
+  unlink(ptr);
+  ptr->left = nullptr;
+  ptr->right = nullptr;
+  ptr->subtree = own;
+  ptr->setParent(nullptr);
+  ptr->setColor(RED);
+  node_type handle;
+  handle.node = ptr;
+  handle.alloc.emplace(alloc);
+  return handle;
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+template <typename K, typename... Args>
+typename BinaryTree<T1, T2, Allocator, Compare, Threaded>::node_type
+BinaryTree<T1, T2, Allocator, Compare, Threaded>::makeNode(K &&key,
+                                                           Args &&...args) {
+  node_type handle;
+  handle.node = createNode(std::forward<K>(key), std::forward<Args>(args)...);
+  handle.alloc.emplace(alloc);
+  return handle;
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+Node<T1, T2, Threaded> *
+BinaryTree<T1, T2, Allocator, Compare, Threaded>::pushNode(node_type &handle,
+                                                           bool &inserted) {
+  inserted = false;
+  if (handle.empty()) return nullptr;
+  if (!header) createHeader();
+  Node<T1, T2, Threaded> *father = nullptr;
+  int right = 0;
+  Node<T1, T2, Threaded> *found =
+      descendUnique(handle.node->key(), father, right);
+  if (found) return found;
+  Node<T1, T2, Threaded> *node = handle.node;
+  if (*handle.alloc == alloc) {
+    handle.release();
+  } else {
+    if constexpr (std::is_void_v<T2>)
+      node = createNode(node->key());
+    else
+      node = createNode(node->key(), std::move(node->data()));
+    node->subtree = handle.node->subtree;
+    handle.reset();
   }
+  inserted = true;
+  return link(father, right, node);
 }
 
-template <typename T1, typename T2>
-void BinaryTree<T1, T2>::print() {
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+template <typename K>
+Node<T1, T2, Threaded> *
+BinaryTree<T1, T2, Allocator, Compare, Threaded>::find(const K &key) const {
+  Node<T1, T2, Threaded> *result = findNode(root, key);
+  return result;
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+void BinaryTree<T1, T2, Allocator, Compare, Threaded>::print() {
   printTree(root);
 }
 
-template <typename T1, typename T2>
-void BinaryTree<T1, T2>::copyRecursive(const Node<T1, T2>* node, 
-                          const Node<T1, T2>* end){
-  if (node && node != end) {
-    // Сохраняем потомков текущего узла
-    Node<T1, T2> *leftChild = node->left;
-    Node<T1, T2> *rightChild = node->right;
+/*Копия строится узел в узел: ключи, данные, цвета и размеры поддеревьев
+переносятся как есть, без вставок и балансировки, за O(n). Большие
+поддеревья делятся между потоками: левая половина копируется асинхронно,
+правая - в текущем потоке, пока не исчерпан запас потоков.*/
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+void BinaryTree<T1, T2, Allocator, Compare, Threaded>::copyFrom(
+    const BinaryTree &other) {
+  if (!other.root) return;
+  unsigned threads = std::thread::hardware_concurrency();
+  if (other.size() < parallel_copy_min ||
+      !std::is_same_v<node_allocator, std::allocator<Node<T1, T2, Threaded>>>)
+    threads = 1;
+  bool created = !header;
+  if (created) createHeader();
+  try {
+    root = cloneTree(other.root, header, threads);
+  } catch (...) {
+    if (created) {
+      destroyNode(header);
+      header = nullptr;
+    }
+    throw;
+  }
+  header->setParent(root);
+  header->left = root;
+  while (header->left->left) header->left = header->left->left;
+  header->right = root;
+  while (header->right->right) header->right = header->right->right;
+  threadAll();
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+Node<T1, T2, Threaded> *
+BinaryTree<T1, T2, Allocator, Compare, Threaded>::cloneTree(
+    const Node<T1, T2, Threaded> *node, Node<T1, T2, Threaded> *father,
+    unsigned threads) {
+  if (!node) return nullptr;
+  Node<T1, T2, Threaded> *copy = copyNode(node);
+  copy->setParent(father);
+  copy->setColor(node->color());
+  copy->subtree = node->subtree;
+  try {
+    if (threads > 1 && node->subtree >= parallel_copy_min) {
+      std::future<Node<T1, T2, Threaded> *> left = std::async(
+          std::launch::async, [this, node, copy, threads] {
+            return cloneTree(node->left, copy, threads / 2);
+          });
+      try {
+        copy->right = cloneTree(node->right, copy, threads - threads / 2);
+      } catch (...) {
+        // Дожидаемся левой половины, чтобы не оставить ее узлы висеть
+        try {
+          clear(left.get());
+        } catch (...) {
+        }
+        throw;
+      }
+      copy->left = left.get();
+    } else {
+      copy->left = cloneTree(node->left, copy, 1);
+      copy->right = cloneTree(node->right, copy, 1);
+    }
+  } catch (...) {
+    clear(copy->left);
+    clear(copy->right);
+    destroyNode(copy);
+    throw;
+  }
+  return copy;
+}
+
+
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+Node<T1, T2, Threaded> *
+BinaryTree<T1, T2, Allocator, Compare, Threaded>::front() const {
+  return root ? header->left : nullptr;
+}
 
-    // Вставляем текущий узел в новое дерево
-    push(node->key, node->data);
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+Node<T1, T2, Threaded> *
+BinaryTree<T1, T2, Allocator, Compare, Threaded>::back() const {
+  return root ? header->right : nullptr;
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+typename BinaryTree<T1, T2, Allocator, Compare, Threaded>::size_type
+BinaryTree<T1, T2, Allocator, Compare, Threaded>::subtreeSize(
+    const Node<T1, T2, Threaded> *ptr) {
+  return ptr ? ptr->subtree : 0;
+}
 
-    // Рекурсивно вызываем copyRecursive для левого поддерева
-    if (leftChild) copyRecursive(leftChild, end);
-    leftChild = nullptr;
-    
-    // Рекурсивно вызываем copyRecursive для правого поддерева
-    if (rightChild) copyRecursive(rightChild, end);
-    rightChild = nullptr;
+// Заглавный узел - единственный красный узел, дед которого он сам
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+bool BinaryTree<T1, T2, Allocator, Compare, Threaded>::isHeader(
+    const Node<T1, T2, Threaded> *ptr) {
+  return ptr->parent() == nullptr ||
+         (ptr->color() == RED && ptr->parent()->parent() == ptr);
+}
 
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+template <typename N>
+N *BinaryTree<T1, T2, Allocator, Compare, Threaded>::select(N *node,
+                                                            size_type k,
+                                                            size_type &offset) {
+  while (node) {
+    size_type left = subtreeSize(node->left);
+    if (k < left) {
+      node = node->left;
+    } else {
+      k -= left;
+      size_type own = node->subtree - left - subtreeSize(node->right);
+      if (k < own) {
+        offset = k;
+        return node;
+      }
+      k -= own;
+      node = node->right;
+    }
   }
+  return nullptr;
 }
 
-template <typename T1, typename T2>
-bool BinaryTree<T1, T2>::empty() const {
-  return tree_size == 0;
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+Node<T1, T2, Threaded> *
+BinaryTree<T1, T2, Allocator, Compare, Threaded>::nth(size_type k,
+                                                      size_type &offset) const {
+  offset = 0;
+  return select(root, k, offset);
 }
 
-template <typename T1, typename T2>
-typename BinaryTree<T1, T2>::size_type BinaryTree<T1, T2>::size() const {
-  return tree_size;
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+Node<T1, T2, Threaded> *
+BinaryTree<T1, T2, Allocator, Compare, Threaded>::nth(size_type k) const {
+  size_type offset = 0;
+  return select(root, k, offset);
 }
 
-template <typename T1, typename T2>
-typename BinaryTree<T1, T2>::size_type BinaryTree<T1, T2>::max_size() const {
-  return std::numeric_limits<size_type>::max() / sizeof(Node<T1, T2>) / 2;
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+template <typename K>
+typename BinaryTree<T1, T2, Allocator, Compare, Threaded>::size_type
+BinaryTree<T1, T2, Allocator, Compare, Threaded>::rank(const K &key) const {
+  size_type result = 0;
+  const Node<T1, T2, Threaded> *node = root;
+  while (node) {
+    if (key_less(node->key(), key)) {
+      result += node->subtree - subtreeSize(node->right);
+      node = node->right;
+    } else {
+      node = node->left;
+    }
+  }
+  return result;
 }
 
-template <typename T1, typename T2>
-BinaryTree<T1, T2>::iterator::iterator(Node<T1, T2> *node) : current(node) {}
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+template <typename K>
+typename BinaryTree<T1, T2, Allocator, Compare, Threaded>::size_type
+BinaryTree<T1, T2, Allocator, Compare, Threaded>::count_range(
+    const K &lo, const K &hi) const {
+  if (!key_less(lo, hi)) return 0;
+  return rank(hi) - rank(lo);
+}
 
-template <typename T1, typename T2>
-typename BinaryTree<T1, T2>::iterator &
-BinaryTree<T1, T2>::iterator::operator++() {
-  if (current == nullptr) return *this;
-  if (current->right){
-    current = current->right;
-    while (current->left) {current = current->left;}
-    return *this;
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+void BinaryTree<T1, T2, Allocator, Compare, Threaded>::addWeight(
+    Node<T1, T2, Threaded> *ptr, std::ptrdiff_t delta) {
+  for (; ptr != header; ptr = ptr->parent()) ptr->subtree += delta;
+}
+
+// Подъем к корню: если узел - правый сын, перед ним стоят все элементы
+// отца, кроме его собственного поддерева
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+typename BinaryTree<T1, T2, Allocator, Compare, Threaded>::size_type
+BinaryTree<T1, T2, Allocator, Compare, Threaded>::position(
+    const Node<T1, T2, Threaded> *ptr) {
+  if (isHeader(ptr)) return subtreeSize(ptr->parent());
+  size_type result = subtreeSize(ptr->left);
+  while (ptr->parent()->parent() != ptr) {
+    if (ptr == ptr->parent()->right)
+      result += ptr->parent()->subtree - ptr->subtree;
+    ptr = ptr->parent();
   }
-  if(current == current->parent->left){
-    current = current->parent;
+  return result;
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+template <typename N>
+N *
+BinaryTree<T1, T2, Allocator, Compare, Threaded>::advance(N *ptr, size_type k,
+                                                          size_type &offset) {
+  offset = 0;
+  N *head = ptr;
+  while (!isHeader(head)) head = head->parent();
+  N *result = select(head->parent(), position(ptr) + k, offset);
+  return result ? result : head;
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+bool BinaryTree<T1, T2, Allocator, Compare, Threaded>::empty() const {
+  return root == nullptr;
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+typename BinaryTree<T1, T2, Allocator, Compare, Threaded>::size_type
+BinaryTree<T1, T2, Allocator, Compare, Threaded>::size() const {
+  return subtreeSize(root);
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+typename BinaryTree<T1, T2, Allocator, Compare, Threaded>::size_type
+BinaryTree<T1, T2, Allocator, Compare, Threaded>::max_size() const {
+  return std::numeric_limits<size_type>::max() /
+         sizeof(Node<T1, T2, Threaded>) / 2;
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+BinaryTree<T1, T2, Allocator, Compare, Threaded>::iterator::iterator(
+    Node<T1, T2, Threaded> *node) : current(node) {}
+
+/*Переход к следующему узлу. Корень подвешен к заглавному узлу, поэтому
+подъем от максимального узла заканчивается на заглавном узле, то есть на
+end(). Проверка x->right != father нужна для случая, когда максимальным
+узлом является сам корень. С нитями шаг - один переход по ссылке next.*/
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+typename BinaryTree<T1, T2, Allocator, Compare, Threaded>::iterator &
+BinaryTree<T1, T2, Allocator, Compare, Threaded>::iterator::operator++() {
+  if (current == nullptr) return *this;
+  if constexpr (Threaded) {
+    current = current->next;
     return *this;
   }
-  if(current == current->parent->right){
-    while (current->parent && current == current->parent->right)
-    {
-      current = current->parent;
+  if (current->right) {
+    current = current->right;
+    while (current->left) current = current->left;
+  } else {
+    Node<T1, T2, Threaded> *father = current->parent();
+    while (current == father->right) {
+      current = father;
+      father = father->parent();
     }
-    if(current->parent) current = current->parent;
-    else{
-      while (current->right) {current = current->right;}
-    }    
+    if (current->right != father) current = father;
   }
   return *this;
 }
 
-template <typename T1, typename T2>
-typename BinaryTree<T1, T2>::iterator &
-BinaryTree<T1, T2>::iterator::operator--() {
+// Шаг назад от end() (заглавного узла) ведет на максимальный узел
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+typename BinaryTree<T1, T2, Allocator, Compare, Threaded>::iterator &
+BinaryTree<T1, T2, Allocator, Compare, Threaded>::iterator::operator--() {
   if (current == nullptr) return *this;
-  if (current->left) {
-    current = current->left;  
+  if constexpr (Threaded) {
+    current = current->prev;
+    return *this;
+  }
+  if (isHeader(current)) {
+    current = current->right;
+  } else if (current->left) {
+    current = current->left;
     while (current->right) current = current->right;
   } else {
-    Node<T1, T2> *father = current->parent;
-    if (father == nullptr || current == father->left) return *this;
-    while (father && current == father->left) {
+    Node<T1, T2, Threaded> *father = current->parent();
+    while (current == father->left) {
       current = father;
-      father = father->parent;
+      father = father->parent();
     }
     current = father;
   }
   return *this;
 }
 
-template <typename T1, typename T2>
-typename BinaryTree<T1, T2>::iterator BinaryTree<T1, T2>::iterator::operator++(
-    int) {
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+typename BinaryTree<T1, T2, Allocator, Compare, Threaded>::iterator
+BinaryTree<T1, T2, Allocator, Compare, Threaded>::iterator::operator++(int) {
   iterator temp = *this;
   ++(*this);
   return temp;
 }
 
-template <typename T1, typename T2>
-typename BinaryTree<T1, T2>::iterator BinaryTree<T1, T2>::iterator::operator--(
-    int) {
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+typename BinaryTree<T1, T2, Allocator, Compare, Threaded>::iterator
+BinaryTree<T1, T2, Allocator, Compare, Threaded>::iterator::operator--(int) {
   iterator temp = *this;
   --(*this);
   return temp;
 }
 
-template <typename T1, typename T2>
-bool BinaryTree<T1, T2>::iterator::operator==(const iterator &other) const {
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+typename BinaryTree<T1, T2, Allocator, Compare, Threaded>::iterator
+BinaryTree<T1, T2, Allocator, Compare, Threaded>::iterator::operator+(
+    size_type k) const {
+  if (current == nullptr) return *this;
+  size_type offset = 0;
+  return iterator(advance(current, k, offset));
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+bool BinaryTree<T1, T2, Allocator, Compare, Threaded>::iterator::operator==(
+    const iterator &other) const {
   return current == other.current;
 }
 
-template <typename T1, typename T2>
-bool BinaryTree<T1, T2>::iterator::operator!=(const iterator &other) const {
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+bool BinaryTree<T1, T2, Allocator, Compare, Threaded>::iterator::operator!=(
+    const iterator &other) const {
   return current != other.current;
 }
 
-template <typename T1, typename T2>
-bool BinaryTree<T1, T2>::iterator::operator>(const iterator &other) const {
-  return current->key > other.current->key;
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+bool BinaryTree<T1, T2, Allocator, Compare, Threaded>::iterator::operator>(
+    const iterator &other) const {
+  return current->key() > other.current->key();
 }
 
-template <typename T1, typename T2>
-bool BinaryTree<T1, T2>::iterator::operator<(const iterator &other) const {
-  return current->key < other.current->key;
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+bool BinaryTree<T1, T2, Allocator, Compare, Threaded>::iterator::operator<(
+    const iterator &other) const {
+  return current->key() < other.current->key();
 }
 
-template <typename T1, typename T2>
-std::pair<T1, T2> BinaryTree<T1, T2>::iterator::operator*() const {
-  return std::make_pair(current->key, current->data);
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+typename BinaryTree<T1, T2, Allocator, Compare, Threaded>::iterator::reference
+BinaryTree<T1, T2, Allocator, Compare, Threaded>::iterator::operator*() const {
+  return current->value;
 }
 
-template <typename T1, typename T2>
-Node<T1, T2> *BinaryTree<T1, T2>::iterator::operator->() const {
-  return current;
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+typename BinaryTree<T1, T2, Allocator, Compare, Threaded>::iterator::pointer
+BinaryTree<T1, T2, Allocator, Compare, Threaded>::iterator::operator->() const {
+  return &current->value;
 }
 
-template <typename T1, typename T2>
-BinaryTree<T1, T2>::const_iterator::const_iterator(const Node<T1, T2> *node)
-    : current(node) {}
-
-template <typename T1, typename T2>
-typename BinaryTree<T1, T2>::const_iterator &
-BinaryTree<T1, T2>::const_iterator::operator++() {
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+BinaryTree<T1, T2, Allocator, Compare,
+           Threaded>::const_iterator::const_iterator(
+    const Node<T1, T2, Threaded> *node) : current(node) {}
+
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+BinaryTree<T1, T2, Allocator, Compare,
+           Threaded>::const_iterator::const_iterator(
+    const iterator &other) : current(other.node()) {}
+
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+typename BinaryTree<T1, T2, Allocator, Compare, Threaded>::const_iterator &
+BinaryTree<T1, T2, Allocator, Compare, Threaded>::const_iterator::operator++() {
   if (current == nullptr) return *this;
-  if (current->right){
-    current = current->right;
-    while (current->left) {current = current->left;}
+  if constexpr (Threaded) {
+    current = current->next;
     return *this;
   }
-  if(current == current->parent->left){
-    current = current->parent;
-    return *this;
-  }
-  if(current == current->parent->right){
-    while (current->parent && current == current->parent->right)
-    {
-      current = current->parent;
+  if (current->right) {
+    current = current->right;
+    while (current->left) current = current->left;
+  } else {
+    const Node<T1, T2, Threaded> *father = current->parent();
+    while (current == father->right) {
+      current = father;
+      father = father->parent();
     }
-    if(current->parent) current = current->parent;
-    else{
-      while (current->right) {current = current->right;}
-    }  
+    if (current->right != father) current = father;
   }
   return *this;
 }
 
-template <typename T1, typename T2>
-typename BinaryTree<T1, T2>::const_iterator &
-BinaryTree<T1, T2>::const_iterator::operator--() {
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+typename BinaryTree<T1, T2, Allocator, Compare, Threaded>::const_iterator &
+BinaryTree<T1, T2, Allocator, Compare, Threaded>::const_iterator::operator--() {
   if (current == nullptr) return *this;
-  if (current->left) {
-    current = current->left;  
+  if constexpr (Threaded) {
+    current = current->prev;
+    return *this;
+  }
+  if (isHeader(current)) {
+    current = current->right;
+  } else if (current->left) {
+    current = current->left;
     while (current->right) current = current->right;
   } else {
-    Node<T1, T2> *father = current->parent;
-    if (father == nullptr || current == father->left) return *this;
-    while (father && current == father->left) {
+    const Node<T1, T2, Threaded> *father = current->parent();
+    while (current == father->left) {
       current = father;
-      father = father->parent;
+      father = father->parent();
     }
     current = father;
   }
   return *this;
 }
 
-template <typename T1, typename T2>
-typename BinaryTree<T1, T2>::const_iterator
-BinaryTree<T1, T2>::const_iterator::operator++(int) {
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+typename BinaryTree<T1, T2, Allocator, Compare, Threaded>::const_iterator
+BinaryTree<T1, T2, Allocator, Compare, Threaded>::const_iterator::operator++(
+    int) {
   const_iterator temp = *this;
   ++(*this);
   return temp;
 }
 
-template <typename T1, typename T2>
-typename BinaryTree<T1, T2>::const_iterator
-BinaryTree<T1, T2>::const_iterator::operator--(int) {
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+typename BinaryTree<T1, T2, Allocator, Compare, Threaded>::const_iterator
+BinaryTree<T1, T2, Allocator, Compare, Threaded>::const_iterator::operator--(
+    int) {
   const_iterator temp = *this;
   --(*this);
   return temp;
 }
 
-template <typename T1, typename T2>
-bool BinaryTree<T1, T2>::const_iterator::operator==(
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+typename BinaryTree<T1, T2, Allocator, Compare, Threaded>::const_iterator
+BinaryTree<T1, T2, Allocator, Compare, Threaded>::const_iterator::operator+(
+    size_type k) const {
+  if (current == nullptr) return *this;
+  size_type offset = 0;
+  return const_iterator(advance(current, k, offset));
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+bool
+BinaryTree<T1, T2, Allocator, Compare, Threaded>::const_iterator::operator==(
     const const_iterator &other) const {
   return current == other.current;
 }
 
-template <typename T1, typename T2>
-bool BinaryTree<T1, T2>::const_iterator::operator!=(
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+bool
+BinaryTree<T1, T2, Allocator, Compare, Threaded>::const_iterator::operator!=(
     const const_iterator &other) const {
   return current != other.current;
 }
 
-template <typename T1, typename T2>
-bool BinaryTree<T1, T2>::const_iterator::operator>(
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+bool
+BinaryTree<T1, T2, Allocator, Compare, Threaded>::const_iterator::operator>(
     const const_iterator &other) const {
-  return current->key > other.current->key;
+  return current->key() > other.current->key();
 }
 
-template <typename T1, typename T2>
-bool BinaryTree<T1, T2>::const_iterator::operator<(
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+bool
+BinaryTree<T1, T2, Allocator, Compare, Threaded>::const_iterator::operator<(
     const const_iterator &other) const {
-  return current->key < other.current->key;
+  return current->key() < other.current->key();
 }
 
-template <typename T1, typename T2>
-std::pair<const T1, const T2> BinaryTree<T1, T2>::const_iterator::operator*()
-    const {
-  return std::make_pair(current->key, current->data);
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+typename BinaryTree<T1, T2, Allocator, Compare,
+                    Threaded>::const_iterator::reference
+BinaryTree<T1, T2, Allocator, Compare, Threaded>::const_iterator::operator*(
+    ) const {
+  return current->value;
 }
 
-template <typename T1, typename T2>
-const Node<T1, T2> *BinaryTree<T1, T2>::const_iterator::operator->() const {
-  return current;
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+typename BinaryTree<T1, T2, Allocator, Compare,
+                    Threaded>::const_iterator::pointer
+BinaryTree<T1, T2, Allocator, Compare, Threaded>::const_iterator::operator->(
+    ) const {
+  return &current->value;
 }
 
-template <typename T1, typename T2>
-typename BinaryTree<T1, T2>::iterator BinaryTree<T1, T2>::begin() {
-  Node<T1, T2> *node = root;
-  if (!node) return iterator(nullptr);
-  while (node && node->left) {
-    node = node->left;
-  }
-  return iterator(node);
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+typename BinaryTree<T1, T2, Allocator, Compare, Threaded>::iterator
+BinaryTree<T1, T2, Allocator, Compare, Threaded>::begin() {
+  return iterator(header ? header->left : nullptr);
 }
 
-template <typename T1, typename T2>
-typename BinaryTree<T1, T2>::iterator BinaryTree<T1, T2>::end() {
-  return iterator(endNode);
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+typename BinaryTree<T1, T2, Allocator, Compare, Threaded>::iterator
+BinaryTree<T1, T2, Allocator, Compare, Threaded>::end() {
+  return iterator(header);
 }
 
-template <typename T1, typename T2>
-typename BinaryTree<T1, T2>::const_iterator BinaryTree<T1, T2>::begin() const {
-  const Node<T1, T2> *node = root;
-  if (!node) return const_iterator(nullptr);
-  while (node && node->left) {
-    node = node->left;
-  }
-  return const_iterator(node);
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+typename BinaryTree<T1, T2, Allocator, Compare, Threaded>::const_iterator
+BinaryTree<T1, T2, Allocator, Compare, Threaded>::begin() const {
+  return const_iterator(header ? header->left : nullptr);
 }
 
-template <typename T1, typename T2>
-typename BinaryTree<T1, T2>::const_iterator BinaryTree<T1, T2>::end() const {
-  return const_iterator(endNode);
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+typename BinaryTree<T1, T2, Allocator, Compare, Threaded>::const_iterator
+BinaryTree<T1, T2, Allocator, Compare, Threaded>::end() const {
+  return const_iterator(header);
 }
 
-template <typename T1, typename T2>
-void BinaryTree<T1, T2>::erase(iterator pos) {
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+template <typename Visit>
+void BinaryTree<T1, T2, Allocator, Compare, Threaded>::for_each(
+    Visit visit, size_type distance) {
+  auto step = [&visit](Node<T1, T2, Threaded> *node) { visit(node->value); };
+  scan(begin(), end(), distance, step);
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+template <typename Visit>
+void BinaryTree<T1, T2, Allocator, Compare, Threaded>::for_each(
+    Visit visit, size_type distance) const {
+  auto step = [&visit](const Node<T1, T2, Threaded> *node) {
+    visit(node->value);
+  };
+  scan(begin(), end(), distance, step);
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+void BinaryTree<T1, T2, Allocator, Compare, Threaded>::erase(iterator pos) {
   if (pos == end()) return;
-  Node<T1, T2> *ptr = find(pos->key);
-  remove(ptr);
+  remove(pos.node());
 }
 
-template <typename T1, typename T2>
-void BinaryTree<T1, T2>::swap(BinaryTree<T1, T2> &other) {
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+void BinaryTree<T1, T2, Allocator, Compare, Threaded>::swap(BinaryTree &other) {
+  // Распределители меняются, только если этого требуют их свойства
+  if constexpr (node_traits::propagate_on_container_swap::value) {
+    using std::swap;
+    swap(alloc, other.alloc);
+  }
+  std::swap(comp, other.comp);
   // Меняем местами корни деревьев
   std::swap(root, other.root);
-  // Меняем местами размеры деревьев
-  std::swap(tree_size, other.tree_size);
-  // меняем endNode
-  std::swap(endNode, other.endNode);
+  // меняем заглавные узлы
+  std::swap(header, other.header);
 }
 
-template <typename T1, typename T2>
-void BinaryTree<T1, T2>::merge(BinaryTree<T1, T2> &other) {
-  // Если текущее дерево меньше, меняем деревья местами
-  if (this->size() < other.size()) {
-    swap(other);
-  }
-
-  auto it = other.begin();
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+void
+BinaryTree<T1, T2, Allocator, Compare, Threaded>::merge(BinaryTree &other) {
+  // Слияние с самим собой ничего не меняет
+  if (this == &other) return;
+  set_union(other);
+}
 
-  for (; it != other.end(); ++it) {
-    push(it->key, it->data);
+// Черная высота поддерева node с учетом пустых листьев или -1, если
+// инвариант нарушен. prev - предыдущий по порядку узел перед поддеревом,
+// для первого узла дерева - заглавный узел
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+template <typename Weight>
+int BinaryTree<T1, T2, Allocator, Compare, Threaded>::checkSubtree(
+    const Node<T1, T2, Threaded> *node, const Node<T1, T2, Threaded> *father,
+    const Node<T1, T2, Threaded> *&prev, Weight &weight) const {
+  if (!node) return 1;
+  if (node->parent() != father) return -1;
+  if (node->color() == RED && father->color() == RED && father != header)
+    return -1;
+  int left = checkSubtree(node->left, node, prev, weight);
+  if (left < 0) return -1;
+  if (prev != header && !key_less(prev->key(), node->key())) return -1;
+  if constexpr (Threaded) {
+    if (prev->next != node || node->prev != prev) return -1;
   }
+  prev = node;
+  int right = checkSubtree(node->right, node, prev, weight);
+  if (right != left) return -1;
+  if (node->subtree != subtreeSize(node->left) + subtreeSize(node->right) +
+                           size_type(weight(node)))
+    return -1;
+  return left + (node->color() == BLACK);
+}
 
-  other.clear();
-  other.tree_size = 0;  // Обнуляем размер второго дерева
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+bool BinaryTree<T1, T2, Allocator, Compare, Threaded>::valid() const {
+  return valid([](const Node<T1, T2, Threaded> *) { return size_type(1); });
 }
 
-template <typename T1, typename T2>
-void BinaryTree<T1, T2>::pushRecursive(Node<T1, T2> *node) {
-  if (node && node != endNode) {
-    // Сохраняем потомков текущего узла
-    Node<T1, T2> *leftChild = node->left;
-    Node<T1, T2> *rightChild = node->right;
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+template <typename Weight>
+bool BinaryTree<T1, T2, Allocator, Compare, Threaded>::valid(
+    Weight weight) const {
+  if (!root)
+    return !header || (header->parent() == nullptr &&
+                       header->left == header && header->right == header);
+  if (!header || header->parent() != root || root->color() != BLACK)
+    return false;
+  const Node<T1, T2, Threaded> *first = root, *last = root;
+  while (first->left) first = first->left;
+  while (last->right) last = last->right;
+  if (header->left != first || header->right != last) return false;
+  const Node<T1, T2, Threaded> *prev = header;
+  if (checkSubtree(root, header, prev, weight) < 0) return false;
+  // Кольцо нитей замыкается на заглавном узле
+  if constexpr (Threaded) return last->next == header && header->prev == last;
+  return true;
+}
 
-    // Вставляем текущий узел в текущее дерево
-    push(node->key, node->data);
-    
-    // Удаляем текущий узел
-    delete node;
-    --tree_size;
+/*Удаление узла без перестроения поддеревьев: если у узла два потомка,
+на его место перевешивается следующий по порядку узел (минимальный в правом
+поддереве), после чего удаляемый узел имеет не более одного потомка и
+вырезается из дерева. Остальные узлы не перевыделяются и не перемещаются,
+поэтому итераторы на них остаются действительными. Если был удален черный
+узел, черная высота восстанавливается в eraseBalance за O(log n).*/
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+void BinaryTree<T1, T2, Allocator, Compare, Threaded>::remove(
+    Node<T1, T2, Threaded> *ptr) {
+  if (!ptr || ptr == header) return;
+  unlink(ptr);
+  destroyNode(ptr);
+}
 
-    // Рекурсивно вызываем pushRecursive для левого поддерева
-    if (leftChild) pushRecursive(leftChild);
-    leftChild = nullptr;
-    
-    // Рекурсивно вызываем pushRecursive для правого поддерева
-    if (rightChild) pushRecursive(rightChild);
-    rightChild = nullptr;
+// Вырезает узел ptr из дерева, сам узел не удаляется
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+void BinaryTree<T1, T2, Allocator, Compare, Threaded>::unlink(
+    Node<T1, T2, Threaded> *ptr) {
+  // Соседи по порядку ключей смыкаются в обход ptr
+  if constexpr (Threaded) chain(ptr->prev, ptr->next);
+  // Поддерживаем ссылки заглавного узла на минимальный и максимальный узлы
+  if (ptr == header->left) {
+    if (ptr->right) {
+      header->left = ptr->right;
+      while (header->left->left) header->left = header->left->left;
+    } else {
+      header->left = ptr->parent();
+    }
+  }
+  if (ptr == header->right) {
+    if (ptr->left) {
+      header->right = ptr->left;
+      while (header->right->right) header->right = header->right->right;
+    } else {
+      header->right = ptr->parent();
+    }
+  }
 
+  // Узлы над ptr теряют его элементы
+  size_type own = ptr->subtree - subtreeSize(ptr->left) -
+                  subtreeSize(ptr->right);
+  for (Node<T1, T2, Threaded> *up = ptr->parent(); up != header;
+       up = up->parent())
+    up->subtree -= own;
+
+  Node<T1, T2, Threaded> *child = nullptr;
+  Node<T1, T2, Threaded> *father = nullptr;
+  if (ptr->left && ptr->right) {
+    Node<T1, T2, Threaded> *next = ptr->right;
+    while (next->left) next = next->left;
+    // Узлы между next и ptr теряют элементы next, поднимающегося наверх
+    size_type moved = next->subtree - subtreeSize(next->right);
+    for (Node<T1, T2, Threaded> *up = next->parent(); up != ptr;
+         up = up->parent())
+      up->subtree -= moved;
+    next->subtree = ptr->subtree - own;
+    child = next->right;
+    if (next->parent() == ptr) {
+      father = next;
+    } else {
+      father = next->parent();
+      father->left = child;
+      if (child) child->setParent(father);
+      next->right = ptr->right;
+      ptr->right->setParent(next);
+    }
+    next->left = ptr->left;
+    ptr->left->setParent(next);
+    replaceNode(ptr, next);
+    // next занимает место ptr вместе с его цветом
+    swapColors(next, ptr);
+  } else {
+    child = ptr->left ? ptr->left : ptr->right;
+    father = ptr->parent();
+    replaceNode(ptr, child);
   }
+  if (ptr->color() == BLACK) eraseBalance(child, father);
+  if (!root) resetHeader();
 }
 
-template <typename T1, typename T2>
-void BinaryTree<T1, T2>::remove(Node<T1, T2> *ptr) {
-  if (!ptr) return;
-  if (ptr != root) {
-    if (ptr->parent->left == ptr)
-      ptr->parent->left = nullptr;
-    else
-      ptr->parent->right = nullptr;
+// Восстановление черной высоты после удаления черного узла,
+// ptr - узел, занявший место удаленного (может быть nullptr)
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+void BinaryTree<T1, T2, Allocator, Compare, Threaded>::eraseBalance(
+    Node<T1, T2, Threaded> *ptr, Node<T1, T2, Threaded> *father) {
+  while (ptr != root && isBlack(ptr)) {
+    if (ptr == father->left) {
+      Node<T1, T2, Threaded> *brother = father->right;
+      if (brother->color() == RED) {
+        brother->setColor(BLACK);
+        father->setColor(RED);
+        lift(brother);
+        brother = father->right;
+      }
+      if (isBlack(brother->left) && isBlack(brother->right)) {
+        brother->setColor(RED);
+        ptr = father;
+        father = ptr->parent();
+      } else {
+        if (isBlack(brother->right)) {
+          brother->left->setColor(BLACK);
+          brother->setColor(RED);
+          lift(brother->left);
+          brother = father->right;
+        }
+        brother->setColor(father->color());
+        father->setColor(BLACK);
+        brother->right->setColor(BLACK);
+        lift(brother);
+        ptr = root;
+      }
+    } else {
+      Node<T1, T2, Threaded> *brother = father->left;
+      if (brother->color() == RED) {
+        brother->setColor(BLACK);
+        father->setColor(RED);
+        lift(brother);
+        brother = father->left;
+      }
+      if (isBlack(brother->left) && isBlack(brother->right)) {
+        brother->setColor(RED);
+        ptr = father;
+        father = ptr->parent();
+      } else {
+        if (isBlack(brother->left)) {
+          brother->right->setColor(BLACK);
+          brother->setColor(RED);
+          lift(brother->right);
+          brother = father->left;
+        }
+        brother->setColor(father->color());
+        father->setColor(BLACK);
+        brother->left->setColor(BLACK);
+        lift(brother);
+        ptr = root;
+      }
+    }
+  }
+  if (ptr) ptr->setColor(BLACK);
+}
 
-    Node<T1, T2> *leftChild = ptr->left;
-    Node<T1, T2> *rightChild = ptr->right;
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+template <typename InputIt>
+void
+BinaryTree<T1, T2, Allocator, Compare, Threaded>::assign_sorted(InputIt first,
+                                                                InputIt last) {
+  assign_sorted(first, last, [](const auto &item) {
+    if constexpr (std::is_void_v<T2>)
+      return T1(item);
+    else
+      return std::pair<T1, T2>(item.first, item.second);
+  });
+}
 
-    delete ptr;
-    --tree_size;
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+template <typename InputIt, typename Get>
+void
+BinaryTree<T1, T2, Allocator, Compare, Threaded>::assign_sorted(InputIt first,
+                                                                InputIt last,
+                                                                Get get) {
+  assign_sorted(first, last, get,
+                [](auto &&...) { return size_type(0); });
+}
 
-    if (leftChild) {
-      pushRecursive(leftChild);
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+template <typename InputIt, typename Get, typename Absorb>
+void
+BinaryTree<T1, T2, Allocator, Compare, Threaded>::assign_sorted(InputIt first,
+                                                                InputIt last,
+                                                                Get get,
+                                                                Absorb absorb) {
+  clear();
+  std::vector<Node<T1, T2, Threaded> *> nodes;
+  if constexpr (std::is_base_of_v<
+                    std::forward_iterator_tag,
+                    typename std::iterator_traits<InputIt>::iterator_category>)
+    nodes.reserve(std::distance(first, last));
+  bool sorted = true;
+  try {
+    for (; first != last; ++first) {
+      nodes.push_back(createItem(get(*first)));
+      if (nodes.size() < 2) continue;
+      Node<T1, T2, Threaded> *prev = nodes[nodes.size() - 2];
+      Node<T1, T2, Threaded> *node = nodes.back();
+      if (key_less(node->key(), prev->key())) {
+        sorted = false;
+      } else if (sorted && !key_less(prev->key(), node->key())) {
+        nodes.pop_back();
+        absorbNode(prev, node, absorb);
+      }
     }
-    if (rightChild) {
-      pushRecursive(rightChild);
+  } catch (...) {
+    for (Node<T1, T2, Threaded> *node : nodes) destroyNode(node);
+    throw;
+  }
+  if (!sorted) {
+    std::stable_sort(nodes.begin(), nodes.end(),
+                     [this](const Node<T1, T2, Threaded> *a,
+                            const Node<T1, T2, Threaded> *b) {
+                       return key_less(a->key(), b->key());
+                     });
+    size_type count = 0;
+    for (Node<T1, T2, Threaded> *node : nodes) {
+      if (count && !key_less(nodes[count - 1]->key(), node->key())) {
+        absorbNode(nodes[count - 1], node, absorb);
+      } else {
+        nodes[count++] = node;
+      }
     }
-  } else removeRoot(ptr);
+    nodes.resize(count);
+  }
+  if (nodes.empty()) return;
+
+  // Все уровни, кроме последнего, заполнены целиком: последний уровень
+  // красим в красный, остальные в черный, и черная высота везде одинакова
+  int red_depth = 0;
+  while ((size_type(2) << red_depth) <= nodes.size()) ++red_depth;
+  if (!header) createHeader();
+  root = linkBalanced(nodes, 0, nodes.size(), header, 0, red_depth);
+  root->setColor(BLACK);
+  header->setParent(root);
+  header->left = nodes.front();
+  header->right = nodes.back();
+  Node<T1, T2, Threaded> *prev = header;
+  for (Node<T1, T2, Threaded> *node : nodes) {
+    chain(prev, node);
+    prev = node;
+  }
+  chain(prev, header);
 }
 
-template <typename T1, typename T2>
-void BinaryTree<T1, T2>::removeRoot(Node<T1, T2> *node) {
-  Node<T1, T2> *left_root = root->left;
-  Node<T1, T2> *right_root = root->right;
-  if (left_root) left_root->parent = nullptr;
-  if (right_root) right_root->parent = nullptr;
-  
-  if(left_root || right_root){
-    if (nodeCounting(left_root) >= nodeCounting(right_root)) {
-      left_root->nodeColor = BLACK;
-      root = left_root;
-      delete node;
-      --tree_size;
-      pushRecursive(right_root);
-    } else {
-      right_root->nodeColor = BLACK;
-      root = right_root;
-      delete node;
-      --tree_size;
-      pushRecursive(left_root);
+// Связывает узлы nodes[lo, hi) в поддерево с корнем в середине отрезка.
+// До связывания поле subtree узла хранит его собственный вес
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+Node<T1, T2, Threaded> *
+BinaryTree<T1, T2, Allocator, Compare, Threaded>::linkBalanced(
+    std::vector<Node<T1, T2, Threaded> *> &nodes, size_t lo, size_t hi,
+    Node<T1, T2, Threaded> *father, int depth, int red_depth) {
+  if (lo >= hi) return nullptr;
+  size_t mid = lo + (hi - lo) / 2;
+  Node<T1, T2, Threaded> *node = nodes[mid];
+  node->setParent(father);
+  node->setColor(depth == red_depth ? RED : BLACK);
+  node->left = linkBalanced(nodes, lo, mid, node, depth + 1, red_depth);
+  node->right = linkBalanced(nodes, mid + 1, hi, node, depth + 1, red_depth);
+  node->subtree += subtreeSize(node->left) + subtreeSize(node->right);
+  return node;
+}
+
+// Связывает нитями соседей по порядку; без нитей ничего не делает
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+void BinaryTree<T1, T2, Allocator, Compare, Threaded>::chain(
+    Node<T1, T2, Threaded> *prev, Node<T1, T2, Threaded> *next) {
+  if constexpr (Threaded) {
+    prev->next = next;
+    next->prev = prev;
+  }
+}
+
+// Проставляет нити поддерева node по порядку вслед за prev, возвращает
+// последний узел поддерева. Рекурсия только по левым сыновьям: O(log n)
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+Node<T1, T2, Threaded> *
+BinaryTree<T1, T2, Allocator, Compare, Threaded>::threadSubtree(
+    Node<T1, T2, Threaded> *node, Node<T1, T2, Threaded> *prev) {
+  for (; node; node = node->right) {
+    prev = threadSubtree(node->left, prev);
+    chain(prev, node);
+    prev = node;
+  }
+  return prev;
+}
+
+// Нити всего дерева заново за O(n), после копирования и операций над
+// множествами, которые перемешивают узлы двух деревьев
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+void BinaryTree<T1, T2, Allocator, Compare, Threaded>::threadAll() {
+  if constexpr (Threaded) {
+    if (header) chain(threadSubtree(root, header), header);
+  }
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+void BinaryTree<T1, T2, Allocator, Compare, Threaded>::prefetch(
+    const Node<T1, T2, Threaded> *node) {
+#if defined(__GNUC__)
+  __builtin_prefetch(node);
+#else
+  (void)node;
+#endif
+}
+
+/*Обход [first, last) с предвыборкой: второй итератор идет на distance
+узлов впереди и подгружает их в кэш, пока visit работает с текущим узлом.
+С нитями оба итератора делают по одному переходу на шаг, поэтому адрес
+следующего узла известен задолго до обращения к нему.*/
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+template <typename It, typename Visit>
+void BinaryTree<T1, T2, Allocator, Compare, Threaded>::scan(It first, It last,
+                                                            size_t distance,
+                                                            Visit &visit) {
+  It ahead = first;
+  for (size_t i = 0; i < distance && ahead != last; ++i) ++ahead;
+  while (first != last) {
+    if (ahead != last) {
+      prefetch(ahead.node());
+      ++ahead;
     }
-  } else {
-    delete node;
-    --tree_size;
+    auto node = first.node();
+    ++first;
+    visit(node);
+  }
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+typename BinaryTree<T1, T2, Allocator, Compare, Threaded>::Part
+BinaryTree<T1, T2, Allocator, Compare, Threaded>::makePart(
+    Node<T1, T2, Threaded> *node, size_t height) {
+  Part result;
+  if (!node) return result;
+  node->setParent(nullptr);
+  if (node->color() == RED) {
+    node->setColor(BLACK);
+    ++height;
+  }
+  result.node = node;
+  result.height = height;
+  return result;
+}
+
+// Отделяет корень от поддеревьев, у корня остается только его вес
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+void BinaryTree<T1, T2, Allocator, Compare, Threaded>::cutRoot(Part whole,
+                                                               Part &left,
+                                                               Part &right) {
+  Node<T1, T2, Threaded> *node = whole.node;
+  node->subtree -= subtreeSize(node->left) + subtreeSize(node->right);
+  left = makePart(node->left, whole.height - 1);
+  right = makePart(node->right, whole.height - 1);
+  node->left = nullptr;
+  node->right = nullptr;
+}
+
+// Забирает все узлы дерева, заглавный узел остается на месте
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+typename BinaryTree<T1, T2, Allocator, Compare, Threaded>::Part
+BinaryTree<T1, T2, Allocator, Compare, Threaded>::detachAll() {
+  size_t height = 0;
+  for (Node<T1, T2, Threaded> *ptr = root; ptr; ptr = ptr->left)
+    if (ptr->color() == BLACK) ++height;
+  Part result = makePart(root, height);
+  root = nullptr;
+  if (header) resetHeader();
+  return result;
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+void BinaryTree<T1, T2, Allocator, Compare, Threaded>::attach(Part whole) {
+  root = whole.node;
+  if (!root) {
+    resetHeader();
+    return;
+  }
+  root->setParent(header);
+  header->setParent(root);
+  header->left = root;
+  while (header->left->left) header->left = header->left->left;
+  header->right = root;
+  while (header->right->right) header->right = header->right->right;
+  // Внутри части нити верны, у крайних узлов они еще ведут в старое дерево
+  chain(header, header->left);
+  chain(header->right, header);
+}
+
+/*Склейка left < mid < right за O(|разность черных высот| + 1). У более
+высокого дерева спускаемся по краю до черного узла той же высоты, что и у
+низкого, и подвешиваем на его место красный mid. Возможное нарушение
+"красный под красным" устраняет обычная балансировка после вставки, для нее
+высокое дерево временно становится корнем *this (оно в это время пусто).*/
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+typename BinaryTree<T1, T2, Allocator, Compare, Threaded>::Part
+BinaryTree<T1, T2, Allocator, Compare, Threaded>::joinParts(
+    Part left, Node<T1, T2, Threaded> *mid, Part right) {
+  mid->setParent(nullptr);
+  if (left.height == right.height) {
+    mid->left = left.node;
+    mid->right = right.node;
+    if (left.node) left.node->setParent(mid);
+    if (right.node) right.node->setParent(mid);
+    mid->subtree += subtreeSize(left.node) + subtreeSize(right.node);
+    mid->setColor(BLACK);
+    Part result;
+    result.node = mid;
+    result.height = left.height + 1;
+    return result;
+  }
+  bool to_right = left.height > right.height;
+  Part result = to_right ? left : right;
+  Part lower = to_right ? right : left;
+  Node<T1, T2, Threaded> *father = nullptr;
+  Node<T1, T2, Threaded> *ptr = result.node;
+  size_t height = result.height;
+  while (ptr && (ptr->color() == RED || height > lower.height)) {
+    if (ptr->color() == BLACK) --height;
+    father = ptr;
+    ptr = to_right ? ptr->right : ptr->left;
+  }
+  size_type added = mid->subtree + subtreeSize(lower.node);
+  for (Node<T1, T2, Threaded> *up = father; up; up = up->parent())
+    up->subtree += added;
+  mid->left = to_right ? ptr : lower.node;
+  mid->right = to_right ? lower.node : ptr;
+  if (mid->left) mid->left->setParent(mid);
+  if (mid->right) mid->right->setParent(mid);
+  mid->subtree += subtreeSize(ptr) + subtreeSize(lower.node);
+  mid->setColor(RED);
+  mid->setParent(father);
+  if (to_right)
+    father->right = mid;
+  else
+    father->left = mid;
+  if (father->color() == RED) {
+    root = result.node;
+    header->setParent(root);
+    root->setParent(header);
+    if (balanceTree(mid)) ++result.height;
+    result.node = root;
+    root->setParent(nullptr);
     root = nullptr;
+    header->setParent(nullptr);
   }
+  return result;
 }
 
-template <typename T1, typename T2>
-int BinaryTree<T1, T2>::nodeCounting(Node<T1, T2> *node) {
-  // Если узел равен nullptr, возвращаем 0
-  if (node == nullptr) {
-    return 0;
+// Склейка без среднего узла: его роль играет максимальный узел left
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+typename BinaryTree<T1, T2, Allocator, Compare, Threaded>::Part
+BinaryTree<T1, T2, Allocator, Compare, Threaded>::joinParts(Part left,
+                                                            Part right) {
+  if (!left.node) return right;
+  if (!right.node) return left;
+  Part rest;
+  Node<T1, T2, Threaded> *last = splitLast(left, rest);
+  return joinParts(rest, last, right);
+}
+
+// Разрезает whole на ключи меньше key, узел с ключом key и ключи больше key
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+void BinaryTree<T1, T2, Allocator, Compare, Threaded>::splitPart(
+    Part whole, const T1 &key, Part &left, Node<T1, T2, Threaded> *&mid,
+    Part &right) {
+  if (!whole.node) {
+    left = right = Part();
+    mid = nullptr;
+    return;
+  }
+  Node<T1, T2, Threaded> *node = whole.node;
+  Part lower, upper, rest;
+  cutRoot(whole, lower, upper);
+  int sign = order(key, node->key());
+  if (sign < 0) {
+    splitPart(lower, key, left, mid, rest);
+    right = joinParts(rest, node, upper);
+  } else if (sign > 0) {
+    splitPart(upper, key, rest, mid, right);
+    left = joinParts(lower, node, rest);
+  } else {
+    left = lower;
+    mid = node;
+    right = upper;
   }
-  // Возвращаем количество узлов в текущем поддереве
-  return 1 + nodeCounting(node->left) + nodeCounting(node->right);
 }
 
-template <typename T1, typename T2>
-Node<T1, T2> *BinaryTree<T1, T2>::lastNode() {
-  Node<T1, T2> *current = root;
-  if (!current) return nullptr;
-  while (current->right && current->right != endNode) {
-    current = current->right;
+// Отрезает максимальный узел, остальные узлы возвращаются в rest
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+Node<T1, T2, Threaded> *
+BinaryTree<T1, T2, Allocator, Compare, Threaded>::splitLast(Part whole,
+                                                            Part &rest) {
+  Node<T1, T2, Threaded> *node = whole.node;
+  Part lower, upper, tail;
+  cutRoot(whole, lower, upper);
+  if (!upper.node) {
+    rest = lower;
+    return node;
   }
-  return current;
+  Node<T1, T2, Threaded> *last = splitLast(upper, tail);
+  rest = joinParts(lower, node, tail);
+  return last;
 }
 
-template <typename T1, typename T2>
-void BinaryTree<T1, T2>::updateEndNode() {
-  if (root) {
-    Node<T1, T2> *last = lastNode();
-    if (!endNode) endNode = new Node<T1, T2>{T1(), T2()};
-    last->right = endNode;
-    endNode->parent = last;
-    endNode->nodeColor = BLACK;
+// Разрезает whole на ключи меньше key и ключи не меньше key
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+void BinaryTree<T1, T2, Allocator, Compare, Threaded>::splitBelow(Part whole,
+                                                                  const T1 &key,
+                                                                  Part &left,
+                                                                  Part &right) {
+  if (!whole.node) {
+    left = right = Part();
+    return;
+  }
+  Node<T1, T2, Threaded> *node = whole.node;
+  Part lower, upper, rest;
+  cutRoot(whole, lower, upper);
+  if (key_less(node->key(), key)) {
+    splitBelow(upper, key, rest, right);
+    left = joinParts(lower, node, rest);
   } else {
-    endNode = nullptr;
+    splitBelow(lower, key, left, rest);
+    right = joinParts(rest, node, upper);
   }
 }
 
-template <typename T1, typename T2>
-bool BinaryTree<T1, T2>::contains(const T1 &key) const {
+/*Корень a делит b на две части, части сливаются с поддеревьями a
+рекурсивно и склеиваются обратно через корень a. keep_a и keep_b говорят,
+оставлять ли ключи, найденные только в a или только в b.*/
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+template <typename Resolve>
+typename BinaryTree<T1, T2, Allocator, Compare, Threaded>::Part
+BinaryTree<T1, T2, Allocator, Compare, Threaded>::combineParts(
+    Part a, Part b, bool keep_a, bool keep_b, Resolve &resolve) {
+  if (!a.node || !b.node) {
+    Part rest = a.node ? a : b;
+    if (a.node ? keep_a : keep_b) return rest;
+    clear(rest.node);
+    return Part();
+  }
+  Node<T1, T2, Threaded> *node = a.node;
+  Part lower, upper, less, greater;
+  Node<T1, T2, Threaded> *match = nullptr;
+  cutRoot(a, lower, upper);
+  splitPart(b, node->key(), less, match, greater);
+  Part left = combineParts(lower, less, keep_a, keep_b, resolve);
+  Part right = combineParts(upper, greater, keep_a, keep_b, resolve);
+  bool keep = keep_a;
+  if (match) {
+    if constexpr (std::is_void_v<T2>)
+      node->subtree = resolve();
+    else
+      node->subtree =
+          resolve(node->data(), static_cast<const T2 &>(match->data()));
+    keep = node->subtree != 0;
+    destroyNode(match);
+  }
+  if (keep) return joinParts(left, node, right);
+  destroyNode(node);
+  return joinParts(left, right);
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+template <typename Resolve>
+void
+BinaryTree<T1, T2, Allocator, Compare, Threaded>::combine(BinaryTree &other,
+                                                          bool keep_a,
+                                                          bool keep_b,
+                                                          Resolve resolve) {
+  // Узлы можно забрать только из дерева с равным распределителем,
+  // иначе other сначала копируется в свою память
+  if (this == &other || alloc != other.alloc) {
+    BinaryTree copy(other, get_allocator());
+    if (this != &other) other.clear();
+    combine(copy, keep_a, keep_b, resolve);
+    return;
+  }
+  if (!header) createHeader();
+  Part a = detachAll();
+  Part b = other.detachAll();
+  attach(combineParts(a, b, keep_a, keep_b, resolve));
+  threadAll();
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+template <typename Resolve>
+void
+BinaryTree<T1, T2, Allocator, Compare, Threaded>::set_union(BinaryTree &other,
+                                                            Resolve resolve) {
+  combine(other, true, true, resolve);
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+void
+BinaryTree<T1, T2, Allocator, Compare, Threaded>::set_union(BinaryTree &other) {
+  set_union(other, [](auto &&...) { return size_type(1); });
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+template <typename Resolve>
+void BinaryTree<T1, T2, Allocator, Compare, Threaded>::set_intersection(
+    BinaryTree &other, Resolve resolve) {
+  combine(other, false, false, resolve);
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+void BinaryTree<T1, T2, Allocator, Compare, Threaded>::set_intersection(
+    BinaryTree &other) {
+  set_intersection(other, [](auto &&...) { return size_type(1); });
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+template <typename Resolve>
+void BinaryTree<T1, T2, Allocator, Compare, Threaded>::set_difference(
+    BinaryTree &other, Resolve resolve) {
+  combine(other, true, false, resolve);
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+void BinaryTree<T1, T2, Allocator, Compare, Threaded>::set_difference(
+    BinaryTree &other) {
+  set_difference(other, [](auto &&...) { return size_type(0); });
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+template <typename Resolve>
+void BinaryTree<T1, T2, Allocator, Compare, Threaded>::symmetric_difference(
+    BinaryTree &other, Resolve resolve) {
+  combine(other, true, true, resolve);
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+void BinaryTree<T1, T2, Allocator, Compare, Threaded>::symmetric_difference(
+    BinaryTree &other) {
+  symmetric_difference(other, [](auto &&...) { return size_type(0); });
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+BinaryTree<T1, T2, Allocator, Compare, Threaded>
+BinaryTree<T1, T2, Allocator, Compare, Threaded>::split(const T1 &key) {
+  BinaryTree result(comp, get_allocator());
+  if (!root) return result;
+  Part left, right;
+  splitBelow(detachAll(), key, left, right);
+  attach(left);
+  result.createHeader();
+  result.attach(right);
+  return result;
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+template <typename Resolve>
+void BinaryTree<T1, T2, Allocator, Compare, Threaded>::join(BinaryTree &other,
+                                                            Resolve resolve) {
+  if (this == &other || !other.root) return;
+  if (alloc != other.alloc) {
+    BinaryTree copy(other, get_allocator());
+    other.clear();
+    join(copy, resolve);
+    return;
+  }
+  if (!root) {
+    swap(other);
+    return;
+  }
+  bool before = key_less(other.back()->key(), front()->key());
+  // Диапазоны ключей пересекаются: склейка нарушила бы порядок
+  if (!before && !key_less(back()->key(), other.front()->key())) {
+    set_union(other, resolve);
+    return;
+  }
+  // Шов между деревьями: нити внутри каждого из них остаются верными
+  if (before)
+    chain(other.back(), front());
+  else
+    chain(back(), other.front());
+  Part mine = detachAll();
+  Part theirs = other.detachAll();
+  attach(before ? joinParts(theirs, mine) : joinParts(mine, theirs));
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+void BinaryTree<T1, T2, Allocator, Compare, Threaded>::join(BinaryTree &other) {
+  join(other, [](auto &&...) { return size_type(1); });
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+void BinaryTree<T1, T2, Allocator, Compare, Threaded>::reserve(size_type n) {
+  if constexpr (is_slab_allocator<node_allocator>::value) alloc.reserve(n);
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+void BinaryTree<T1, T2, Allocator, Compare, Threaded>::createHeader() {
+  if constexpr (std::is_void_v<T2>)
+    header = createNode(T1());
+  else
+    header = createNode(T1(), T2());
+  resetHeader();
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+template <typename K, typename... Args>
+Node<T1, T2, Threaded> *
+BinaryTree<T1, T2, Allocator, Compare, Threaded>::createNode(K &&key,
+                                                             Args &&...args) {
+  Node<T1, T2, Threaded> *node = node_traits::allocate(alloc, 1);
+  try {
+    node_traits::construct(alloc, node, std::in_place, std::forward<K>(key),
+                           std::forward<Args>(args)...);
+  } catch (...) {
+    node_traits::deallocate(alloc, node, 1);
+    throw;
+  }
+  return node;
+}
+
+// Узел с копией значения node, для копирования деревьев
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+Node<T1, T2, Threaded> *
+BinaryTree<T1, T2, Allocator, Compare, Threaded>::copyNode(
+    const Node<T1, T2, Threaded> *node) {
+  Node<T1, T2, Threaded> *copy = node_traits::allocate(alloc, 1);
+  try {
+    node_traits::construct(alloc, copy, node->value);
+  } catch (...) {
+    node_traits::deallocate(alloc, copy, 1);
+    throw;
+  }
+  return copy;
+}
+
+// Узел из результата get в assign_sorted: пары (ключ, данные) или ключа
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+template <typename Item>
+Node<T1, T2, Threaded> *
+BinaryTree<T1, T2, Allocator, Compare, Threaded>::createItem(Item &&item) {
+  if constexpr (std::is_void_v<T2>)
+    return createNode(std::forward<Item>(item));
+  else
+    return createNode(std::forward<Item>(item).first,
+                      std::forward<Item>(item).second);
+}
+
+// Дубликат node поглощается узлом kept и удаляется
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+template <typename Absorb>
+void BinaryTree<T1, T2, Allocator, Compare, Threaded>::absorbNode(
+    Node<T1, T2, Threaded> *kept, Node<T1, T2, Threaded> *node,
+    Absorb &absorb) {
+  if constexpr (!std::is_void_v<T2>) {
+    try {
+      kept->subtree += absorb(kept->data(), node->data());
+    } catch (...) {
+      destroyNode(node);
+      throw;
+    }
+  }
+  destroyNode(node);
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+void BinaryTree<T1, T2, Allocator, Compare, Threaded>::destroyNode(
+    Node<T1, T2, Threaded> *node) {
+  node_traits::destroy(alloc, node);
+  node_traits::deallocate(alloc, node, 1);
+}
+
+// Заглавный узел пустого дерева замкнут сам на себя, begin() == end().
+// Он всегда красный, что отличает его от черного корня при переходе --end()
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+void BinaryTree<T1, T2, Allocator, Compare, Threaded>::resetHeader() {
+  header->setParent(nullptr);
+  header->left = header;
+  header->right = header;
+  header->setColor(RED);
+  chain(header, header);
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare,
+          bool Threaded>
+template <typename K>
+bool
+BinaryTree<T1, T2, Allocator, Compare, Threaded>::contains(const K &key) const {
   bool result = false;
   if (find(key)) return true;
   return result;
@@ -0,0 +1,1379 @@
+#ifndef BTREE_H
+#define BTREE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+#include "key_order.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace binary_tree {
+
+// Данные элемента множества: под них в листьях не отводится места
+struct NoValue {};
+
+/*B+-дерево с уникальными ключами. Элементы хранятся только в листьях,
+листья связаны в двусвязный список для обхода, внутренние узлы хранят
+разделители: в поддереве сына i лежат ключи из [keys[i - 1], keys[i]).
+Узел занимает около node_bytes байт и выровнен по строке кэша, поэтому за
+один промах читаются десятки ключей, а высота дерева в несколько раз меньше,
+чем у красно-черного. Внутри узла позиция ищется линейным подсчетом без
+ветвлений (для 32-битных целых ключей - через SSE2), для прочих ключей -
+двоичным поиском. Ключи упорядочены по Compare, как у BinaryTree; подсчет
+без ветвлений работает только для std::less над арифметическим ключом.
+Ключи хранятся массивами, поэтому T1 (и T2) должны иметь конструктор по
+умолчанию. Любая вставка и удаление делают итераторы недействительными.*/
+template <typename T1, typename T2,
+          typename Allocator = std::allocator<std::pair<const T1, T2>>,
+          typename Compare = std::less<T1>>
+class BTree {
+ public:
+  using size_type = size_t;
+  using allocator_type = Allocator;
+
+  static constexpr size_type node_bytes = 256;
+  static constexpr int leaf_capacity = std::max<int>(
+      4, (node_bytes - 2 * sizeof(void *) - sizeof(int)) /
+             (sizeof(T1) + (std::is_empty_v<T2> ? 0 : sizeof(T2))));
+  static constexpr int inner_capacity = std::max<int>(
+      4, (node_bytes - sizeof(void *) - sizeof(int)) /
+             (sizeof(T1) + sizeof(void *)));
+
+ private:
+  // Меньше этого число элементов в узле (кроме корня) не опускается
+  static constexpr int leaf_min = leaf_capacity / 2;
+  static constexpr int inner_min = inner_capacity / 2;
+  // Высота дерева с ветвлением не меньше 2 на каждом уровне
+  static constexpr int max_depth = 64;
+
+  // Данные пустого типа не хранятся: все обращения попадают в один объект
+  struct EmptyValues {
+    T2 value;
+    T2 &operator[](int) { return value; }
+    const T2 &operator[](int) const { return value; }
+  };
+  using Values =
+      std::conditional_t<std::is_empty_v<T2>, EmptyValues, T2[leaf_capacity]>;
+
+  struct alignas(64) Leaf {
+    int count = 0;
+    Leaf *prev = nullptr, *next = nullptr;
+    T1 keys[leaf_capacity];
+    Values values;
+  };
+
+  // Сыновей на одного больше, чем ключей. Сыновья последнего внутреннего
+  // уровня - листья, остальных - внутренние узлы
+  struct alignas(64) Inner {
+    int count = 0;
+    T1 keys[inner_capacity];
+    void *children[inner_capacity + 1];
+  };
+
+  // Шаг спуска: узел и номер сына, в которого ушли
+  struct Step {
+    Inner *node;
+    int index;
+  };
+
+  using leaf_allocator = typename std::allocator_traits<
+      Allocator>::template rebind_alloc<Leaf>;
+  using leaf_traits = std::allocator_traits<leaf_allocator>;
+  using inner_allocator = typename std::allocator_traits<
+      Allocator>::template rebind_alloc<Inner>;
+  using inner_traits = std::allocator_traits<inner_allocator>;
+
+  leaf_allocator leaf_alloc;
+  inner_allocator inner_alloc;
+  void *root = nullptr;
+  // Число внутренних уровней, 0 - корень сам является листом
+  int height = 0;
+  Leaf *first = nullptr, *last = nullptr;
+  size_type tree_size = 0;
+  Compare comp;
+
+  Leaf *createLeaf();
+  Inner *createInner();
+  void destroyLeaf(Leaf *leaf);
+  void destroyInner(Inner *inner);
+  void clear(void *node, int level);
+  void *cloneNode(const void *node, int level, Leaf *&previous);
+  void copyFrom(const BTree &other);
+  // a < b в порядке Compare
+  template <typename A, typename B>
+  bool key_less(const A &a, const B &b) const {
+    return KeyOrder<Compare>::less(comp, a, b);
+  }
+  template <bool Upper, typename K>
+  int rank(const T1 *keys, int n, const K &key) const;
+  template <typename K>
+  Leaf *descend(const K &key, Step *path) const;
+  void insertInner(Step *path, int depth, T1 separator, void *child,
+                   Inner **spare);
+  void fixLeaf(Leaf *&leaf, int &pos, Step *path);
+  void fixInner(int level, Step *path);
+  bool balancePair(void *left, void *right, int level, T1 &separator);
+  void splice(BTree &other);
+  bool checkNode(const void *node, int level, const T1 *low, const T1 *high,
+                 const Leaf *&previous, size_type &count) const;
+
+ public:
+  BTree() = default;
+
+  explicit BTree(const Allocator &allocator)
+      : leaf_alloc(allocator), inner_alloc(allocator) {}
+
+  explicit BTree(const Compare &compare,
+                 const Allocator &allocator = Allocator())
+      : leaf_alloc(allocator), inner_alloc(allocator), comp(compare) {}
+
+  // Конструктор со списком инициализирования
+  BTree(std::initializer_list<std::pair<T1, T2>> const &items,
+        const Allocator &allocator = Allocator());
+
+  // Конструктор копирования: повторяет форму исходного дерева
+  BTree(const BTree &other);
+
+  // Конструктор перемещения
+  BTree(BTree &&other) noexcept;
+
+  BTree &operator=(const BTree &other);
+  BTree &operator=(BTree &&other);
+
+  ~BTree();
+
+  allocator_type get_allocator() const { return allocator_type(leaf_alloc); }
+  Compare key_comp() const { return comp; }
+
+  /*Ключи и данные лежат в листе разными массивами, и пары pair<const T1, T2>
+  в памяти нет. Поэтому итератор, как у std::flat_map, разыменовывается в
+  пару ссылок reference: it->first, it->second = x. pointer - обертка над
+  такой парой, через которую работает оператор ->.*/
+  template <typename Reference>
+  struct Arrow {
+    Reference ref;
+    const Reference *operator->() const { return &ref; }
+  };
+
+  class const_iterator;
+
+  class iterator {
+   private:
+    const BTree *tree;
+    Leaf *leaf;
+    int pos;
+    friend class BTree;
+    friend class const_iterator;
+
+   public:
+    using iterator_category = std::bidirectional_iterator_tag;
+    using value_type = std::pair<const T1, T2>;
+    using difference_type = std::ptrdiff_t;
+    using reference = std::pair<const T1 &, T2 &>;
+    using pointer = Arrow<reference>;
+
+    iterator(const BTree *tree, Leaf *leaf, int pos);
+
+    // Префиксный оператор++
+    iterator &operator++();
+
+    // Префиксный оператор--
+    iterator &operator--();
+
+    // Постфиксный оператор++
+    iterator operator++(int);
+
+    // Постфиксный оператор--
+    iterator operator--(int);
+
+    // Операторы сравнения
+    bool operator==(const iterator &other) const;
+    bool operator!=(const iterator &other) const;
+
+    // Оператор разыменования
+    reference operator*() const;
+
+    // Оператор доступа к члену
+    pointer operator->() const;
+  };
+
+  class const_iterator {
+   private:
+    iterator position;
+
+   public:
+    using iterator_category = std::bidirectional_iterator_tag;
+    using value_type = std::pair<const T1, T2>;
+    using difference_type = std::ptrdiff_t;
+    using reference = std::pair<const T1 &, const T2 &>;
+    using pointer = Arrow<reference>;
+
+    const_iterator(const BTree *tree, Leaf *leaf, int pos);
+    const_iterator(const iterator &other);
+
+    // Префиксный оператор++
+    const_iterator &operator++();
+
+    // Префиксный оператор--
+    const_iterator &operator--();
+
+    // Постфиксный оператор++
+    const_iterator operator++(int);
+
+    // Постфиксный оператор--
+    const_iterator operator--(int);
+
+    // Операторы сравнения
+    bool operator==(const const_iterator &other) const;
+    bool operator!=(const const_iterator &other) const;
+
+    // Оператор разыменования
+    reference operator*() const;
+
+    // Оператор доступа к члену
+    pointer operator->() const;
+  };
+
+  // Методы для получения итераторов
+  iterator begin();
+  iterator end();
+  const_iterator begin() const;
+  const_iterator end() const;
+
+  // Вставка уникального ключа. Возвращает позицию нового или уже
+  // существующего элемента с таким ключом (тогда second == false)
+  std::pair<iterator, bool> push(const T1 &key, const T2 &data);
+  // То же, но ключ копируется или перемещается из key, а данные строятся из
+  // args только если ключа еще нет
+  template <typename K, typename... Args>
+  std::pair<iterator, bool> emplace(K &&key, Args &&...args);
+
+  /*Поиск по ключу K: это T1 или, при прозрачном Compare, любой тип, который
+  Compare сравнивает с T1 напрямую. Контейнеры пропускают сюда K только для
+  прозрачного компаратора.*/
+  template <typename K>
+  iterator find(const K &key);
+  template <typename K>
+  const_iterator find(const K &key) const;
+  // Первый элемент с ключом не меньше key
+  template <typename K>
+  iterator lower_bound(const K &key);
+  template <typename K>
+  const_iterator lower_bound(const K &key) const;
+  // Первый элемент с ключом больше key
+  template <typename K>
+  iterator upper_bound(const K &key);
+  template <typename K>
+  const_iterator upper_bound(const K &key) const;
+  template <typename K>
+  bool contains(const K &key) const;
+
+  // Удаление по итератору и по ключу. Удаление по итератору не ищет ключ
+  // в листе и возвращает итератор на следующий элемент. Итераторы на
+  // другие элементы становятся недействительными
+  iterator erase(iterator pos);
+  template <typename K>
+  size_type erase(const K &key);
+
+  // Методы для доступа к информации о наполнении контейнера
+  bool empty() const;
+  size_type size() const;
+  size_type max_size() const;
+
+  /*Проверка инвариантов за O(n), для тестов: все листья на одной глубине,
+  узлы, кроме корня, заполнены не меньше чем наполовину, ключи в узле
+  возрастают и лежат между разделителями отца, список листьев идет в порядке
+  ключей от first до last, а число элементов равно size().*/
+  bool valid() const;
+
+  // Число внутренних уровней, 0 - все элементы в одном листе
+  int depth() const { return height; }
+
+  // Забирает из other ключи, которых нет в *this, other становится пустым.
+  // Непересекающиеся деревья сшиваются без переноса элементов
+  void merge(BTree &other);
+
+  void clear();
+  void swap(BTree &other);
+
+ private:
+  // Объявлена после итератора, который она возвращает
+  iterator eraseAt(Leaf *leaf, int pos, Step *path);
+};
+
+template <typename T1, typename T2, typename Allocator, typename Compare>
+BTree<T1, T2, Allocator, Compare>::BTree(
+    std::initializer_list<std::pair<T1, T2>> const &items,
+    const Allocator &allocator)
+    : BTree(allocator) {
+  for (const auto &item : items) push(item.first, item.second);
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare>
+BTree<T1, T2, Allocator, Compare>::BTree(const BTree &other)
+    : leaf_alloc(
+          leaf_traits::select_on_container_copy_construction(other.leaf_alloc)),
+      inner_alloc(inner_traits::select_on_container_copy_construction(
+          other.inner_alloc)),
+      comp(other.comp) {
+  copyFrom(other);
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare>
+BTree<T1, T2, Allocator, Compare>::BTree(BTree &&other) noexcept
+    : leaf_alloc(std::move(other.leaf_alloc)),
+      inner_alloc(std::move(other.inner_alloc)),
+      root(other.root),
+      height(other.height),
+      first(other.first),
+      last(other.last),
+      tree_size(other.tree_size),
+      comp(other.comp) {
+  other.root = nullptr;
+  other.height = 0;
+  other.first = other.last = nullptr;
+  other.tree_size = 0;
+}
+
+// Распределитель не переходит, элементы копируются в свою память
+template <typename T1, typename T2, typename Allocator, typename Compare>
+BTree<T1, T2, Allocator, Compare> &
+BTree<T1, T2, Allocator, Compare>::operator=(const BTree &other) {
+  if (this != &other) {
+    clear();
+    comp = other.comp;
+    copyFrom(other);
+  }
+  return *this;
+}
+
+// Узлы забираются при равных распределителях, иначе копируются
+template <typename T1, typename T2, typename Allocator, typename Compare>
+BTree<T1, T2, Allocator, Compare> &
+BTree<T1, T2, Allocator, Compare>::operator=(BTree &&other) {
+  if (this != &other) {
+    if (leaf_alloc != other.leaf_alloc) {
+      *this = static_cast<const BTree &>(other);
+      other.clear();
+    } else {
+      clear();
+      comp = other.comp;
+      std::swap(root, other.root);
+      std::swap(height, other.height);
+      std::swap(first, other.first);
+      std::swap(last, other.last);
+      std::swap(tree_size, other.tree_size);
+    }
+  }
+  return *this;
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare>
+BTree<T1, T2, Allocator, Compare>::~BTree() {
+  clear(root, height);
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare>
+typename BTree<T1, T2, Allocator, Compare>::Leaf *
+BTree<T1, T2, Allocator, Compare>::createLeaf() {
+  Leaf *leaf = leaf_traits::allocate(leaf_alloc, 1);
+  try {
+    leaf_traits::construct(leaf_alloc, leaf);
+  } catch (...) {
+    leaf_traits::deallocate(leaf_alloc, leaf, 1);
+    throw;
+  }
+  return leaf;
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare>
+typename BTree<T1, T2, Allocator, Compare>::Inner *
+BTree<T1, T2, Allocator, Compare>::createInner() {
+  Inner *inner = inner_traits::allocate(inner_alloc, 1);
+  try {
+    inner_traits::construct(inner_alloc, inner);
+  } catch (...) {
+    inner_traits::deallocate(inner_alloc, inner, 1);
+    throw;
+  }
+  return inner;
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare>
+void BTree<T1, T2, Allocator, Compare>::destroyLeaf(Leaf *leaf) {
+  leaf_traits::destroy(leaf_alloc, leaf);
+  leaf_traits::deallocate(leaf_alloc, leaf, 1);
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare>
+void BTree<T1, T2, Allocator, Compare>::destroyInner(Inner *inner) {
+  inner_traits::destroy(inner_alloc, inner);
+  inner_traits::deallocate(inner_alloc, inner, 1);
+}
+
+// level - число внутренних уровней под node и включая его
+template <typename T1, typename T2, typename Allocator, typename Compare>
+void BTree<T1, T2, Allocator, Compare>::clear(void *node, int level) {
+  if (!node) return;
+  if (level == 0) {
+    destroyLeaf(static_cast<Leaf *>(node));
+    return;
+  }
+  Inner *inner = static_cast<Inner *>(node);
+  for (int i = 0; i <= inner->count; ++i) clear(inner->children[i], level - 1);
+  destroyInner(inner);
+}
+
+// previous - последний уже скопированный лист, к нему цепляется следующий
+template <typename T1, typename T2, typename Allocator, typename Compare>
+void *BTree<T1, T2, Allocator, Compare>::cloneNode(const void *node,
+                                                   int level,
+                                                   Leaf *&previous) {
+  if (!node) return nullptr;
+  if (level == 0) {
+    const Leaf *leaf = static_cast<const Leaf *>(node);
+    Leaf *copy = createLeaf();
+    copy->count = leaf->count;
+    std::copy(leaf->keys, leaf->keys + leaf->count, copy->keys);
+    if constexpr (!std::is_empty_v<T2>)
+      std::copy(leaf->values, leaf->values + leaf->count, copy->values);
+    copy->prev = previous;
+    if (previous)
+      previous->next = copy;
+    else
+      first = copy;
+    previous = copy;
+    return copy;
+  }
+  const Inner *inner = static_cast<const Inner *>(node);
+  Inner *copy = createInner();
+  int done = 0;
+  try {
+    for (; done <= inner->count; ++done)
+      copy->children[done] =
+          cloneNode(inner->children[done], level - 1, previous);
+  } catch (...) {
+    for (int i = 0; i < done; ++i) clear(copy->children[i], level - 1);
+    destroyInner(copy);
+    throw;
+  }
+  copy->count = inner->count;
+  std::copy(inner->keys, inner->keys + inner->count, copy->keys);
+  return copy;
+}
+
+// Копирует other в пустое дерево, при исключении дерево остается пустым
+template <typename T1, typename T2, typename Allocator, typename Compare>
+void BTree<T1, T2, Allocator, Compare>::copyFrom(const BTree &other) {
+  Leaf *previous = nullptr;
+  try {
+    root = cloneNode(other.root, other.height, previous);
+  } catch (...) {
+    first = last = nullptr;
+    throw;
+  }
+  height = other.height;
+  last = previous;
+  tree_size = other.tree_size;
+}
+
+/*Число ключей в keys[0..n), меньших key (Upper - не больших key). Для
+арифметических ключей под std::less - подсчет без ветвлений, который
+компилятор векторизует, для 32-битных целых - явно через SSE2 по четыре
+ключа. Для прочих ключей и компараторов - двоичный поиск через Compare.*/
+template <typename T1, typename T2, typename Allocator, typename Compare>
+template <bool Upper, typename K>
+int BTree<T1, T2, Allocator, Compare>::rank(const T1 *keys, int n,
+                                            const K &key) const {
+  if constexpr (std::is_arithmetic_v<T1> && std::is_same_v<K, T1> &&
+                is_std_less<Compare>::value) {
+    int result = 0, i = 0;
+#if defined(__SSE2__)
+    if constexpr (std::is_integral_v<T1> && sizeof(T1) == 4) {
+      // Беззнаковые ключи сравниваются как знаковые со сдвигом на 2^31
+      const __m128i bias =
+          _mm_set1_epi32(std::is_signed_v<T1> ? 0 : INT32_MIN);
+      const __m128i needle =
+          _mm_xor_si128(_mm_set1_epi32(std::int32_t(key)), bias);
+      static constexpr int bits[16] = {0, 1, 1, 2, 1, 2, 2, 3,
+                                       1, 2, 2, 3, 2, 3, 3, 4};
+      for (; i + 4 <= n; i += 4) {
+        __m128i block = _mm_xor_si128(
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(keys + i)),
+            bias);
+        __m128i hit = Upper ? _mm_cmpgt_epi32(block, needle)
+                            : _mm_cmplt_epi32(block, needle);
+        int count = bits[_mm_movemask_ps(_mm_castsi128_ps(hit))];
+        result += Upper ? 4 - count : count;
+      }
+    }
+#endif
+    for (; i < n; ++i) result += Upper ? !(key < keys[i]) : keys[i] < key;
+    return result;
+  } else if constexpr (Upper) {
+    return int(std::upper_bound(keys, keys + n, key,
+                                [this](const K &a, const T1 &b) {
+                                  return key_less(a, b);
+                                }) -
+               keys);
+  } else {
+    return int(std::lower_bound(keys, keys + n, key,
+                                [this](const T1 &a, const K &b) {
+                                  return key_less(a, b);
+                                }) -
+               keys);
+  }
+}
+
+// Спуск к листу, в котором лежит или должен лежать key. Если path не
+// nullptr, в него записываются height шагов спуска
+template <typename T1, typename T2, typename Allocator, typename Compare>
+template <typename K>
+typename BTree<T1, T2, Allocator, Compare>::Leaf *
+BTree<T1, T2, Allocator, Compare>::descend(const K &key, Step *path) const {
+  void *node = root;
+  for (int level = 0; level < height; ++level) {
+    Inner *inner = static_cast<Inner *>(node);
+    int index = rank<true>(inner->keys, inner->count, key);
+    if (path) path[level] = Step{inner, index};
+    node = inner->children[index];
+  }
+  return static_cast<Leaf *>(node);
+}
+
+/*Вставляет разделитель separator и правого сына child рядом с сыном, в
+которого вел последний из depth шагов path. Переполненные узлы делятся
+пополам, средний ключ уходит выше. Новые узлы берутся из spare,
+заготовленного до изменений.*/
+template <typename T1, typename T2, typename Allocator, typename Compare>
+void BTree<T1, T2, Allocator, Compare>::insertInner(Step *path, int depth,
+                                                    T1 separator, void *child,
+                                                    Inner **spare) {
+  for (int level = depth - 1; level >= 0; --level) {
+    Inner *node = path[level].node;
+    int index = path[level].index;
+    if (node->count < inner_capacity) {
+      std::move_backward(node->keys + index, node->keys + node->count,
+                         node->keys + node->count + 1);
+      std::move_backward(node->children + index + 1,
+                         node->children + node->count + 1,
+                         node->children + node->count + 2);
+      node->keys[index] = std::move(separator);
+      node->children[index + 1] = child;
+      ++node->count;
+      return;
+    }
+    // Все ключи и сыновья вместе с новыми, затем раздел по середине
+    T1 keys[inner_capacity + 1];
+    void *children[inner_capacity + 2];
+    std::move(node->keys, node->keys + index, keys);
+    keys[index] = std::move(separator);
+    std::move(node->keys + index, node->keys + inner_capacity,
+              keys + index + 1);
+    std::copy(node->children, node->children + index + 1, children);
+    children[index + 1] = child;
+    std::copy(node->children + index + 1, node->children + inner_capacity + 1,
+              children + index + 2);
+    const int mid = (inner_capacity + 1) / 2;
+    Inner *sibling = *spare++;
+    node->count = mid;
+    std::move(keys, keys + mid, node->keys);
+    std::copy(children, children + mid + 1, node->children);
+    sibling->count = inner_capacity - mid;
+    std::move(keys + mid + 1, keys + inner_capacity + 1, sibling->keys);
+    std::copy(children + mid + 1, children + inner_capacity + 2,
+              sibling->children);
+    separator = std::move(keys[mid]);
+    child = sibling;
+  }
+  // Разделился корень: дерево растет на уровень
+  Inner *top = *spare;
+  top->count = 1;
+  top->keys[0] = std::move(separator);
+  top->children[0] = root;
+  top->children[1] = child;
+  root = top;
+  ++height;
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare>
+std::pair<typename BTree<T1, T2, Allocator, Compare>::iterator, bool>
+BTree<T1, T2, Allocator, Compare>::push(const T1 &key, const T2 &data) {
+  return emplace(key, data);
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare>
+template <typename K, typename... Args>
+std::pair<typename BTree<T1, T2, Allocator, Compare>::iterator, bool>
+BTree<T1, T2, Allocator, Compare>::emplace(K &&key, Args &&...args) {
+  if (!root) {
+    T1 new_key = std::forward<K>(key);
+    T2 new_data = T2(std::forward<Args>(args)...);
+    Leaf *leaf = createLeaf();
+    leaf->keys[0] = std::move(new_key);
+    leaf->values[0] = std::move(new_data);
+    leaf->count = 1;
+    root = first = last = leaf;
+    tree_size = 1;
+    return {iterator(this, leaf, 0), true};
+  }
+  Step path[max_depth];
+  Leaf *leaf = descend(key, path);
+  int pos = rank<false>(leaf->keys, leaf->count, key);
+  if (pos < leaf->count && !key_less(key, leaf->keys[pos]))
+    return {iterator(this, leaf, pos), false};
+
+  // Ключ и данные строятся до изменения дерева: если конструктор бросит
+  // исключение (например, bad_alloc у строки), дерево останется прежним
+  T1 new_key = std::forward<K>(key);
+  T2 new_data = T2(std::forward<Args>(args)...);
+  if (leaf->count == leaf_capacity) {
+    // Все узлы для каскада делений выделяются до изменения дерева
+    int splits = 0;
+    while (splits < height &&
+           path[height - 1 - splits].node->count == inner_capacity)
+      ++splits;
+    int needed = splits + (splits == height ? 1 : 0);
+    Inner *spare[max_depth + 1] = {};
+    Leaf *right = createLeaf();
+    // Разделитель - первый ключ правой половины: новый ключ первым туда не
+    // попадает, поэтому копия разделителя тоже делается заранее
+    const int mid = leaf_capacity / 2;
+    T1 separator;
+    try {
+      for (int i = 0; i < needed; ++i) spare[i] = createInner();
+      separator = leaf->keys[mid];
+    } catch (...) {
+      for (Inner *inner : spare)
+        if (inner) destroyInner(inner);
+      destroyLeaf(right);
+      throw;
+    }
+    right->count = leaf_capacity - mid;
+    std::move(leaf->keys + mid, leaf->keys + leaf_capacity, right->keys);
+    if constexpr (!std::is_empty_v<T2>)
+      std::move(leaf->values + mid, leaf->values + leaf_capacity,
+                right->values);
+    leaf->count = mid;
+    right->next = leaf->next;
+    right->prev = leaf;
+    if (leaf->next)
+      leaf->next->prev = right;
+    else
+      last = right;
+    leaf->next = right;
+    if (pos > mid) {
+      pos -= mid;
+      leaf = right;
+    }
+    std::move_backward(leaf->keys + pos, leaf->keys + leaf->count,
+                       leaf->keys + leaf->count + 1);
+    if constexpr (!std::is_empty_v<T2>)
+      std::move_backward(leaf->values + pos, leaf->values + leaf->count,
+                         leaf->values + leaf->count + 1);
+    leaf->keys[pos] = std::move(new_key);
+    leaf->values[pos] = std::move(new_data);
+    ++leaf->count;
+    ++tree_size;
+    if (height == 0) {
+      Inner *top = spare[0];
+      top->count = 1;
+      top->keys[0] = std::move(separator);
+      top->children[0] = root;
+      top->children[1] = right;
+      root = top;
+      height = 1;
+    } else {
+      insertInner(path, height, std::move(separator), right, spare);
+    }
+    return {iterator(this, leaf, pos), true};
+  }
+
+  std::move_backward(leaf->keys + pos, leaf->keys + leaf->count,
+                     leaf->keys + leaf->count + 1);
+  if constexpr (!std::is_empty_v<T2>)
+    std::move_backward(leaf->values + pos, leaf->values + leaf->count,
+                       leaf->values + leaf->count + 1);
+  leaf->keys[pos] = std::move(new_key);
+  leaf->values[pos] = std::move(new_data);
+  ++leaf->count;
+  ++tree_size;
+  return {iterator(this, leaf, pos), true};
+}
+
+/*Лист после удаления стал меньше leaf_min: занимаем элемент у соседа или
+сливаемся с ним, тогда разделитель уходит из отца и проверяется уже он.
+Позиция leaf/pos сдвигается вместе с элементом, который на ней стоял.*/
+template <typename T1, typename T2, typename Allocator, typename Compare>
+void BTree<T1, T2, Allocator, Compare>::fixLeaf(Leaf *&leaf, int &pos,
+                                                Step *path) {
+  Inner *father = path[height - 1].node;
+  int index = path[height - 1].index;
+  Leaf *left = index > 0 ? static_cast<Leaf *>(father->children[index - 1])
+                         : nullptr;
+  Leaf *right = index < father->count
+                    ? static_cast<Leaf *>(father->children[index + 1])
+                    : nullptr;
+  if (left && left->count > leaf_min) {
+    std::move_backward(leaf->keys, leaf->keys + leaf->count,
+                       leaf->keys + leaf->count + 1);
+    if constexpr (!std::is_empty_v<T2>)
+      std::move_backward(leaf->values, leaf->values + leaf->count,
+                         leaf->values + leaf->count + 1);
+    --left->count;
+    leaf->keys[0] = std::move(left->keys[left->count]);
+    leaf->values[0] = std::move(left->values[left->count]);
+    ++leaf->count;
+    ++pos;
+    father->keys[index - 1] = leaf->keys[0];
+    return;
+  }
+  if (right && right->count > leaf_min) {
+    leaf->keys[leaf->count] = std::move(right->keys[0]);
+    leaf->values[leaf->count] = std::move(right->values[0]);
+    ++leaf->count;
+    std::move(right->keys + 1, right->keys + right->count, right->keys);
+    if constexpr (!std::is_empty_v<T2>)
+      std::move(right->values + 1, right->values + right->count,
+                right->values);
+    --right->count;
+    father->keys[index] = right->keys[0];
+    return;
+  }
+  // Слияние: правый из пары листьев переезжает в левый и удаляется
+  if (left) {
+    right = leaf;
+    --index;
+    pos += left->count;
+    leaf = left;
+  } else {
+    left = leaf;
+  }
+  std::move(right->keys, right->keys + right->count,
+            left->keys + left->count);
+  if constexpr (!std::is_empty_v<T2>)
+    std::move(right->values, right->values + right->count,
+              left->values + left->count);
+  left->count += right->count;
+  left->next = right->next;
+  if (right->next)
+    right->next->prev = left;
+  else
+    last = left;
+  destroyLeaf(right);
+  std::move(father->keys + index + 1, father->keys + father->count,
+            father->keys + index);
+  std::copy(father->children + index + 2,
+            father->children + father->count + 1,
+            father->children + index + 1);
+  --father->count;
+  fixInner(height - 1, path);
+}
+
+// То же для внутреннего узла path[level].node, ключи сыновей перетекают
+// через разделитель в отце
+template <typename T1, typename T2, typename Allocator, typename Compare>
+void BTree<T1, T2, Allocator, Compare>::fixInner(int level, Step *path) {
+  Inner *node = path[level].node;
+  if (level == 0) {
+    // Корень без ключей уступает место единственному сыну
+    if (node->count == 0) {
+      root = node->children[0];
+      --height;
+      destroyInner(node);
+    }
+    return;
+  }
+  if (node->count >= inner_min) return;
+  Inner *father = path[level - 1].node;
+  int index = path[level - 1].index;
+  Inner *left = index > 0 ? static_cast<Inner *>(father->children[index - 1])
+                          : nullptr;
+  Inner *right = index < father->count
+                     ? static_cast<Inner *>(father->children[index + 1])
+                     : nullptr;
+  if (left && left->count > inner_min) {
+    std::move_backward(node->keys, node->keys + node->count,
+                       node->keys + node->count + 1);
+    std::copy_backward(node->children, node->children + node->count + 1,
+                       node->children + node->count + 2);
+    node->keys[0] = std::move(father->keys[index - 1]);
+    node->children[0] = left->children[left->count];
+    father->keys[index - 1] = std::move(left->keys[left->count - 1]);
+    --left->count;
+    ++node->count;
+    return;
+  }
+  if (right && right->count > inner_min) {
+    node->keys[node->count] = std::move(father->keys[index]);
+    node->children[node->count + 1] = right->children[0];
+    ++node->count;
+    father->keys[index] = std::move(right->keys[0]);
+    std::move(right->keys + 1, right->keys + right->count, right->keys);
+    std::copy(right->children + 1, right->children + right->count + 1,
+              right->children);
+    --right->count;
+    return;
+  }
+  if (left) {
+    right = node;
+    --index;
+  } else {
+    left = node;
+  }
+  left->keys[left->count] = std::move(father->keys[index]);
+  std::move(right->keys, right->keys + right->count,
+            left->keys + left->count + 1);
+  std::copy(right->children, right->children + right->count + 1,
+            left->children + left->count + 1);
+  left->count += right->count + 1;
+  destroyInner(right);
+  std::move(father->keys + index + 1, father->keys + father->count,
+            father->keys + index);
+  std::copy(father->children + index + 2,
+            father->children + father->count + 1,
+            father->children + index + 1);
+  --father->count;
+  fixInner(level - 1, path);
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare>
+template <typename K>
+typename BTree<T1, T2, Allocator, Compare>::iterator
+BTree<T1, T2, Allocator, Compare>::find(const K &key) {
+  if (!root) return end();
+  Leaf *leaf = descend(key, nullptr);
+  int pos = rank<false>(leaf->keys, leaf->count, key);
+  if (pos == leaf->count || key_less(key, leaf->keys[pos])) return end();
+  return iterator(this, leaf, pos);
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare>
+template <typename K>
+typename BTree<T1, T2, Allocator, Compare>::const_iterator
+BTree<T1, T2, Allocator, Compare>::find(const K &key) const {
+  return const_cast<BTree *>(this)->find(key);
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare>
+template <typename K>
+typename BTree<T1, T2, Allocator, Compare>::iterator
+BTree<T1, T2, Allocator, Compare>::lower_bound(const K &key) {
+  if (!root) return end();
+  Leaf *leaf = descend(key, nullptr);
+  int pos = rank<false>(leaf->keys, leaf->count, key);
+  if (pos == leaf->count) return iterator(this, leaf->next, 0);
+  return iterator(this, leaf, pos);
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare>
+template <typename K>
+typename BTree<T1, T2, Allocator, Compare>::const_iterator
+BTree<T1, T2, Allocator, Compare>::lower_bound(const K &key) const {
+  return const_cast<BTree *>(this)->lower_bound(key);
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare>
+template <typename K>
+typename BTree<T1, T2, Allocator, Compare>::iterator
+BTree<T1, T2, Allocator, Compare>::upper_bound(const K &key) {
+  if (!root) return end();
+  Leaf *leaf = descend(key, nullptr);
+  int pos = rank<true>(leaf->keys, leaf->count, key);
+  if (pos == leaf->count) return iterator(this, leaf->next, 0);
+  return iterator(this, leaf, pos);
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare>
+template <typename K>
+typename BTree<T1, T2, Allocator, Compare>::const_iterator
+BTree<T1, T2, Allocator, Compare>::upper_bound(const K &key) const {
+  return const_cast<BTree *>(this)->upper_bound(key);
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare>
+template <typename K>
+bool BTree<T1, T2, Allocator, Compare>::contains(const K &key) const {
+  return find(key) != end();
+}
+
+// Спуск по ключу элемента лишь восстанавливает путь до его листа: ключ не
+// копируется и в листе не ищется
+template <typename T1, typename T2, typename Allocator, typename Compare>
+typename BTree<T1, T2, Allocator, Compare>::iterator
+BTree<T1, T2, Allocator, Compare>::erase(iterator pos) {
+  if (!pos.leaf) return end();
+  Step path[max_depth];
+  descend(pos.leaf->keys[pos.pos], path);
+  return eraseAt(pos.leaf, pos.pos, path);
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare>
+template <typename K>
+typename BTree<T1, T2, Allocator, Compare>::size_type
+BTree<T1, T2, Allocator, Compare>::erase(const K &key) {
+  if (!root) return 0;
+  Step path[max_depth];
+  Leaf *leaf = descend(key, path);
+  int pos = rank<false>(leaf->keys, leaf->count, key);
+  if (pos == leaf->count || key_less(key, leaf->keys[pos])) return 0;
+  eraseAt(leaf, pos, path);
+  return 1;
+}
+
+// Удаляет элемент pos листа leaf, path - путь спуска к leaf. Возвращает
+// позицию следующего элемента после выравнивания листа
+template <typename T1, typename T2, typename Allocator, typename Compare>
+typename BTree<T1, T2, Allocator, Compare>::iterator
+BTree<T1, T2, Allocator, Compare>::eraseAt(Leaf *leaf, int pos, Step *path) {
+  std::move(leaf->keys + pos + 1, leaf->keys + leaf->count, leaf->keys + pos);
+  if constexpr (!std::is_empty_v<T2>)
+    std::move(leaf->values + pos + 1, leaf->values + leaf->count,
+              leaf->values + pos);
+  --leaf->count;
+  --tree_size;
+  if (height == 0) {
+    if (leaf->count == 0) {
+      destroyLeaf(leaf);
+      root = first = last = nullptr;
+      return end();
+    }
+  } else if (leaf->count < leaf_min) {
+    fixLeaf(leaf, pos, path);
+  }
+  if (pos == leaf->count) return iterator(this, leaf->next, 0);
+  return iterator(this, leaf, pos);
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare>
+bool BTree<T1, T2, Allocator, Compare>::empty() const {
+  return tree_size == 0;
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare>
+typename BTree<T1, T2, Allocator, Compare>::size_type
+BTree<T1, T2, Allocator, Compare>::size() const {
+  return tree_size;
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare>
+typename BTree<T1, T2, Allocator, Compare>::size_type
+BTree<T1, T2, Allocator, Compare>::max_size() const {
+  return leaf_traits::max_size(leaf_alloc) / 2 * leaf_capacity;
+}
+
+// low и high - разделители, между которыми должны лежать ключи node
+// (nullptr - без границы), previous - последний пройденный лист
+template <typename T1, typename T2, typename Allocator, typename Compare>
+bool BTree<T1, T2, Allocator, Compare>::checkNode(
+    const void *node, int level, const T1 *low, const T1 *high,
+    const Leaf *&previous, size_type &count) const {
+  const bool is_root = node == root;
+  if (level == 0) {
+    const Leaf *leaf = static_cast<const Leaf *>(node);
+    if (leaf->count > leaf_capacity ||
+        leaf->count < (is_root ? 1 : leaf_min) || leaf->prev != previous ||
+        (previous ? previous->next != leaf : first != leaf))
+      return false;
+    for (int i = 0; i < leaf->count; ++i)
+      if ((i > 0 && !key_less(leaf->keys[i - 1], leaf->keys[i])) ||
+          (low && key_less(leaf->keys[i], *low)) ||
+          (high && !key_less(leaf->keys[i], *high)))
+        return false;
+    previous = leaf;
+    count += leaf->count;
+    return true;
+  }
+  const Inner *inner = static_cast<const Inner *>(node);
+  if (inner->count > inner_capacity ||
+      inner->count < (is_root ? 1 : inner_min))
+    return false;
+  for (int i = 0; i < inner->count; ++i)
+    if ((i > 0 && !key_less(inner->keys[i - 1], inner->keys[i])) ||
+        (low && key_less(inner->keys[i], *low)) ||
+        (high && !key_less(inner->keys[i], *high)))
+      return false;
+  for (int i = 0; i <= inner->count; ++i)
+    if (!checkNode(inner->children[i], level - 1,
+                   i > 0 ? &inner->keys[i - 1] : low,
+                   i < inner->count ? &inner->keys[i] : high, previous, count))
+      return false;
+  return true;
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare>
+bool BTree<T1, T2, Allocator, Compare>::valid() const {
+  if (!root)
+    return height == 0 && !first && !last && tree_size == 0;
+  const Leaf *previous = nullptr;
+  size_type count = 0;
+  return checkNode(root, height, nullptr, nullptr, previous, count) &&
+         previous == last && !last->next && count == tree_size;
+}
+
+/*Соседние узлы left и right уровня level (0 - листья) после сшивания
+деревьев: если все помещается в один узел, right сливается в left и
+удаляется (результат false). Иначе элементы перетекают из большего узла в
+меньший так, чтобы оба были заполнены не меньше чем наполовину, и separator
+становится новым разделителем между ними. Списки листьев уже связаны.*/
+template <typename T1, typename T2, typename Allocator, typename Compare>
+bool BTree<T1, T2, Allocator, Compare>::balancePair(void *left, void *right,
+                                                    int level,
+                                                    T1 &separator) {
+  if (level == 0) {
+    Leaf *l = static_cast<Leaf *>(left), *r = static_cast<Leaf *>(right);
+    const int total = l->count + r->count;
+    if (total <= leaf_capacity) {
+      std::move(r->keys, r->keys + r->count, l->keys + l->count);
+      if constexpr (!std::is_empty_v<T2>)
+        std::move(r->values, r->values + r->count, l->values + l->count);
+      l->count = total;
+      l->next = r->next;
+      if (r->next)
+        r->next->prev = l;
+      else
+        last = l;
+      destroyLeaf(r);
+      return false;
+    }
+    const int mid = total / 2;
+    if (l->count > mid) {
+      const int shift = l->count - mid;
+      std::move_backward(r->keys, r->keys + r->count,
+                         r->keys + r->count + shift);
+      std::move(l->keys + mid, l->keys + l->count, r->keys);
+      if constexpr (!std::is_empty_v<T2>) {
+        std::move_backward(r->values, r->values + r->count,
+                           r->values + r->count + shift);
+        std::move(l->values + mid, l->values + l->count, r->values);
+      }
+    } else {
+      const int shift = mid - l->count;
+      std::move(r->keys, r->keys + shift, l->keys + l->count);
+      std::move(r->keys + shift, r->keys + r->count, r->keys);
+      if constexpr (!std::is_empty_v<T2>) {
+        std::move(r->values, r->values + shift, l->values + l->count);
+        std::move(r->values + shift, r->values + r->count, r->values);
+      }
+    }
+    r->count = total - mid;
+    l->count = mid;
+    separator = r->keys[0];
+    return true;
+  }
+  Inner *l = static_cast<Inner *>(left), *r = static_cast<Inner *>(right);
+  // Ключи обоих узлов и разделитель между ними
+  const int total = l->count + r->count + 1;
+  if (total <= inner_capacity) {
+    l->keys[l->count] = std::move(separator);
+    std::move(r->keys, r->keys + r->count, l->keys + l->count + 1);
+    std::copy(r->children, r->children + r->count + 1,
+              l->children + l->count + 1);
+    l->count = total;
+    destroyInner(r);
+    return false;
+  }
+  T1 keys[2 * inner_capacity + 1];
+  void *children[2 * inner_capacity + 2];
+  std::move(l->keys, l->keys + l->count, keys);
+  keys[l->count] = std::move(separator);
+  std::move(r->keys, r->keys + r->count, keys + l->count + 1);
+  std::copy(l->children, l->children + l->count + 1, children);
+  std::copy(r->children, r->children + r->count + 1,
+            children + l->count + 1);
+  const int mid = (total - 1) / 2;
+  l->count = mid;
+  std::move(keys, keys + mid, l->keys);
+  std::copy(children, children + mid + 1, l->children);
+  separator = std::move(keys[mid]);
+  r->count = total - 1 - mid;
+  std::move(keys + mid + 1, keys + total, r->keys);
+  std::copy(children + mid + 1, children + total + 1, r->children);
+  return true;
+}
+
+/*Сшивает деревья, когда все ключи other больше ключей *this, а узлы одного
+дерева может освободить распределитель другого. Корень низкого дерева
+становится крайним сыном узла той же высоты в высоком, стык
+выравнивается balancePair, и разделитель поднимается как при делении узла.
+Элементы не копируются, время O(высота).*/
+template <typename T1, typename T2, typename Allocator, typename Compare>
+void BTree<T1, T2, Allocator, Compare>::splice(BTree &other) {
+  T1 separator = other.first->keys[0];
+  // Корень низкого дерева вшивается в высокое: справа, если выше *this,
+  // иначе слева в other
+  const bool taller = height >= other.height;
+  BTree &host = taller ? *this : other;
+  const int depth = taller ? height - other.height : other.height - height;
+  Step path[max_depth];
+  void *node = host.root;
+  for (int level = 0; level < depth; ++level) {
+    Inner *inner = static_cast<Inner *>(node);
+    path[level] = Step{inner, taller ? inner->count : 0};
+    node = inner->children[path[level].index];
+  }
+  // Все узлы для каскада делений выделяются до изменения деревьев
+  int splits = 0;
+  while (splits < depth &&
+         path[depth - 1 - splits].node->count == inner_capacity)
+    ++splits;
+  const int needed = splits + (splits == depth ? 1 : 0);
+  Inner *spare[max_depth + 1] = {};
+  try {
+    for (int i = 0; i < needed; ++i) spare[i] = createInner();
+  } catch (...) {
+    for (Inner *inner : spare)
+      if (inner) destroyInner(inner);
+    throw;
+  }
+  void *left = taller ? node : root;
+  void *right = taller ? other.root : node;
+  const int level = taller ? other.height : height;
+  // Низкое дерево *this занимает место крайнего левого узла other, а этот
+  // узел становится его правым соседом
+  if (!taller) path[depth - 1].node->children[0] = left;
+  last->next = other.first;
+  other.first->prev = last;
+  last = other.last;
+  tree_size += other.tree_size;
+  if (balancePair(left, right, level, separator)) {
+    if (depth == 0) {
+      Inner *top = spare[0];
+      top->count = 1;
+      top->keys[0] = std::move(separator);
+      top->children[0] = left;
+      top->children[1] = right;
+      host.root = top;
+      ++host.height;
+    } else {
+      host.insertInner(path, depth, std::move(separator), right, spare);
+    }
+  } else {
+    for (int i = 0; i < needed; ++i) destroyInner(spare[i]);
+  }
+  root = host.root;
+  height = host.height;
+  other.root = nullptr;
+  other.height = 0;
+  other.first = other.last = nullptr;
+  other.tree_size = 0;
+}
+
+/*Если диапазоны ключей не пересекаются и распределители равны, деревья
+сшиваются целыми листьями за O(высота). Иначе элементы other переносятся
+по одному перемещением, ключи, которые уже есть в *this, удаляются.*/
+template <typename T1, typename T2, typename Allocator, typename Compare>
+void BTree<T1, T2, Allocator, Compare>::merge(BTree &other) {
+  if (this == &other || !other.root) return;
+  if (leaf_alloc == other.leaf_alloc && inner_alloc == other.inner_alloc) {
+    if (!root) {
+      swap(other);
+      return;
+    }
+    if (key_less(last->keys[last->count - 1], other.first->keys[0])) {
+      splice(other);
+      return;
+    }
+    if (key_less(other.last->keys[other.last->count - 1], first->keys[0])) {
+      swap(other);
+      splice(other);
+      return;
+    }
+  }
+  for (Leaf *leaf = other.first; leaf; leaf = leaf->next)
+    for (int i = 0; i < leaf->count; ++i)
+      emplace(std::move(leaf->keys[i]), std::move(leaf->values[i]));
+  other.clear();
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare>
+void BTree<T1, T2, Allocator, Compare>::clear() {
+  clear(root, height);
+  root = nullptr;
+  height = 0;
+  first = last = nullptr;
+  tree_size = 0;
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare>
+void BTree<T1, T2, Allocator, Compare>::swap(BTree &other) {
+  if constexpr (leaf_traits::propagate_on_container_swap::value) {
+    using std::swap;
+    swap(leaf_alloc, other.leaf_alloc);
+    swap(inner_alloc, other.inner_alloc);
+  }
+  std::swap(root, other.root);
+  std::swap(height, other.height);
+  std::swap(first, other.first);
+  std::swap(last, other.last);
+  std::swap(tree_size, other.tree_size);
+  std::swap(comp, other.comp);
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare>
+typename BTree<T1, T2, Allocator, Compare>::iterator
+BTree<T1, T2, Allocator, Compare>::begin() {
+  return iterator(this, first, 0);
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare>
+typename BTree<T1, T2, Allocator, Compare>::iterator
+BTree<T1, T2, Allocator, Compare>::end() {
+  return iterator(this, nullptr, 0);
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare>
+typename BTree<T1, T2, Allocator, Compare>::const_iterator
+BTree<T1, T2, Allocator, Compare>::begin() const {
+  return const_iterator(this, first, 0);
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare>
+typename BTree<T1, T2, Allocator, Compare>::const_iterator
+BTree<T1, T2, Allocator, Compare>::end() const {
+  return const_iterator(this, nullptr, 0);
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare>
+BTree<T1, T2, Allocator, Compare>::iterator::iterator(const BTree *tree,
+                                                      Leaf *leaf, int pos)
+    : tree(tree), leaf(leaf), pos(pos) {}
+
+template <typename T1, typename T2, typename Allocator, typename Compare>
+typename BTree<T1, T2, Allocator, Compare>::iterator &
+BTree<T1, T2, Allocator, Compare>::iterator::operator++() {
+  if (leaf && ++pos == leaf->count) {
+    leaf = leaf->next;
+    pos = 0;
+  }
+  return *this;
+}
+
+// Для end() - последний элемент
+template <typename T1, typename T2, typename Allocator, typename Compare>
+typename BTree<T1, T2, Allocator, Compare>::iterator &
+BTree<T1, T2, Allocator, Compare>::iterator::operator--() {
+  if (!leaf || pos == 0) {
+    leaf = leaf ? leaf->prev : tree->last;
+    pos = leaf ? leaf->count : 0;
+  }
+  if (leaf) --pos;
+  return *this;
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare>
+typename BTree<T1, T2, Allocator, Compare>::iterator
+BTree<T1, T2, Allocator, Compare>::iterator::operator++(int) {
+  iterator temp = *this;
+  ++(*this);
+  return temp;
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare>
+typename BTree<T1, T2, Allocator, Compare>::iterator
+BTree<T1, T2, Allocator, Compare>::iterator::operator--(int) {
+  iterator temp = *this;
+  --(*this);
+  return temp;
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare>
+bool BTree<T1, T2, Allocator, Compare>::iterator::operator==(
+    const iterator &other) const {
+  return leaf == other.leaf && pos == other.pos;
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare>
+bool BTree<T1, T2, Allocator, Compare>::iterator::operator!=(
+    const iterator &other) const {
+  return !(*this == other);
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare>
+typename BTree<T1, T2, Allocator, Compare>::iterator::reference
+BTree<T1, T2, Allocator, Compare>::iterator::operator*() const {
+  return reference(leaf->keys[pos], leaf->values[pos]);
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare>
+typename BTree<T1, T2, Allocator, Compare>::iterator::pointer
+BTree<T1, T2, Allocator, Compare>::iterator::operator->() const {
+  return pointer{**this};
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare>
+BTree<T1, T2, Allocator, Compare>::const_iterator::const_iterator(
+    const BTree *tree, Leaf *leaf, int pos)
+    : position(tree, leaf, pos) {}
+
+template <typename T1, typename T2, typename Allocator, typename Compare>
+BTree<T1, T2, Allocator, Compare>::const_iterator::const_iterator(
+    const iterator &other)
+    : position(other) {}
+
+template <typename T1, typename T2, typename Allocator, typename Compare>
+typename BTree<T1, T2, Allocator, Compare>::const_iterator &
+BTree<T1, T2, Allocator, Compare>::const_iterator::operator++() {
+  ++position;
+  return *this;
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare>
+typename BTree<T1, T2, Allocator, Compare>::const_iterator &
+BTree<T1, T2, Allocator, Compare>::const_iterator::operator--() {
+  --position;
+  return *this;
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare>
+typename BTree<T1, T2, Allocator, Compare>::const_iterator
+BTree<T1, T2, Allocator, Compare>::const_iterator::operator++(int) {
+  const_iterator temp = *this;
+  ++position;
+  return temp;
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare>
+typename BTree<T1, T2, Allocator, Compare>::const_iterator
+BTree<T1, T2, Allocator, Compare>::const_iterator::operator--(int) {
+  const_iterator temp = *this;
+  --position;
+  return temp;
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare>
+bool BTree<T1, T2, Allocator, Compare>::const_iterator::operator==(
+    const const_iterator &other) const {
+  return position == other.position;
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare>
+bool BTree<T1, T2, Allocator, Compare>::const_iterator::operator!=(
+    const const_iterator &other) const {
+  return position != other.position;
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare>
+typename BTree<T1, T2, Allocator, Compare>::const_iterator::reference
+BTree<T1, T2, Allocator, Compare>::const_iterator::operator*() const {
+  return reference(*position);
+}
+
+template <typename T1, typename T2, typename Allocator, typename Compare>
+typename BTree<T1, T2, Allocator, Compare>::const_iterator::pointer
+BTree<T1, T2, Allocator, Compare>::const_iterator::operator->() const {
+  return pointer{**this};
+}
+
+}  // namespace binary_tree
+
+#endif  // BTREE_H
@@ -0,0 +1,192 @@
+#ifndef BTREE_MAP_H
+#define BTREE_MAP_H
+
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <memory_resource>
+#include <stdexcept>
+#include <utility>
+
+#include "btree.h"
+
+namespace binary_tree {
+
+/*Словарь на B+-дереве с тем же интерфейсом, что у map, включая Compare
+и поиск по прозрачному компаратору. Десятки ключей в узле дают один промах
+кэша на уровень дерева высотой в несколько раз меньше красно-черного, зато
+любая вставка и удаление делают итераторы недействительными.*/
+template <typename Key, typename T,
+          typename Allocator = std::allocator<std::pair<const Key, T>>,
+          typename Compare = std::less<Key>>
+class btree_map {
+ private:
+  using tree_type = BTree<Key, T, Allocator, Compare>;
+  tree_type tree;
+
+ public:
+  using key_type = Key;
+  using mapped_type = T;
+  using value_type = std::pair<const key_type, mapped_type>;
+  using iterator = typename tree_type::iterator;
+  using const_iterator = typename tree_type::const_iterator;
+  // Ключи и данные лежат раздельно, поэтому ссылка на элемент - пара
+  // ссылок, а не value_type &, как у map
+  using reference = typename iterator::reference;
+  using const_reference = typename const_iterator::reference;
+  using size_type = size_t;
+  using allocator_type = Allocator;
+  using key_compare = Compare;
+
+  btree_map() = default;
+
+  explicit btree_map(const Allocator &alloc) : tree(alloc) {}
+
+  explicit btree_map(const Compare &comp, const Allocator &alloc = Allocator())
+      : tree(comp, alloc) {}
+
+  btree_map(std::initializer_list<value_type> const &items,
+            const Allocator &alloc = Allocator())
+      : tree(alloc) {
+    for (const value_type &item : items) tree.push(item.first, item.second);
+  }
+
+  btree_map(const btree_map &other) = default;
+  btree_map(btree_map &&other) noexcept = default;
+  btree_map &operator=(const btree_map &other) = default;
+  btree_map &operator=(btree_map &&other) = default;
+  ~btree_map() = default;
+
+  allocator_type get_allocator() const { return tree.get_allocator(); }
+  key_compare key_comp() const { return tree.key_comp(); }
+
+  T &at(const Key &key) {
+    iterator result = tree.find(key);
+    if (result == end()) throw std::out_of_range("Key not found");
+    return result->second;
+  }
+
+  const T &at(const Key &key) const {
+    const_iterator result = tree.find(key);
+    if (result == end()) throw std::out_of_range("Key not found");
+    return result->second;
+  }
+
+  // Данные по умолчанию строятся, только если ключа нет
+  T &operator[](const Key &key) { return tree.emplace(key).first->second; }
+
+  T &operator[](Key &&key) {
+    return tree.emplace(std::move(key)).first->second;
+  }
+
+  iterator begin() { return tree.begin(); }
+  iterator end() { return tree.end(); }
+  const_iterator begin() const { return tree.begin(); }
+  const_iterator end() const { return tree.end(); }
+
+  bool empty() const { return tree.empty(); }
+  size_type size() const { return tree.size(); }
+  size_type max_size() const { return tree.max_size(); }
+
+  void clear() { tree.clear(); }
+
+  std::pair<iterator, bool> insert(const value_type &value) {
+    return tree.push(value.first, value.second);
+  }
+
+  std::pair<iterator, bool> insert(const Key &key, const T &obj) {
+    return tree.push(key, obj);
+  }
+
+  std::pair<iterator, bool> insert_or_assign(const Key &key, const T &obj) {
+    std::pair<iterator, bool> result = tree.push(key, obj);
+    if (!result.second) result.first->second = obj;
+    return result;
+  }
+
+  // Возвращает итератор на следующий элемент
+  iterator erase(iterator pos) {
+    if (pos == end()) return end();
+    return tree.erase(pos);
+  }
+
+  size_type erase(const Key &key) { return tree.erase(key); }
+
+  template <typename K, transparent_t<Compare, K> = 0>
+  size_type erase(const K &key) {
+    return tree.erase(key);
+  }
+
+  void swap(btree_map &other) { tree.swap(other.tree); }
+
+  void merge(btree_map &other) { tree.merge(other.tree); }
+
+  // Проверка инвариантов дерева, O(n)
+  bool valid() const { return tree.valid(); }
+
+  // Число внутренних уровней B+-дерева
+  int depth() const { return tree.depth(); }
+
+  bool contains(const Key &key) const { return tree.contains(key); }
+
+  template <typename K, transparent_t<Compare, K> = 0>
+  bool contains(const K &key) const {
+    return tree.contains(key);
+  }
+
+  iterator find(const Key &key) { return tree.find(key); }
+  const_iterator find(const Key &key) const { return tree.find(key); }
+
+  template <typename K, transparent_t<Compare, K> = 0>
+  iterator find(const K &key) {
+    return tree.find(key);
+  }
+
+  template <typename K, transparent_t<Compare, K> = 0>
+  const_iterator find(const K &key) const {
+    return tree.find(key);
+  }
+
+  iterator lower_bound(const Key &key) { return tree.lower_bound(key); }
+
+  const_iterator lower_bound(const Key &key) const {
+    return tree.lower_bound(key);
+  }
+
+  template <typename K, transparent_t<Compare, K> = 0>
+  iterator lower_bound(const K &key) {
+    return tree.lower_bound(key);
+  }
+
+  template <typename K, transparent_t<Compare, K> = 0>
+  const_iterator lower_bound(const K &key) const {
+    return tree.lower_bound(key);
+  }
+
+  iterator upper_bound(const Key &key) { return tree.upper_bound(key); }
+
+  const_iterator upper_bound(const Key &key) const {
+    return tree.upper_bound(key);
+  }
+
+  template <typename K, transparent_t<Compare, K> = 0>
+  iterator upper_bound(const K &key) {
+    return tree.upper_bound(key);
+  }
+
+  template <typename K, transparent_t<Compare, K> = 0>
+  const_iterator upper_bound(const K &key) const {
+    return tree.upper_bound(key);
+  }
+};
+
+namespace pmr {
+// Словарь на B+-дереве, узлы которого живут в std::pmr::memory_resource
+template <typename Key, typename T, typename Compare = std::less<Key>>
+using btree_map = binary_tree::btree_map<
+    Key, T, std::pmr::polymorphic_allocator<std::pair<const Key, T>>, Compare>;
+}  // namespace pmr
+
+}  // namespace binary_tree
+
+#endif  // BTREE_MAP_H
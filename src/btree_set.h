@@ -0,0 +1,198 @@
+#ifndef BTREE_SET_H
+#define BTREE_SET_H
+
+#include <cstddef>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <memory_resource>
+#include <utility>
+
+#include "btree.h"
+
+namespace binary_tree {
+
+// Множество на B+-дереве с тем же интерфейсом, что у set, включая Compare
+// и поиск по прозрачному компаратору. В листьях хранятся только ключи
+template <typename Key, typename Allocator = std::allocator<Key>,
+          typename Compare = std::less<Key>>
+class btree_set {
+ private:
+  using tree_type = BTree<Key, NoValue, Allocator, Compare>;
+  tree_type tree;
+
+ public:
+  using key_type = Key;
+  using value_type = Key;
+  using reference = value_type &;
+  using const_reference = const value_type &;
+  using size_type = size_t;
+  using allocator_type = Allocator;
+  using key_compare = Compare;
+  using value_compare = Compare;
+
+  // Ключи в листьях хранятся по-настоящему, поэтому итератор отдает
+  // ссылку на ключ только для чтения, как у set
+  class iterator {
+   private:
+    typename tree_type::iterator it;
+
+   public:
+    using iterator_category = std::bidirectional_iterator_tag;
+    using value_type = Key;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const Key *;
+    using reference = const Key &;
+
+    iterator(typename tree_type::iterator iter) : it(iter) {}
+
+    // Оператор разыменования
+    reference operator*() const { return (*it).first; }
+
+    // Оператор доступа к члену
+    pointer operator->() const { return &(*it).first; }
+
+    // Операторы сравнения
+    bool operator==(const iterator &other) const { return it == other.it; }
+    bool operator!=(const iterator &other) const { return it != other.it; }
+
+    // Префиксный оператор++
+    iterator &operator++() {
+      ++it;
+      return *this;
+    }
+
+    // Постфиксный оператор++
+    iterator operator++(int) {
+      iterator temp = *this;
+      ++it;
+      return temp;
+    }
+
+    // Префиксный оператор--
+    iterator &operator--() {
+      --it;
+      return *this;
+    }
+
+    // Постфиксный оператор--
+    iterator operator--(int) {
+      iterator temp = *this;
+      --it;
+      return temp;
+    }
+
+    // Метод для получения  итератора
+    typename tree_type::iterator getIterator() const { return it; }
+  };
+
+  using const_iterator = iterator;
+
+  btree_set() = default;
+
+  explicit btree_set(const Allocator &alloc) : tree(alloc) {}
+
+  explicit btree_set(const Compare &comp, const Allocator &alloc = Allocator())
+      : tree(comp, alloc) {}
+
+  btree_set(std::initializer_list<key_type> const &items,
+            const Allocator &alloc = Allocator())
+      : tree(alloc) {
+    for (const key_type &item : items) tree.push(item, NoValue());
+  }
+
+  btree_set(const btree_set &other) = default;
+  btree_set(btree_set &&other) noexcept = default;
+  btree_set &operator=(const btree_set &other) = default;
+  btree_set &operator=(btree_set &&other) = default;
+  ~btree_set() = default;
+
+  allocator_type get_allocator() const { return tree.get_allocator(); }
+  key_compare key_comp() const { return tree.key_comp(); }
+  value_compare value_comp() const { return tree.key_comp(); }
+
+  iterator begin() const {
+    return iterator(const_cast<tree_type &>(tree).begin());
+  }
+  iterator end() const { return iterator(const_cast<tree_type &>(tree).end()); }
+
+  bool empty() const { return tree.empty(); }
+  size_type size() const { return tree.size(); }
+  size_type max_size() const { return tree.max_size(); }
+
+  void clear() { tree.clear(); }
+
+  std::pair<iterator, bool> insert(const key_type &value) {
+    auto result = tree.push(value, NoValue());
+    return std::make_pair(iterator(result.first), result.second);
+  }
+
+  // Возвращает итератор на следующий элемент
+  iterator erase(iterator pos) {
+    if (pos == end()) return end();
+    return iterator(tree.erase(pos.getIterator()));
+  }
+
+  size_type erase(const Key &key) { return tree.erase(key); }
+
+  template <typename K, transparent_t<Compare, K> = 0>
+  size_type erase(const K &key) {
+    return tree.erase(key);
+  }
+
+  void swap(btree_set &other) { tree.swap(other.tree); }
+
+  void merge(btree_set &other) { tree.merge(other.tree); }
+
+  // Проверка инвариантов дерева, O(n)
+  bool valid() const { return tree.valid(); }
+
+  // Число внутренних уровней B+-дерева
+  int depth() const { return tree.depth(); }
+
+  bool contains(const Key &key) const { return tree.contains(key); }
+
+  template <typename K, transparent_t<Compare, K> = 0>
+  bool contains(const K &key) const {
+    return tree.contains(key);
+  }
+
+  iterator find(const Key &key) const {
+    return iterator(const_cast<tree_type &>(tree).find(key));
+  }
+
+  template <typename K, transparent_t<Compare, K> = 0>
+  iterator find(const K &key) const {
+    return iterator(const_cast<tree_type &>(tree).find(key));
+  }
+
+  iterator lower_bound(const Key &key) const {
+    return iterator(const_cast<tree_type &>(tree).lower_bound(key));
+  }
+
+  template <typename K, transparent_t<Compare, K> = 0>
+  iterator lower_bound(const K &key) const {
+    return iterator(const_cast<tree_type &>(tree).lower_bound(key));
+  }
+
+  iterator upper_bound(const Key &key) const {
+    return iterator(const_cast<tree_type &>(tree).upper_bound(key));
+  }
+
+  template <typename K, transparent_t<Compare, K> = 0>
+  iterator upper_bound(const K &key) const {
+    return iterator(const_cast<tree_type &>(tree).upper_bound(key));
+  }
+};
+
+namespace pmr {
+// Множество на B+-дереве, узлы которого живут в std::pmr::memory_resource
+template <typename Key, typename Compare = std::less<Key>>
+using btree_set =
+    binary_tree::btree_set<Key, std::pmr::polymorphic_allocator<Key>, Compare>;
+}  // namespace pmr
+
+}  // namespace binary_tree
+
+#endif  // BTREE_SET_H
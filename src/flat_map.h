@@ -0,0 +1,673 @@
+#ifndef FLAT_MAP_H
+#define FLAT_MAP_H
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <memory_resource>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "key_order.h"
+
+namespace binary_tree {
+
+/*Первый элемент упорядоченного по less массива base[0..n), не меньший key
+(Upper - больший key). Половина отбрасывается на каждом шаге без ветвлений:
+условие выбирает лишь смещение, и компилятор для простых ключей ставит
+условную пересылку вместо перехода.*/
+template <bool Upper, typename Key, typename K, typename Less>
+size_t branchlessBound(const Key *base, size_t n, const K &key, Less less) {
+  if (n == 0) return 0;
+  const Key *start = base;
+  while (n > 1) {
+    size_t half = n / 2;
+    bool right = Upper ? !less(key, base[half]) : less(base[half], key);
+    base = right ? base + half : base;
+    n -= half;
+  }
+  bool right = Upper ? !less(key, *base) : less(*base, key);
+  return size_t(base - start) + right;
+}
+
+/*Словарь на двух упорядоченных массивах: ключи отдельно от данных, поэтому
+поиск читает подряд только ключи, а обход идет по памяти без переходов по
+указателям. Вставка и удаление сдвигают хвост массивов за O(n), поэтому
+словарь рассчитан на небольшие и редко меняющиеся таблицы, а пачку
+элементов лучше вставлять одним insert(first, last). Ключи и данные должны
+иметь конструктор по умолчанию. Любая вставка и удаление делают итераторы
+недействительными. Compare и поиск по прозрачному компаратору - как у map.*/
+template <typename Key, typename T,
+          typename Allocator = std::allocator<std::pair<const Key, T>>,
+          typename Compare = std::less<Key>>
+class flat_map {
+ private:
+  using key_allocator = typename std::allocator_traits<
+      Allocator>::template rebind_alloc<Key>;
+  /*Данные лежат в обертке: для T = bool массив std::vector<bool> хранил бы
+  биты и не давал ссылок bool &, которые отдают at(), operator[] и
+  итераторы.*/
+  struct Mapped {
+    T value;
+  };
+  using mapped_allocator = typename std::allocator_traits<
+      Allocator>::template rebind_alloc<Mapped>;
+
+  std::vector<Key, key_allocator> keys;
+  std::vector<Mapped, mapped_allocator> values;
+  Compare comp;
+
+  // a < b в порядке Compare
+  template <typename A, typename B>
+  bool key_less(const A &a, const B &b) const {
+    return KeyOrder<Compare>::less(comp, a, b);
+  }
+
+  // Сравнение ключей для двоичного поиска
+  auto less() const {
+    return [this](const auto &a, const auto &b) { return key_less(a, b); };
+  }
+
+ public:
+  using key_type = Key;
+  using mapped_type = T;
+  using value_type = std::pair<const key_type, mapped_type>;
+  using size_type = size_t;
+  using allocator_type = Allocator;
+  using key_compare = Compare;
+
+  /*Ключи и данные лежат в разных массивах, и пары pair<const Key, T> в
+  памяти нет. Поэтому итератор, как у std::flat_map, разыменовывается в
+  пару ссылок reference: it->first, it->second = x. pointer - обертка над
+  такой парой, через которую работает оператор ->.*/
+  template <typename Reference>
+  struct Arrow {
+    Reference ref;
+    const Reference *operator->() const { return &ref; }
+  };
+
+  class iterator {
+   private:
+    flat_map *owner;
+    size_type index;
+    friend class flat_map;
+
+   public:
+    using iterator_category = std::bidirectional_iterator_tag;
+    using value_type = std::pair<const Key, T>;
+    using difference_type = std::ptrdiff_t;
+    using reference = std::pair<const Key &, T &>;
+    using pointer = Arrow<reference>;
+
+    iterator(flat_map *owner, size_type index) : owner(owner), index(index) {}
+
+    // Префиксный оператор++
+    iterator &operator++() {
+      ++index;
+      return *this;
+    }
+
+    // Префиксный оператор--
+    iterator &operator--() {
+      --index;
+      return *this;
+    }
+
+    // Постфиксный оператор++
+    iterator operator++(int) {
+      iterator temp = *this;
+      ++index;
+      return temp;
+    }
+
+    // Постфиксный оператор--
+    iterator operator--(int) {
+      iterator temp = *this;
+      --index;
+      return temp;
+    }
+
+    // Сдвиг на k элементов вперед за O(1)
+    iterator operator+(size_type k) const { return iterator(owner, index + k); }
+
+    // Операторы сравнения
+    bool operator==(const iterator &other) const {
+      return index == other.index;
+    }
+    bool operator!=(const iterator &other) const {
+      return index != other.index;
+    }
+    bool operator>(const iterator &other) const { return index > other.index; }
+    bool operator<(const iterator &other) const { return index < other.index; }
+
+    // Оператор разыменования
+    reference operator*() const {
+      return reference(owner->keys[index], owner->values[index].value);
+    }
+
+    // Оператор доступа к члену
+    pointer operator->() const { return pointer{**this}; }
+  };
+
+  class const_iterator {
+   private:
+    const flat_map *owner;
+    size_type index;
+    friend class flat_map;
+
+   public:
+    using iterator_category = std::bidirectional_iterator_tag;
+    using value_type = std::pair<const Key, T>;
+    using difference_type = std::ptrdiff_t;
+    using reference = std::pair<const Key &, const T &>;
+    using pointer = Arrow<reference>;
+
+    const_iterator(const flat_map *owner, size_type index)
+        : owner(owner), index(index) {}
+    const_iterator(const iterator &other)
+        : owner(other.owner), index(other.index) {}
+
+    // Префиксный оператор++
+    const_iterator &operator++() {
+      ++index;
+      return *this;
+    }
+
+    // Префиксный оператор--
+    const_iterator &operator--() {
+      --index;
+      return *this;
+    }
+
+    // Постфиксный оператор++
+    const_iterator operator++(int) {
+      const_iterator temp = *this;
+      ++index;
+      return temp;
+    }
+
+    // Постфиксный оператор--
+    const_iterator operator--(int) {
+      const_iterator temp = *this;
+      --index;
+      return temp;
+    }
+
+    // Сдвиг на k элементов вперед за O(1)
+    const_iterator operator+(size_type k) const {
+      return const_iterator(owner, index + k);
+    }
+
+    // Операторы сравнения
+    bool operator==(const const_iterator &other) const {
+      return index == other.index;
+    }
+    bool operator!=(const const_iterator &other) const {
+      return index != other.index;
+    }
+    bool operator>(const const_iterator &other) const {
+      return index > other.index;
+    }
+    bool operator<(const const_iterator &other) const {
+      return index < other.index;
+    }
+
+    // Оператор разыменования
+    reference operator*() const {
+      return reference(owner->keys[index], owner->values[index].value);
+    }
+
+    // Оператор доступа к члену
+    pointer operator->() const { return pointer{**this}; }
+  };
+
+  // Ссылка на элемент - пара ссылок, а не value_type &, как у map
+  using reference = typename iterator::reference;
+  using const_reference = typename const_iterator::reference;
+
+ private:
+  // K - Key или тип, который прозрачный компаратор сравнивает с Key
+  template <typename K>
+  size_type lowerIndex(const K &key) const {
+    return branchlessBound<false>(keys.data(), keys.size(), key, less());
+  }
+
+  template <typename K>
+  size_type upperIndex(const K &key) const {
+    return branchlessBound<true>(keys.data(), keys.size(), key, less());
+  }
+
+  // Номер элемента с ключом key или size(), если его нет
+  template <typename K>
+  size_type findIndex(const K &key) const {
+    size_type index = lowerIndex(key);
+    if (index == keys.size() || key_less(key, keys[index])) return keys.size();
+    return index;
+  }
+
+  template <typename K>
+  size_type eraseKey(const K &key) {
+    size_type index = findIndex(key);
+    if (index == keys.size()) return 0;
+    erase(iterator(this, index));
+    return 1;
+  }
+
+  iterator insertAt(size_type index, const Key &key, const T &obj) {
+    keys.insert(keys.begin() + index, key);
+    try {
+      values.insert(values.begin() + index, Mapped{obj});
+    } catch (...) {
+      keys.erase(keys.begin() + index);
+      throw;
+    }
+    return iterator(this, index);
+  }
+
+  /*Слияние с other за один линейный проход. Элементы только из *this,
+  только из other и общие ключи (с данными из *this) остаются по флагам
+  keep_a, keep_b и keep_both, other становится пустым. Для other == *this
+  все ключи общие: они остаются целиком или удаляются по keep_both.*/
+  void combine(flat_map &other, bool keep_a, bool keep_b, bool keep_both) {
+    if (this == &other) {
+      if (!keep_both) clear();
+      return;
+    }
+    std::vector<Key, key_allocator> merged_keys(keys.get_allocator());
+    std::vector<Mapped, mapped_allocator> merged_values(
+        values.get_allocator());
+    merged_keys.reserve(keys.size() + (keep_b ? other.keys.size() : 0));
+    merged_values.reserve(merged_keys.capacity());
+    auto take = [&](flat_map &from, size_type &i) {
+      merged_keys.push_back(std::move(from.keys[i]));
+      merged_values.push_back(std::move(from.values[i]));
+      ++i;
+    };
+    size_type i = 0, j = 0;
+    while (i < keys.size() && j < other.keys.size()) {
+      if (key_less(keys[i], other.keys[j])) {
+        keep_a ? take(*this, i) : void(++i);
+      } else if (key_less(other.keys[j], keys[i])) {
+        keep_b ? take(other, j) : void(++j);
+      } else {
+        keep_both ? take(*this, i) : void(++i);
+        ++j;
+      }
+    }
+    while (keep_a && i < keys.size()) take(*this, i);
+    while (keep_b && j < other.keys.size()) take(other, j);
+    keys.swap(merged_keys);
+    values.swap(merged_values);
+    other.clear();
+  }
+
+ public:
+  flat_map() = default;
+
+  // Массивы берутся из распределителя alloc, например из pmr-ресурса
+  explicit flat_map(const Allocator &alloc)
+      : keys(key_allocator(alloc)), values(mapped_allocator(alloc)) {}
+
+  explicit flat_map(const Compare &comp, const Allocator &alloc = Allocator())
+      : keys(key_allocator(alloc)),
+        values(mapped_allocator(alloc)),
+        comp(comp) {}
+
+  flat_map(std::initializer_list<value_type> const &items,
+           const Allocator &alloc = Allocator())
+      : flat_map(alloc) {
+    insert(items.begin(), items.end());
+  }
+
+  // Конструктор из диапазона пар, вход сортируется один раз
+  template <typename InputIt, typename = typename std::iterator_traits<
+                                  InputIt>::iterator_category>
+  flat_map(InputIt first, InputIt last, const Allocator &alloc = Allocator())
+      : flat_map(alloc) {
+    insert(first, last);
+  }
+
+  flat_map(const flat_map &other) = default;
+  flat_map(flat_map &&other) noexcept = default;
+  flat_map &operator=(const flat_map &other) = default;
+  flat_map &operator=(flat_map &&other) = default;
+  ~flat_map() = default;
+
+  allocator_type get_allocator() const {
+    return allocator_type(keys.get_allocator());
+  }
+  key_compare key_comp() const { return comp; }
+
+  // Запас памяти под n элементов без перевыделения массивов
+  void reserve(size_type n) {
+    keys.reserve(n);
+    values.reserve(n);
+  }
+
+  // Отдает память, оставшуюся от удаленных элементов
+  void shrink_to_fit() {
+    keys.shrink_to_fit();
+    values.shrink_to_fit();
+  }
+
+  T &at(const Key &key) {
+    size_type index = findIndex(key);
+    if (index == keys.size()) throw std::out_of_range("Key not found");
+    return values[index].value;
+  }
+
+  const T &at(const Key &key) const {
+    size_type index = findIndex(key);
+    if (index == keys.size()) throw std::out_of_range("Key not found");
+    return values[index].value;
+  }
+
+  T &operator[](const Key &key) {
+    size_type index = lowerIndex(key);
+    if (index == keys.size() || key_less(key, keys[index]))
+      insertAt(index, key, T());
+    return values[index].value;
+  }
+
+  const T &operator[](const Key &key) const { return at(key); }
+
+  iterator begin() { return iterator(this, 0); }
+  iterator end() { return iterator(this, keys.size()); }
+  const_iterator begin() const { return const_iterator(this, 0); }
+  const_iterator end() const { return const_iterator(this, keys.size()); }
+
+  bool empty() const { return keys.empty(); }
+  size_type size() const { return keys.size(); }
+  size_type max_size() const {
+    return std::min(keys.max_size(), values.max_size());
+  }
+
+  void clear() {
+    keys.clear();
+    values.clear();
+  }
+
+  // Заменяет содержимое диапазоном пар
+  template <typename InputIt>
+  void assign_sorted(InputIt first, InputIt last) {
+    clear();
+    insert(first, last);
+  }
+
+  std::pair<iterator, bool> insert(const value_type &value) {
+    size_type index = lowerIndex(value.first);
+    if (index < keys.size() && !key_less(value.first, keys[index]))
+      return std::make_pair(iterator(this, index), false);
+    return std::make_pair(insertAt(index, value.first, value.second), true);
+  }
+
+  std::pair<iterator, bool> insert(const Key &key, const T &obj) {
+    return insert(value_type(key, obj));
+  }
+
+  // Вставка с подсказкой: при верной подсказке без двоичного поиска
+  iterator insert(const_iterator hint, const value_type &value) {
+    size_type index = hint.index;
+    if ((index == keys.size() || key_less(value.first, keys[index])) &&
+        (index == 0 || key_less(keys[index - 1], value.first)))
+      return insertAt(index, value.first, value.second);
+    return insert(value).first;
+  }
+
+  template <typename... Args>
+  iterator emplace_hint(const_iterator hint, Args &&...args) {
+    return insert(hint, value_type(std::forward<Args>(args)...));
+  }
+
+  /*Пачка элементов вставляется одним слиянием: вход сортируется (если он
+  еще не упорядочен), из равных ключей остается первый, затем массивы
+  удлиняются и сливаются с конца на месте. Уже имеющиеся ключи не
+  меняются. O(n + m log m) вместо O(n m) при вставке по одному.*/
+  template <typename InputIt>
+  void insert(InputIt first, InputIt last) {
+    using batch_allocator = typename std::allocator_traits<
+        Allocator>::template rebind_alloc<std::pair<Key, T>>;
+    std::vector<std::pair<Key, T>, batch_allocator> batch(
+        first, last, batch_allocator(get_allocator()));
+    auto by_key = [this](const std::pair<Key, T> &a,
+                         const std::pair<Key, T> &b) {
+      return key_less(a.first, b.first);
+    };
+    if (!std::is_sorted(batch.begin(), batch.end(), by_key))
+      std::stable_sort(batch.begin(), batch.end(), by_key);
+    batch.erase(std::unique(batch.begin(), batch.end(),
+                            [&by_key](const std::pair<Key, T> &a,
+                                      const std::pair<Key, T> &b) {
+                              return !by_key(a, b);
+                            }),
+                batch.end());
+    size_type fresh = 0;
+    for (size_type i = 0, j = 0; j < batch.size();) {
+      if (i < keys.size() && key_less(keys[i], batch[j].first)) {
+        ++i;
+      } else {
+        if (i == keys.size() || key_less(batch[j].first, keys[i])) ++fresh;
+        ++j;
+      }
+    }
+    if (fresh == 0) return;
+    size_type i = keys.size(), j = batch.size(), out = keys.size() + fresh;
+    keys.resize(out);
+    values.resize(out);
+    // Когда out догоняет i, новые ключи кончились: остаток пачки - повторы,
+    // а keys[0..i) уже на своих местах
+    while (j > 0 && out > i) {
+      if (i > 0 && key_less(batch[j - 1].first, keys[i - 1])) {
+        --i;
+        --out;
+        keys[out] = std::move(keys[i]);
+        values[out] = std::move(values[i]);
+      } else if (i > 0 && !key_less(keys[i - 1], batch[j - 1].first)) {
+        --j;
+      } else {
+        --j;
+        --out;
+        keys[out] = std::move(batch[j].first);
+        values[out].value = std::move(batch[j].second);
+      }
+    }
+  }
+
+  std::pair<iterator, bool> insert_or_assign(const Key &key, const T &obj) {
+    size_type index = lowerIndex(key);
+    if (index < keys.size() && !key_less(key, keys[index])) {
+      values[index].value = obj;
+      return std::make_pair(iterator(this, index), false);
+    }
+    return std::make_pair(insertAt(index, key, obj), true);
+  }
+
+  void erase(iterator pos) {
+    if (pos == end()) return;
+    keys.erase(keys.begin() + pos.index);
+    values.erase(values.begin() + pos.index);
+  }
+
+  size_type erase(const Key &key) { return eraseKey(key); }
+
+  template <typename K, transparent_t<Compare, K> = 0>
+  size_type erase(const K &key) {
+    return eraseKey(key);
+  }
+
+  void swap(flat_map &other) {
+    keys.swap(other.keys);
+    values.swap(other.values);
+    std::swap(comp, other.comp);
+  }
+
+  // Забирает из other ключи, которых нет в *this, other становится пустым
+  void merge(flat_map &other) { combine(other, true, true, true); }
+
+  /*Операции над множествами за один линейный проход, O(n + m). Результат
+  остается в *this, other становится пустым. Для общих ключей остаются
+  значения из *this.*/
+  void set_union(flat_map &other) { combine(other, true, true, true); }
+  void set_intersection(flat_map &other) {
+    combine(other, false, false, true);
+  }
+  void set_difference(flat_map &other) { combine(other, true, false, false); }
+  void symmetric_difference(flat_map &other) {
+    combine(other, true, true, false);
+  }
+
+  // Разрезание и склейка: split оставляет ключи меньше key и возвращает
+  // остальные, join забирает все ключи other. Ключи, лежащие целиком левее
+  // или правее ключей *this, дописываются, иначе join работает как merge
+  flat_map split(const Key &key) {
+    size_type index = lowerIndex(key);
+    flat_map result(comp, get_allocator());
+    result.keys.assign(std::make_move_iterator(keys.begin() + index),
+                       std::make_move_iterator(keys.end()));
+    result.values.assign(std::make_move_iterator(values.begin() + index),
+                         std::make_move_iterator(values.end()));
+    keys.erase(keys.begin() + index, keys.end());
+    values.erase(values.begin() + index, values.end());
+    return result;
+  }
+
+  void join(flat_map &other) {
+    if (other.empty() || this == &other) return;
+    if (!empty()) {
+      bool before = key_less(other.keys.back(), keys.front());
+      // Диапазоны пересекаются: дописывание нарушило бы порядок, поэтому
+      // массивы сливаются линейно, как в merge
+      if (!before && !key_less(keys.back(), other.keys.front())) {
+        combine(other, true, true, true);
+        return;
+      }
+      if (before) other.swap(*this);
+    }
+    keys.insert(keys.end(), std::make_move_iterator(other.keys.begin()),
+                std::make_move_iterator(other.keys.end()));
+    values.insert(values.end(), std::make_move_iterator(other.values.begin()),
+                  std::make_move_iterator(other.values.end()));
+    other.clear();
+  }
+
+  bool contains(const Key &key) const { return findIndex(key) != keys.size(); }
+
+  template <typename K, transparent_t<Compare, K> = 0>
+  bool contains(const K &key) const {
+    return findIndex(key) != keys.size();
+  }
+
+  // Порядковые статистики за O(1) и O(log n)
+  iterator nth(size_type k) {
+    return k < keys.size() ? iterator(this, k) : end();
+  }
+
+  size_type rank(const Key &key) const { return lowerIndex(key); }
+
+  size_type count_range(const Key &lo, const Key &hi) const {
+    if (!key_less(lo, hi)) return 0;
+    return lowerIndex(hi) - lowerIndex(lo);
+  }
+
+  iterator find(const Key &key) { return iterator(this, findIndex(key)); }
+
+  const_iterator find(const Key &key) const {
+    return const_iterator(this, findIndex(key));
+  }
+
+  template <typename K, transparent_t<Compare, K> = 0>
+  iterator find(const K &key) {
+    return iterator(this, findIndex(key));
+  }
+
+  template <typename K, transparent_t<Compare, K> = 0>
+  const_iterator find(const K &key) const {
+    return const_iterator(this, findIndex(key));
+  }
+
+  // Границы диапазонов двоичным поиском без ветвлений, O(log n)
+  iterator lower_bound(const Key &key) {
+    return iterator(this, lowerIndex(key));
+  }
+
+  const_iterator lower_bound(const Key &key) const {
+    return const_iterator(this, lowerIndex(key));
+  }
+
+  template <typename K, transparent_t<Compare, K> = 0>
+  iterator lower_bound(const K &key) {
+    return iterator(this, lowerIndex(key));
+  }
+
+  template <typename K, transparent_t<Compare, K> = 0>
+  const_iterator lower_bound(const K &key) const {
+    return const_iterator(this, lowerIndex(key));
+  }
+
+  iterator upper_bound(const Key &key) {
+    return iterator(this, upperIndex(key));
+  }
+
+  const_iterator upper_bound(const Key &key) const {
+    return const_iterator(this, upperIndex(key));
+  }
+
+  template <typename K, transparent_t<Compare, K> = 0>
+  iterator upper_bound(const K &key) {
+    return iterator(this, upperIndex(key));
+  }
+
+  template <typename K, transparent_t<Compare, K> = 0>
+  const_iterator upper_bound(const K &key) const {
+    return const_iterator(this, upperIndex(key));
+  }
+
+  std::pair<iterator, iterator> equal_range(const Key &key) {
+    return std::make_pair(lower_bound(key), upper_bound(key));
+  }
+
+  std::pair<const_iterator, const_iterator> equal_range(const Key &key) const {
+    return std::make_pair(lower_bound(key), upper_bound(key));
+  }
+
+  template <typename K, transparent_t<Compare, K> = 0>
+  std::pair<iterator, iterator> equal_range(const K &key) {
+    return std::make_pair(lower_bound(key), upper_bound(key));
+  }
+
+  template <typename K, transparent_t<Compare, K> = 0>
+  std::pair<const_iterator, const_iterator> equal_range(const K &key) const {
+    return std::make_pair(lower_bound(key), upper_bound(key));
+  }
+
+  // Наибольший ключ, не больше key, или end()
+  iterator floor(const Key &key) {
+    size_type index = upperIndex(key);
+    return index ? iterator(this, index - 1) : end();
+  }
+
+  const_iterator floor(const Key &key) const {
+    size_type index = upperIndex(key);
+    return index ? const_iterator(this, index - 1) : end();
+  }
+
+  // Наименьший ключ, не меньше key, или end()
+  iterator ceiling(const Key &key) { return lower_bound(key); }
+
+  const_iterator ceiling(const Key &key) const { return lower_bound(key); }
+};
+
+namespace pmr {
+// Словарь на массивах, память которых берется из std::pmr::memory_resource
+template <typename Key, typename T, typename Compare = std::less<Key>>
+using flat_map = binary_tree::flat_map<
+    Key, T, std::pmr::polymorphic_allocator<std::pair<const Key, T>>, Compare>;
+}  // namespace pmr
+
+}  // namespace binary_tree
+
+#endif  // FLAT_MAP_H
@@ -0,0 +1,337 @@
+#ifndef FLAT_SET_H
+#define FLAT_SET_H
+
+#include <algorithm>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <memory_resource>
+#include <utility>
+#include <vector>
+
+#include "flat_map.h"
+
+namespace binary_tree {
+
+/*Множество на упорядоченном массиве с тем же интерфейсом, что у set.
+Итератор - это итератор массива: обход и сдвиг на k элементов идут за O(1).
+Как и у flat_map, вставка и удаление стоят O(n) и делают итераторы
+недействительными. Compare и поиск по прозрачному компаратору - как у set.*/
+template <typename Key, typename Allocator = std::allocator<Key>,
+          typename Compare = std::less<Key>>
+class flat_set {
+ private:
+  std::vector<Key, Allocator> keys;
+  Compare comp;
+
+  // a < b в порядке Compare
+  template <typename A, typename B>
+  bool key_less(const A &a, const B &b) const {
+    return KeyOrder<Compare>::less(comp, a, b);
+  }
+
+  // Сравнение ключей для алгоритмов стандартной библиотеки
+  auto less() const {
+    return [this](const auto &a, const auto &b) { return key_less(a, b); };
+  }
+
+  // K - Key или тип, который прозрачный компаратор сравнивает с Key
+  template <typename K>
+  size_t lowerIndex(const K &key) const {
+    return branchlessBound<false>(keys.data(), keys.size(), key, less());
+  }
+
+  template <typename K>
+  size_t upperIndex(const K &key) const {
+    return branchlessBound<true>(keys.data(), keys.size(), key, less());
+  }
+
+  template <typename K>
+  typename std::vector<Key, Allocator>::const_iterator findKey(
+      const K &key) const {
+    size_t index = lowerIndex(key);
+    if (index == keys.size() || key_less(key, keys[index])) return keys.end();
+    return keys.begin() + index;
+  }
+
+  template <typename K>
+  size_t eraseKey(const K &key) {
+    auto pos = findKey(key);
+    if (pos == keys.end()) return 0;
+    keys.erase(pos);
+    return 1;
+  }
+
+  // Повторы соседних ключей в упорядоченном диапазоне
+  auto same() const {
+    return [this](const Key &a, const Key &b) { return !key_less(a, b); };
+  }
+
+  // Результат слияния двух упорядоченных массивов заменяет *this, other
+  // становится пустым. Для other == *this все ключи общие: они остаются
+  // целиком или удаляются по keep_common
+  template <typename Combine>
+  void combine(flat_set &other, bool keep_common, Combine algorithm) {
+    if (this == &other) {
+      if (!keep_common) clear();
+      return;
+    }
+    std::vector<Key, Allocator> merged(keys.get_allocator());
+    merged.reserve(keys.size() + other.keys.size());
+    algorithm(std::make_move_iterator(keys.begin()),
+              std::make_move_iterator(keys.end()),
+              std::make_move_iterator(other.keys.begin()),
+              std::make_move_iterator(other.keys.end()),
+              std::back_inserter(merged), less());
+    keys.swap(merged);
+    other.clear();
+  }
+
+ public:
+  using key_type = Key;
+  using value_type = Key;
+  using reference = value_type &;
+  using const_reference = const value_type &;
+  using size_type = size_t;
+  using allocator_type = Allocator;
+  using key_compare = Compare;
+  using value_compare = Compare;
+  using iterator = typename std::vector<Key, Allocator>::const_iterator;
+  using const_iterator = iterator;
+
+  flat_set() = default;
+
+  // Массив берется из распределителя alloc, например из pmr-ресурса
+  explicit flat_set(const Allocator &alloc) : keys(alloc) {}
+
+  explicit flat_set(const Compare &comp, const Allocator &alloc = Allocator())
+      : keys(alloc), comp(comp) {}
+
+  flat_set(std::initializer_list<key_type> const &items,
+           const Allocator &alloc = Allocator())
+      : flat_set(alloc) {
+    insert(items.begin(), items.end());
+  }
+
+  // Конструктор из диапазона ключей, вход сортируется один раз
+  template <typename InputIt, typename = typename std::iterator_traits<
+                                  InputIt>::iterator_category>
+  flat_set(InputIt first, InputIt last, const Allocator &alloc = Allocator())
+      : flat_set(alloc) {
+    insert(first, last);
+  }
+
+  flat_set(const flat_set &other) = default;
+  flat_set(flat_set &&other) noexcept = default;
+  flat_set &operator=(const flat_set &other) = default;
+  flat_set &operator=(flat_set &&other) = default;
+  ~flat_set() = default;
+
+  allocator_type get_allocator() const { return keys.get_allocator(); }
+  key_compare key_comp() const { return comp; }
+  value_compare value_comp() const { return comp; }
+
+  // Запас памяти под n элементов без перевыделения массива
+  void reserve(size_type n) { keys.reserve(n); }
+
+  // Отдает память, оставшуюся от удаленных элементов
+  void shrink_to_fit() { keys.shrink_to_fit(); }
+
+  iterator begin() const { return keys.begin(); }
+  iterator end() const { return keys.end(); }
+
+  bool empty() const { return keys.empty(); }
+  size_type size() const { return keys.size(); }
+  size_type max_size() const { return keys.max_size(); }
+
+  void clear() { keys.clear(); }
+
+  // Заменяет содержимое диапазоном ключей
+  template <typename InputIt>
+  void assign_sorted(InputIt first, InputIt last) {
+    clear();
+    insert(first, last);
+  }
+
+  std::pair<iterator, bool> insert(const key_type &value) {
+    size_type index = lowerIndex(value);
+    if (index < keys.size() && !key_less(value, keys[index]))
+      return std::make_pair(keys.begin() + index, false);
+    return std::make_pair(keys.insert(keys.begin() + index, value), true);
+  }
+
+  // Вставка с подсказкой: при верной подсказке без двоичного поиска
+  iterator insert(const_iterator hint, const key_type &value) {
+    if ((hint == keys.end() || key_less(value, *hint)) &&
+        (hint == keys.begin() || key_less(*(hint - 1), value)))
+      return keys.insert(hint, value);
+    return insert(value).first;
+  }
+
+  template <typename... Args>
+  iterator emplace_hint(const_iterator hint, Args &&...args) {
+    return insert(hint, key_type(std::forward<Args>(args)...));
+  }
+
+  /*Пачка ключей вставляется одним слиянием: новые ключи дописываются в
+  конец, хвост сортируется и очищается от повторов, а затем сливается с
+  прежней частью на месте. O(n + m log m) вместо O(n m) при вставке по
+  одному.*/
+  template <typename InputIt>
+  void insert(InputIt first, InputIt last) {
+    size_type old_size = keys.size();
+    keys.insert(keys.end(), first, last);
+    auto middle = keys.begin() + old_size;
+    if (!std::is_sorted(middle, keys.end(), less()))
+      std::sort(middle, keys.end(), less());
+    keys.erase(std::unique(middle, keys.end(), same()), keys.end());
+    middle = keys.begin() + old_size;
+    if (middle == keys.begin() || middle == keys.end() ||
+        key_less(*(middle - 1), *middle))
+      return;
+    std::inplace_merge(keys.begin(), middle, keys.end(), less());
+    keys.erase(std::unique(keys.begin(), keys.end(), same()), keys.end());
+  }
+
+  void erase(iterator pos) {
+    if (pos != keys.end()) keys.erase(pos);
+  }
+
+  size_type erase(const Key &key) { return eraseKey(key); }
+
+  template <typename K, transparent_t<Compare, K> = 0>
+  size_type erase(const K &key) {
+    return eraseKey(key);
+  }
+
+  void swap(flat_set &other) {
+    keys.swap(other.keys);
+    std::swap(comp, other.comp);
+  }
+
+  // Забирает из other ключи, которых нет в *this, other становится пустым
+  void merge(flat_set &other) { set_union(other); }
+
+  /*Операции над множествами за один линейный проход, O(n + m). Результат
+  остается в *this, other становится пустым.*/
+  void set_union(flat_set &other) {
+    combine(other, true,
+            [](auto... args) { return std::set_union(args...); });
+  }
+  void set_intersection(flat_set &other) {
+    combine(other, true,
+            [](auto... args) { return std::set_intersection(args...); });
+  }
+  void set_difference(flat_set &other) {
+    combine(other, false,
+            [](auto... args) { return std::set_difference(args...); });
+  }
+  void symmetric_difference(flat_set &other) {
+    combine(other, false, [](auto... args) {
+      return std::set_symmetric_difference(args...);
+    });
+  }
+
+  // Разрезание и склейка: split оставляет ключи меньше key и возвращает
+  // остальные, join забирает все ключи other. Ключи, лежащие целиком левее
+  // или правее ключей *this, дописываются, иначе join работает как merge
+  flat_set split(const Key &key) {
+    auto middle = keys.begin() + lowerIndex(key);
+    flat_set result(comp, get_allocator());
+    result.keys.assign(std::make_move_iterator(middle),
+                       std::make_move_iterator(keys.end()));
+    keys.erase(middle, keys.end());
+    return result;
+  }
+
+  void join(flat_set &other) {
+    if (other.empty() || this == &other) return;
+    if (!empty()) {
+      bool before = key_less(other.keys.back(), keys.front());
+      // Диапазоны пересекаются: ключи сливаются линейно, как в merge
+      if (!before && !key_less(keys.back(), other.keys.front())) {
+        set_union(other);
+        return;
+      }
+      if (before) other.swap(*this);
+    }
+    keys.insert(keys.end(), std::make_move_iterator(other.keys.begin()),
+                std::make_move_iterator(other.keys.end()));
+    other.clear();
+  }
+
+  bool contains(const Key &key) const { return findKey(key) != end(); }
+
+  template <typename K, transparent_t<Compare, K> = 0>
+  bool contains(const K &key) const {
+    return findKey(key) != end();
+  }
+
+  // Порядковые статистики за O(1) и O(log n)
+  iterator nth(size_type k) const {
+    return k < keys.size() ? keys.begin() + k : end();
+  }
+
+  size_type rank(const Key &key) const { return lowerIndex(key); }
+
+  size_type count_range(const Key &lo, const Key &hi) const {
+    if (!key_less(lo, hi)) return 0;
+    return lowerIndex(hi) - lowerIndex(lo);
+  }
+
+  iterator find(const Key &key) const { return findKey(key); }
+
+  template <typename K, transparent_t<Compare, K> = 0>
+  iterator find(const K &key) const {
+    return findKey(key);
+  }
+
+  // Границы диапазонов двоичным поиском без ветвлений, O(log n)
+  iterator lower_bound(const Key &key) const {
+    return keys.begin() + lowerIndex(key);
+  }
+
+  template <typename K, transparent_t<Compare, K> = 0>
+  iterator lower_bound(const K &key) const {
+    return keys.begin() + lowerIndex(key);
+  }
+
+  iterator upper_bound(const Key &key) const {
+    return keys.begin() + upperIndex(key);
+  }
+
+  template <typename K, transparent_t<Compare, K> = 0>
+  iterator upper_bound(const K &key) const {
+    return keys.begin() + upperIndex(key);
+  }
+
+  std::pair<iterator, iterator> equal_range(const Key &key) const {
+    return std::make_pair(lower_bound(key), upper_bound(key));
+  }
+
+  template <typename K, transparent_t<Compare, K> = 0>
+  std::pair<iterator, iterator> equal_range(const K &key) const {
+    return std::make_pair(lower_bound(key), upper_bound(key));
+  }
+
+  // Наибольший ключ, не больше key, или end()
+  iterator floor(const Key &key) const {
+    size_type index = upperIndex(key);
+    return index ? keys.begin() + (index - 1) : end();
+  }
+
+  // Наименьший ключ, не меньше key, или end()
+  iterator ceiling(const Key &key) const { return lower_bound(key); }
+};
+
+namespace pmr {
+// Множество на массиве, память которого берется из std::pmr::memory_resource
+template <typename Key, typename Compare = std::less<Key>>
+using flat_set =
+    binary_tree::flat_set<Key, std::pmr::polymorphic_allocator<Key>, Compare>;
+}  // namespace pmr
+
+}  // namespace binary_tree
+
+#endif  // FLAT_SET_H
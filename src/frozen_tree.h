@@ -0,0 +1,342 @@
+#ifndef FROZEN_TREE_H
+#define FROZEN_TREE_H
+
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+#include "binary_tree.h"
+
+namespace binary_tree {
+
+/*Неизменяемый снимок дерева для чтения. Ключи лежат в плоском массиве в
+порядке Эйтцингера (обход в ширину): сыновья элемента k (с единицы) - это 2k
+и 2k + 1, так что первые уровни поиска занимают несколько соседних строк
+кэша, а адрес следующего шага вычисляется без чтения указателей. Данные
+лежат в параллельном массиве в том же порядке и читаются только для
+найденного ключа. Спуск идет без ветвлений: сравнение дает номер сына,
+а через несколько уровней вперед заранее подгружается строка с потомками.
+Ключи упорядочены и ищутся по Compare, как в исходном дереве.*/
+template <typename T1, typename T2, typename Compare = std::less<T1>>
+class FrozenTree {
+ public:
+  using size_type = size_t;
+
+ private:
+  /*Данные лежат в обертке: для T2 = bool массив std::vector<bool> хранил бы
+  биты, и ссылка it->second указывала бы на временный объект.*/
+  struct Slot {
+    T2 value;
+  };
+
+  std::vector<T1> keys;
+  std::vector<Slot> values;
+  Compare comp;
+
+  // Сколько ключей помещается в строку кэша: столько потомков на уровне
+  // log2(block) ниже текущего лежат подряд и подгружаются одним prefetch
+  static constexpr size_type block = sizeof(T1) < 64 ? 64 / sizeof(T1) : 1;
+
+  template <typename ForwardIt>
+  void place(ForwardIt &it, size_type k);
+  static size_type nextIndex(size_type k, size_type n);
+  static size_type prevIndex(size_type k, size_type n);
+  static size_type climb(size_type k);
+  void prefetch(size_type k) const;
+  template <typename Less>
+  size_type descend(Less less) const;
+  // a < b в порядке Compare
+  bool key_less(const T1 &a, const T1 &b) const {
+    return KeyOrder<Compare>::less(comp, a, b);
+  }
+
+ public:
+  FrozenTree() = default;
+
+  // Снимок содержимого дерева вместе с его порядком ключей, O(n)
+  template <typename Allocator, bool Threaded>
+  explicit FrozenTree(
+      const BinaryTree<T1, T2, Allocator, Compare, Threaded> &tree);
+
+  // Снимок упорядоченного по comp диапазона пар без повторов
+  template <typename ForwardIt>
+  FrozenTree(ForwardIt first, ForwardIt last,
+             const Compare &comp = Compare());
+
+  /*Ключи и данные лежат разными массивами, поэтому итератор, как у BTree,
+  разыменовывается в пару ссылок: it->first, it->second. pointer - обертка
+  над такой парой, через которую работает оператор ->.*/
+  template <typename Reference>
+  struct Arrow {
+    Reference ref;
+    const Reference *operator->() const { return &ref; }
+  };
+
+  class const_iterator {
+   private:
+    const FrozenTree *tree;
+    // Номер элемента в порядке Эйтцингера, 0 - end()
+    size_type index;
+
+   public:
+    using iterator_category = std::bidirectional_iterator_tag;
+    using value_type = std::pair<const T1, T2>;
+    using difference_type = std::ptrdiff_t;
+    using reference = std::pair<const T1 &, const T2 &>;
+    using pointer = Arrow<reference>;
+
+    const_iterator(const FrozenTree *tree, size_type index);
+
+    // Префиксный оператор++
+    const_iterator &operator++();
+
+    // Префиксный оператор--
+    const_iterator &operator--();
+
+    // Постфиксный оператор++
+    const_iterator operator++(int);
+
+    // Постфиксный оператор--
+    const_iterator operator--(int);
+
+    // Операторы сравнения
+    bool operator==(const const_iterator &other) const;
+    bool operator!=(const const_iterator &other) const;
+
+    // Оператор разыменования
+    reference operator*() const;
+
+    // Оператор доступа к члену
+    pointer operator->() const;
+  };
+  using iterator = const_iterator;
+
+  const_iterator begin() const;
+  const_iterator end() const;
+
+  const_iterator find(const T1 &key) const;
+  // Первый элемент с ключом не меньше key
+  const_iterator lower_bound(const T1 &key) const;
+  // Первый элемент с ключом больше key
+  const_iterator upper_bound(const T1 &key) const;
+  bool contains(const T1 &key) const;
+
+  bool empty() const;
+  size_type size() const;
+};
+
+// Обход дерева по возрастанию ключей сразу раскладывается в порядок Эйтцингера
+template <typename T1, typename T2, typename Compare>
+template <typename Allocator, bool Threaded>
+FrozenTree<T1, T2, Compare>::FrozenTree(
+    const BinaryTree<T1, T2, Allocator, Compare, Threaded> &tree)
+    : keys(tree.size()), values(tree.size()), comp(tree.key_comp()) {
+  auto it = tree.begin();
+  place(it, 1);
+}
+
+template <typename T1, typename T2, typename Compare>
+template <typename ForwardIt>
+FrozenTree<T1, T2, Compare>::FrozenTree(ForwardIt first, ForwardIt last,
+                                        const Compare &comp)
+    : keys(std::distance(first, last)), values(keys.size()), comp(comp) {
+  place(first, 1);
+}
+
+// Симметричный обход неявного дерева с корнем k: слева направо
+// ячейки получают очередные элементы упорядоченного входа
+template <typename T1, typename T2, typename Compare>
+template <typename ForwardIt>
+void FrozenTree<T1, T2, Compare>::place(ForwardIt &it, size_type k) {
+  if (k > keys.size()) return;
+  place(it, 2 * k);
+  const auto &item = *it;
+  keys[k - 1] = item.first;
+  values[k - 1].value = item.second;
+  ++it;
+  place(it, 2 * k + 1);
+}
+
+// Подъем из правого сына: снимает младшие единицы номера и еще один шаг
+template <typename T1, typename T2, typename Compare>
+typename FrozenTree<T1, T2, Compare>::size_type
+FrozenTree<T1, T2, Compare>::climb(size_type k) {
+#if defined(__GNUC__)
+  return k >> (__builtin_ctzll(~static_cast<unsigned long long>(k)) + 1);
+#else
+  while (k & 1) k >>= 1;
+  return k >> 1;
+#endif
+}
+
+template <typename T1, typename T2, typename Compare>
+typename FrozenTree<T1, T2, Compare>::size_type
+FrozenTree<T1, T2, Compare>::nextIndex(size_type k, size_type n) {
+  if (2 * k + 1 <= n) {
+    k = 2 * k + 1;
+    while (2 * k <= n) k *= 2;
+    return k;
+  }
+  return climb(k);
+}
+
+// Для end() (0) - последний элемент
+template <typename T1, typename T2, typename Compare>
+typename FrozenTree<T1, T2, Compare>::size_type
+FrozenTree<T1, T2, Compare>::prevIndex(size_type k, size_type n) {
+  if (k == 0) {
+    if (n == 0) return 0;
+    k = 1;
+    while (2 * k + 1 <= n) k = 2 * k + 1;
+    return k;
+  }
+  if (2 * k <= n) {
+    k = 2 * k;
+    while (2 * k + 1 <= n) k = 2 * k + 1;
+    return k;
+  }
+  // Подъем из левого сына
+  while (k > 1 && !(k & 1)) k >>= 1;
+  return k >> 1;
+}
+
+template <typename T1, typename T2, typename Compare>
+void FrozenTree<T1, T2, Compare>::prefetch(size_type k) const {
+#if defined(__GNUC__)
+  if (k * block <= keys.size()) __builtin_prefetch(&keys[k * block - 1]);
+#else
+  (void)k;
+#endif
+}
+
+/*Спуск без ветвлений: less(ключ) решает, идти ли направо. Возвращает номер
+первого элемента, для которого less ложно, 0 - такого нет.*/
+template <typename T1, typename T2, typename Compare>
+template <typename Less>
+typename FrozenTree<T1, T2, Compare>::size_type
+FrozenTree<T1, T2, Compare>::descend(Less less) const {
+  size_type n = keys.size(), k = 1;
+  while (k <= n) {
+    prefetch(k);
+    k = 2 * k + size_type(less(keys[k - 1]));
+  }
+  // Последний поворот налево и был ответом
+  return climb(k);
+}
+
+template <typename T1, typename T2, typename Compare>
+typename FrozenTree<T1, T2, Compare>::const_iterator
+FrozenTree<T1, T2, Compare>::begin() const {
+  size_type k = keys.empty() ? 0 : 1;
+  while (k && 2 * k <= keys.size()) k *= 2;
+  return const_iterator(this, k);
+}
+
+template <typename T1, typename T2, typename Compare>
+typename FrozenTree<T1, T2, Compare>::const_iterator
+FrozenTree<T1, T2, Compare>::end() const {
+  return const_iterator(this, 0);
+}
+
+template <typename T1, typename T2, typename Compare>
+typename FrozenTree<T1, T2, Compare>::const_iterator
+FrozenTree<T1, T2, Compare>::find(const T1 &key) const {
+  size_type k = descend([&](const T1 &value) { return key_less(value, key); });
+  if (k == 0 || key_less(key, keys[k - 1])) return end();
+  return const_iterator(this, k);
+}
+
+template <typename T1, typename T2, typename Compare>
+typename FrozenTree<T1, T2, Compare>::const_iterator
+FrozenTree<T1, T2, Compare>::lower_bound(const T1 &key) const {
+  return const_iterator(
+      this, descend([&](const T1 &value) { return key_less(value, key); }));
+}
+
+template <typename T1, typename T2, typename Compare>
+typename FrozenTree<T1, T2, Compare>::const_iterator
+FrozenTree<T1, T2, Compare>::upper_bound(const T1 &key) const {
+  return const_iterator(
+      this, descend([&](const T1 &value) { return !key_less(key, value); }));
+}
+
+template <typename T1, typename T2, typename Compare>
+bool FrozenTree<T1, T2, Compare>::contains(const T1 &key) const {
+  return find(key) != end();
+}
+
+template <typename T1, typename T2, typename Compare>
+bool FrozenTree<T1, T2, Compare>::empty() const {
+  return keys.empty();
+}
+
+template <typename T1, typename T2, typename Compare>
+typename FrozenTree<T1, T2, Compare>::size_type
+FrozenTree<T1, T2, Compare>::size() const {
+  return keys.size();
+}
+
+template <typename T1, typename T2, typename Compare>
+FrozenTree<T1, T2, Compare>::const_iterator::const_iterator(
+    const FrozenTree *tree, size_type index)
+    : tree(tree), index(index) {}
+
+template <typename T1, typename T2, typename Compare>
+typename FrozenTree<T1, T2, Compare>::const_iterator &
+FrozenTree<T1, T2, Compare>::const_iterator::operator++() {
+  index = nextIndex(index, tree->keys.size());
+  return *this;
+}
+
+template <typename T1, typename T2, typename Compare>
+typename FrozenTree<T1, T2, Compare>::const_iterator &
+FrozenTree<T1, T2, Compare>::const_iterator::operator--() {
+  index = prevIndex(index, tree->keys.size());
+  return *this;
+}
+
+template <typename T1, typename T2, typename Compare>
+typename FrozenTree<T1, T2, Compare>::const_iterator
+FrozenTree<T1, T2, Compare>::const_iterator::operator++(int) {
+  const_iterator temp = *this;
+  ++(*this);
+  return temp;
+}
+
+template <typename T1, typename T2, typename Compare>
+typename FrozenTree<T1, T2, Compare>::const_iterator
+FrozenTree<T1, T2, Compare>::const_iterator::operator--(int) {
+  const_iterator temp = *this;
+  --(*this);
+  return temp;
+}
+
+template <typename T1, typename T2, typename Compare>
+bool FrozenTree<T1, T2, Compare>::const_iterator::operator==(
+    const const_iterator &other) const {
+  return index == other.index;
+}
+
+template <typename T1, typename T2, typename Compare>
+bool FrozenTree<T1, T2, Compare>::const_iterator::operator!=(
+    const const_iterator &other) const {
+  return index != other.index;
+}
+
+template <typename T1, typename T2, typename Compare>
+typename FrozenTree<T1, T2, Compare>::const_iterator::reference
+FrozenTree<T1, T2, Compare>::const_iterator::operator*() const {
+  return reference(tree->keys[index - 1], tree->values[index - 1].value);
+}
+
+template <typename T1, typename T2, typename Compare>
+typename FrozenTree<T1, T2, Compare>::const_iterator::pointer
+FrozenTree<T1, T2, Compare>::const_iterator::operator->() const {
+  return pointer{**this};
+}
+
+}  // namespace binary_tree
+
+#endif  // FROZEN_TREE_H
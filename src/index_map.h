@@ -0,0 +1,125 @@
+#ifndef INDEX_MAP_H
+#define INDEX_MAP_H
+
+#include <initializer_list>
+#include <stdexcept>
+#include <utility>
+
+#include "index_tree.h"
+
+namespace binary_tree {
+
+/*Словарь на IndexTree: узлы лежат в одном массиве и связаны 32-битными
+номерами. Интерфейс как у btree_map, ключи сравниваются через operator<.
+Любая вставка может перевыделить массив и делает итераторы
+недействительными.*/
+template <typename Key, typename T>
+class index_map {
+ private:
+  using tree_type = IndexTree<Key, T>;
+  tree_type tree;
+
+ public:
+  using key_type = Key;
+  using mapped_type = T;
+  using value_type = std::pair<const key_type, mapped_type>;
+  using iterator = typename tree_type::iterator;
+  using const_iterator = typename tree_type::const_iterator;
+  // Ссылка на элемент - пара ссылок на ключ и данные узла, как у btree_map
+  using reference = typename iterator::reference;
+  using const_reference = typename const_iterator::reference;
+  using size_type = size_t;
+
+  index_map() = default;
+
+  index_map(std::initializer_list<value_type> const &items) {
+    tree.reserve(items.size());
+    for (const value_type &item : items) tree.push(item.first, item.second);
+  }
+
+  index_map(const index_map &other) = default;
+  index_map(index_map &&other) noexcept = default;
+  index_map &operator=(const index_map &other) = default;
+  index_map &operator=(index_map &&other) = default;
+  ~index_map() = default;
+
+  T &at(const Key &key) {
+    iterator result = tree.find(key);
+    if (result == end()) throw std::out_of_range("Key not found");
+    return result->second;
+  }
+
+  const T &at(const Key &key) const {
+    const_iterator result = tree.find(key);
+    if (result == end()) throw std::out_of_range("Key not found");
+    return result->second;
+  }
+
+  // Данные по умолчанию строятся, только если ключа нет
+  T &operator[](const Key &key) { return tree.emplace(key).first->second; }
+
+  iterator begin() { return tree.begin(); }
+  iterator end() { return tree.end(); }
+  const_iterator begin() const { return tree.begin(); }
+  const_iterator end() const { return tree.end(); }
+
+  bool empty() const { return tree.empty(); }
+  size_type size() const { return tree.size(); }
+  size_type max_size() const { return tree.max_size(); }
+
+  void clear() { tree.clear(); }
+
+  // Запас ячеек под n узлов без перевыделения массива
+  void reserve(size_type n) { tree.reserve(n); }
+
+  // Узлы перекладываются в порядке ключей без свободных ячеек
+  void compact() { tree.compact(); }
+
+  std::pair<iterator, bool> insert(const value_type &value) {
+    return tree.push(value.first, value.second);
+  }
+
+  std::pair<iterator, bool> insert(const Key &key, const T &obj) {
+    return tree.push(key, obj);
+  }
+
+  std::pair<iterator, bool> insert_or_assign(const Key &key, const T &obj) {
+    std::pair<iterator, bool> result = tree.push(key, obj);
+    if (!result.second) result.first->second = obj;
+    return result;
+  }
+
+  // Ячейка удаленного узла занимается следующей вставкой
+  void erase(iterator pos) {
+    if (pos == end()) return;
+    tree.erase(pos);
+  }
+
+  size_type erase(const Key &key) { return tree.erase(key); }
+
+  void swap(index_map &other) { tree.swap(other.tree); }
+
+  // Проверка инвариантов дерева, O(n)
+  bool valid() const { return tree.valid(); }
+
+  bool contains(const Key &key) const { return tree.contains(key); }
+
+  iterator find(const Key &key) { return tree.find(key); }
+  const_iterator find(const Key &key) const { return tree.find(key); }
+
+  iterator lower_bound(const Key &key) { return tree.lower_bound(key); }
+
+  const_iterator lower_bound(const Key &key) const {
+    return tree.lower_bound(key);
+  }
+
+  iterator upper_bound(const Key &key) { return tree.upper_bound(key); }
+
+  const_iterator upper_bound(const Key &key) const {
+    return tree.upper_bound(key);
+  }
+};
+
+}  // namespace binary_tree
+
+#endif  // INDEX_MAP_H
@@ -0,0 +1,835 @@
+#ifndef INDEX_TREE_H
+#define INDEX_TREE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "binary_tree.h"
+
+namespace binary_tree {
+
+/*Узел дерева с индексными связями. Вместо указателей узел хранит номера
+left, right и parent в общем массиве узлов, цвет занимает старший бит номера
+отца. Связи занимают 12 байт вместо 24, поэтому в дереве может быть не больше
+2^31 - 1 узлов. Связи доступны только самому дереву.*/
+template <typename T1, typename T2>
+class IndexTree;
+
+template <typename T1, typename T2>
+struct IndexNode {
+  // Номер отсутствующего узла
+  static constexpr std::uint32_t nil = 0x7FFFFFFF;
+
+  T1 key;
+  T2 data;
+
+  // Данные строятся из args, без args - по умолчанию
+  template <typename... Args>
+  explicit IndexNode(const T1 &key, Args &&...args)
+      : key(key), data(std::forward<Args>(args)...) {}
+
+ private:
+  friend class IndexTree<T1, T2>;
+
+  std::uint32_t left = nil, right = nil;
+
+  std::uint32_t parent() const { return parent_color & nil; }
+  COLOR color() const { return COLOR(parent_color >> 31); }
+  void setParent(std::uint32_t index) {
+    parent_color = (parent_color & ~nil) | index;
+  }
+  void setColor(COLOR value) {
+    parent_color = (parent_color & nil) | std::uint32_t(value) << 31;
+  }
+
+  // Новый узел красный (RED == 0) и без отца
+  std::uint32_t parent_color = nil;
+};
+
+/*Красно-черное дерево с уникальными ключами, узлы которого лежат в одном
+растущем массиве и связаны 32-битными номерами. Освобожденные ячейки
+собираются в список и занимаются повторно. Дерево копируется и перемещается
+вместе с массивом (для тривиально копируемых ключей и данных - одним
+memcpy), а массив вместе с номером корня можно записать на диск как есть.
+Освобожденная ячейка получает пустые T1() и T2(), поэтому ключ и данные
+должны иметь конструктор по умолчанию. Вставка может перевыделить массив,
+поэтому итераторы и ссылки на узлы действительны только до следующей
+вставки.*/
+template <typename T1, typename T2>
+class IndexTree {
+ private:
+  using node_type = IndexNode<T1, T2>;
+  static constexpr std::uint32_t nil = node_type::nil;
+
+  std::vector<node_type> nodes;
+  std::uint32_t root = nil;
+  // Голова списка свободных ячеек, следующая ячейка хранится в left
+  std::uint32_t free_head = nil;
+  size_t tree_size = 0;
+
+  node_type &at(std::uint32_t index) { return nodes[index]; }
+  const node_type &at(std::uint32_t index) const { return nodes[index]; }
+  template <typename... Args>
+  std::uint32_t createNode(const T1 &key, Args &&...args);
+  void destroyNode(std::uint32_t index);
+  void rotateLeft(std::uint32_t ptr);
+  void rotateRight(std::uint32_t ptr);
+  void replaceNode(std::uint32_t ptr, std::uint32_t child);
+  bool isBlack(std::uint32_t ptr) const;
+  void balanceTree(std::uint32_t ptr);
+  void eraseBalance(std::uint32_t ptr, std::uint32_t father);
+  void remove(std::uint32_t ptr);
+  std::uint32_t findIndex(const T1 &key) const;
+  std::uint32_t lowerIndex(const T1 &key) const;
+  std::uint32_t upperIndex(const T1 &key) const;
+  std::uint32_t minimum(std::uint32_t ptr) const;
+  std::uint32_t maximum(std::uint32_t ptr) const;
+  std::uint32_t next(std::uint32_t ptr) const;
+  std::uint32_t prev(std::uint32_t ptr) const;
+  // Черная высота поддерева ptr или -1, если инварианты нарушены
+  int checkSubtree(std::uint32_t ptr, std::uint32_t father,
+                   std::uint32_t &previous, size_t &count) const;
+
+ public:
+  using size_type = size_t;
+
+  IndexTree() = default;
+
+  // Конструктор со списком инициализирования
+  IndexTree(std::initializer_list<std::pair<T1, T2>> const &items);
+
+  /*Итератор разыменовывается в пару ссылок на ключ и данные узла, как у
+  BTree: it->first, it->second = x. Ключ только для чтения, чтобы не
+  нарушить порядок дерева. pointer - обертка над такой парой, через которую
+  работает оператор ->.*/
+  template <typename Reference>
+  struct Arrow {
+    Reference ref;
+    const Reference *operator->() const { return &ref; }
+  };
+
+  class iterator {
+   private:
+    IndexTree *tree;
+    std::uint32_t current;
+    friend class IndexTree;
+    friend class const_iterator;
+
+   public:
+    using iterator_category = std::bidirectional_iterator_tag;
+    using value_type = std::pair<const T1, T2>;
+    using difference_type = std::ptrdiff_t;
+    using reference = std::pair<const T1 &, T2 &>;
+    using pointer = Arrow<reference>;
+
+    iterator(IndexTree *tree, std::uint32_t index);
+
+    // Префиксный оператор++
+    iterator &operator++();
+
+    // Префиксный оператор--
+    iterator &operator--();
+
+    // Постфиксный оператор++
+    iterator operator++(int);
+
+    // Постфиксный оператор--
+    iterator operator--(int);
+
+    // Операторы сравнения
+    bool operator==(const iterator &other) const;
+    bool operator!=(const iterator &other) const;
+
+    // Оператор разыменования
+    reference operator*() const;
+
+    // Оператор доступа к члену
+    pointer operator->() const;
+  };
+
+  class const_iterator {
+   private:
+    const IndexTree *tree;
+    std::uint32_t current;
+
+   public:
+    using iterator_category = std::bidirectional_iterator_tag;
+    using value_type = std::pair<const T1, T2>;
+    using difference_type = std::ptrdiff_t;
+    using reference = std::pair<const T1 &, const T2 &>;
+    using pointer = Arrow<reference>;
+
+    const_iterator(const IndexTree *tree, std::uint32_t index);
+    const_iterator(const iterator &other);
+
+    // Префиксный оператор++
+    const_iterator &operator++();
+
+    // Префиксный оператор--
+    const_iterator &operator--();
+
+    // Постфиксный оператор++
+    const_iterator operator++(int);
+
+    // Постфиксный оператор--
+    const_iterator operator--(int);
+
+    // Операторы сравнения
+    bool operator==(const const_iterator &other) const;
+    bool operator!=(const const_iterator &other) const;
+
+    // Оператор разыменования
+    reference operator*() const;
+
+    // Оператор доступа к члену
+    pointer operator->() const;
+  };
+
+  // Методы для получения итераторов
+  iterator begin();
+  iterator end();
+  const_iterator begin() const;
+  const_iterator end() const;
+
+  // Вставка уникального ключа. Возвращает позицию нового или уже
+  // существующего узла с таким ключом (тогда second == false)
+  std::pair<iterator, bool> push(const T1 &key, const T2 &data);
+  // То же, но данные строятся из args, только если ключа еще нет
+  template <typename... Args>
+  std::pair<iterator, bool> emplace(const T1 &key, Args &&...args);
+
+  iterator find(const T1 &key);
+  const_iterator find(const T1 &key) const;
+  // Первый узел с ключом не меньше key
+  iterator lower_bound(const T1 &key);
+  const_iterator lower_bound(const T1 &key) const;
+  // Первый узел с ключом больше key
+  iterator upper_bound(const T1 &key);
+  const_iterator upper_bound(const T1 &key) const;
+  bool contains(const T1 &key) const;
+
+  // Удаление по итератору и по ключу, ячейка узла уходит в список свободных
+  void erase(iterator pos);
+  size_type erase(const T1 &key);
+
+  // Методы для доступа к информации о наполнении контейнера
+  bool empty() const;
+  size_type size() const;
+  size_type max_size() const;
+
+  // Готовит место под n узлов без перевыделения массива
+  void reserve(size_type n);
+
+  /*Перекладывает узлы в порядке ключей без свободных ячеек и отдает лишнюю
+  память. После этого обход идет по массиву подряд, а сам массив можно
+  сохранить без пропусков.*/
+  void compact();
+
+  void clear();
+  void swap(IndexTree &other);
+
+  /*Проверка инвариантов за O(n), для тестов: номера отцов согласованы,
+  ключи строго возрастают, корень черный, у красного узла нет красных
+  сыновей, черная высота всех путей одинакова, а каждая ячейка массива
+  занята узлом дерева или лежит в списке свободных.*/
+  bool valid() const;
+};
+
+template <typename T1, typename T2>
+IndexTree<T1, T2>::IndexTree(
+    std::initializer_list<std::pair<T1, T2>> const &items) {
+  reserve(items.size());
+  for (const auto &item : items) push(item.first, item.second);
+}
+
+// Свободная ячейка занимается повторно, иначе массив растет на один узел
+template <typename T1, typename T2>
+template <typename... Args>
+std::uint32_t IndexTree<T1, T2>::createNode(const T1 &key, Args &&...args) {
+  if (free_head != nil) {
+    std::uint32_t index = free_head;
+    free_head = at(index).left;
+    at(index) = node_type(key, std::forward<Args>(args)...);
+    return index;
+  }
+  if (nodes.size() >= nil) throw std::length_error("IndexTree is full");
+  nodes.emplace_back(key, std::forward<Args>(args)...);
+  return std::uint32_t(nodes.size() - 1);
+}
+
+// Ячейка уходит в список свободных, а ее ключ и данные сбрасываются, чтобы
+// сразу отдать занятые ими память и ресурсы
+template <typename T1, typename T2>
+void IndexTree<T1, T2>::destroyNode(std::uint32_t index) {
+  at(index).left = free_head;
+  free_head = index;
+  at(index).key = T1();
+  at(index).data = T2();
+}
+
+// Правый сын ptr поднимается на его место
+template <typename T1, typename T2>
+void IndexTree<T1, T2>::rotateLeft(std::uint32_t ptr) {
+  std::uint32_t son = at(ptr).right;
+  at(ptr).right = at(son).left;
+  if (at(son).left != nil) at(at(son).left).setParent(ptr);
+  replaceNode(ptr, son);
+  at(son).left = ptr;
+  at(ptr).setParent(son);
+}
+
+// Левый сын ptr поднимается на его место
+template <typename T1, typename T2>
+void IndexTree<T1, T2>::rotateRight(std::uint32_t ptr) {
+  std::uint32_t son = at(ptr).left;
+  at(ptr).left = at(son).right;
+  if (at(son).right != nil) at(at(son).right).setParent(ptr);
+  replaceNode(ptr, son);
+  at(son).right = ptr;
+  at(ptr).setParent(son);
+}
+
+// Ставит child на место ptr у отца ptr
+template <typename T1, typename T2>
+void IndexTree<T1, T2>::replaceNode(std::uint32_t ptr, std::uint32_t child) {
+  std::uint32_t father = at(ptr).parent();
+  if (child != nil) at(child).setParent(father);
+  if (father == nil)
+    root = child;
+  else if (at(father).left == ptr)
+    at(father).left = child;
+  else
+    at(father).right = child;
+}
+
+// Пустой лист (nil) считается черным
+template <typename T1, typename T2>
+bool IndexTree<T1, T2>::isBlack(std::uint32_t ptr) const {
+  return ptr == nil || at(ptr).color() == BLACK;
+}
+
+// Восстановление свойств после вставки красного узла ptr
+template <typename T1, typename T2>
+void IndexTree<T1, T2>::balanceTree(std::uint32_t ptr) {
+  while (ptr != root && at(at(ptr).parent()).color() == RED) {
+    // Отец красный, значит он не корень и дед существует
+    std::uint32_t father = at(ptr).parent();
+    std::uint32_t gf = at(father).parent();
+    bool left = at(gf).left == father;
+    std::uint32_t un = left ? at(gf).right : at(gf).left;
+    if (!isBlack(un)) {
+      at(father).setColor(BLACK);
+      at(un).setColor(BLACK);
+      at(gf).setColor(RED);
+      ptr = gf;
+      continue;
+    }
+    if (ptr == (left ? at(father).right : at(father).left)) {
+      if (left)
+        rotateLeft(father);
+      else
+        rotateRight(father);
+      father = ptr;
+    }
+    at(father).setColor(BLACK);
+    at(gf).setColor(RED);
+    if (left)
+      rotateRight(gf);
+    else
+      rotateLeft(gf);
+    break;
+  }
+  at(root).setColor(BLACK);
+}
+
+/*Восстановление свойств после удаления черного узла. ptr - узел (возможно
+nil) на месте удаленного, на пути через него не хватает одного черного.*/
+template <typename T1, typename T2>
+void IndexTree<T1, T2>::eraseBalance(std::uint32_t ptr, std::uint32_t father) {
+  while (ptr != root && isBlack(ptr)) {
+    // У дважды черного узла брат всегда существует
+    bool left = at(father).left == ptr;
+    std::uint32_t brother = left ? at(father).right : at(father).left;
+    if (at(brother).color() == RED) {
+      at(brother).setColor(BLACK);
+      at(father).setColor(RED);
+      if (left)
+        rotateLeft(father);
+      else
+        rotateRight(father);
+      brother = left ? at(father).right : at(father).left;
+    }
+    std::uint32_t inner = left ? at(brother).left : at(brother).right;
+    std::uint32_t outer = left ? at(brother).right : at(brother).left;
+    if (isBlack(inner) && isBlack(outer)) {
+      at(brother).setColor(RED);
+      ptr = father;
+      father = at(ptr).parent();
+      continue;
+    }
+    if (isBlack(outer)) {
+      at(inner).setColor(BLACK);
+      at(brother).setColor(RED);
+      if (left)
+        rotateRight(brother);
+      else
+        rotateLeft(brother);
+      outer = brother;
+      brother = inner;
+    }
+    at(brother).setColor(at(father).color());
+    at(father).setColor(BLACK);
+    at(outer).setColor(BLACK);
+    if (left)
+      rotateLeft(father);
+    else
+      rotateRight(father);
+    ptr = root;
+  }
+  if (ptr != nil) at(ptr).setColor(BLACK);
+}
+
+template <typename T1, typename T2>
+void IndexTree<T1, T2>::remove(std::uint32_t ptr) {
+  std::uint32_t child, father;
+  COLOR removed = at(ptr).color();
+  if (at(ptr).left == nil || at(ptr).right == nil) {
+    child = at(ptr).left == nil ? at(ptr).right : at(ptr).left;
+    father = at(ptr).parent();
+    replaceNode(ptr, child);
+  } else {
+    // Место ptr занимает следующий по порядку узел
+    std::uint32_t next = minimum(at(ptr).right);
+    removed = at(next).color();
+    child = at(next).right;
+    if (at(next).parent() == ptr) {
+      father = next;
+    } else {
+      father = at(next).parent();
+      replaceNode(next, child);
+      at(next).right = at(ptr).right;
+      at(at(next).right).setParent(next);
+    }
+    replaceNode(ptr, next);
+    at(next).left = at(ptr).left;
+    at(at(next).left).setParent(next);
+    at(next).setColor(at(ptr).color());
+  }
+  if (removed == BLACK) eraseBalance(child, father);
+  destroyNode(ptr);
+  --tree_size;
+}
+
+template <typename T1, typename T2>
+std::uint32_t IndexTree<T1, T2>::findIndex(const T1 &key) const {
+  std::uint32_t current = root;
+  while (current != nil) {
+    if (key < at(current).key)
+      current = at(current).left;
+    else if (at(current).key < key)
+      current = at(current).right;
+    else
+      return current;
+  }
+  return nil;
+}
+
+template <typename T1, typename T2>
+std::uint32_t IndexTree<T1, T2>::lowerIndex(const T1 &key) const {
+  std::uint32_t result = nil;
+  for (std::uint32_t current = root; current != nil;) {
+    if (at(current).key < key) {
+      current = at(current).right;
+    } else {
+      result = current;
+      current = at(current).left;
+    }
+  }
+  return result;
+}
+
+template <typename T1, typename T2>
+std::uint32_t IndexTree<T1, T2>::upperIndex(const T1 &key) const {
+  std::uint32_t result = nil;
+  for (std::uint32_t current = root; current != nil;) {
+    if (key < at(current).key) {
+      result = current;
+      current = at(current).left;
+    } else {
+      current = at(current).right;
+    }
+  }
+  return result;
+}
+
+template <typename T1, typename T2>
+std::uint32_t IndexTree<T1, T2>::minimum(std::uint32_t ptr) const {
+  if (ptr == nil) return nil;
+  while (at(ptr).left != nil) ptr = at(ptr).left;
+  return ptr;
+}
+
+template <typename T1, typename T2>
+std::uint32_t IndexTree<T1, T2>::maximum(std::uint32_t ptr) const {
+  if (ptr == nil) return nil;
+  while (at(ptr).right != nil) ptr = at(ptr).right;
+  return ptr;
+}
+
+template <typename T1, typename T2>
+std::uint32_t IndexTree<T1, T2>::next(std::uint32_t ptr) const {
+  if (at(ptr).right != nil) return minimum(at(ptr).right);
+  std::uint32_t father = at(ptr).parent();
+  while (father != nil && at(father).right == ptr) {
+    ptr = father;
+    father = at(ptr).parent();
+  }
+  return father;
+}
+
+// Для end() (nil) - последний узел дерева
+template <typename T1, typename T2>
+std::uint32_t IndexTree<T1, T2>::prev(std::uint32_t ptr) const {
+  if (ptr == nil) return maximum(root);
+  if (at(ptr).left != nil) return maximum(at(ptr).left);
+  std::uint32_t father = at(ptr).parent();
+  while (father != nil && at(father).left == ptr) {
+    ptr = father;
+    father = at(ptr).parent();
+  }
+  return father;
+}
+
+template <typename T1, typename T2>
+std::pair<typename IndexTree<T1, T2>::iterator, bool> IndexTree<T1, T2>::push(
+    const T1 &key, const T2 &data) {
+  return emplace(key, data);
+}
+
+template <typename T1, typename T2>
+template <typename... Args>
+std::pair<typename IndexTree<T1, T2>::iterator, bool>
+IndexTree<T1, T2>::emplace(const T1 &key, Args &&...args) {
+  std::uint32_t father = nil;
+  bool right = false;
+  for (std::uint32_t current = root; current != nil;) {
+    father = current;
+    if (key < at(current).key) {
+      right = false;
+      current = at(current).left;
+    } else if (at(current).key < key) {
+      right = true;
+      current = at(current).right;
+    } else {
+      return {iterator(this, current), false};
+    }
+  }
+  // createNode может перевыделить массив, поэтому связи ставятся по номерам
+  std::uint32_t index = createNode(key, std::forward<Args>(args)...);
+  at(index).setParent(father);
+  if (father == nil)
+    root = index;
+  else if (right)
+    at(father).right = index;
+  else
+    at(father).left = index;
+  ++tree_size;
+  balanceTree(index);
+  return {iterator(this, index), true};
+}
+
+template <typename T1, typename T2>
+typename IndexTree<T1, T2>::iterator IndexTree<T1, T2>::find(const T1 &key) {
+  return iterator(this, findIndex(key));
+}
+
+template <typename T1, typename T2>
+typename IndexTree<T1, T2>::const_iterator IndexTree<T1, T2>::find(
+    const T1 &key) const {
+  return const_iterator(this, findIndex(key));
+}
+
+template <typename T1, typename T2>
+typename IndexTree<T1, T2>::iterator IndexTree<T1, T2>::lower_bound(
+    const T1 &key) {
+  return iterator(this, lowerIndex(key));
+}
+
+template <typename T1, typename T2>
+typename IndexTree<T1, T2>::const_iterator IndexTree<T1, T2>::lower_bound(
+    const T1 &key) const {
+  return const_iterator(this, lowerIndex(key));
+}
+
+template <typename T1, typename T2>
+typename IndexTree<T1, T2>::iterator IndexTree<T1, T2>::upper_bound(
+    const T1 &key) {
+  return iterator(this, upperIndex(key));
+}
+
+template <typename T1, typename T2>
+typename IndexTree<T1, T2>::const_iterator IndexTree<T1, T2>::upper_bound(
+    const T1 &key) const {
+  return const_iterator(this, upperIndex(key));
+}
+
+template <typename T1, typename T2>
+bool IndexTree<T1, T2>::contains(const T1 &key) const {
+  return findIndex(key) != nil;
+}
+
+template <typename T1, typename T2>
+void IndexTree<T1, T2>::erase(iterator pos) {
+  if (pos.current != nil) remove(pos.current);
+}
+
+template <typename T1, typename T2>
+typename IndexTree<T1, T2>::size_type IndexTree<T1, T2>::erase(
+    const T1 &key) {
+  std::uint32_t index = findIndex(key);
+  if (index == nil) return 0;
+  remove(index);
+  return 1;
+}
+
+template <typename T1, typename T2>
+bool IndexTree<T1, T2>::empty() const {
+  return root == nil;
+}
+
+template <typename T1, typename T2>
+typename IndexTree<T1, T2>::size_type IndexTree<T1, T2>::size() const {
+  return tree_size;
+}
+
+template <typename T1, typename T2>
+typename IndexTree<T1, T2>::size_type IndexTree<T1, T2>::max_size() const {
+  return std::min<size_type>(nil, nodes.max_size());
+}
+
+template <typename T1, typename T2>
+void IndexTree<T1, T2>::reserve(size_type n) {
+  nodes.reserve(n);
+}
+
+template <typename T1, typename T2>
+void IndexTree<T1, T2>::compact() {
+  // Новый номер каждой занятой ячейки - ее место в порядке ключей
+  std::vector<std::uint32_t> order(nodes.size(), nil);
+  std::vector<node_type> packed;
+  packed.reserve(tree_size);
+  for (std::uint32_t i = minimum(root); i != nil; i = next(i)) {
+    order[i] = std::uint32_t(packed.size());
+    packed.push_back(std::move(at(i)));
+  }
+  auto renumber = [&order](std::uint32_t index) {
+    return index == nil ? nil : order[index];
+  };
+  for (node_type &node : packed) {
+    node.left = renumber(node.left);
+    node.right = renumber(node.right);
+    node.setParent(renumber(node.parent()));
+  }
+  root = renumber(root);
+  free_head = nil;
+  nodes.swap(packed);
+}
+
+template <typename T1, typename T2>
+void IndexTree<T1, T2>::clear() {
+  nodes.clear();
+  root = nil;
+  free_head = nil;
+  tree_size = 0;
+}
+
+template <typename T1, typename T2>
+void IndexTree<T1, T2>::swap(IndexTree &other) {
+  std::swap(nodes, other.nodes);
+  std::swap(root, other.root);
+  std::swap(free_head, other.free_head);
+  std::swap(tree_size, other.tree_size);
+}
+
+template <typename T1, typename T2>
+int IndexTree<T1, T2>::checkSubtree(std::uint32_t ptr, std::uint32_t father,
+                                    std::uint32_t &previous,
+                                    size_t &count) const {
+  if (ptr == nil) return 1;
+  if (ptr >= nodes.size() || at(ptr).parent() != father) return -1;
+  if (at(ptr).color() == RED && (!isBlack(at(ptr).left) ||
+                                 !isBlack(at(ptr).right)))
+    return -1;
+  int left = checkSubtree(at(ptr).left, ptr, previous, count);
+  if (left < 0) return -1;
+  if (previous != nil && !(at(previous).key < at(ptr).key)) return -1;
+  previous = ptr;
+  // Дерево из ячеек, больше size() узлов, зациклилось бы
+  if (++count > tree_size) return -1;
+  int right = checkSubtree(at(ptr).right, ptr, previous, count);
+  if (right != left) return -1;
+  return left + (at(ptr).color() == BLACK);
+}
+
+template <typename T1, typename T2>
+bool IndexTree<T1, T2>::valid() const {
+  if (!isBlack(root)) return false;
+  std::uint32_t previous = nil;
+  size_t count = 0;
+  if (checkSubtree(root, nil, previous, count) < 0 || count != tree_size)
+    return false;
+  for (std::uint32_t i = free_head; i != nil; i = at(i).left)
+    if (i >= nodes.size() || ++count > nodes.size()) return false;
+  return count == nodes.size();
+}
+
+template <typename T1, typename T2>
+typename IndexTree<T1, T2>::iterator IndexTree<T1, T2>::begin() {
+  return iterator(this, minimum(root));
+}
+
+template <typename T1, typename T2>
+typename IndexTree<T1, T2>::iterator IndexTree<T1, T2>::end() {
+  return iterator(this, nil);
+}
+
+template <typename T1, typename T2>
+typename IndexTree<T1, T2>::const_iterator IndexTree<T1, T2>::begin() const {
+  return const_iterator(this, minimum(root));
+}
+
+template <typename T1, typename T2>
+typename IndexTree<T1, T2>::const_iterator IndexTree<T1, T2>::end() const {
+  return const_iterator(this, nil);
+}
+
+template <typename T1, typename T2>
+IndexTree<T1, T2>::iterator::iterator(IndexTree *tree, std::uint32_t index)
+    : tree(tree), current(index) {}
+
+template <typename T1, typename T2>
+typename IndexTree<T1, T2>::iterator &
+IndexTree<T1, T2>::iterator::operator++() {
+  current = tree->next(current);
+  return *this;
+}
+
+template <typename T1, typename T2>
+typename IndexTree<T1, T2>::iterator &
+IndexTree<T1, T2>::iterator::operator--() {
+  current = tree->prev(current);
+  return *this;
+}
+
+template <typename T1, typename T2>
+typename IndexTree<T1, T2>::iterator IndexTree<T1, T2>::iterator::operator++(
+    int) {
+  iterator temp = *this;
+  ++(*this);
+  return temp;
+}
+
+template <typename T1, typename T2>
+typename IndexTree<T1, T2>::iterator IndexTree<T1, T2>::iterator::operator--(
+    int) {
+  iterator temp = *this;
+  --(*this);
+  return temp;
+}
+
+template <typename T1, typename T2>
+bool IndexTree<T1, T2>::iterator::operator==(const iterator &other) const {
+  return current == other.current;
+}
+
+template <typename T1, typename T2>
+bool IndexTree<T1, T2>::iterator::operator!=(const iterator &other) const {
+  return current != other.current;
+}
+
+template <typename T1, typename T2>
+typename IndexTree<T1, T2>::iterator::reference
+IndexTree<T1, T2>::iterator::operator*() const {
+  node_type &node = tree->at(current);
+  return reference(node.key, node.data);
+}
+
+template <typename T1, typename T2>
+typename IndexTree<T1, T2>::iterator::pointer
+IndexTree<T1, T2>::iterator::operator->() const {
+  return pointer{**this};
+}
+
+template <typename T1, typename T2>
+IndexTree<T1, T2>::const_iterator::const_iterator(const IndexTree *tree,
+                                                  std::uint32_t index)
+    : tree(tree), current(index) {}
+
+template <typename T1, typename T2>
+IndexTree<T1, T2>::const_iterator::const_iterator(const iterator &other)
+    : tree(other.tree), current(other.current) {}
+
+template <typename T1, typename T2>
+typename IndexTree<T1, T2>::const_iterator &
+IndexTree<T1, T2>::const_iterator::operator++() {
+  current = tree->next(current);
+  return *this;
+}
+
+template <typename T1, typename T2>
+typename IndexTree<T1, T2>::const_iterator &
+IndexTree<T1, T2>::const_iterator::operator--() {
+  current = tree->prev(current);
+  return *this;
+}
+
+template <typename T1, typename T2>
+typename IndexTree<T1, T2>::const_iterator
+IndexTree<T1, T2>::const_iterator::operator++(int) {
+  const_iterator temp = *this;
+  ++(*this);
+  return temp;
+}
+
+template <typename T1, typename T2>
+typename IndexTree<T1, T2>::const_iterator
+IndexTree<T1, T2>::const_iterator::operator--(int) {
+  const_iterator temp = *this;
+  --(*this);
+  return temp;
+}
+
+template <typename T1, typename T2>
+bool IndexTree<T1, T2>::const_iterator::operator==(
+    const const_iterator &other) const {
+  return current == other.current;
+}
+
+template <typename T1, typename T2>
+bool IndexTree<T1, T2>::const_iterator::operator!=(
+    const const_iterator &other) const {
+  return current != other.current;
+}
+
+template <typename T1, typename T2>
+typename IndexTree<T1, T2>::const_iterator::reference
+IndexTree<T1, T2>::const_iterator::operator*() const {
+  const node_type &node = tree->at(current);
+  return reference(node.key, node.data);
+}
+
+template <typename T1, typename T2>
+typename IndexTree<T1, T2>::const_iterator::pointer
+IndexTree<T1, T2>::const_iterator::operator->() const {
+  return pointer{**this};
+}
+
+}  // namespace binary_tree
+
+#endif  // INDEX_TREE_H
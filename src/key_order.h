@@ -0,0 +1,114 @@
+#ifndef KEY_ORDER_H
+#define KEY_ORDER_H
+
+#include <functional>
+#include <type_traits>
+#include <utility>
+
+/*Сравнение ключей, общее для всех движков: binary_tree::BinaryTree и
+контейнеры над ним, rb_tree::RB_Tree, B+-дерево и массивы flat_map/flat_set
+подключают этот заголовок, поэтому правила сравнения у них одни.*/
+
+namespace binary_tree {
+
+// Прозрачный компаратор объявляет вложенный тип is_transparent
+template <typename Compare, typename = void>
+struct is_transparent : std::false_type {};
+
+template <typename Compare>
+struct is_transparent<Compare, std::void_t<typename Compare::is_transparent>>
+    : std::true_type {};
+
+// Шаблонные перегрузки поиска по ключу K включаются, как в std::map, только
+// для прозрачного компаратора. K в условии откладывает проверку до вызова
+template <typename Compare, typename K>
+using transparent_t = std::enable_if_t<
+    is_transparent<Compare>::value && !std::is_same_v<K, void>, int>;
+
+// Ключ с методом compare(), возвращающим int, как у std::string
+template <typename A, typename B, typename = void>
+struct has_compare : std::false_type {};
+
+template <typename A, typename B>
+struct has_compare<A, B,
+                   std::enable_if_t<std::is_same_v<
+                       decltype(std::declval<const A &>().compare(
+                           std::declval<const B &>())),
+                       int>>> : std::true_type {};
+
+template <typename Compare>
+struct is_std_less : std::false_type {};
+
+template <typename T>
+struct is_std_less<std::less<T>> : std::true_type {};
+
+/*Трехсторонний компаратор: знак результата говорит, меньше, равен или больше
+первый аргумент. Строки сравниваются одним проходом compare(), в C++20
+остальные типы - через <=>, иначе двумя вызовами <. Прозрачен, как
+std::less<>.*/
+struct three_way {
+  using is_transparent = void;
+
+  template <typename A, typename B>
+  int operator()(const A &a, const B &b) const {
+    if constexpr (has_compare<A, B>::value) {
+      return a.compare(b);
+    } else if constexpr (has_compare<B, A>::value) {
+      int result = b.compare(a);
+      return result > 0 ? -1 : result < 0;
+    } else {
+#if defined(__cpp_impl_three_way_comparison) && \
+    __cpp_impl_three_way_comparison >= 201907L
+      auto result = a <=> b;
+      return result < 0 ? -1 : result > 0;
+#else
+      return a < b ? -1 : b < a;
+#endif
+    }
+  }
+};
+
+/*Порядок ключей через Compare. Обычный Compare возвращает bool (a < b),
+трехсторонний - int или результат <=>, знак которого сравнивается с нулем.
+compare() дает знак за одно сравнение, если Compare трехсторонний или это
+std::less над ключом с методом compare() (std::string), иначе за два.*/
+template <typename Compare>
+struct KeyOrder {
+  template <typename A, typename B>
+  using result = decltype(std::declval<const Compare &>()(
+      std::declval<const A &>(), std::declval<const B &>()));
+
+  // Compare сам возвращает знак сравнения
+  template <typename A, typename B>
+  static constexpr bool native =
+      !std::is_same_v<std::decay_t<result<A, B>>, bool>;
+
+  // Знак доступен за одно сравнение
+  template <typename A, typename B>
+  static constexpr bool three_way =
+      native<A, B> || (is_std_less<Compare>::value && has_compare<A, B>::value);
+
+  template <typename A, typename B>
+  static bool less(const Compare &comp, const A &a, const B &b) {
+    if constexpr (native<A, B>)
+      return comp(a, b) < 0;
+    else
+      return comp(a, b);
+  }
+
+  template <typename A, typename B>
+  static int compare(const Compare &comp, const A &a, const B &b) {
+    if constexpr (native<A, B>) {
+      auto sign = comp(a, b);
+      return sign < 0 ? -1 : !(sign == 0);
+    } else if constexpr (three_way<A, B>) {
+      return a.compare(b);
+    } else {
+      return comp(a, b) ? -1 : bool(comp(b, a));
+    }
+  }
+};
+
+}  // namespace binary_tree
+
+#endif  // KEY_ORDER_H
@@ -2,17 +2,31 @@
 #define MAP_H
 
 #include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <memory_resource>
 #include <stdexcept>
+#include <type_traits>
 #include <utility>
 
 #include "binary_tree.h"
+#include "frozen_tree.h"
 
 namespace binary_tree {
 
-template <typename Key, typename T>
+/*Compare стоит после Allocator, чтобы не ломать уже написанные
+map<Key, T, Allocator>. С прозрачным компаратором (std::less<>) find,
+contains, count, lower_bound, upper_bound, equal_range и erase принимают
+любой сравнимый с Key тип без создания временного ключа. Threaded == true
+связывает узлы нитями по порядку ключей: шаг итератора становится одним
+переходом по ссылке ценой двух указателей на узел.*/
+template <typename Key, typename T,
+          typename Allocator = std::allocator<std::pair<const Key, T>>,
+          typename Compare = std::less<Key>, bool Threaded = false>
 class map {
  private:
-  BinaryTree<Key, T> tree;
+  using tree_type = BinaryTree<Key, T, Allocator, Compare, Threaded>;
+  tree_type tree;
 
  public:
   using key_type = Key;
@@ -21,23 +35,108 @@ class map {
   using reference = value_type &;
   using const_reference = const value_type &;
   using size_type = size_t;
-  using iterator = typename BinaryTree<Key, T>::iterator;
-  using const_iterator = typename BinaryTree<Key, T>::const_iterator;
+  using allocator_type = Allocator;
+  using key_compare = Compare;
+  using iterator = typename tree_type::iterator;
+  using const_iterator = typename tree_type::const_iterator;
+  using node_type = typename tree_type::node_type;
+  using insert_return_type = InsertReturn<iterator, node_type>;
 
+ private:
+  // Общие тела обычных и прозрачных перегрузок: K - либо Key, либо тип,
+  // который прозрачный компаратор сравнивает с Key напрямую
+  template <typename K>
+  iterator findKey(const K &key) {
+    Node<Key, T, Threaded> *result = tree.find(key);
+    return result ? iterator(result) : end();
+  }
+
+  template <typename K>
+  const_iterator findKey(const K &key) const {
+    Node<Key, T, Threaded> *result = tree.find(key);
+    return result ? const_iterator(result) : end();
+  }
+
+  template <typename K>
+  size_type eraseKey(const K &key) {
+    Node<Key, T, Threaded> *result = tree.find(key);
+    if (!result) return 0;
+    tree.erase(iterator(result));
+    return 1;
+  }
+
+  /*Вставки за один спуск от корня: данные строятся из args, только если
+  ключа key еще нет. Ключ и данные перемещаются в узел, если переданы как
+  rvalue.*/
+  template <typename K, typename... Args>
+  std::pair<iterator, bool> tryEmplace(K &&key, Args &&...args) {
+    bool inserted = false;
+    Node<Key, T, Threaded> *result = tree.pushUnique(
+        inserted, std::forward<K>(key), std::forward<Args>(args)...);
+    return std::make_pair(iterator(result), inserted);
+  }
+
+  // Если ключ уже есть, obj не тронут вставкой и присваивается найденному
+  template <typename K, typename M>
+  std::pair<iterator, bool> insertOrAssign(K &&key, M &&obj) {
+    bool inserted = false;
+    Node<Key, T, Threaded> *result =
+        tree.pushUnique(inserted, std::forward<K>(key), std::forward<M>(obj));
+    if (!inserted) result->data() = std::forward<M>(obj);
+    return std::make_pair(iterator(result), inserted);
+  }
+
+  // Ключи уникальны, поэтому верхняя граница - следующий за найденным узел
+  template <typename It, typename K>
+  std::pair<It, It> equalRange(It first, It end, const K &key) const {
+    It last = first;
+    if (first != end && !tree.key_less(key, first->first)) ++last;
+    return std::make_pair(first, last);
+  }
+
+ public:
   map() = default;
 
-  map(std::initializer_list<value_type> const &items) {
-    for (const auto &item : items) {
-      tree.push(item.first, item.second);
-    }
+  // Узлы берутся из распределителя alloc, например из pmr-ресурса
+  explicit map(const Allocator &alloc) : tree(alloc) {}
+
+  explicit map(const Compare &comp, const Allocator &alloc = Allocator())
+      : tree(comp, alloc) {}
+
+  map(std::initializer_list<value_type> const &items,
+      const Allocator &alloc = Allocator())
+      : tree(alloc) {
+    tree.assign_sorted(items.begin(), items.end());
+  }
+
+  // Конструктор из диапазона пар, упорядоченный вход собирается за O(n)
+  template <typename InputIt, typename = typename std::iterator_traits<
+                                  InputIt>::iterator_category>
+  map(InputIt first, InputIt last, const Allocator &alloc = Allocator())
+      : tree(alloc) {
+    tree.assign_sorted(first, last);
   }
 
   map(const map &other) : tree(other.tree) {}
 
+  map(const map &other, const Allocator &alloc) : tree(other.tree, alloc) {}
+
   map(map &&other) noexcept : tree(std::move(other.tree)) {}
 
   ~map() = default;
 
+  allocator_type get_allocator() const { return tree.get_allocator(); }
+  key_compare key_comp() const { return tree.key_comp(); }
+
+  // Запас памяти под n новых узлов, если узлы берутся из slab_allocator
+  void reserve(size_type n) { tree.reserve(n); }
+
+  // Неизменяемый снимок для чтения с поиском по массиву в порядке Эйтцингера
+  // с тем же порядком ключей Compare
+  FrozenTree<Key, T, Compare> freeze() const {
+    return FrozenTree<Key, T, Compare>(tree);
+  }
+
   map &operator=(const map &other) {
     if (this != &other) {
       tree = other.tree;
@@ -45,36 +144,32 @@ class map {
     return *this;
   }
 
-  map &operator=(map &&other) noexcept {
+  map &operator=(map &&other) noexcept(
+      std::is_nothrow_move_assignable_v<tree_type>) {
     tree = std::move(other.tree);
     return *this;
   }
 
   T &at(const Key &key) {
-    Node<Key, T> *result = tree.find(key);
+    Node<Key, T, Threaded> *result = tree.find(key);
     if (!result) throw std::out_of_range("Key not found");
-    return result->data;
+    return result->data();
   }
 
   const T &at(const Key &key) const {
-    Node<Key, T> *result = tree.find(key);
+    Node<Key, T, Threaded> *result = tree.find(key);
     if (!result) throw std::out_of_range("Key not found");
-    return result->data;
+    return result->data();
   }
 
-  T &operator[](const Key &key) {
-    Node<Key, T> *result = tree.find(key);
-    if (!result) {
-      tree.push(key, T());
-      result = tree.find(key);
-    }
-    return result->data;
-  }
+  T &operator[](const Key &key) { return tryEmplace(key).first->second; }
+
+  T &operator[](Key &&key) { return tryEmplace(std::move(key)).first->second; }
 
   const T &operator[](const Key &key) const {
-    Node<Key, T> *result = tree.find(key);
+    Node<Key, T, Threaded> *result = tree.find(key);
     if (!result) throw std::out_of_range("Key not found");
-    return result->data;
+    return result->data();
   }
 
   iterator begin() { return tree.begin(); }
@@ -82,35 +177,139 @@ class map {
   const_iterator begin() const { return tree.begin(); }
   const_iterator end() const { return tree.end(); }
 
+  /*Обход по возрастанию ключей с предвыборкой узлов на distance шагов
+  вперед; visit получает ссылку на пару (ключ, значение).*/
+  template <typename Visit>
+  void for_each(Visit visit,
+                size_type distance = tree_type::prefetch_distance) {
+    tree.for_each(visit, distance);
+  }
+  template <typename Visit>
+  void for_each(Visit visit,
+                size_type distance = tree_type::prefetch_distance) const {
+    tree.for_each(visit, distance);
+  }
+
   bool empty() const { return tree.empty(); }
   size_type size() const { return tree.size(); }
   size_type max_size() const { return tree.max_size(); }
 
   void clear() { tree.clear(); }
 
+  // Заменяет содержимое диапазоном пар, для упорядоченного входа за O(n)
+  template <typename InputIt>
+  void assign_sorted(InputIt first, InputIt last) {
+    tree.assign_sorted(first, last);
+  }
+
   std::pair<iterator, bool> insert(const value_type &value) {
-    Node<Key, T> *result = tree.find(value.first);
-    if (result) {
-      return std::make_pair(iterator(result), false);
-    }
-    tree.push(value.first, value.second);
-    result = tree.find(value.first);
-    return std::make_pair(iterator(result), true);
+    return tryEmplace(value.first, value.second);
+  }
+
+  // Ключ value_type константен и копируется, данные перемещаются
+  std::pair<iterator, bool> insert(value_type &&value) {
+    return tryEmplace(value.first, std::move(value.second));
+  }
+
+  // Пара другого типа, например std::pair<Key, T>, перемещается целиком
+  template <typename P, typename = std::enable_if_t<
+                            std::is_constructible_v<value_type, P &&>>>
+  std::pair<iterator, bool> insert(P &&value) {
+    return emplace(std::forward<P>(value));
   }
 
   std::pair<iterator, bool> insert(const Key &key, const T &obj) {
-    return insert(std::make_pair(key, obj));
+    return tryEmplace(key, obj);
   }
 
-  std::pair<iterator, bool> insert_or_assign(const Key &key, const T &obj) {
-    Node<Key, T> *result = tree.find(key);
-    if (result) {
-      result->data = obj;
-      return std::make_pair(iterator(result), false);
-    }
-    tree.push(key, obj);
-    result = tree.find(key);
-    return std::make_pair(iterator(result), true);
+  // Вставка с подсказкой: при верной подсказке без спуска от корня
+  iterator insert(const_iterator hint, const value_type &value) {
+    bool inserted = false;
+    return iterator(tree.pushHint(hint.node(), inserted, value.first,
+                                  value.second));
+  }
+
+  iterator insert(const_iterator hint, value_type &&value) {
+    bool inserted = false;
+    return iterator(tree.pushHint(hint.node(), inserted, value.first,
+                                  std::move(value.second)));
+  }
+
+  /*Элемент собирается из args во временной паре, затем ключ и данные
+  перемещаются в узел. Если ключ уже есть, пара просто удаляется.*/
+  template <typename... Args>
+  std::pair<iterator, bool> emplace(Args &&...args) {
+    std::pair<Key, T> value(std::forward<Args>(args)...);
+    return tryEmplace(std::move(value.first), std::move(value.second));
+  }
+
+  template <typename... Args>
+  iterator emplace_hint(const_iterator hint, Args &&...args) {
+    std::pair<Key, T> value(std::forward<Args>(args)...);
+    bool inserted = false;
+    return iterator(tree.pushHint(hint.node(), inserted,
+                                  std::move(value.first),
+                                  std::move(value.second)));
+  }
+
+  // Данные строятся из args прямо в узле и только если ключа еще нет
+  template <typename... Args>
+  std::pair<iterator, bool> try_emplace(const Key &key, Args &&...args) {
+    return tryEmplace(key, std::forward<Args>(args)...);
+  }
+
+  template <typename... Args>
+  std::pair<iterator, bool> try_emplace(Key &&key, Args &&...args) {
+    return tryEmplace(std::move(key), std::forward<Args>(args)...);
+  }
+
+  template <typename... Args>
+  iterator try_emplace(const_iterator hint, const Key &key, Args &&...args) {
+    bool inserted = false;
+    return iterator(tree.pushHint(hint.node(), inserted, key,
+                                  std::forward<Args>(args)...));
+  }
+
+  template <typename... Args>
+  iterator try_emplace(const_iterator hint, Key &&key, Args &&...args) {
+    bool inserted = false;
+    return iterator(tree.pushHint(hint.node(), inserted, std::move(key),
+                                  std::forward<Args>(args)...));
+  }
+
+  template <typename M>
+  std::pair<iterator, bool> insert_or_assign(const Key &key, M &&obj) {
+    return insertOrAssign(key, std::forward<M>(obj));
+  }
+
+  template <typename M>
+  std::pair<iterator, bool> insert_or_assign(Key &&key, M &&obj) {
+    return insertOrAssign(std::move(key), std::forward<M>(obj));
+  }
+
+  /*Node handle: extract вынимает элемент вместе с узлом, insert вставляет
+  его обратно в этот или другой map. При равных распределителях узел
+  только перевешивается, без выделения памяти и копирования. Если ключ уже
+  есть, узел возвращается в поле node результата.*/
+  node_type extract(const_iterator pos) {
+    return tree.extract(const_cast<Node<Key, T, Threaded> *>(pos.node()));
+  }
+
+  node_type extract(const Key &key) { return tree.extract(tree.find(key)); }
+
+  insert_return_type insert(node_type &&handle) {
+    bool inserted = false;
+    Node<Key, T, Threaded> *result = tree.pushNode(handle, inserted);
+    if (!result) return {end(), false, node_type()};
+    if (!inserted) return {iterator(result), false, std::move(handle)};
+    return {iterator(result), true, node_type()};
+  }
+
+  // Подсказка не используется: узел вставляется обычным спуском
+  iterator insert(const_iterator, node_type &&handle) {
+    bool inserted = false;
+    Node<Key, T, Threaded> *result = tree.pushNode(handle, inserted);
+    return result ? iterator(result) : end();
   }
 
   void erase(iterator pos) {
@@ -118,23 +317,166 @@ class map {
     tree.erase(pos);
   }
 
+  size_type erase(const Key &key) { return eraseKey(key); }
+
+  template <typename K, transparent_t<Compare, K> = 0>
+  size_type erase(const K &key) {
+    return eraseKey(key);
+  }
+
   void swap(map &other) { tree.swap(other.tree); }
 
   void merge(map &other) { tree.merge(other.tree); }
 
-  bool contains(const Key &key) { return tree.contains(key); }
+  /*Операции над множествами за O(m log(n/m + 1)), m <= n - размеры
+  контейнеров. Результат остается в *this, узлы other переходят в него или
+  удаляются, other становится пустым. Для общих ключей остаются значения
+  из *this.*/
+  void set_union(map &other) { tree.set_union(other.tree); }
+  void set_intersection(map &other) { tree.set_intersection(other.tree); }
+  void set_difference(map &other) { tree.set_difference(other.tree); }
+  void symmetric_difference(map &other) {
+    tree.symmetric_difference(other.tree);
+  }
+
+  // Разрезание и склейка за O(log n) без копирования узлов: split оставляет
+  // ключи меньше key и возвращает остальные, join забирает все ключи other.
+  // Если диапазоны ключей пересекаются, join работает как set_union
+  map split(const Key &key) {
+    map result(get_allocator());
+    result.tree = tree.split(key);
+    return result;
+  }
+
+  void join(map &other) { tree.join(other.tree); }
+
+  bool contains(const Key &key) const { return tree.contains(key); }
+
+  template <typename K, transparent_t<Compare, K> = 0>
+  bool contains(const K &key) const {
+    return tree.contains(key);
+  }
+
+  size_type count(const Key &key) const { return tree.contains(key); }
+
+  template <typename K, transparent_t<Compare, K> = 0>
+  size_type count(const K &key) const {
+    return tree.contains(key);
+  }
 
   void print_tree() { tree.print(); }
 
-  iterator find(const Key &key) {
-    Node<Key, Key> *result = tree.find(key);
-    if (result) {
-      return iterator(result);
-    }
-    return end();
+  // Проверка инвариантов дерева, O(n)
+  bool valid() const { return tree.valid(); }
+
+  // Порядковые статистики за O(log n)
+  iterator nth(size_type k) {
+    Node<Key, T, Threaded> *result = tree.nth(k);
+    return result ? iterator(result) : end();
+  }
+
+  size_type rank(const Key &key) const { return tree.rank(key); }
+
+  size_type count_range(const Key &lo, const Key &hi) const {
+    return tree.count_range(lo, hi);
+  }
+
+  iterator find(const Key &key) { return findKey(key); }
+
+  const_iterator find(const Key &key) const { return findKey(key); }
+
+  template <typename K, transparent_t<Compare, K> = 0>
+  iterator find(const K &key) {
+    return findKey(key);
+  }
+
+  template <typename K, transparent_t<Compare, K> = 0>
+  const_iterator find(const K &key) const {
+    return findKey(key);
+  }
+
+  // Границы диапазонов за один спуск по дереву, O(log n)
+  iterator lower_bound(const Key &key) {
+    return iterator(tree.lower_bound(key));
   }
+
+  const_iterator lower_bound(const Key &key) const {
+    return const_iterator(tree.lower_bound(key));
+  }
+
+  template <typename K, transparent_t<Compare, K> = 0>
+  iterator lower_bound(const K &key) {
+    return iterator(tree.lower_bound(key));
+  }
+
+  template <typename K, transparent_t<Compare, K> = 0>
+  const_iterator lower_bound(const K &key) const {
+    return const_iterator(tree.lower_bound(key));
+  }
+
+  iterator upper_bound(const Key &key) {
+    return iterator(tree.upper_bound(key));
+  }
+
+  const_iterator upper_bound(const Key &key) const {
+    return const_iterator(tree.upper_bound(key));
+  }
+
+  template <typename K, transparent_t<Compare, K> = 0>
+  iterator upper_bound(const K &key) {
+    return iterator(tree.upper_bound(key));
+  }
+
+  template <typename K, transparent_t<Compare, K> = 0>
+  const_iterator upper_bound(const K &key) const {
+    return const_iterator(tree.upper_bound(key));
+  }
+
+  std::pair<iterator, iterator> equal_range(const Key &key) {
+    return equalRange(lower_bound(key), end(), key);
+  }
+
+  std::pair<const_iterator, const_iterator> equal_range(const Key &key) const {
+    return equalRange(lower_bound(key), end(), key);
+  }
+
+  template <typename K, transparent_t<Compare, K> = 0>
+  std::pair<iterator, iterator> equal_range(const K &key) {
+    return equalRange(lower_bound(key), end(), key);
+  }
+
+  template <typename K, transparent_t<Compare, K> = 0>
+  std::pair<const_iterator, const_iterator> equal_range(const K &key) const {
+    return equalRange(lower_bound(key), end(), key);
+  }
+
+  // Наибольший ключ, не больше key, или end()
+  iterator floor(const Key &key) { return iterator(tree.floor(key)); }
+
+  const_iterator floor(const Key &key) const {
+    return const_iterator(tree.floor(key));
+  }
+
+  // Наименьший ключ, не меньше key, или end()
+  iterator ceiling(const Key &key) { return lower_bound(key); }
+
+  const_iterator ceiling(const Key &key) const { return lower_bound(key); }
 };
 
+namespace pmr {
+// Словарь, узлы которого живут в std::pmr::memory_resource
+template <typename Key, typename T, typename Compare = std::less<Key>>
+using map = binary_tree::map<
+    Key, T, std::pmr::polymorphic_allocator<std::pair<const Key, T>>, Compare>;
+}  // namespace pmr
+
+namespace threaded {
+// Словарь с нитями между соседними узлами
+template <typename Key, typename T, typename Compare = std::less<Key>>
+using map = binary_tree::map<Key, T, std::allocator<std::pair<const Key, T>>,
+                             Compare, true>;
+}  // namespace threaded
+
 }  // namespace binary_tree
 
 #endif  // MAP_H
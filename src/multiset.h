@@ -1,161 +1,392 @@
 #ifndef MULTISET_H
 #define MULTISET_H
 
+#include <algorithm>
 #include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <memory_resource>
 #include <utility>
 
 #include "binary_tree.h"
 
 namespace binary_tree {
 
-template <typename Key>
+/*Мультимножество хранит один узел на каждый различный ключ, а в поле data
+узла - число его повторов. Поэтому insert, count, erase и equal_range
+работают за O(log n) при любом количестве дубликатов, а память зависит
+только от числа различных ключей. Итератор помнит узел и номер повтора
+внутри узла, так что при обходе каждый дубликат выдается отдельно.*/
+template <typename Key, typename Allocator = std::allocator<Key>,
+          typename Compare = std::less<Key>, bool Threaded = false>
 class multiset {
- private:
-  BinaryTree<Key, Key> tree;
-
  public:
   using key_type = Key;
   using value_type = Key;
   using reference = value_type &;
   using const_reference = const value_type &;
   using size_type = size_t;
+  using allocator_type = Allocator;
+  using key_compare = Compare;
+  using value_compare = Compare;
+
+ private:
+  using tree_type = BinaryTree<Key, size_type, Allocator, Compare, Threaded>;
+  tree_type tree;
+  size_type multiset_size = 0;
+
+  // Пересчет размеров после операций над множествами
+  void recount(multiset &other) {
+    multiset_size = tree.size();
+    other.multiset_size = 0;
+  }
 
+ public:
   class MultisetIterator {
    private:
-    typename BinaryTree<Key, Key>::iterator it;
+    typename tree_type::iterator it;
+    size_type index = 0;
 
    public:
-    MultisetIterator(typename BinaryTree<Key, Key>::iterator iter) : it(iter) {}
+    using iterator_category = std::bidirectional_iterator_tag;
+    using value_type = Key;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const Key *;
+    using reference = const Key &;
+
+    MultisetIterator(typename tree_type::iterator iter, size_type index = 0)
+        : it(iter), index(index) {}
 
     // Оператор разыменования
-    key_type operator*() const {
-      return it->key;  // Возвращаем только ключ
-    }
+    // Все копии ключа ссылаются на один и тот же узел
+    reference operator*() const { return it.node()->key(); }
+
+    pointer operator->() const { return &it.node()->key(); }
 
     // Операторы сравнения
     bool operator==(const MultisetIterator &other) const {
-      return it == other.it;
+      return it == other.it && index == other.index;
     }
     bool operator!=(const MultisetIterator &other) const {
-      return it != other.it;
+      return !(*this == other);
     }
     bool operator>(const MultisetIterator &other) const {
-      return it > other.it;
+      return it > other.it || (it == other.it && index > other.index);
     }
     bool operator<(const MultisetIterator &other) const {
-      return it < other.it;
+      return it < other.it || (it == other.it && index < other.index);
     }
 
     // Префиксный оператор++
     MultisetIterator &operator++() {
-      ++it;
+      if (index + 1 < it.node()->data()) {
+        ++index;
+      } else {
+        ++it;
+        index = 0;
+      }
       return *this;
     }
 
     // Постфиксный оператор++
     MultisetIterator operator++(int) {
       MultisetIterator temp = *this;
-      ++it;
+      ++(*this);
       return temp;
     }
 
     // Префиксный оператор--
     MultisetIterator &operator--() {
-      --it;
+      if (index > 0) {
+        --index;
+      } else {
+        --it;
+        index = it.node()->data() - 1;
+      }
       return *this;
     }
 
     // Постфиксный оператор--
     MultisetIterator operator--(int) {
       MultisetIterator temp = *this;
-      --it;
+      --(*this);
       return temp;
     }
 
-    // Метод для получения итератора
-    typename BinaryTree<Key, Key>::iterator getIterator() const { return it; }
+    // Сдвиг на k элементов вперед за O(log n)
+    MultisetIterator operator+(size_type k) const {
+      if (it.node() == nullptr) return *this;
+      size_type offset = 0;
+      Node<Key, size_type, Threaded> *node =
+          tree_type::advance(it.node(), index + k, offset);
+      return MultisetIterator(node, offset);
+    }
+
+    // Методы для получения итератора по узлам и номера повтора
+    typename tree_type::iterator getIterator() const { return it; }
+    size_type getIndex() const { return index; }
   };
 
   class MultisetConstIterator {
    private:
-    typename BinaryTree<Key, Key>::const_iterator it;
+    typename tree_type::const_iterator it;
+    size_type index = 0;
 
    public:
-    MultisetConstIterator(typename BinaryTree<Key, Key>::const_iterator iter)
-        : it(iter) {}
+    using iterator_category = std::bidirectional_iterator_tag;
+    using value_type = Key;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const Key *;
+    using reference = const Key &;
+
+    MultisetConstIterator(typename tree_type::const_iterator iter,
+                          size_type index = 0)
+        : it(iter), index(index) {}
+    MultisetConstIterator(const MultisetIterator &other)
+        : it(other.getIterator()), index(other.getIndex()) {}
 
     // Оператор разыменования
-    const key_type operator*() const {
-      return it->key;  // Возвращаем только ключ
-    }
+    // Все копии ключа ссылаются на один и тот же узел
+    reference operator*() const { return it.node()->key(); }
+
+    pointer operator->() const { return &it.node()->key(); }
 
     // Операторы сравнения
     bool operator==(const MultisetConstIterator &other) const {
-      return it == other.it;
+      return it == other.it && index == other.index;
     }
     bool operator!=(const MultisetConstIterator &other) const {
-      return it != other.it;
+      return !(*this == other);
     }
     bool operator>(const MultisetConstIterator &other) const {
-      return it > other.it;
+      return it > other.it || (it == other.it && index > other.index);
     }
     bool operator<(const MultisetConstIterator &other) const {
-      return it < other.it;
+      return it < other.it || (it == other.it && index < other.index);
     }
 
     // Префиксный оператор++
     MultisetConstIterator &operator++() {
-      ++it;
+      if (index + 1 < it.node()->data()) {
+        ++index;
+      } else {
+        ++it;
+        index = 0;
+      }
       return *this;
     }
 
     // Постфиксный оператор++
     MultisetConstIterator operator++(int) {
       MultisetConstIterator temp = *this;
-      ++it;
+      ++(*this);
       return temp;
     }
 
     // Префиксный оператор--
     MultisetConstIterator &operator--() {
-      --it;
+      if (index > 0) {
+        --index;
+      } else {
+        --it;
+        index = it.node()->data() - 1;
+      }
       return *this;
     }
 
     // Постфиксный оператор--
     MultisetConstIterator operator--(int) {
       MultisetConstIterator temp = *this;
-      --it;
+      --(*this);
       return temp;
     }
+
+    // Сдвиг на k элементов вперед за O(log n)
+    MultisetConstIterator operator+(size_type k) const {
+      if (it.node() == nullptr) return *this;
+      size_type offset = 0;
+      const Node<Key, size_type, Threaded> *node =
+          tree_type::advance(it.node(), index + k, offset);
+      return MultisetConstIterator(node, offset);
+    }
+
+    // Метод для получения итератора по узлам
+    typename tree_type::const_iterator getIterator() const { return it; }
+  };
+
+  /*Node handle с одним элементом. Узел дерева хранит еще и счетчик
+  повторов, но наружу он не отдается: handle всегда несет ровно одну копию
+  ключа, и вставка добавляет ровно один элемент.*/
+  class MultisetNode {
+   private:
+    typename tree_type::node_type handle;
+    friend class multiset;
+
+    explicit MultisetNode(typename tree_type::node_type &&handle)
+        : handle(std::move(handle)) {}
+
+   public:
+    using key_type = Key;
+    using value_type = Key;
+    using allocator_type = Allocator;
+
+    MultisetNode() = default;
+
+    bool empty() const { return handle.empty(); }
+    explicit operator bool() const { return !handle.empty(); }
+    allocator_type get_allocator() const { return handle.get_allocator(); }
+
+    // Вне дерева ключ можно изменить перед вставкой
+    value_type &value() const { return handle.key(); }
+
+    void swap(MultisetNode &other) noexcept { handle.swap(other.handle); }
   };
 
   using iterator = MultisetIterator;
   using const_iterator = MultisetConstIterator;
+  using node_type = MultisetNode;
+
+ private:
+  // Общие тела обычных и прозрачных перегрузок: K - либо Key, либо тип,
+  // который прозрачный компаратор сравнивает с Key напрямую
+  template <typename K>
+  iterator findKey(const K &key) {
+    Node<Key, size_type, Threaded> *result = tree.find(key);
+    return result ? iterator(result) : end();
+  }
+
+  template <typename K>
+  const_iterator findKey(const K &key) const {
+    Node<Key, size_type, Threaded> *result = tree.find(key);
+    return result ? const_iterator(result) : end();
+  }
+
+  template <typename K>
+  size_type countKey(const K &key) const {
+    Node<Key, size_type, Threaded> *node = tree.find(key);
+    return node ? node->data() : 0;
+  }
+
+  template <typename K>
+  size_type eraseKey(const K &key) {
+    Node<Key, size_type, Threaded> *node = tree.find(key);
+    if (!node) return 0;
+    size_type result = node->data();
+    tree.remove(node);
+    multiset_size -= result;
+    return result;
+  }
+
+  // Новый дубликат встает в конец своей серии, как в std::multiset. Один
+  // спуск от корня, узел создается только для нового ключа
+  template <typename K>
+  iterator insertKey(K &&value) {
+    bool inserted = false;
+    Node<Key, size_type, Threaded> *node =
+        tree.pushUnique(inserted, std::forward<K>(value), size_type(1));
+    if (!inserted) {
+      ++node->data();
+      tree.addWeight(node, 1);
+    }
+    ++multiset_size;
+    return iterator(node, node->data() - 1);
+  }
+
+  template <typename K>
+  iterator insertKey(const_iterator hint, K &&value) {
+    bool inserted = false;
+    Node<Key, size_type, Threaded> *node = tree.pushHint(
+        hint.getIterator().node(), inserted, std::forward<K>(value), 1);
+    if (!inserted) {
+      ++node->data();
+      tree.addWeight(node, 1);
+    }
+    ++multiset_size;
+    return iterator(node, node->data() - 1);
+  }
+
+  node_type extractNode(Node<Key, size_type, Threaded> *node) {
+    --multiset_size;
+    if (node->data() == 1) return node_type(tree.extract(node));
+    --node->data();
+    tree.addWeight(node, -1);
+    return node_type(tree.makeNode(node->key(), size_type(1)));
+  }
+
+  // Все повторы ключа лежат в одном узле, поэтому диапазон равных
+  // элементов заканчивается на следующем узле
+  template <typename It, typename NodeIt, typename K>
+  std::pair<It, It> equalRange(NodeIt first, NodeIt end, const K &key) const {
+    NodeIt last = first;
+    if (first != end && !tree.key_less(key, first->first)) ++last;
+    return std::make_pair(It(first), It(last));
+  }
+
+ public:
 
   // Конструктор по умолчанию
   multiset() = default;
 
+  // Узлы берутся из распределителя alloc, например из pmr-ресурса
+  explicit multiset(const Allocator &alloc) : tree(alloc) {}
+
+  explicit multiset(const Compare &comp, const Allocator &alloc = Allocator())
+      : tree(comp, alloc) {}
+
   // Конструктор со списком инициализации
-  multiset(std::initializer_list<value_type> const &items) {
-    for (const auto &item : items) {
-      tree.push(item, item);
-    }
+  multiset(std::initializer_list<value_type> const &items,
+           const Allocator &alloc = Allocator())
+      : tree(alloc) {
+    assign_sorted(items.begin(), items.end());
+  }
+
+  // Конструктор из диапазона, упорядоченный вход собирается за O(n)
+  template <typename InputIt, typename = typename std::iterator_traits<
+                                  InputIt>::iterator_category>
+  multiset(InputIt first, InputIt last, const Allocator &alloc = Allocator())
+      : tree(alloc) {
+    assign_sorted(first, last);
   }
 
   // Конструктор копирования
-  multiset(const multiset &ms) : tree(ms.tree) {}
+  multiset(const multiset &ms)
+      : tree(ms.tree), multiset_size(ms.multiset_size) {}
+
+  multiset(const multiset &ms, const Allocator &alloc)
+      : tree(ms.tree, alloc), multiset_size(ms.multiset_size) {}
 
   // Конструктор перемещения
-  multiset(multiset &&ms) noexcept : tree(std::move(ms.tree)) {}
+  multiset(multiset &&ms) noexcept
+      : tree(std::move(ms.tree)), multiset_size(ms.multiset_size) {
+    ms.multiset_size = 0;
+  }
 
   // Деструктор
   ~multiset() = default;
 
+  allocator_type get_allocator() const { return tree.get_allocator(); }
+  key_compare key_comp() const { return tree.key_comp(); }
+  value_compare value_comp() const { return tree.key_comp(); }
+
+  // Запас памяти под n новых узлов, если узлы берутся из slab_allocator
+  void reserve(size_type n) { tree.reserve(n); }
+
+  // Оператор присваивания копированием
+  multiset &operator=(const multiset &ms) {
+    if (this != &ms) {
+      tree = ms.tree;
+      multiset_size = ms.multiset_size;
+    }
+    return *this;
+  }
+
   // Оператор присваивания перемещением
-  multiset &operator=(multiset &&ms) noexcept {
+  multiset &operator=(multiset &&ms) noexcept(
+      std::is_nothrow_move_assignable_v<tree_type>) {
     if (this != &ms) {
       tree = std::move(ms.tree);
+      multiset_size = ms.multiset_size;
+      ms.multiset_size = 0;
     }
     return *this;
   }
@@ -167,71 +398,328 @@ class multiset {
   const_iterator end() const { return const_iterator(tree.end()); }
 
   // Методы для проверки состояния контейнера
-  bool empty() const { return tree.empty(); }
-  size_type size() const { return tree.size(); }
+  bool empty() const { return multiset_size == 0; }
+  size_type size() const { return multiset_size; }
   size_type max_size() const { return tree.max_size(); }
 
   // Методы для изменения контейнера
-  void clear() { tree.clear(); }
+  void clear() {
+    tree.clear();
+    multiset_size = 0;
+  }
 
-  iterator insert(const value_type &value) {
-    tree.push(value, value);
-    return iterator(tree.find(value));
+  // Заменяет содержимое диапазоном, для упорядоченного входа за O(n).
+  // Равные ключи сворачиваются в счетчик одного узла
+  template <typename InputIt>
+  void assign_sorted(InputIt first, InputIt last) {
+    size_type count = 0;
+    tree.assign_sorted(
+        first, last,
+        [&count](const value_type &value) {
+          ++count;
+          return std::pair<Key, size_type>(value, 1);
+        },
+        [](size_type &repeats, const size_type &more) {
+          repeats += more;
+          return more;
+        });
+    multiset_size = count;
   }
 
-  void erase(iterator pos) { tree.erase(pos.getIterator()); }
+  iterator insert(const value_type &value) { return insertKey(value); }
 
-  void swap(multiset &other) { tree.swap(other.tree); }
+  iterator insert(value_type &&value) { return insertKey(std::move(value)); }
 
-  void merge(multiset &other) { tree.merge(other.tree); }
+  // Вставка с подсказкой: при верной подсказке без спуска от корня
+  iterator insert(const_iterator hint, const value_type &value) {
+    return insertKey(hint, value);
+  }
 
-  // Методы для просмотра контейнера
-  size_type count(const Key &key) const {
-    size_type count = 0;
-    for (auto it = tree.begin(); it != tree.end(); ++it) {
-      if (it->key == key) {
-        ++count;
-      }
-    }
-    return count;
+  iterator insert(const_iterator hint, value_type &&value) {
+    return insertKey(hint, std::move(value));
+  }
+
+  template <typename... Args>
+  iterator emplace(Args &&...args) {
+    return insertKey(value_type(std::forward<Args>(args)...));
+  }
+
+  template <typename... Args>
+  iterator emplace_hint(const_iterator hint, Args &&...args) {
+    return insertKey(hint, value_type(std::forward<Args>(args)...));
   }
 
-  iterator find(const Key &key) {
-    Node<Key, Key> *result = tree.find(key);
-    if (result) {
-      return iterator(result);
+  /*Node handle. Повторы ключа хранятся в одном узле, поэтому extract
+  вынимает сам узел, только если элемент в нем единственный; иначе счетчик
+  уменьшается, а handle получает новый узел. insert забирает узел из
+  handle, а для уже имеющегося ключа увеличивает его счетчик на один и
+  освобождает узел handle.*/
+  node_type extract(const_iterator pos) {
+    if (pos == end()) return node_type();
+    return extractNode(const_cast<Node<Key, size_type, Threaded> *>(
+        pos.getIterator().node()));
+  }
+
+  node_type extract(const Key &key) {
+    Node<Key, size_type, Threaded> *node = tree.find(key);
+    return node ? extractNode(node) : node_type();
+  }
+
+  iterator insert(node_type &&handle) {
+    if (handle.empty()) return end();
+    bool inserted = false;
+    Node<Key, size_type, Threaded> *node =
+        tree.pushNode(handle.handle, inserted);
+    if (!inserted) {
+      ++node->data();
+      tree.addWeight(node, 1);
+      handle = node_type();
     }
-    return end();
+    ++multiset_size;
+    return iterator(node, node->data() - 1);
+  }
+
+  // Подсказка не используется: узел вставляется обычным спуском
+  iterator insert(const_iterator, node_type &&handle) {
+    return insert(std::move(handle));
+  }
+
+  // Удаляет один элемент, на который указывает итератор
+  void erase(iterator pos) {
+    if (pos == end()) return;
+    auto it = pos.getIterator();
+    if (it.node()->data() > 1) {
+      --it.node()->data();
+      tree.addWeight(it.node(), -1);
+    } else
+      tree.erase(it);
+    --multiset_size;
+  }
+
+  // Удаляет все элементы с ключом key, возвращает их количество
+  size_type erase(const Key &key) { return eraseKey(key); }
+
+  template <typename K, transparent_t<Compare, K> = 0>
+  size_type erase(const K &key) {
+    return eraseKey(key);
+  }
+
+  void swap(multiset &other) {
+    tree.swap(other.tree);
+    std::swap(multiset_size, other.multiset_size);
+  }
+
+  // Счетчики совпадающих ключей складываются, узлы не дублируются
+  void merge(multiset &other) {
+    if (this == &other) return;
+    tree.set_union(other.tree, [](size_type &repeats, const size_type &more) {
+      return repeats += more;
+    });
+    multiset_size += other.multiset_size;
+    other.multiset_size = 0;
+  }
+
+  /*Операции над мультимножествами за O(m log(n/m + 1)), m и n - число
+  разных ключей. Как в std::set_union и соседних алгоритмах, ключ входит
+  в результат max(a, b), min(a, b), a - b или |a - b| раз, где a и b - его
+  повторы в *this и other. Узлы other переходят в *this или удаляются,
+  other становится пустым.*/
+  void set_union(multiset &other) {
+    tree.set_union(other.tree, [](size_type &repeats, const size_type &more) {
+      return repeats = std::max(repeats, more);
+    });
+    recount(other);
+  }
+
+  void set_intersection(multiset &other) {
+    tree.set_intersection(other.tree,
+                          [](size_type &repeats, const size_type &more) {
+                            return repeats = std::min(repeats, more);
+                          });
+    recount(other);
+  }
+
+  void set_difference(multiset &other) {
+    tree.set_difference(other.tree,
+                        [](size_type &repeats, const size_type &more) {
+                          return repeats = repeats > more ? repeats - more : 0;
+                        });
+    recount(other);
+  }
+
+  void symmetric_difference(multiset &other) {
+    tree.symmetric_difference(
+        other.tree, [](size_type &repeats, const size_type &more) {
+          return repeats = repeats > more ? repeats - more : more - repeats;
+        });
+    recount(other);
+  }
+
+  // Разрезание и склейка за O(log n) без копирования узлов: split оставляет
+  // элементы меньше key и возвращает остальные, join забирает все элементы
+  // other. Повторы общего ключа на стыке складываются в один узел
+  multiset split(const Key &key) {
+    multiset result(get_allocator());
+    result.tree = tree.split(key);
+    multiset_size = tree.size();
+    result.multiset_size = result.tree.size();
+    return result;
+  }
+
+  void join(multiset &other) {
+    if (this == &other) return;
+    tree.join(other.tree, [](size_type &repeats, const size_type &more) {
+      return repeats += more;
+    });
+    recount(other);
+  }
+
+  // Методы для просмотра контейнера
+  size_type count(const Key &key) const { return countKey(key); }
+
+  template <typename K, transparent_t<Compare, K> = 0>
+  size_type count(const K &key) const {
+    return countKey(key);
+  }
+
+  iterator find(const Key &key) { return findKey(key); }
+
+  const_iterator find(const Key &key) const { return findKey(key); }
+
+  template <typename K, transparent_t<Compare, K> = 0>
+  iterator find(const K &key) {
+    return findKey(key);
+  }
+
+  template <typename K, transparent_t<Compare, K> = 0>
+  const_iterator find(const K &key) const {
+    return findKey(key);
   }
 
   bool contains(const Key &key) const { return tree.contains(key); }
 
-  std::pair<iterator, iterator> equal_range(const Key &key) {
-    iterator start = lower_bound(key);
-    iterator end = upper_bound(key);
-    return std::make_pair(start, end);
+  template <typename K, transparent_t<Compare, K> = 0>
+  bool contains(const K &key) const {
+    return tree.contains(key);
   }
 
+  // Порядковые статистики за O(log n), дубликаты учитываются
+  iterator nth(size_type k) {
+    size_type offset = 0;
+    Node<Key, size_type, Threaded> *node = tree.nth(k, offset);
+    return node ? iterator(node, offset) : end();
+  }
+
+  size_type rank(const Key &key) const { return tree.rank(key); }
+
+  size_type count_range(const Key &lo, const Key &hi) const {
+    return tree.count_range(lo, hi);
+  }
+
+  // Границы диапазонов за один спуск по дереву, O(log n)
   iterator lower_bound(const Key &key) {
-    iterator it = begin();
-    if (it == end() || *it >= key) return it;
-    while (it != end() && *it < key) {
-      ++it;
-    }
-    return it;
+    return iterator(tree.lower_bound(key));
+  }
+
+  const_iterator lower_bound(const Key &key) const {
+    return const_iterator(tree.lower_bound(key));
+  }
+
+  template <typename K, transparent_t<Compare, K> = 0>
+  iterator lower_bound(const K &key) {
+    return iterator(tree.lower_bound(key));
+  }
+
+  template <typename K, transparent_t<Compare, K> = 0>
+  const_iterator lower_bound(const K &key) const {
+    return const_iterator(tree.lower_bound(key));
   }
 
   iterator upper_bound(const Key &key) {
-    iterator it = begin();
-    while (it != end() && *it <= key) {
-      ++it;
-    }
-    return it;
+    return iterator(tree.upper_bound(key));
+  }
+
+  const_iterator upper_bound(const Key &key) const {
+    return const_iterator(tree.upper_bound(key));
+  }
+
+  template <typename K, transparent_t<Compare, K> = 0>
+  iterator upper_bound(const K &key) {
+    return iterator(tree.upper_bound(key));
+  }
+
+  template <typename K, transparent_t<Compare, K> = 0>
+  const_iterator upper_bound(const K &key) const {
+    return const_iterator(tree.upper_bound(key));
   }
 
+  std::pair<iterator, iterator> equal_range(const Key &key) {
+    return equalRange<iterator>(
+        typename tree_type::iterator(tree.lower_bound(key)), tree.end(), key);
+  }
+
+  std::pair<const_iterator, const_iterator> equal_range(const Key &key) const {
+    return equalRange<const_iterator>(
+        typename tree_type::const_iterator(tree.lower_bound(key)), tree.end(),
+        key);
+  }
+
+  template <typename K, transparent_t<Compare, K> = 0>
+  std::pair<iterator, iterator> equal_range(const K &key) {
+    return equalRange<iterator>(
+        typename tree_type::iterator(tree.lower_bound(key)), tree.end(), key);
+  }
+
+  template <typename K, transparent_t<Compare, K> = 0>
+  std::pair<const_iterator, const_iterator> equal_range(const K &key) const {
+    return equalRange<const_iterator>(
+        typename tree_type::const_iterator(tree.lower_bound(key)), tree.end(),
+        key);
+  }
+
+  // Последний из повторов наибольшего ключа, не больше key, или end()
+  iterator floor(const Key &key) {
+    Node<Key, size_type, Threaded> *node = tree.floor(key);
+    if (iterator(node) == end()) return end();
+    return iterator(node, node->data() - 1);
+  }
+
+  const_iterator floor(const Key &key) const {
+    const Node<Key, size_type, Threaded> *node = tree.floor(key);
+    if (const_iterator(node) == end()) return end();
+    return const_iterator(node, node->data() - 1);
+  }
+
+  // Первый из повторов наименьшего ключа, не меньше key, или end()
+  iterator ceiling(const Key &key) { return lower_bound(key); }
+
+  const_iterator ceiling(const Key &key) const { return lower_bound(key); }
+
   void print_tree() { tree.print(); }
+
+  // Проверка инвариантов дерева, O(n)
+  bool valid() const {
+    // Вес узла - число повторов его ключа
+    return tree.valid([](const Node<Key, size_type, Threaded> *node) {
+      return node->data();
+    });
+  }
 };
 
+namespace pmr {
+// Мультимножество, узлы которого живут в std::pmr::memory_resource
+template <typename Key, typename Compare = std::less<Key>>
+using multiset =
+    binary_tree::multiset<Key, std::pmr::polymorphic_allocator<Key>, Compare>;
+}  // namespace pmr
+
+namespace threaded {
+// Мультимножество с нитями между соседними узлами
+template <typename Key, typename Compare = std::less<Key>>
+using multiset =
+    binary_tree::multiset<Key, std::allocator<Key>, Compare, true>;
+}  // namespace threaded
+
 }  // namespace binary_tree
 
 #endif  // MULTISET_H
@@ -2,16 +2,24 @@
 #define SET_H
 
 #include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <memory_resource>
 #include <utility>
 
-#include "../tree/binary_tree.h"
+#include "binary_tree.h"
 
 namespace binary_tree {
 
-template <typename Key>
+// Как и у map, Compare стоит после Allocator, а с прозрачным компаратором
+// поиски и erase принимают любой сравнимый с Key тип
+// Threaded == true, как и у map, связывает узлы нитями по порядку ключей
+template <typename Key, typename Allocator = std::allocator<Key>,
+          typename Compare = std::less<Key>, bool Threaded = false>
 class set {
  private:
-  BinaryTree<Key, Key> tree;
+  using tree_type = BinaryTree<Key, void, Allocator, Compare, Threaded>;
+  tree_type tree;
 
  public:
   using key_type = Key;
@@ -19,18 +27,30 @@ class set {
   using reference = value_type &;
   using const_reference = const value_type &;
   using size_type = size_t;
+  using allocator_type = Allocator;
+  using key_compare = Compare;
+  using value_compare = Compare;
 
+  /*Итераторы множества отдают константную ссылку на ключ, хранящийся в
+  узле: ключ нельзя менять на месте, не нарушив порядок.*/
   class iterator {
    private:
-    typename BinaryTree<Key, Key>::iterator it;
+    typename tree_type::iterator it;
 
    public:
-    iterator(typename BinaryTree<Key, Key>::iterator iter) : it(iter) {}
+    using iterator_category = std::bidirectional_iterator_tag;
+    using value_type = Key;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const Key *;
+    using reference = const Key &;
+
+    iterator(typename tree_type::iterator iter = nullptr) : it(iter) {}
 
     // Оператор разыменования
-    key_type operator*() const {
-      return it->key;  // Возвращаем только ключ
-    }
+    reference operator*() const { return *it; }
+
+    // Оператор доступа к члену
+    pointer operator->() const { return &*it; }
 
     // Операторы сравнения
     bool operator==(const iterator &other) const { return it == other.it; }
@@ -64,25 +84,36 @@ class set {
       return temp;
     }
 
-    // Оператор доступа к члену
-    Node<Key, Key> *operator->() const { return it.operator->(); }
+    // Сдвиг на k элементов вперед за O(log n)
+    iterator operator+(size_type k) const { return iterator(it + k); }
+
+    // Узел дерева под итератором
+    Node<Key, void, Threaded> *node() const { return it.node(); }
 
     // Метод для получения  итератора
-    typename BinaryTree<Key, Key>::iterator getIterator() const { return it; }
+    typename tree_type::iterator getIterator() const { return it; }
   };
 
   class const_iterator {
    private:
-    typename BinaryTree<Key, Key>::const_iterator it;
+    typename tree_type::const_iterator it;
 
    public:
-    const_iterator(typename BinaryTree<Key, Key>::const_iterator iter)
+    using iterator_category = std::bidirectional_iterator_tag;
+    using value_type = Key;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const Key *;
+    using reference = const Key &;
+
+    const_iterator(typename tree_type::const_iterator iter = nullptr)
         : it(iter) {}
+    const_iterator(const iterator &other) : it(other.getIterator()) {}
 
     // Оператор разыменования
-    const key_type operator*() const {
-      return it->first;  // Возвращаем только ключ
-    }
+    reference operator*() const { return *it; }
+
+    // Оператор доступа к члену
+    pointer operator->() const { return &*it; }
 
     // Операторы сравнения
     bool operator==(const const_iterator &other) const {
@@ -119,24 +150,98 @@ class set {
       --it;
       return temp;
     }
-    // Оператор доступа к члену
-    const Node<Key, Key> *operator->() const { return it.operator->(); }
+    // Сдвиг на k элементов вперед за O(log n)
+    const_iterator operator+(size_type k) const {
+      return const_iterator(it + k);
+    }
+
+    // Узел дерева под итератором
+    const Node<Key, void, Threaded> *node() const { return it.node(); }
   };
 
+  using node_type = typename tree_type::node_type;
+  using insert_return_type = InsertReturn<iterator, node_type>;
+
+ private:
+  // Общие тела обычных и прозрачных перегрузок: K - либо Key, либо тип,
+  // который прозрачный компаратор сравнивает с Key напрямую
+  template <typename K>
+  iterator findKey(const K &key) {
+    Node<Key, void, Threaded> *result = tree.find(key);
+    return result ? iterator(result) : end();
+  }
+
+  template <typename K>
+  const_iterator findKey(const K &key) const {
+    Node<Key, void, Threaded> *result = tree.find(key);
+    return result ? const_iterator(result) : end();
+  }
+
+  template <typename K>
+  size_type eraseKey(const K &key) {
+    Node<Key, void, Threaded> *result = tree.find(key);
+    if (!result) return 0;
+    tree.erase(typename tree_type::iterator(result));
+    return 1;
+  }
+
+  /*Ключ перемещается в узел, если передан как rvalue. Узел множества
+  хранит только ключ: отдельного поля данных у него нет.*/
+  template <typename K>
+  std::pair<iterator, bool> insertKey(K &&value) {
+    bool inserted = false;
+    Node<Key, void, Threaded> *result =
+        tree.pushUnique(inserted, std::forward<K>(value));
+    return std::make_pair(iterator(result), inserted);
+  }
+
+  template <typename K>
+  iterator insertKey(const_iterator hint, K &&value) {
+    bool inserted = false;
+    return iterator(
+        tree.pushHint(hint.node(), inserted, std::forward<K>(value)));
+  }
+
+  // Ключи уникальны, поэтому верхняя граница - следующий за найденным узел
+  template <typename It, typename K>
+  std::pair<It, It> equalRange(It first, It end, const K &key) const {
+    It last = first;
+    if (first != end && !tree.key_less(key, *first)) ++last;
+    return std::make_pair(first, last);
+  }
+
+ public:
   set() = default;
 
-  set(std::initializer_list<key_type> const &items) {
-    for (const auto &item : items) {
-      tree.push(item, item);
-    }
+  // Узлы берутся из распределителя alloc, например из pmr-ресурса
+  explicit set(const Allocator &alloc) : tree(alloc) {}
+
+  explicit set(const Compare &comp, const Allocator &alloc = Allocator())
+      : tree(comp, alloc) {}
+
+  set(std::initializer_list<key_type> const &items,
+      const Allocator &alloc = Allocator())
+      : tree(alloc) {
+    assign_sorted(items.begin(), items.end());
+  }
+
+  // Конструктор из диапазона, упорядоченный вход собирается за O(n)
+  template <typename InputIt, typename = typename std::iterator_traits<
+                                  InputIt>::iterator_category>
+  set(InputIt first, InputIt last, const Allocator &alloc = Allocator())
+      : tree(alloc) {
+    assign_sorted(first, last);
   }
 
   set(const set &s) : tree(s.tree) {}
 
+  set(const set &s, const Allocator &alloc) : tree(s.tree, alloc) {}
+
   set(set &&s) noexcept : tree(std::move(s.tree)) {}
 
   // Оператор присваивания перемещением
-  set &operator=(set &&other) noexcept {
+  set &operator=(set &&other) noexcept(
+      std::is_nothrow_move_assignable_v<tree_type>) {
     if (this != &other) {
       tree = std::move(other.tree);
     }
@@ -153,46 +258,249 @@ class set {
 
   ~set() = default;
 
+  allocator_type get_allocator() const { return tree.get_allocator(); }
+  key_compare key_comp() const { return tree.key_comp(); }
+  value_compare value_comp() const { return tree.key_comp(); }
+
+  // Запас памяти под n новых узлов, если узлы берутся из slab_allocator
+  void reserve(size_type n) { tree.reserve(n); }
+
   iterator begin() { return iterator(tree.begin()); }
   iterator end() { return iterator(tree.end()); }
   const_iterator begin() const { return const_iterator(tree.begin()); }
   const_iterator end() const { return const_iterator(tree.end()); }
 
+  // Обход по возрастанию с предвыборкой узлов на distance шагов вперед
+  template <typename Visit>
+  void for_each(Visit visit,
+                size_type distance = tree_type::prefetch_distance) const {
+    tree.for_each(visit, distance);
+  }
+
   bool empty() const { return tree.empty(); }
   size_type size() const { return tree.size(); }
   size_type max_size() const { return tree.max_size(); }
 
   void clear() { tree.clear(); }
 
+  // Заменяет содержимое диапазоном, для упорядоченного входа за O(n)
+  template <typename InputIt>
+  void assign_sorted(InputIt first, InputIt last) {
+    tree.assign_sorted(first, last);
+  }
+
   std::pair<iterator, bool> insert(const key_type &value) {
-    Node<Key, Key> *result = tree.find(value);
-    if (result) {
-      return std::make_pair(iterator(result), false);
-    }
-    tree.push(value, value);
-    result = tree.find(value);
-    return std::make_pair(iterator(result), true);
+    return insertKey(value);
+  }
+
+  std::pair<iterator, bool> insert(key_type &&value) {
+    return insertKey(std::move(value));
+  }
+
+  // Вставка с подсказкой: при верной подсказке без спуска от корня
+  iterator insert(const_iterator hint, const key_type &value) {
+    return insertKey(hint, value);
+  }
+
+  iterator insert(const_iterator hint, key_type &&value) {
+    return insertKey(hint, std::move(value));
+  }
+
+  // Ключ собирается из args и перемещается в узел
+  template <typename... Args>
+  std::pair<iterator, bool> emplace(Args &&...args) {
+    return insertKey(key_type(std::forward<Args>(args)...));
+  }
+
+  template <typename... Args>
+  iterator emplace_hint(const_iterator hint, Args &&...args) {
+    return insertKey(hint, key_type(std::forward<Args>(args)...));
+  }
+
+  /*Node handle: extract вынимает ключ вместе с узлом, insert вставляет его
+  обратно в этот или другой set без выделения памяти и копирования. Если
+  ключ уже есть, узел возвращается в поле node результата.*/
+  node_type extract(const_iterator pos) {
+    return tree.extract(const_cast<Node<Key, void, Threaded> *>(pos.node()));
+  }
+
+  node_type extract(const Key &key) { return tree.extract(tree.find(key)); }
+
+  insert_return_type insert(node_type &&handle) {
+    bool inserted = false;
+    Node<Key, void, Threaded> *result = tree.pushNode(handle, inserted);
+    if (!result) return {end(), false, node_type()};
+    if (!inserted) return {iterator(result), false, std::move(handle)};
+    return {iterator(result), true, node_type()};
+  }
+
+  // Подсказка не используется: узел вставляется обычным спуском
+  iterator insert(const_iterator, node_type &&handle) {
+    bool inserted = false;
+    Node<Key, void, Threaded> *result = tree.pushNode(handle, inserted);
+    return result ? iterator(result) : end();
   }
 
   void erase(iterator pos) { tree.erase(pos.getIterator()); }
 
+  size_type erase(const Key &key) { return eraseKey(key); }
+
+  template <typename K, transparent_t<Compare, K> = 0>
+  size_type erase(const K &key) {
+    return eraseKey(key);
+  }
+
   void swap(set &other) { tree.swap(other.tree); }
 
   void merge(set &other) { tree.merge(other.tree); }
 
+  /*Операции над множествами за O(m log(n/m + 1)), m <= n - размеры
+  контейнеров. Результат остается в *this, узлы other переходят в него или
+  удаляются, other становится пустым.*/
+  void set_union(set &other) { tree.set_union(other.tree); }
+  void set_intersection(set &other) { tree.set_intersection(other.tree); }
+  void set_difference(set &other) { tree.set_difference(other.tree); }
+  void symmetric_difference(set &other) {
+    tree.symmetric_difference(other.tree);
+  }
+
+  // Разрезание и склейка за O(log n) без копирования узлов: split оставляет
+  // ключи меньше key и возвращает остальные, join забирает все ключи other.
+  // Если диапазоны ключей пересекаются, join работает как set_union
+  set split(const Key &key) {
+    set result(get_allocator());
+    result.tree = tree.split(key);
+    return result;
+  }
+
+  void join(set &other) { tree.join(other.tree); }
+
   void print_tree() { tree.print(); }
 
-  bool contains(const Key &key) { return tree.contains(key); }
+  // Проверка инвариантов дерева, O(n)
+  bool valid() const { return tree.valid(); }
 
-  iterator find(const Key &key) {
-    Node<Key, Key> *result = tree.find(key);
-    if (result) {
-      return iterator(result);
-    }
-    return end();
+  bool contains(const Key &key) const { return tree.contains(key); }
+
+  template <typename K, transparent_t<Compare, K> = 0>
+  bool contains(const K &key) const {
+    return tree.contains(key);
+  }
+
+  size_type count(const Key &key) const { return tree.contains(key); }
+
+  template <typename K, transparent_t<Compare, K> = 0>
+  size_type count(const K &key) const {
+    return tree.contains(key);
+  }
+
+  // Порядковые статистики за O(log n)
+  iterator nth(size_type k) {
+    Node<Key, void, Threaded> *result = tree.nth(k);
+    return result ? iterator(result) : end();
+  }
+
+  size_type rank(const Key &key) const { return tree.rank(key); }
+
+  size_type count_range(const Key &lo, const Key &hi) const {
+    return tree.count_range(lo, hi);
+  }
+
+  iterator find(const Key &key) { return findKey(key); }
+
+  const_iterator find(const Key &key) const { return findKey(key); }
+
+  template <typename K, transparent_t<Compare, K> = 0>
+  iterator find(const K &key) {
+    return findKey(key);
+  }
+
+  template <typename K, transparent_t<Compare, K> = 0>
+  const_iterator find(const K &key) const {
+    return findKey(key);
+  }
+
+  // Границы диапазонов за один спуск по дереву, O(log n)
+  iterator lower_bound(const Key &key) {
+    return iterator(tree.lower_bound(key));
   }
+
+  const_iterator lower_bound(const Key &key) const {
+    return const_iterator(tree.lower_bound(key));
+  }
+
+  template <typename K, transparent_t<Compare, K> = 0>
+  iterator lower_bound(const K &key) {
+    return iterator(tree.lower_bound(key));
+  }
+
+  template <typename K, transparent_t<Compare, K> = 0>
+  const_iterator lower_bound(const K &key) const {
+    return const_iterator(tree.lower_bound(key));
+  }
+
+  iterator upper_bound(const Key &key) {
+    return iterator(tree.upper_bound(key));
+  }
+
+  const_iterator upper_bound(const Key &key) const {
+    return const_iterator(tree.upper_bound(key));
+  }
+
+  template <typename K, transparent_t<Compare, K> = 0>
+  iterator upper_bound(const K &key) {
+    return iterator(tree.upper_bound(key));
+  }
+
+  template <typename K, transparent_t<Compare, K> = 0>
+  const_iterator upper_bound(const K &key) const {
+    return const_iterator(tree.upper_bound(key));
+  }
+
+  std::pair<iterator, iterator> equal_range(const Key &key) {
+    return equalRange(lower_bound(key), end(), key);
+  }
+
+  std::pair<const_iterator, const_iterator> equal_range(const Key &key) const {
+    return equalRange(lower_bound(key), end(), key);
+  }
+
+  template <typename K, transparent_t<Compare, K> = 0>
+  std::pair<iterator, iterator> equal_range(const K &key) {
+    return equalRange(lower_bound(key), end(), key);
+  }
+
+  template <typename K, transparent_t<Compare, K> = 0>
+  std::pair<const_iterator, const_iterator> equal_range(const K &key) const {
+    return equalRange(lower_bound(key), end(), key);
+  }
+
+  // Наибольший ключ, не больше key, или end()
+  iterator floor(const Key &key) { return iterator(tree.floor(key)); }
+
+  const_iterator floor(const Key &key) const {
+    return const_iterator(tree.floor(key));
+  }
+
+  // Наименьший ключ, не меньше key, или end()
+  iterator ceiling(const Key &key) { return lower_bound(key); }
+
+  const_iterator ceiling(const Key &key) const { return lower_bound(key); }
 };
 
+namespace pmr {
+// Множество, узлы которого живут в std::pmr::memory_resource
+template <typename Key, typename Compare = std::less<Key>>
+using set =
+    binary_tree::set<Key, std::pmr::polymorphic_allocator<Key>, Compare>;
+}  // namespace pmr
+
+namespace threaded {
+// Множество с нитями между соседними узлами
+template <typename Key, typename Compare = std::less<Key>>
+using set = binary_tree::set<Key, std::allocator<Key>, Compare, true>;
+}  // namespace threaded
+
 }  // namespace binary_tree
 
 #endif  // SET_H
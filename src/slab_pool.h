@@ -0,0 +1,224 @@
+#ifndef SLAB_POOL_H
+#define SLAB_POOL_H
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+namespace binary_tree {
+
+/*Пул ячеек одного размера. Ячейки нарезаются из больших непрерывных
+кусков, освобожденные ячейки попадают в список свободных и выдаются
+повторно, память кускам возвращается только в release() и деструкторе.
+Размер куска растет вдвое от min_chunk до huge_page байт. При huge_pages
+куски по 2 МБ выравниваются по границе огромной страницы и через madvise
+ядру предлагается отдать под них прозрачные огромные страницы (только
+Linux), что сокращает промахи TLB при спуске по большому дереву.*/
+class slab_pool {
+ public:
+  static constexpr std::size_t min_chunk = 4096;
+  static constexpr std::size_t huge_page = std::size_t(2) << 20;
+
+  explicit slab_pool(bool huge_pages = false) : huge_pages(huge_pages) {}
+  slab_pool(const slab_pool &) = delete;
+  slab_pool &operator=(const slab_pool &) = delete;
+  ~slab_pool() { release(); }
+
+  // Ячейка под объект размера size. Размер ячейки фиксируется первым
+  // запросом, объекты другого размера выделяются через operator new
+  void *allocate(std::size_t size, std::size_t align);
+  void deallocate(void *ptr, std::size_t size, std::size_t align);
+  // Готовит n ячеек, которые будут выданы без обращения к системе
+  void reserve(std::size_t size, std::size_t align, std::size_t n);
+  // Возвращает все куски, все выданные ячейки становятся недействительны
+  void release();
+  bool hugePages() const { return huge_pages; }
+
+ private:
+  struct FreeSlot {
+    FreeSlot *next;
+  };
+  struct Chunk {
+    void *memory;
+    bool aligned;
+  };
+
+  std::vector<Chunk> chunks;
+  FreeSlot *free_list = nullptr;
+  char *cursor = nullptr;
+  char *limit = nullptr;
+  std::size_t slot = 0;
+  std::size_t next_chunk = min_chunk;
+  bool huge_pages;
+
+  bool fits(std::size_t size, std::size_t align);
+  void grow(std::size_t bytes);
+};
+
+inline bool slab_pool::fits(std::size_t size, std::size_t align) {
+  std::size_t need = size < sizeof(FreeSlot) ? sizeof(FreeSlot) : size;
+  need = (need + align - 1) / align * align;
+  if (slot == 0 && align <= alignof(std::max_align_t)) slot = need;
+  return need == slot;
+}
+
+inline void *slab_pool::allocate(std::size_t size, std::size_t align) {
+  if (!fits(size, align)) {
+    if (align > alignof(std::max_align_t))
+      return ::operator new(size, std::align_val_t(align));
+    return ::operator new(size);
+  }
+  if (free_list) {
+    FreeSlot *result = free_list;
+    free_list = free_list->next;
+    return result;
+  }
+  if (cursor == limit) {
+    grow(next_chunk);
+    if (next_chunk < huge_page) next_chunk *= 2;
+  }
+  void *result = cursor;
+  cursor += slot;
+  return result;
+}
+
+inline void slab_pool::deallocate(void *ptr, std::size_t size,
+                                  std::size_t align) {
+  if (!fits(size, align)) {
+    if (align > alignof(std::max_align_t))
+      ::operator delete(ptr, std::align_val_t(align));
+    else
+      ::operator delete(ptr);
+    return;
+  }
+  FreeSlot *freed = static_cast<FreeSlot *>(ptr);
+  freed->next = free_list;
+  free_list = freed;
+}
+
+inline void slab_pool::reserve(std::size_t size, std::size_t align,
+                               std::size_t n) {
+  if (!fits(size, align)) return;
+  std::size_t available = (limit - cursor) / slot;
+  for (FreeSlot *ptr = free_list; ptr && available < n; ptr = ptr->next)
+    ++available;
+  if (available >= n) return;
+  std::size_t bytes = (n - available) * slot;
+  if (bytes >= huge_page)
+    bytes = (bytes + huge_page - 1) / huge_page * huge_page;
+  grow(bytes < next_chunk ? next_chunk : bytes);
+}
+
+// Новый кусок становится текущим, остаток старого уходит в список свободных
+inline void slab_pool::grow(std::size_t bytes) {
+  for (; cursor + slot <= limit; cursor += slot) {
+    FreeSlot *freed = reinterpret_cast<FreeSlot *>(cursor);
+    freed->next = free_list;
+    free_list = freed;
+  }
+  if (bytes < slot) bytes = slot;
+  bool aligned = huge_pages && bytes >= huge_page;
+  void *memory = aligned ? ::operator new(bytes, std::align_val_t(huge_page))
+                         : ::operator new(bytes);
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+  if (aligned) madvise(memory, bytes, MADV_HUGEPAGE);
+#endif
+  try {
+    chunks.push_back(Chunk{memory, aligned});
+  } catch (...) {
+    if (aligned)
+      ::operator delete(memory, std::align_val_t(huge_page));
+    else
+      ::operator delete(memory);
+    throw;
+  }
+  cursor = static_cast<char *>(memory);
+  limit = cursor + bytes / slot * slot;
+}
+
+inline void slab_pool::release() {
+  for (Chunk &chunk : chunks) {
+    if (chunk.aligned)
+      ::operator delete(chunk.memory, std::align_val_t(huge_page));
+    else
+      ::operator delete(chunk.memory);
+  }
+  chunks.clear();
+  free_list = nullptr;
+  cursor = limit = nullptr;
+  next_chunk = min_chunk;
+}
+
+/*Распределитель поверх общего slab_pool. Копии и перепривязанные копии
+делят один пул и равны между собой, копия контейнера получает новый пул.
+Деревья с общим пулом (например, после split) нельзя менять из разных
+потоков одновременно.*/
+template <typename T>
+class slab_allocator {
+ public:
+  using value_type = T;
+  using propagate_on_container_copy_assignment = std::false_type;
+  using propagate_on_container_move_assignment = std::true_type;
+  using propagate_on_container_swap = std::true_type;
+  using is_always_equal = std::false_type;
+
+  slab_allocator() : slab_allocator(false) {}
+  explicit slab_allocator(bool huge_pages)
+      : pool(std::make_shared<slab_pool>(huge_pages)) {}
+  // Копирование вместо перемещения: источник остается рабочим
+  slab_allocator(const slab_allocator &other) = default;
+  template <typename U>
+  slab_allocator(const slab_allocator<U> &other) : pool(other.pool) {}
+
+  T *allocate(std::size_t n) {
+    if (n != 1) return std::allocator<T>().allocate(n);
+    return static_cast<T *>(pool->allocate(sizeof(T), alignof(T)));
+  }
+
+  void deallocate(T *ptr, std::size_t n) {
+    if (n != 1) return std::allocator<T>().deallocate(ptr, n);
+    pool->deallocate(ptr, sizeof(T), alignof(T));
+  }
+
+  slab_allocator select_on_container_copy_construction() const {
+    return slab_allocator(pool->hugePages());
+  }
+
+  void reserve(std::size_t n) { pool->reserve(sizeof(T), alignof(T), n); }
+
+  // Пул принадлежит только этому распределителю и его можно сбросить целиком
+  bool unique() const { return pool.use_count() == 1; }
+  void release() { pool->release(); }
+
+  template <typename U>
+  bool operator==(const slab_allocator<U> &other) const {
+    return pool == other.pool;
+  }
+
+  template <typename U>
+  bool operator!=(const slab_allocator<U> &other) const {
+    return pool != other.pool;
+  }
+
+ private:
+  template <typename U>
+  friend class slab_allocator;
+
+  std::shared_ptr<slab_pool> pool;
+};
+
+template <typename A>
+struct is_slab_allocator : std::false_type {};
+
+template <typename T>
+struct is_slab_allocator<slab_allocator<T>> : std::true_type {};
+
+}  // namespace binary_tree
+
+#endif  // SLAB_POOL_H
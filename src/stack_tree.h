@@ -0,0 +1,907 @@
+#ifndef STACK_TREE_H
+#define STACK_TREE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <utility>
+
+#include "binary_tree.h"
+
+namespace binary_tree {
+
+/*Узел без указателя на отца. Путь от корня хранят сами операции: вставка и
+удаление собирают его при спуске, итератор носит его с собой. Цвет хранится
+в младшем бите указателя на правого сына, так что на связи уходит 16 байт.
+Связи доступны только самому дереву.*/
+template <typename T1, typename T2>
+struct StackNode {
+  T1 key;
+  T2 data;
+
+  StackNode(const T1 &key, const T2 &data) : key(key), data(data) {}
+
+ private:
+  template <typename, typename, typename>
+  friend class StackTree;
+
+  StackNode *left = nullptr;
+
+  StackNode *right() const {
+    return reinterpret_cast<StackNode *>(right_color & ~std::uintptr_t(1));
+  }
+  COLOR color() const { return COLOR(right_color & 1); }
+  void setRight(StackNode *ptr) {
+    right_color = reinterpret_cast<std::uintptr_t>(ptr) | (right_color & 1);
+  }
+  void setColor(COLOR value) {
+    right_color = (right_color & ~std::uintptr_t(1)) | value;
+  }
+
+  // Новый узел красный (RED == 0) и без правого сына
+  std::uintptr_t right_color = 0;
+};
+
+/*Красно-черное дерево с уникальными ключами на узлах StackNode. Годится для
+точечных поисков и прямых проходов, когда память дороже отдельных шагов
+итератора. Итератор хранит путь от корня фиксированной длины max_height,
+поэтому он заметно тяжелее указателя и его лучше не копировать без нужды.
+Повороты меняют предков узлов, поэтому любая вставка и удаление делают
+недействительными все итераторы, кроме возвращенного самой операцией.
+Сами узлы при этом не перемещаются.*/
+template <typename T1, typename T2,
+          typename Allocator = std::allocator<std::pair<const T1, T2>>>
+class StackTree {
+ public:
+  using size_type = size_t;
+  using allocator_type = Allocator;
+
+  // Высота красно-черного дерева не больше 2 log2(n + 1)
+  static constexpr int max_height = 2 * std::numeric_limits<size_type>::digits;
+
+ private:
+  using node_type = StackNode<T1, T2>;
+  using node_allocator = typename std::allocator_traits<
+      Allocator>::template rebind_alloc<node_type>;
+  using node_traits = std::allocator_traits<node_allocator>;
+
+  node_allocator alloc;
+  node_type *root = nullptr;
+  size_type tree_size = 0;
+
+  node_type *createNode(const T1 &key, const T2 &data);
+  void destroyNode(node_type *node);
+  void clear(node_type *node);
+  node_type *cloneTree(const node_type *node);
+  static bool isBlack(const node_type *ptr);
+  void replaceChild(node_type *father, node_type *ptr, node_type *child);
+  node_type *rotate(node_type *ptr, node_type *father, bool left);
+  void balanceTree(node_type *ptr, node_type **path, int depth);
+  void eraseBalance(node_type *ptr, node_type **path, int depth);
+  void remove(node_type **path, int depth);
+  int findPath(const T1 &key, node_type **path) const;
+  const node_type *findNode(const T1 &key) const;
+  template <typename Less>
+  int boundPath(node_type **path, Less less) const;
+
+  /*Шаги итератора по пути path[0..depth), где path[depth - 1] - текущий
+  узел, пустой путь означает end()*/
+  static void stepForward(node_type **path, int &depth);
+  static void stepBack(node_type *root, node_type **path, int &depth);
+
+  // Черная высота поддерева node или -1, если инварианты нарушены
+  static int checkSubtree(const node_type *node, const node_type *&prev,
+                          size_type &count);
+
+ public:
+  StackTree() = default;
+
+  explicit StackTree(const Allocator &allocator) : alloc(allocator) {}
+
+  // Конструктор со списком инициализирования
+  StackTree(std::initializer_list<std::pair<T1, T2>> const &items,
+            const Allocator &allocator = Allocator());
+
+  // Конструктор копирования: повторяет форму и цвета исходного дерева
+  StackTree(const StackTree &other);
+
+  // Конструктор перемещения
+  StackTree(StackTree &&other) noexcept;
+
+  StackTree &operator=(const StackTree &other);
+  StackTree &operator=(StackTree &&other);
+
+  ~StackTree();
+
+  allocator_type get_allocator() const { return allocator_type(alloc); }
+
+  /*Итератор разыменовывается в пару ссылок на ключ и данные узла, как у
+  BTree: it->first, it->second = x. Ключ только для чтения, чтобы не
+  нарушить порядок дерева. pointer - обертка над такой парой, через которую
+  работает оператор ->.*/
+  template <typename Reference>
+  struct Arrow {
+    Reference ref;
+    const Reference *operator->() const { return &ref; }
+  };
+
+  class const_iterator;
+
+  class iterator {
+   private:
+    const StackTree *tree;
+    int depth;
+    node_type *path[max_height];
+    friend class StackTree;
+    friend class const_iterator;
+
+   public:
+    using iterator_category = std::bidirectional_iterator_tag;
+    using value_type = std::pair<const T1, T2>;
+    using difference_type = std::ptrdiff_t;
+    using reference = std::pair<const T1 &, T2 &>;
+    using pointer = Arrow<reference>;
+
+    explicit iterator(const StackTree *tree);
+
+    // Префиксный оператор++
+    iterator &operator++();
+
+    // Префиксный оператор--
+    iterator &operator--();
+
+    // Постфиксный оператор++
+    iterator operator++(int);
+
+    // Постфиксный оператор--
+    iterator operator--(int);
+
+    // Операторы сравнения
+    bool operator==(const iterator &other) const;
+    bool operator!=(const iterator &other) const;
+
+    // Оператор разыменования
+    reference operator*() const;
+
+    // Оператор доступа к члену
+    pointer operator->() const;
+  };
+
+  class const_iterator {
+   private:
+    iterator position;
+
+   public:
+    using iterator_category = std::bidirectional_iterator_tag;
+    using value_type = std::pair<const T1, T2>;
+    using difference_type = std::ptrdiff_t;
+    using reference = std::pair<const T1 &, const T2 &>;
+    using pointer = Arrow<reference>;
+
+    explicit const_iterator(const StackTree *tree);
+    const_iterator(const iterator &other);
+
+    // Префиксный оператор++
+    const_iterator &operator++();
+
+    // Префиксный оператор--
+    const_iterator &operator--();
+
+    // Постфиксный оператор++
+    const_iterator operator++(int);
+
+    // Постфиксный оператор--
+    const_iterator operator--(int);
+
+    // Операторы сравнения
+    bool operator==(const const_iterator &other) const;
+    bool operator!=(const const_iterator &other) const;
+
+    // Оператор разыменования
+    reference operator*() const;
+
+    // Оператор доступа к члену
+    pointer operator->() const;
+  };
+
+  // Методы для получения итераторов
+  iterator begin();
+  iterator end();
+  const_iterator begin() const;
+  const_iterator end() const;
+
+  // Вставка уникального ключа. Возвращает позицию нового или уже
+  // существующего узла с таким ключом (тогда second == false). Прочие
+  // итераторы становятся недействительными
+  std::pair<iterator, bool> push(const T1 &key, const T2 &data);
+
+  // Позиция узла с ключом key или end(). Наружу узел отдается только
+  // через итератор, ключ которого нельзя изменить
+  iterator find(const T1 &key);
+  const_iterator find(const T1 &key) const;
+  // Первый узел с ключом не меньше key
+  iterator lower_bound(const T1 &key);
+  const_iterator lower_bound(const T1 &key) const;
+  // Первый узел с ключом больше key
+  iterator upper_bound(const T1 &key);
+  const_iterator upper_bound(const T1 &key) const;
+  // Точечный поиск без построения пути
+  bool contains(const T1 &key) const;
+
+  // Удаление по итератору и по ключу. Прочие итераторы становятся
+  // недействительными, erase(pos) возвращает итератор на следующий узел
+  iterator erase(iterator pos);
+  size_type erase(const T1 &key);
+
+  // Методы для доступа к информации о наполнении контейнера
+  bool empty() const;
+  size_type size() const;
+  size_type max_size() const;
+
+  void clear();
+  void swap(StackTree &other);
+
+  /*Проверка инвариантов за O(n), для тестов: ключи строго возрастают,
+  корень черный, у красного узла нет красных сыновей, черная высота всех
+  путей одинакова, число узлов равно size().*/
+  bool valid() const;
+};
+
+template <typename T1, typename T2, typename Allocator>
+StackTree<T1, T2, Allocator>::StackTree(
+    std::initializer_list<std::pair<T1, T2>> const &items,
+    const Allocator &allocator)
+    : alloc(allocator) {
+  for (const auto &item : items) push(item.first, item.second);
+}
+
+template <typename T1, typename T2, typename Allocator>
+StackTree<T1, T2, Allocator>::StackTree(const StackTree &other)
+    : alloc(node_traits::select_on_container_copy_construction(other.alloc)),
+      root(cloneTree(other.root)),
+      tree_size(other.tree_size) {}
+
+template <typename T1, typename T2, typename Allocator>
+StackTree<T1, T2, Allocator>::StackTree(StackTree &&other) noexcept
+    : alloc(std::move(other.alloc)),
+      root(other.root),
+      tree_size(other.tree_size) {
+  other.root = nullptr;
+  other.tree_size = 0;
+}
+
+// Распределитель не переходит, элементы копируются в свою память
+template <typename T1, typename T2, typename Allocator>
+StackTree<T1, T2, Allocator> &StackTree<T1, T2, Allocator>::operator=(
+    const StackTree &other) {
+  if (this != &other) {
+    clear();
+    root = cloneTree(other.root);
+    tree_size = other.tree_size;
+  }
+  return *this;
+}
+
+// Узлы забираются при равных распределителях, иначе копируются
+template <typename T1, typename T2, typename Allocator>
+StackTree<T1, T2, Allocator> &StackTree<T1, T2, Allocator>::operator=(
+    StackTree &&other) {
+  if (this != &other) {
+    if (alloc != other.alloc) {
+      *this = static_cast<const StackTree &>(other);
+      other.clear();
+    } else {
+      clear();
+      std::swap(root, other.root);
+      std::swap(tree_size, other.tree_size);
+    }
+  }
+  return *this;
+}
+
+template <typename T1, typename T2, typename Allocator>
+StackTree<T1, T2, Allocator>::~StackTree() {
+  clear(root);
+}
+
+template <typename T1, typename T2, typename Allocator>
+typename StackTree<T1, T2, Allocator>::node_type *
+StackTree<T1, T2, Allocator>::createNode(const T1 &key, const T2 &data) {
+  node_type *node = node_traits::allocate(alloc, 1);
+  try {
+    node_traits::construct(alloc, node, key, data);
+  } catch (...) {
+    node_traits::deallocate(alloc, node, 1);
+    throw;
+  }
+  return node;
+}
+
+template <typename T1, typename T2, typename Allocator>
+void StackTree<T1, T2, Allocator>::destroyNode(node_type *node) {
+  node_traits::destroy(alloc, node);
+  node_traits::deallocate(alloc, node, 1);
+}
+
+template <typename T1, typename T2, typename Allocator>
+void StackTree<T1, T2, Allocator>::clear(node_type *node) {
+  while (node) {
+    clear(node->left);
+    node_type *right = node->right();
+    destroyNode(node);
+    node = right;
+  }
+}
+
+template <typename T1, typename T2, typename Allocator>
+typename StackTree<T1, T2, Allocator>::node_type *
+StackTree<T1, T2, Allocator>::cloneTree(const node_type *node) {
+  if (!node) return nullptr;
+  node_type *copy = createNode(node->key, node->data);
+  copy->setColor(node->color());
+  try {
+    copy->left = cloneTree(node->left);
+    copy->setRight(cloneTree(node->right()));
+  } catch (...) {
+    clear(copy);
+    throw;
+  }
+  return copy;
+}
+
+// Пустой лист (nullptr) считается черным
+template <typename T1, typename T2, typename Allocator>
+bool StackTree<T1, T2, Allocator>::isBlack(const node_type *ptr) {
+  return ptr == nullptr || ptr->color() == BLACK;
+}
+
+// Ставит child на место сына ptr у father, для корня father == nullptr
+template <typename T1, typename T2, typename Allocator>
+void StackTree<T1, T2, Allocator>::replaceChild(node_type *father,
+                                                node_type *ptr,
+                                                node_type *child) {
+  if (!father)
+    root = child;
+  else if (father->left == ptr)
+    father->left = child;
+  else
+    father->setRight(child);
+}
+
+/*Поворот вокруг ptr с отцом father: при left на место ptr поднимается его
+правый сын, иначе левый. Возвращает поднятый узел.*/
+template <typename T1, typename T2, typename Allocator>
+typename StackTree<T1, T2, Allocator>::node_type *
+StackTree<T1, T2, Allocator>::rotate(node_type *ptr, node_type *father,
+                                     bool left) {
+  node_type *son;
+  if (left) {
+    son = ptr->right();
+    ptr->setRight(son->left);
+    son->left = ptr;
+  } else {
+    son = ptr->left;
+    ptr->left = son->right();
+    son->setRight(ptr);
+  }
+  replaceChild(father, ptr, son);
+  return son;
+}
+
+// Восстановление свойств после вставки красного узла ptr с предками path
+template <typename T1, typename T2, typename Allocator>
+void StackTree<T1, T2, Allocator>::balanceTree(node_type *ptr,
+                                               node_type **path, int depth) {
+  while (depth > 0 && path[depth - 1]->color() == RED) {
+    // Отец красный, значит он не корень и дед существует
+    node_type *father = path[depth - 1];
+    node_type *gf = path[depth - 2];
+    bool left = gf->left == father;
+    node_type *un = left ? gf->right() : gf->left;
+    if (!isBlack(un)) {
+      father->setColor(BLACK);
+      un->setColor(BLACK);
+      gf->setColor(RED);
+      ptr = gf;
+      depth -= 2;
+      continue;
+    }
+    if (ptr == (left ? father->right() : father->left))
+      father = rotate(father, gf, left);
+    father->setColor(BLACK);
+    gf->setColor(RED);
+    rotate(gf, depth > 2 ? path[depth - 3] : nullptr, !left);
+    break;
+  }
+  root->setColor(BLACK);
+}
+
+/*Восстановление свойств после удаления черного узла. ptr - узел (возможно
+nullptr) на месте удаленного, path[0..depth) - его предки.*/
+template <typename T1, typename T2, typename Allocator>
+void StackTree<T1, T2, Allocator>::eraseBalance(node_type *ptr,
+                                                node_type **path, int depth) {
+  while (depth > 0 && isBlack(ptr)) {
+    // У дважды черного узла брат всегда существует
+    node_type *father = path[depth - 1];
+    node_type *gf = depth > 1 ? path[depth - 2] : nullptr;
+    bool left = father->left == ptr;
+    node_type *brother = left ? father->right() : father->left;
+    if (brother->color() == RED) {
+      // Брат поднимается над отцом и становится новым предком ptr
+      brother->setColor(BLACK);
+      father->setColor(RED);
+      rotate(father, gf, left);
+      gf = path[depth - 1] = brother;
+      path[depth++] = father;
+      brother = left ? father->right() : father->left;
+    }
+    node_type *inner = left ? brother->left : brother->right();
+    node_type *outer = left ? brother->right() : brother->left;
+    if (isBlack(inner) && isBlack(outer)) {
+      brother->setColor(RED);
+      ptr = father;
+      --depth;
+      continue;
+    }
+    if (isBlack(outer)) {
+      inner->setColor(BLACK);
+      brother->setColor(RED);
+      outer = brother;
+      brother = rotate(brother, father, !left);
+    }
+    brother->setColor(father->color());
+    father->setColor(BLACK);
+    outer->setColor(BLACK);
+    rotate(father, gf, left);
+    return;
+  }
+  if (ptr) ptr->setColor(BLACK);
+}
+
+/*Удаляет узел path[depth - 1], path[0..depth - 1) - его предки. В массиве
+path должно быть место под путь до следующего по порядку узла.*/
+template <typename T1, typename T2, typename Allocator>
+void StackTree<T1, T2, Allocator>::remove(node_type **path, int depth) {
+  node_type *ptr = path[--depth];
+  node_type *father = depth > 0 ? path[depth - 1] : nullptr;
+  node_type *child;
+  COLOR removed = ptr->color();
+  if (!ptr->left || !ptr->right()) {
+    child = ptr->left ? ptr->left : ptr->right();
+    replaceChild(father, ptr, child);
+  } else {
+    // Место ptr занимает следующий по порядку узел next
+    int place = depth++;
+    node_type *next = ptr->right();
+    while (next->left) {
+      path[depth++] = next;
+      next = next->left;
+    }
+    removed = next->color();
+    child = next->right();
+    if (depth - 1 != place) {
+      path[depth - 1]->left = child;
+      next->setRight(ptr->right());
+    }
+    next->left = ptr->left;
+    next->setColor(ptr->color());
+    replaceChild(father, ptr, next);
+    path[place] = next;
+  }
+  destroyNode(ptr);
+  --tree_size;
+  if (removed == BLACK) eraseBalance(child, path, depth);
+}
+
+// Путь до узла с ключом key, 0 - ключа нет
+template <typename T1, typename T2, typename Allocator>
+int StackTree<T1, T2, Allocator>::findPath(const T1 &key,
+                                           node_type **path) const {
+  int depth = 0;
+  for (node_type *current = root; current;) {
+    path[depth++] = current;
+    if (key < current->key)
+      current = current->left;
+    else if (current->key < key)
+      current = current->right();
+    else
+      return depth;
+  }
+  return 0;
+}
+
+/*Путь до первого узла, для которого less(ключ, узел) ложно (как в
+std::partition_point), 0 - такого узла нет*/
+template <typename T1, typename T2, typename Allocator>
+template <typename Less>
+int StackTree<T1, T2, Allocator>::boundPath(node_type **path,
+                                            Less less) const {
+  int depth = 0, found = 0;
+  for (node_type *current = root; current;) {
+    path[depth++] = current;
+    if (less(current)) {
+      current = current->right();
+    } else {
+      found = depth;
+      current = current->left;
+    }
+  }
+  return found;
+}
+
+template <typename T1, typename T2, typename Allocator>
+void StackTree<T1, T2, Allocator>::stepForward(node_type **path,
+                                               int &depth) {
+  node_type *current = path[depth - 1];
+  if (current->right()) {
+    for (current = current->right(); current; current = current->left)
+      path[depth++] = current;
+    return;
+  }
+  // Поднимаемся, пока приходим из правого поддерева
+  while (--depth > 0 && path[depth - 1]->right() == current)
+    current = path[depth - 1];
+}
+
+template <typename T1, typename T2, typename Allocator>
+void StackTree<T1, T2, Allocator>::stepBack(node_type *root,
+                                            node_type **path, int &depth) {
+  node_type *current;
+  if (depth == 0) {
+    current = root;
+  } else if (path[depth - 1]->left) {
+    current = path[depth - 1]->left;
+  } else {
+    // Поднимаемся, пока приходим из левого поддерева
+    current = path[depth - 1];
+    while (--depth > 0 && path[depth - 1]->left == current)
+      current = path[depth - 1];
+    return;
+  }
+  for (; current; current = current->right()) path[depth++] = current;
+}
+
+template <typename T1, typename T2, typename Allocator>
+std::pair<typename StackTree<T1, T2, Allocator>::iterator, bool>
+StackTree<T1, T2, Allocator>::push(const T1 &key, const T2 &data) {
+  iterator result(this);
+  node_type **path = result.path;
+  int depth = 0;
+  node_type *father = nullptr;
+  for (node_type *current = root; current;) {
+    father = current;
+    path[depth++] = current;
+    if (key < current->key) {
+      current = current->left;
+    } else if (current->key < key) {
+      current = current->right();
+    } else {
+      result.depth = depth;
+      return {result, false};
+    }
+  }
+  node_type *node = createNode(key, data);
+  if (!father)
+    root = node;
+  else if (key < father->key)
+    father->left = node;
+  else
+    father->setRight(node);
+  ++tree_size;
+  balanceTree(node, path, depth);
+  // Повороты меняют предков нового узла, путь до него строится заново
+  result.depth = findPath(key, path);
+  return {result, true};
+}
+
+template <typename T1, typename T2, typename Allocator>
+const typename StackTree<T1, T2, Allocator>::node_type *
+StackTree<T1, T2, Allocator>::findNode(const T1 &key) const {
+  const node_type *current = root;
+  while (current) {
+    if (key < current->key)
+      current = current->left;
+    else if (current->key < key)
+      current = current->right();
+    else
+      return current;
+  }
+  return nullptr;
+}
+
+template <typename T1, typename T2, typename Allocator>
+typename StackTree<T1, T2, Allocator>::iterator
+StackTree<T1, T2, Allocator>::find(const T1 &key) {
+  iterator result(this);
+  result.depth = findPath(key, result.path);
+  return result;
+}
+
+template <typename T1, typename T2, typename Allocator>
+typename StackTree<T1, T2, Allocator>::const_iterator
+StackTree<T1, T2, Allocator>::find(const T1 &key) const {
+  return const_cast<StackTree *>(this)->find(key);
+}
+
+template <typename T1, typename T2, typename Allocator>
+typename StackTree<T1, T2, Allocator>::iterator
+StackTree<T1, T2, Allocator>::lower_bound(const T1 &key) {
+  iterator result(this);
+  result.depth = boundPath(result.path,
+                           [&key](const node_type *node) {
+                             return node->key < key;
+                           });
+  return result;
+}
+
+template <typename T1, typename T2, typename Allocator>
+typename StackTree<T1, T2, Allocator>::const_iterator
+StackTree<T1, T2, Allocator>::lower_bound(const T1 &key) const {
+  return const_cast<StackTree *>(this)->lower_bound(key);
+}
+
+template <typename T1, typename T2, typename Allocator>
+typename StackTree<T1, T2, Allocator>::iterator
+StackTree<T1, T2, Allocator>::upper_bound(const T1 &key) {
+  iterator result(this);
+  result.depth = boundPath(result.path,
+                           [&key](const node_type *node) {
+                             return !(key < node->key);
+                           });
+  return result;
+}
+
+template <typename T1, typename T2, typename Allocator>
+typename StackTree<T1, T2, Allocator>::const_iterator
+StackTree<T1, T2, Allocator>::upper_bound(const T1 &key) const {
+  return const_cast<StackTree *>(this)->upper_bound(key);
+}
+
+template <typename T1, typename T2, typename Allocator>
+bool StackTree<T1, T2, Allocator>::contains(const T1 &key) const {
+  return findNode(key) != nullptr;
+}
+
+// Путь итератора сам служит стеком удаления
+template <typename T1, typename T2, typename Allocator>
+typename StackTree<T1, T2, Allocator>::iterator
+StackTree<T1, T2, Allocator>::erase(iterator pos) {
+  if (pos.depth == 0) return pos;
+  iterator next = pos;
+  ++next;
+  remove(pos.path, pos.depth);
+  // Следующий узел остался на месте, но его предки после поворотов другие
+  if (next.depth > 0) {
+    node_type *node = next.path[next.depth - 1];
+    next.depth = findPath(node->key, next.path);
+  }
+  return next;
+}
+
+template <typename T1, typename T2, typename Allocator>
+typename StackTree<T1, T2, Allocator>::size_type
+StackTree<T1, T2, Allocator>::erase(const T1 &key) {
+  node_type *path[max_height];
+  int depth = findPath(key, path);
+  if (depth == 0) return 0;
+  remove(path, depth);
+  return 1;
+}
+
+template <typename T1, typename T2, typename Allocator>
+bool StackTree<T1, T2, Allocator>::empty() const {
+  return root == nullptr;
+}
+
+template <typename T1, typename T2, typename Allocator>
+typename StackTree<T1, T2, Allocator>::size_type
+StackTree<T1, T2, Allocator>::size() const {
+  return tree_size;
+}
+
+template <typename T1, typename T2, typename Allocator>
+typename StackTree<T1, T2, Allocator>::size_type
+StackTree<T1, T2, Allocator>::max_size() const {
+  return node_traits::max_size(alloc);
+}
+
+template <typename T1, typename T2, typename Allocator>
+void StackTree<T1, T2, Allocator>::clear() {
+  clear(root);
+  root = nullptr;
+  tree_size = 0;
+}
+
+template <typename T1, typename T2, typename Allocator>
+void StackTree<T1, T2, Allocator>::swap(StackTree &other) {
+  if constexpr (node_traits::propagate_on_container_swap::value) {
+    using std::swap;
+    swap(alloc, other.alloc);
+  }
+  std::swap(root, other.root);
+  std::swap(tree_size, other.tree_size);
+}
+
+template <typename T1, typename T2, typename Allocator>
+int StackTree<T1, T2, Allocator>::checkSubtree(const node_type *node,
+                                               const node_type *&prev,
+                                               size_type &count) {
+  if (!node) return 1;
+  if (node->color() == RED && (!isBlack(node->left) || !isBlack(node->right())))
+    return -1;
+  int left = checkSubtree(node->left, prev, count);
+  if (left < 0) return -1;
+  if (prev && !(prev->key < node->key)) return -1;
+  prev = node;
+  ++count;
+  int right = checkSubtree(node->right(), prev, count);
+  if (right != left) return -1;
+  return left + (node->color() == BLACK);
+}
+
+template <typename T1, typename T2, typename Allocator>
+bool StackTree<T1, T2, Allocator>::valid() const {
+  if (!isBlack(root)) return false;
+  const node_type *prev = nullptr;
+  size_type count = 0;
+  return checkSubtree(root, prev, count) > 0 && count == tree_size;
+}
+
+template <typename T1, typename T2, typename Allocator>
+typename StackTree<T1, T2, Allocator>::iterator
+StackTree<T1, T2, Allocator>::begin() {
+  iterator result(this);
+  for (node_type *current = root; current; current = current->left)
+    result.path[result.depth++] = current;
+  return result;
+}
+
+template <typename T1, typename T2, typename Allocator>
+typename StackTree<T1, T2, Allocator>::iterator
+StackTree<T1, T2, Allocator>::end() {
+  return iterator(this);
+}
+
+template <typename T1, typename T2, typename Allocator>
+typename StackTree<T1, T2, Allocator>::const_iterator
+StackTree<T1, T2, Allocator>::begin() const {
+  return const_cast<StackTree *>(this)->begin();
+}
+
+template <typename T1, typename T2, typename Allocator>
+typename StackTree<T1, T2, Allocator>::const_iterator
+StackTree<T1, T2, Allocator>::end() const {
+  return const_iterator(this);
+}
+
+template <typename T1, typename T2, typename Allocator>
+StackTree<T1, T2, Allocator>::iterator::iterator(const StackTree *tree)
+    : tree(tree), depth(0) {}
+
+template <typename T1, typename T2, typename Allocator>
+typename StackTree<T1, T2, Allocator>::iterator &
+StackTree<T1, T2, Allocator>::iterator::operator++() {
+  if (depth > 0) stepForward(path, depth);
+  return *this;
+}
+
+template <typename T1, typename T2, typename Allocator>
+typename StackTree<T1, T2, Allocator>::iterator &
+StackTree<T1, T2, Allocator>::iterator::operator--() {
+  stepBack(tree->root, path, depth);
+  return *this;
+}
+
+template <typename T1, typename T2, typename Allocator>
+typename StackTree<T1, T2, Allocator>::iterator
+StackTree<T1, T2, Allocator>::iterator::operator++(int) {
+  iterator temp = *this;
+  ++(*this);
+  return temp;
+}
+
+template <typename T1, typename T2, typename Allocator>
+typename StackTree<T1, T2, Allocator>::iterator
+StackTree<T1, T2, Allocator>::iterator::operator--(int) {
+  iterator temp = *this;
+  --(*this);
+  return temp;
+}
+
+// Итераторы одного дерева равны, если указывают на один узел
+template <typename T1, typename T2, typename Allocator>
+bool StackTree<T1, T2, Allocator>::iterator::operator==(
+    const iterator &other) const {
+  if (depth == 0 || other.depth == 0) return depth == other.depth;
+  return path[depth - 1] == other.path[other.depth - 1];
+}
+
+template <typename T1, typename T2, typename Allocator>
+bool StackTree<T1, T2, Allocator>::iterator::operator!=(
+    const iterator &other) const {
+  return !(*this == other);
+}
+
+template <typename T1, typename T2, typename Allocator>
+typename StackTree<T1, T2, Allocator>::iterator::reference
+StackTree<T1, T2, Allocator>::iterator::operator*() const {
+  return reference(path[depth - 1]->key, path[depth - 1]->data);
+}
+
+template <typename T1, typename T2, typename Allocator>
+typename StackTree<T1, T2, Allocator>::iterator::pointer
+StackTree<T1, T2, Allocator>::iterator::operator->() const {
+  return pointer{**this};
+}
+
+template <typename T1, typename T2, typename Allocator>
+StackTree<T1, T2, Allocator>::const_iterator::const_iterator(
+    const StackTree *tree)
+    : position(tree) {}
+
+template <typename T1, typename T2, typename Allocator>
+StackTree<T1, T2, Allocator>::const_iterator::const_iterator(
+    const iterator &other)
+    : position(other) {}
+
+template <typename T1, typename T2, typename Allocator>
+typename StackTree<T1, T2, Allocator>::const_iterator &
+StackTree<T1, T2, Allocator>::const_iterator::operator++() {
+  ++position;
+  return *this;
+}
+
+template <typename T1, typename T2, typename Allocator>
+typename StackTree<T1, T2, Allocator>::const_iterator &
+StackTree<T1, T2, Allocator>::const_iterator::operator--() {
+  --position;
+  return *this;
+}
+
+template <typename T1, typename T2, typename Allocator>
+typename StackTree<T1, T2, Allocator>::const_iterator
+StackTree<T1, T2, Allocator>::const_iterator::operator++(int) {
+  const_iterator temp = *this;
+  ++position;
+  return temp;
+}
+
+template <typename T1, typename T2, typename Allocator>
+typename StackTree<T1, T2, Allocator>::const_iterator
+StackTree<T1, T2, Allocator>::const_iterator::operator--(int) {
+  const_iterator temp = *this;
+  --position;
+  return temp;
+}
+
+template <typename T1, typename T2, typename Allocator>
+bool StackTree<T1, T2, Allocator>::const_iterator::operator==(
+    const const_iterator &other) const {
+  return position == other.position;
+}
+
+template <typename T1, typename T2, typename Allocator>
+bool StackTree<T1, T2, Allocator>::const_iterator::operator!=(
+    const const_iterator &other) const {
+  return position != other.position;
+}
+
+template <typename T1, typename T2, typename Allocator>
+typename StackTree<T1, T2, Allocator>::const_iterator::reference
+StackTree<T1, T2, Allocator>::const_iterator::operator*() const {
+  return reference(*position);
+}
+
+template <typename T1, typename T2, typename Allocator>
+typename StackTree<T1, T2, Allocator>::const_iterator::pointer
+StackTree<T1, T2, Allocator>::const_iterator::operator->() const {
+  return pointer{**this};
+}
+
+}  // namespace binary_tree
+
+#endif  // STACK_TREE_H
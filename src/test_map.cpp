@@ -1,7 +1,46 @@
+#include <algorithm>
 #include <iostream>
 
+#include "btree_map.h"
+#include "flat_map.h"
+#include "index_map.h"
+#include "index_tree.h"
 #include "map.h"
+#include "stack_tree.h"
 #include <map>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Тип, копирование которого бросает bad_alloc, пока поднят флаг fail
+struct Fragile {
+  static inline bool fail = false;
+  int value = 0;
+  Fragile() = default;
+  Fragile(int value) : value(value) {}
+  Fragile(const Fragile &other) : value(other.value) {
+    if (fail) throw std::bad_alloc();
+  }
+  Fragile(Fragile &&other) noexcept = default;
+  Fragile &operator=(const Fragile &other) {
+    if (fail) throw std::bad_alloc();
+    value = other.value;
+    return *this;
+  }
+  Fragile &operator=(Fragile &&other) noexcept = default;
+  bool operator<(const Fragile &other) const { return value < other.value; }
+};
+
+// Тип, который считает свои построения по умолчанию
+struct Counted {
+  static inline int made = 0;
+  int value = 0;
+  Counted() { ++made; }
+};
 
 int main() {
   // Создаем объект Map
@@ -11,22 +50,22 @@ int main() {
   auto result1 = myMap.insert(1, "one");
   std::cout << "Insert (1, \"one\"): "
             << (result1.second ? "Inserted" : "Not inserted") << std::endl;
-  std::cout << "Iterator key: " << result1.first->key
-            << ", value: " << result1.first->data << std::endl;
+  std::cout << "Iterator key: " << result1.first->first
+            << ", value: " << result1.first->second << std::endl;
   std::cout << std::endl;
 
   auto result2 = myMap.insert(2, "two");
   std::cout << "Insert (2, \"two\"): "
             << (result2.second ? "Inserted" : "Not inserted") << std::endl;
-  std::cout << "Iterator key: " << result2.first->key
-            << ", value: " << result2.first->data << std::endl;
+  std::cout << "Iterator key: " << result2.first->first
+            << ", value: " << result2.first->second << std::endl;
   std::cout << std::endl;
 
   auto result3 = myMap.insert(3, "three");
   std::cout << "Insert (3, \"three\"): "
             << (result3.second ? "Inserted" : "Not inserted") << std::endl;
-  std::cout << "Iterator key: " << result3.first->key
-            << ", value: " << result3.first->data << std::endl;
+  std::cout << "Iterator key: " << result3.first->first
+            << ", value: " << result3.first->second << std::endl;
   std::cout << std::endl;
 
   // Проверяем наличие элементов
@@ -118,7 +157,7 @@ int main() {
   std::cout << std::endl;
 
   // Оператор ->
-  std::cout << "Arrow operator it1: " << it1->key << ": " << it1->data
+  std::cout << "Arrow operator it1: " << it1->first << ": " << it1->second
             << std::endl;
   std::cout << std::endl;
 
@@ -183,7 +222,7 @@ int main() {
   std::cout << std::endl;
   std::cout << "myMap contents:" << std::endl;
   for (auto it = myMap.begin(); it != myMap.end(); ++it) {
-    std::cout << it->key << ": " << it->data << std::endl;
+    std::cout << it->first << ": " << it->second << std::endl;
   }
   std::cout << std::endl;
   std::cout << "newMap after merge:" << std::endl;
@@ -213,6 +252,1030 @@ int main() {
     }*/
   
 
+  // Порядковые статистики
+  {
+    binary_tree::map<int, int> scores = {{50, 1}, {10, 2}, {40, 3}, {20, 4},
+                                         {30, 5}, {60, 6}, {70, 7}};
+    std::cout << "nth(3): " << scores.nth(3)->first << std::endl;
+    std::cout << "rank(45): " << scores.rank(45) << std::endl;
+    std::cout << "count_range(20, 60): " << scores.count_range(20, 60)
+              << std::endl;
+    std::cout << "begin() + 5: " << (scores.begin() + 5)->first << std::endl;
+    std::cout << std::endl;
+  }
+
+  // Порядковые статистики против std::map после случайных вставок и
+  // удалений: nth, rank, count_range и сдвиг итератора
+  {
+    std::mt19937 rng(5);
+    binary_tree::map<int, int> tree;
+    std::map<int, int> model;
+    bool ok = true;
+    for (int i = 0; i < 6000 && ok; ++i) {
+      int key = rng() % 1500;
+      if (rng() % 3) {
+        tree.insert(key, i);
+        model.emplace(key, i);
+      } else {
+        tree.erase(key);
+        model.erase(key);
+      }
+      if (i % 300 != 0) continue;
+      std::vector<int> keys;
+      for (const auto &item : model) keys.push_back(item.first);
+      ok = tree.valid() && tree.size() == model.size();
+      for (size_t k = 0; k < keys.size() && ok; k += 5)
+        ok = tree.nth(k)->first == keys[k] &&
+             (tree.begin() + k)->first == keys[k];
+      ok = ok && tree.nth(keys.size()) == tree.end();
+      // Число ключей модели меньше x
+      auto below = [&keys](int x) {
+        return size_t(std::lower_bound(keys.begin(), keys.end(), x) -
+                      keys.begin());
+      };
+      for (int probe = 0; probe < 50 && ok; ++probe) {
+        int lo = rng() % 1600, hi = rng() % 1600;
+        ok = tree.rank(lo) == below(lo) &&
+             tree.count_range(lo, hi) == (lo < hi ? below(hi) - below(lo) : 0);
+      }
+    }
+    std::cout << "order statistics against std::map: " << ok << std::endl;
+    std::cout << std::endl;
+    if (!ok) return 1;
+  }
+
+  // Перенос диапазона ключей между шардами
+  {
+    binary_tree::map<int, int> shard = {{1, 10}, {2, 20}, {3, 30}, {4, 40},
+                                        {5, 50}, {6, 60}};
+    binary_tree::map<int, int> upper = shard.split(4);
+    std::cout << "split(4): " << shard.size() << " + " << upper.size()
+              << ", first moved: " << upper.begin()->first << std::endl;
+    shard.join(upper);
+    std::cout << "join: " << shard.size() << ", last: " << shard.nth(5)->first
+              << std::endl;
+    std::cout << std::endl;
+  }
+
+  // split и join против std::map: разрез в случайной точке, склейка в
+  // любом порядке, инварианты и порядковые статистики после каждого шага
+  {
+    std::mt19937 rng(11);
+    bool ok = true;
+    auto same = [](const auto &tree, const std::map<int, int> &model) {
+      return tree.valid() && tree.size() == model.size() &&
+             std::equal(tree.begin(), tree.end(), model.begin(), model.end());
+    };
+    for (int round = 0; round < 200 && ok; ++round) {
+      binary_tree::map<int, int> tree;
+      binary_tree::threaded::map<int, int> threaded;
+      std::map<int, int> model;
+      for (int i = rng() % (round * 5 + 1); i > 0; --i) {
+        int key = rng() % 1000;
+        tree.insert(key, i);
+        threaded.insert(key, i);
+        model.emplace(key, i);
+      }
+      int key = rng() % 1100;
+      auto upper = tree.split(key);
+      auto threaded_upper = threaded.split(key);
+      std::map<int, int> model_upper(model.lower_bound(key), model.end());
+      model.erase(model.lower_bound(key), model.end());
+      ok = same(tree, model) && same(upper, model_upper) &&
+           same(threaded, model) && same(threaded_upper, model_upper) &&
+           (model.empty() || tree.nth(model.size() - 1)->first ==
+                                 model.rbegin()->first);
+      for (const auto &item : model_upper) model.insert(item);
+      if (round % 2) {
+        upper.join(tree);
+        threaded_upper.join(threaded);
+        ok = ok && same(upper, model) && tree.empty() &&
+             same(threaded_upper, model) && threaded.empty();
+      } else {
+        tree.join(upper);
+        threaded.join(threaded_upper);
+        ok = ok && same(tree, model) && upper.empty() &&
+             same(threaded, model) && threaded_upper.empty();
+      }
+    }
+    std::cout << "split/join against std::map: " << ok << std::endl;
+    std::cout << std::endl;
+    if (!ok) return 1;
+  }
+
+  // Узлы из монотонного буфера, освобождаются все сразу вместе с ним
+  {
+    char buffer[4096];
+    std::pmr::monotonic_buffer_resource arena(buffer, sizeof(buffer));
+    binary_tree::pmr::map<int, int> request_map(&arena);
+    for (int i = 0; i < 10; ++i) request_map.insert(i, i * i);
+    std::cout << "pmr map size: " << request_map.size()
+              << ", [7]: " << request_map[7] << std::endl;
+    std::cout << std::endl;
+  }
+
+  // Узлы в одном массиве, связи - 32-битные номера
+  {
+    binary_tree::IndexTree<uint64_t, uint32_t> ids;
+    ids.reserve(8);
+    for (uint64_t id = 8; id > 0; --id) ids.push(id * 1000, uint32_t(id));
+    ids.erase(3000);
+    ids.compact();
+    // Через итератор меняются только данные: ключ и связи узла закрыты
+    auto found = ids.lower_bound(2500);
+    found->second += 100;
+    static_assert(
+        std::is_const_v<std::remove_reference_t<decltype(found->first)>>,
+        "index tree keys are read-only");
+    std::cout << "index tree size: " << ids.size()
+              << ", lower_bound(2500): " << found->first << "=" << found->second
+              << std::endl;
+    std::cout << std::endl;
+  }
+
+  // index_map против std::map: удаления освобождают ячейки, следующие
+  // вставки занимают их снова, а compact время от времени перекладывает
+  // узлы подряд. valid проверяет красно-черные свойства и список свободных
+  {
+    std::mt19937 rng(15);
+    binary_tree::index_map<int, int> tree;
+    std::map<int, int> model;
+    bool ok = true;
+    for (int i = 0; i < 40000 && ok; ++i) {
+      int key = rng() % 3000;
+      int op = rng() % 5;
+      if (op < 2) {
+        bool inserted = tree.insert(key, key + 1).second;
+        ok = inserted == model.emplace(key, key + 1).second;
+      } else if (op == 2) {
+        tree[key] += 2;
+        model[key] += 2;
+      } else if (op == 3) {
+        ok = tree.erase(key) == model.erase(key);
+      } else if (!model.empty()) {
+        auto it = tree.lower_bound(key);
+        if (it == tree.end()) it = tree.begin();
+        model.erase(it->first);
+        tree.erase(it);
+      }
+      if (i % 1000 == 999) tree.compact();
+      if (i % 200 == 0)
+        ok = ok && tree.valid() && tree.size() == model.size();
+    }
+    // Итераторы годятся для алгоритмов: элемент - пара ссылок на узел
+    const auto &view = tree;
+    std::vector<std::pair<const int, int>> copied(view.begin(), view.end());
+    auto even = [](const auto &item) { return item.second % 2 == 0; };
+    ok = ok && tree.valid() &&
+         std::equal(copied.begin(), copied.end(), model.begin(), model.end()) &&
+         std::count_if(tree.begin(), tree.end(), even) ==
+             std::count_if(model.begin(), model.end(), even);
+    for (int key = 0; key < 3000 && ok; ++key) {
+      auto found = model.find(key);
+      ok = view.contains(key) == (found != model.end()) &&
+           (found == model.end() || view.at(key) == found->second);
+    }
+    while (!model.empty() && ok) {
+      int key = std::next(model.begin(), rng() % model.size())->first;
+      tree.erase(tree.find(key));
+      model.erase(key);
+      if (model.size() % 100 == 0) tree.compact();
+      if (model.size() % 50 == 0)
+        ok = tree.valid() && tree.size() == model.size();
+    }
+    ok = ok && tree.empty() && tree.valid();
+    std::cout << "index_map random insert/erase/compact: " << ok << std::endl;
+    std::cout << std::endl;
+    if (!ok) return 1;
+  }
+
+  // Удаление сразу отдает ресурсы данных узла, не дожидаясь повторного
+  // занятия ячейки
+  {
+    auto resource = std::make_shared<int>(7);
+    binary_tree::index_map<int, std::shared_ptr<int>> owners;
+    for (int key = 0; key < 10; ++key) owners.insert(key, resource);
+    bool ok = resource.use_count() == 11;
+    owners.erase(3);
+    owners.erase(owners.find(5));
+    ok = ok && resource.use_count() == 9 && owners.valid();
+    owners.insert(20, resource);
+    ok = ok && resource.use_count() == 10 && owners.size() == 9;
+    owners.compact();
+    ok = ok && resource.use_count() == 10 && owners.valid();
+    std::cout << "index_map erase releases data: " << ok << std::endl;
+    std::cout << std::endl;
+    if (!ok) return 1;
+  }
+
+  // Узлы без указателя на отца, итератор хранит путь от корня
+  {
+    binary_tree::StackTree<int, int> lookup = {{3, 30}, {1, 10}, {2, 20}};
+    lookup.erase(2);
+    std::cout << "stack tree:";
+    for (auto it = lookup.begin(); it != lookup.end(); ++it)
+      std::cout << " " << it->first << "=" << it->second;
+    std::cout << std::endl << std::endl;
+  }
+
+  // StackTree против std::map: вставки, удаления по ключу и по итератору
+  // из find и lower_bound. В большом дереве около трети узлов имеют двух
+  // сыновей, так что erase(iterator) часто переставляет следующий узел
+  {
+    std::mt19937 rng(16);
+    binary_tree::StackTree<int, int> tree;
+    std::map<int, int> model;
+    bool ok = true;
+    for (int i = 0; i < 40000 && ok; ++i) {
+      int key = rng() % 4000;
+      int op = rng() % 5;
+      if (op < 2) {
+        bool inserted = tree.push(key, key * 3).second;
+        ok = inserted == model.emplace(key, key * 3).second;
+      } else if (op == 2) {
+        ok = tree.erase(key) == model.erase(key);
+      } else if (op == 3) {
+        auto it = tree.find(key);
+        ok = (it != tree.end()) == model.count(key);
+        if (it != tree.end()) {
+          ok = ok && it->second == key * 3;
+          tree.erase(it);
+          model.erase(key);
+        }
+      } else if (!model.empty()) {
+        auto it = tree.lower_bound(key);
+        if (it == tree.end()) it = tree.begin();
+        model.erase(it->first);
+        tree.erase(it);
+      }
+      if (i % 200 == 0)
+        ok = ok && tree.valid() && tree.size() == model.size();
+    }
+    // Элемент итератора - пара ссылок на узел, алгоритмы работают с ней
+    const auto &view = tree;
+    auto same = [](const auto &a, const auto &b) {
+      return a.first == b.first && a.second == b.second;
+    };
+    ok = ok && tree.valid() &&
+         std::equal(view.begin(), view.end(), model.begin(), model.end(),
+                    same);
+    for (int key = 0; key < 4000 && ok; ++key) {
+      auto it = view.find(key);
+      ok = (it != view.end()) == model.count(key) &&
+           (it == view.end() || it->first == key);
+    }
+    // Проход с удалением: erase возвращает следующий узел
+    for (auto it = tree.begin(); it != tree.end();) {
+      if (it->first % 3 == 0) {
+        model.erase(it->first);
+        it = tree.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    ok = ok && tree.valid() &&
+         std::equal(tree.begin(), tree.end(), model.begin(), model.end(),
+                    same);
+    while (!model.empty() && ok) {
+      int key = std::next(model.begin(), rng() % model.size())->first;
+      tree.erase(tree.find(key));
+      model.erase(key);
+      if (model.size() % 50 == 0)
+        ok = tree.valid() && tree.size() == model.size();
+    }
+    ok = ok && tree.empty() && tree.valid();
+    std::cout << "stack tree random insert/erase: " << ok << std::endl;
+    std::cout << std::endl;
+    if (!ok) return 1;
+  }
+
+  // Снимок только для чтения
+  {
+    binary_tree::map<int, std::string> config = {
+        {1, "one"}, {4, "four"}, {9, "nine"}, {16, "sixteen"}};
+    auto frozen = config.freeze();
+    std::cout << "frozen lower_bound(5): " << frozen.lower_bound(5)->second
+              << ", contains(4): " << frozen.contains(4) << std::endl;
+    std::cout << std::endl;
+  }
+
+  // Снимок словаря с bool: it->second ссылается на данные снимка
+  {
+    binary_tree::map<int, bool> flags;
+    for (int key = 0; key < 10; ++key) flags.insert(key, key % 2 == 1);
+    auto frozen = flags.freeze();
+    int total = 0;
+    for (auto it = frozen.begin(); it != frozen.end(); ++it)
+      total += it->second;
+    // Итераторы снимка годятся для алгоритмов
+    auto set = [](const auto &item) { return item.second; };
+    auto by_key = [](const auto &a, const auto &b) {
+      return a.first < b.first;
+    };
+    bool ok = total == 5 && frozen.find(3)->second &&
+              !frozen.find(4)->second && (*frozen.find(7)).second &&
+              std::count_if(frozen.begin(), frozen.end(), set) == 5 &&
+              std::is_sorted(frozen.begin(), frozen.end(), by_key);
+    std::cout << "frozen map<int, bool>: " << ok << std::endl;
+    std::cout << std::endl;
+    if (!ok) return 1;
+  }
+
+  // Снимок ищет в порядке Compare исходного словаря: по убыванию для
+  // std::greater и через знак сравнения для three_way
+  {
+    binary_tree::map<int, int, std::allocator<std::pair<const int, int>>,
+                     std::greater<int>>
+        descending;
+    binary_tree::map<int, int, std::allocator<std::pair<const int, int>>,
+                     binary_tree::three_way>
+        signed_order;
+    std::map<int, int> model;
+    for (int key = 1; key < 100; key += 2) {
+      descending.insert(key, key * 10);
+      signed_order.insert(key, key * 10);
+      model[key] = key * 10;
+    }
+    auto down = descending.freeze();
+    auto by_sign = signed_order.freeze();
+    bool ok = down.begin()->first == 99 && by_sign.begin()->first == 1;
+    for (int key = 0; key <= 100 && ok; ++key) {
+      bool present = model.count(key) != 0;
+      ok = down.contains(key) == present && by_sign.contains(key) == present &&
+           (!present || (down.find(key)->second == key * 10 &&
+                         by_sign.find(key)->second == key * 10));
+      // Первый ключ не меньше key в порядке убывания - это ключ <= key
+      auto below = model.upper_bound(key);
+      bool has_below = below != model.begin();
+      auto bound = down.lower_bound(key);
+      ok = ok && (has_below ? bound != down.end() &&
+                                  bound->first == std::prev(below)->first
+                            : bound == down.end());
+    }
+    std::cout << "frozen snapshot with greater and three_way: " << ok
+              << std::endl;
+    std::cout << std::endl;
+    if (!ok) return 1;
+  }
+
+  // Тот же интерфейс на B+-дереве
+  {
+    binary_tree::btree_map<int, std::string> routes = {{80, "http"},
+                                                       {443, "https"}};
+    routes[22] = "ssh";
+    routes.insert_or_assign(80, "http-alt");
+    std::cout << "btree_map size: " << routes.size()
+              << ", at(80): " << routes.at(80)
+              << ", first: " << routes.begin()->first << std::endl;
+    std::cout << std::endl;
+  }
+
+  // Словарь на упорядоченных массивах: пачка вставляется одним слиянием
+  {
+    std::vector<std::pair<int, std::string>> batch = {
+        {3, "three"}, {1, "one"}, {2, "two"}, {1, "uno"}};
+    binary_tree::flat_map<int, std::string> config;
+    config.insert(batch.begin(), batch.end());
+    std::cout << "flat_map:";
+    for (auto it = config.begin(); it != config.end(); ++it)
+      std::cout << " " << it->first << "=" << it->second;
+    std::cout << ", floor(5): " << config.floor(5)->first << std::endl;
+    std::cout << std::endl;
+  }
+
+  // Пачка с уже имеющимися и новыми ключами: имеющиеся данные не меняются,
+  // из повторов внутри пачки остается первый, как у std::map::insert
+  {
+    auto check = [](auto flat, auto model, auto make_key, unsigned seed) {
+      std::mt19937 rng(seed);
+      bool ok = true;
+      for (int round = 0; round < 300 && ok; ++round) {
+        std::vector<std::pair<decltype(make_key(0)), std::string>> batch;
+        size_t length = rng() % 12;
+        for (size_t i = 0; i < length; ++i)
+          batch.emplace_back(make_key(rng() % 400),
+                             std::string(20, char('a' + round % 26)));
+        flat.insert(batch.begin(), batch.end());
+        model.insert(batch.begin(), batch.end());
+        ok = flat.size() == model.size() &&
+             std::equal(flat.begin(), flat.end(), model.begin(), model.end(),
+                        [](const auto &a, const auto &b) {
+                          return a.first == b.first && a.second == b.second;
+                        });
+      }
+      return ok;
+    };
+    binary_tree::flat_map<int, std::string> small = {
+        {1, "one"}, {2, "two"}, {3, "three"}};
+    std::vector<std::pair<int, std::string>> batch = {{2, "x"}, {9, "nine"}};
+    small.insert(batch.begin(), batch.end());
+    bool ok = small.size() == 4 && small.at(2) == "two" &&
+              small.at(3) == "three" && small.at(9) == "nine";
+    ok = ok &&
+         check(binary_tree::flat_map<int, std::string>(),
+               std::map<int, std::string>(), [](int key) { return key; }, 3) &&
+         check(binary_tree::flat_map<std::string, std::string>(),
+               std::map<std::string, std::string>(),
+               [](int key) { return "key-" + std::to_string(key); }, 4);
+    std::cout << "flat_map batch insert with duplicates: " << ok << std::endl;
+    std::cout << std::endl;
+    if (!ok) return 1;
+  }
+
+  // join плоского словаря: непересекающиеся ключи дописываются с любой
+  // стороны, пересекающиеся сливаются, общие ключи берут данные *this
+  {
+    using flat = binary_tree::flat_map<int, int>;
+    bool ok = true;
+    auto check = [&ok](flat joined, flat other, std::map<int, int> model) {
+      joined.join(other);
+      ok = ok && other.empty() && joined.size() == model.size() &&
+           std::equal(joined.begin(), joined.end(), model.begin(),
+                      model.end(), [](const auto &a, const auto &b) {
+                        return a.first == b.first && a.second == b.second;
+                      });
+      for (const auto &[key, value] : model)
+        ok = ok && joined.contains(key) && joined.at(key) == value;
+    };
+    check(flat{{1, 1}, {5, 5}, {9, 9}}, flat{{3, 30}, {7, 70}},
+          {{1, 1}, {3, 30}, {5, 5}, {7, 70}, {9, 9}});
+    check(flat{{1, 1}, {5, 5}}, flat{{5, 50}, {6, 60}},
+          {{1, 1}, {5, 5}, {6, 60}});
+    check(flat{{10, 1}}, flat{{1, 2}, {5, 3}}, {{1, 2}, {5, 3}, {10, 1}});
+    std::cout << "flat_map join with overlapping keys: " << ok << std::endl;
+    std::cout << std::endl;
+    if (!ok) return 1;
+  }
+
+  // Флаги настроек: flat_map<std::string, bool> отдает настоящие ссылки
+  // bool & через at(), operator[] и итераторы
+  {
+    binary_tree::flat_map<std::string, bool> flags = {{"beta", false},
+                                                      {"audit", true}};
+    flags["cache"] = true;
+    flags.at("beta") = true;
+    std::vector<std::pair<std::string, bool>> batch = {
+        {"audit", false}, {"dark-mode", false}, {"zstd", true}};
+    flags.insert(batch.begin(), batch.end());
+    for (auto it = flags.begin(); it != flags.end(); ++it)
+      if (it->first == "dark-mode") it->second = true;
+    bool &zstd = flags.find("zstd")->second;
+    zstd = false;
+    const auto &view = flags;
+    int enabled = 0;
+    for (auto it = view.begin(); it != view.end(); ++it) enabled += it->second;
+    bool ok = flags.size() == 5 && enabled == 4 && view.at("audit") &&
+              !view.at("zstd") && (*view.begin()).first == "audit";
+    std::cout << "flat_map<std::string, bool>: " << ok << std::endl;
+    std::cout << std::endl;
+    if (!ok) return 1;
+  }
+
+  // flat_map с Compare, как у map: по убыванию для std::greater, через знак
+  // сравнения для three_way и поиск по string_view для std::less<>
+  {
+    binary_tree::flat_map<int, int, std::allocator<std::pair<const int, int>>,
+                          std::greater<int>>
+        descending;
+    binary_tree::flat_map<std::string, int,
+                          std::allocator<std::pair<const std::string, int>>,
+                          binary_tree::three_way>
+        by_sign;
+    binary_tree::flat_map<std::string, int,
+                          std::allocator<std::pair<const std::string, int>>,
+                          std::less<>>
+        headers = {{"Host", 1}, {"Accept", 2}, {"Cookie", 3}};
+    std::map<int, int, std::greater<int>> model;
+    std::map<std::string, int> words;
+    std::vector<std::pair<int, int>> batch;
+    for (int i = 0; i < 500; ++i) {
+      int key = (i * 211) % 500;
+      if (i % 2)
+        descending.insert(key, -key);
+      else
+        batch.emplace_back(key, -key);
+      model.emplace(key, -key);
+      by_sign[std::to_string(key)] = key;
+      words[std::to_string(key)] = key;
+    }
+    descending.insert(batch.begin(), batch.end());
+    auto tail = descending.split(100);
+    descending.join(tail);
+    auto same = [](const auto &a, const auto &b) {
+      return a.first == b.first && a.second == b.second;
+    };
+    std::string_view name = "Cookie: id=1";
+    name = name.substr(0, name.find(':'));
+    bool ok = std::equal(descending.begin(), descending.end(), model.begin(),
+                         model.end(), same) &&
+              std::equal(by_sign.begin(), by_sign.end(), words.begin(),
+                         words.end(), same) &&
+              descending.lower_bound(1000)->first == 499 &&
+              descending.floor(250)->first == 250 &&
+              descending.upper_bound(250)->first == 249 &&
+              descending.count_range(300, 200) == 100 &&
+              by_sign.find("42")->second == 42 &&
+              headers.find(name)->second == 3 && headers.contains(name) &&
+              headers.erase(name) == 1 && !headers.contains(name);
+    std::cout << "flat_map with greater, three_way and less<>: " << ok
+              << std::endl;
+    std::cout << std::endl;
+    if (!ok) return 1;
+  }
+
+  // Операции flat_map с самим собой не теряют элементы, а временный массив
+  // пачки берется из того же pmr-ресурса, что и сами массивы
+  {
+    struct counting_resource : std::pmr::memory_resource {
+      std::vector<size_t> sizes;
+      void *do_allocate(size_t bytes, size_t align) override {
+        sizes.push_back(bytes);
+        return std::pmr::new_delete_resource()->allocate(bytes, align);
+      }
+      void do_deallocate(void *ptr, size_t bytes, size_t align) override {
+        std::pmr::new_delete_resource()->deallocate(ptr, bytes, align);
+      }
+      bool do_is_equal(
+          const std::pmr::memory_resource &other) const noexcept override {
+        return this == &other;
+      }
+    } resource;
+    binary_tree::flat_map<int, int> self = {{1, 10}, {2, 20}};
+    self.merge(self);
+    self.set_union(self);
+    self.set_intersection(self);
+    self.join(self);
+    bool ok = self.size() == 2 && self.at(2) == 20;
+    auto difference = self, symmetric = self;
+    difference.set_difference(difference);
+    symmetric.symmetric_difference(symmetric);
+    ok = ok && difference.empty() && symmetric.empty();
+    std::vector<std::pair<int, int>> input;
+    for (int i = 64; i > 0; --i) input.emplace_back(i, -i);
+    binary_tree::pmr::flat_map<int, int> arena_map(&resource);
+    arena_map.insert(input.begin(), input.end());
+    size_t batch_bytes = input.size() * sizeof(std::pair<int, int>);
+    ok = ok && arena_map.size() == 64 && arena_map.at(64) == -64 &&
+         std::count(resource.sizes.begin(), resource.sizes.end(),
+                    batch_bytes) == 1;
+    std::cout << "flat_map self operations and pmr batch: " << ok
+              << std::endl;
+    std::cout << std::endl;
+    if (!ok) return 1;
+  }
+
+  // Итераторы btree_map и flat_map отдают пару ссылок first/second и
+  // работают со стандартными алгоритмами
+  {
+    binary_tree::btree_map<int, int> btree;
+    binary_tree::flat_map<int, int> flat;
+    std::map<int, int> model;
+    for (int i = 0; i < 300; ++i) {
+      int key = (i * 71) % 300;
+      btree.insert(key, -key);
+      flat.insert(key, -key);
+      model.emplace(key, -key);
+    }
+    for (auto it = btree.begin(); it != btree.end(); ++it) it->second *= 2;
+    for (auto it = flat.begin(); it != flat.end(); ++it) it->second *= 2;
+    for (auto &item : model) item.second *= 2;
+    auto same = [](const auto &a, const auto &b) {
+      return a.first == b.first && a.second == b.second;
+    };
+    std::vector<std::pair<int, int>> from_btree(btree.begin(), btree.end());
+    std::vector<std::pair<int, int>> from_flat(flat.begin(), flat.end());
+    const auto &const_flat = flat;
+    bool ok =
+        std::equal(btree.begin(), btree.end(), model.begin(), model.end(),
+                   same) &&
+        std::equal(const_flat.begin(), const_flat.end(), model.begin(),
+                   model.end(), same) &&
+        std::equal(from_btree.begin(), from_btree.end(), model.begin(),
+                   model.end(), same) &&
+        std::equal(from_flat.begin(), from_flat.end(), model.begin(),
+                   model.end(), same) &&
+        std::distance(btree.begin(), btree.end()) == 300 &&
+        std::find_if(flat.begin(), flat.end(), [](const auto &item) {
+          return item.second == -20;
+        })->first == 10 &&
+        &btree.find(7)->second == &btree.at(7);
+    std::cout << "btree_map and flat_map standard iterators: " << ok
+              << std::endl;
+    std::cout << std::endl;
+    if (!ok) return 1;
+  }
+
+  // B+-дерево против std::map: случайные вставки и удаления по ключу и по
+  // итератору с делениями и слияниями листьев и внутренних узлов. Удаление
+  // по итератору возвращает тот же следующий элемент, что и std::map
+  {
+    std::mt19937 rng(18);
+    binary_tree::btree_map<int, std::string> tree;
+    std::map<int, std::string> model;
+    bool ok = true;
+    int max_depth = 0;
+    for (int i = 0; i < 60000 && ok; ++i) {
+      int key = rng() % 6000;
+      int op = rng() % 5;
+      if (op < 3) {
+        tree.insert(key, std::to_string(key));
+        model.emplace(key, std::to_string(key));
+      } else if (op == 3) {
+        ok = tree.erase(key) == model.erase(key);
+      } else if (!model.empty()) {
+        auto it = tree.lower_bound(key);
+        if (it == tree.end()) it = tree.begin();
+        auto next = model.erase(model.find(it->first));
+        it = tree.erase(it);
+        ok = next == model.end() ? it == tree.end()
+                                 : it != tree.end() && it->first == next->first;
+      }
+      max_depth = std::max(max_depth, tree.depth());
+      if (i % 200 == 0)
+        ok = ok && tree.valid() && tree.size() == model.size();
+    }
+    auto same = [](const auto &a, const auto &b) {
+      return a.first == b.first && a.second == b.second;
+    };
+    ok = ok && max_depth >= 2 &&
+         std::equal(tree.begin(), tree.end(), model.begin(), model.end(),
+                    same);
+    while (!model.empty() && ok) {
+      int key = std::next(model.begin(), rng() % model.size())->first;
+      tree.erase(key);
+      model.erase(key);
+      if (model.size() % 50 == 0)
+        ok = tree.valid() && tree.size() == model.size();
+    }
+    ok = ok && tree.empty() && tree.valid();
+    std::cout << "btree_map random insert/erase, depth " << max_depth << ": "
+              << ok << std::endl;
+    std::cout << std::endl;
+    if (!ok) return 1;
+  }
+
+  // Исключение при копировании ключа или данных в push оставляет дерево
+  // прежним, в том числе при делении листа
+  {
+    binary_tree::btree_map<Fragile, Fragile> tree;
+    std::map<int, int> model;
+    bool ok = true;
+    for (int i = 0; i < 3000 && ok; ++i) {
+      int key = (i * 7919) % 3000;
+      Fragile::fail = i % 3 == 0;
+      try {
+        tree.insert(Fragile(key), Fragile(-key));
+        ok = !Fragile::fail;
+        model.emplace(key, -key);
+      } catch (const std::bad_alloc &) {
+        ok = Fragile::fail;
+      }
+      Fragile::fail = false;
+      if (i % 100 == 0) ok = ok && tree.valid() && tree.size() == model.size();
+    }
+    ok = ok && tree.valid() && tree.depth() >= 1 &&
+         std::equal(tree.begin(), tree.end(), model.begin(), model.end(),
+                    [](const auto &a, const auto &b) {
+                      return a.first.value == b.first &&
+                             a.second.value == b.second;
+                    });
+    std::cout << "btree_map push is exception safe: " << ok << std::endl;
+    std::cout << std::endl;
+    if (!ok) return 1;
+  }
+
+  // B+-дерево с Compare, как у map: порядок по убыванию для std::greater,
+  // знак сравнения для three_way и поиск по string_view для std::less<>
+  {
+    binary_tree::btree_map<int, int, std::allocator<std::pair<const int, int>>,
+                           std::greater<int>>
+        descending;
+    binary_tree::btree_map<std::string, int,
+                           std::allocator<std::pair<const std::string, int>>,
+                           binary_tree::three_way>
+        by_sign;
+    binary_tree::btree_map<std::string, int,
+                           std::allocator<std::pair<const std::string, int>>,
+                           std::less<>>
+        headers;
+    std::map<int, int, std::greater<int>> model;
+    std::map<std::string, int> words;
+    for (int i = 0; i < 2000; ++i) {
+      int key = (i * 613) % 2000;
+      descending.insert(key, -key);
+      model.emplace(key, -key);
+      by_sign.insert(std::to_string(key), key);
+      headers.insert(std::to_string(key), key);
+      words.emplace(std::to_string(key), key);
+    }
+    for (int key = 0; key < 2000; key += 3) {
+      descending.erase(key);
+      model.erase(key);
+    }
+    auto same = [](const auto &a, const auto &b) {
+      return a.first == b.first && a.second == b.second;
+    };
+    std::string_view name = "1234: value";
+    name = name.substr(0, name.find(':'));
+    bool ok = descending.valid() && by_sign.valid() && headers.valid() &&
+              std::equal(descending.begin(), descending.end(), model.begin(),
+                         model.end(), same) &&
+              std::equal(by_sign.begin(), by_sign.end(), words.begin(),
+                         words.end(), same) &&
+              descending.lower_bound(999)->first == 998 &&
+              descending.upper_bound(998)->first == 997 &&
+              by_sign.find("777")->second == 777 &&
+              headers.find(name)->second == 1234 && headers.contains(name) &&
+              headers.lower_bound(name)->first == "1234" &&
+              headers.erase(name) == 1 && !headers.contains(name);
+    std::cout << "btree_map with greater, three_way and less<>: " << ok
+              << std::endl;
+    std::cout << std::endl;
+    if (!ok) return 1;
+  }
+
+  // merge на B+-дереве: ключи other, которых нет в *this, переходят в него,
+  // общие ключи сохраняют данные *this, other становится пустым
+  {
+    binary_tree::btree_map<int, int> target, source;
+    std::map<int, int> model;
+    for (int i = 0; i < 500; i += 2) {
+      target[i] = i;
+      model[i] = i;
+    }
+    for (int i = 0; i < 750; i += 3) {
+      source[i] = -i;
+      model.emplace(i, -i);
+    }
+    target.merge(source);
+    target.merge(target);
+    bool ok = source.empty() && target.size() == model.size() &&
+              std::equal(target.begin(), target.end(), model.begin(),
+                         model.end(), [](const auto &a, const auto &b) {
+                           return a.first == b.first && a.second == b.second;
+                         });
+    std::cout << "btree_map merge: " << ok << std::endl;
+    std::cout << std::endl;
+    if (!ok) return 1;
+  }
+
+  // merge непересекающихся B+-деревьев разной высоты сшивает их целыми
+  // листьями: other справа и слева от *this, инварианты и порядок сохранены
+  {
+    std::mt19937 rng(31);
+    bool ok = true;
+    for (int round = 0; round < 200 && ok; ++round) {
+      binary_tree::btree_map<int, int> low, high;
+      std::map<int, int> model;
+      int low_size = rng() % (round < 100 ? 100 : 5000);
+      int high_size = rng() % (round % 2 ? 100 : 5000);
+      for (int i = 0; i < low_size; ++i) {
+        int key = rng() % 100000;
+        low.insert(key, -key);
+        model.emplace(key, -key);
+      }
+      for (int i = 0; i < high_size; ++i) {
+        int key = 100000 + rng() % 100000;
+        high.insert(key, -key);
+        model.emplace(key, -key);
+      }
+      if (round % 4 < 2) {
+        low.merge(high);
+      } else {
+        high.merge(low);
+        low.swap(high);
+      }
+      ok = low.valid() && high.empty() && high.valid() &&
+           low.size() == model.size() &&
+           std::equal(low.begin(), low.end(), model.begin(), model.end(),
+                      [](const auto &a, const auto &b) {
+                        return a.first == b.first && a.second == b.second;
+                      });
+    }
+    std::cout << "btree_map merge of disjoint trees: " << ok << std::endl;
+    std::cout << std::endl;
+    if (!ok) return 1;
+  }
+
+  // operator[] строит данные по умолчанию только для нового ключа (ячейки
+  // листа строятся вместе с ним, поэтому считаются только повторные вызовы)
+  {
+    binary_tree::btree_map<int, Counted> tree;
+    tree[1].value = 5;
+    int made = Counted::made;
+    bool ok = true;
+    for (int i = 0; i < 10; ++i) ok = ok && tree[1].value == 5;
+    ok = ok && Counted::made == made && tree.size() == 1;
+    std::cout << "btree_map operator[] on hit: " << ok << std::endl;
+    binary_tree::index_map<int, Counted> index;
+    index[1].value = 5;
+    made = Counted::made;
+    for (int i = 0; i < 10; ++i) ok = ok && index[1].value == 5;
+    ok = ok && Counted::made == made && index.size() == 1;
+    index[2];
+    ok = ok && Counted::made == made + 1 && index.size() == 2;
+    std::cout << "index_map operator[] on hit: " << ok << std::endl;
+    std::cout << std::endl;
+    if (!ok) return 1;
+  }
+
+  // Прозрачный компаратор: поиск по string_view без временной строки
+  {
+    binary_tree::map<std::string, int,
+                     std::allocator<std::pair<const std::string, int>>,
+                     std::less<>>
+        headers = {{"Host", 1}, {"Accept", 2}};
+    std::string_view name = "Host: example.org";
+    name = name.substr(0, name.find(':'));
+    std::cout << "transparent find(" << name
+              << "): " << headers.find(name)->second
+              << ", contains(\"Cookie\"): " << headers.contains("Cookie")
+              << std::endl;
+    std::cout << std::endl;
+  }
+
+  // Трехсторонний компаратор: одно сравнение строк на уровень спуска
+  {
+    binary_tree::map<std::string, int,
+                     std::allocator<std::pair<const std::string, int>>,
+                     binary_tree::three_way>
+        words = {{"pear", 3}, {"apple", 1}, {"kiwi", 2}};
+    std::cout << "three_way order:";
+    for (auto it = words.begin(); it != words.end(); ++it)
+      std::cout << " " << it->first;
+    std::cout << ", find(\"kiwi\"): " << words.find("kiwi")->second
+              << std::endl;
+    std::cout << std::endl;
+  }
+
+  // try_emplace и node handle: значение строится в узле, узел переходит
+  // в другой контейнер без копирования
+  {
+    binary_tree::map<int, std::string> from, to;
+    from.try_emplace(1, 3, 'a');
+    from.emplace(2, std::string("bb"));
+    auto handle = from.extract(1);
+    handle.key() = 10;
+    auto result = to.insert(std::move(handle));
+    std::cout << "node handle: inserted " << result.inserted << ", key "
+              << result.position->first << ", value " << result.position->second
+              << ", left in source: " << from.size() << std::endl;
+    std::cout << std::endl;
+  }
+
+  // Итератор отдает ссылку на пару из узла: обход и стандартные алгоритмы
+  // работают без копий
+  {
+    binary_tree::map<int, std::string> ports = {
+        {22, "ssh"}, {80, "http"}, {443, "https"}};
+    std::string joined;
+    for (const auto &[port, name] : ports) joined += name + " ";
+    auto found = std::find_if(ports.begin(), ports.end(),
+                              [](const auto &item) { return item.first > 50; });
+    found->second += "-alt";
+    std::cout << "range for: " << joined << "find_if(> 50): " << found->first
+              << "=" << ports.at(80) << std::endl;
+    std::cout << std::endl;
+  }
+
+  // Дерево с нитями: ++ и -- идут по ссылке на соседа, for_each заранее
+  // подгружает узлы впереди
+  {
+    binary_tree::threaded::map<int, int> squares;
+    for (int i = 5; i >= 1; --i) squares.insert(i, i * i);
+    squares.erase(3);
+    long sum = 0;
+    squares.for_each([&sum](const auto &item) { sum += item.second; });
+    auto last = --squares.end();
+    std::cout << "threaded: last " << last->first << "=" << last->second
+              << ", sum " << sum << std::endl;
+    std::cout << std::endl;
+  }
+
+  // merge с пересекающимися ключами: повторов нет, порядок сохранен, для
+  // общих ключей остаются значения *this, other пуст, слияние с самим собой
+  // ничего не меняет. Проверяется и дерево с нитями, и разные pmr-ресурсы
+  {
+    auto check = [](auto target, auto source) {
+      std::map<int, int> model;
+      for (int i = 0; i < 400; i += 2) {
+        target[i] = i;
+        model[i] = i;
+      }
+      for (int i = 0; i < 600; i += 3) {
+        source[i] = -i;
+        model.emplace(i, -i);
+      }
+      target.merge(source);
+      target.merge(target);
+      std::vector<std::pair<int, int>> forward, backward;
+      for (auto it = target.begin(); it != target.end(); ++it)
+        forward.emplace_back(it->first, it->second);
+      for (auto it = target.end(); it != target.begin();) {
+        --it;
+        backward.emplace_back(it->first, it->second);
+      }
+      std::vector<std::pair<int, int>> expected(model.begin(), model.end());
+      return target.valid() && source.empty() &&
+             target.size() == model.size() && forward == expected &&
+             std::equal(backward.begin(), backward.end(), expected.rbegin(),
+                        expected.rend());
+    };
+    std::pmr::monotonic_buffer_resource first_arena, second_arena;
+    bool ok = check(binary_tree::map<int, int>(),
+                    binary_tree::map<int, int>()) &&
+              check(binary_tree::threaded::map<int, int>(),
+                    binary_tree::threaded::map<int, int>()) &&
+              check(binary_tree::pmr::map<int, int>(&first_arena),
+                    binary_tree::pmr::map<int, int>(&second_arena));
+    std::cout << "merge with overlapping keys: " << ok << std::endl;
+    std::cout << std::endl;
+    if (!ok) return 1;
+  }
+
+  // Копия больше parallel_copy_min собирается в несколько потоков: она
+  // корректна, совпадает с оригиналом и не делит с ним узлы
+  {
+    using big_map = binary_tree::map<int, int>;
+    std::mt19937 rng(9);
+    big_map original;
+    std::map<int, int> model;
+    const size_t count =
+        3 * binary_tree::BinaryTree<int, int>::parallel_copy_min;
+    while (model.size() < count) {
+      int key = rng() % 1000000;
+      original[key] = key / 2;
+      model[key] = key / 2;
+    }
+    big_map copy(original);
+    big_map assigned;
+    assigned = original;
+    auto same = [&model](const big_map &tree) {
+      return tree.valid() && tree.size() == model.size() &&
+             std::equal(tree.begin(), tree.end(), model.begin(), model.end());
+    };
+    bool ok = same(copy) && same(assigned);
+    copy.begin()->second = -1;
+    copy.erase(copy.find(model.rbegin()->first));
+    ok = ok && same(original) && copy.valid();
+    std::cout << "parallel copy of " << model.size() << " keys: " << ok
+              << std::endl;
+    std::cout << std::endl;
+    if (!ok) return 1;
+  }
+
+  // Вставка за один спуск: для существующего ключа все виды вставки
+  // возвращают найденный элемент и не трогают его данные, try_emplace не
+  // забирает аргумент, insert_or_assign и operator[] меняют данные
+  {
+    std::mt19937 rng(23);
+    binary_tree::map<int, std::string> our_map;
+    std::map<int, std::string> std_map;
+    bool ok = true;
+    for (int i = 0; i < 20000 && ok; ++i) {
+      int key = rng() % 2000;
+      std::string value = std::to_string(i);
+      std::pair<binary_tree::map<int, std::string>::iterator, bool> result;
+      std::pair<std::map<int, std::string>::iterator, bool> expected;
+      switch (rng() % 5) {
+        case 0:
+          result = our_map.insert({key, value});
+          expected = std_map.insert({key, value});
+          break;
+        case 1:
+          result = our_map.emplace(key, value);
+          expected = std_map.emplace(key, value);
+          break;
+        case 2: {
+          std::string moved = value;
+          result = our_map.try_emplace(key, std::move(moved));
+          expected = std_map.try_emplace(key, value);
+          ok = result.second || moved == value;
+          break;
+        }
+        case 3:
+          result = our_map.insert_or_assign(key, value);
+          expected = std_map.insert_or_assign(key, value);
+          break;
+        default:
+          our_map[key] = value;
+          std_map[key] = value;
+          result = {our_map.find(key), true};
+          expected = {std_map.find(key), true};
+          break;
+      }
+      ok = ok && result.second == expected.second &&
+           result.first != our_map.end() && *result.first == *expected.first;
+      if (i % 100 == 0)
+        ok = ok && our_map.valid() && our_map.size() == std_map.size();
+    }
+    ok = ok && std::equal(our_map.begin(), our_map.end(), std_map.begin(),
+                          std_map.end());
+    std::cout << "unique insert, existing keys untouched: " << ok << std::endl;
+    std::cout << std::endl;
+    if (!ok) return 1;
+  }
+
   // Очистка контейнера
   myMap.clear();
   std::cout << "myMap size after clear: " << myMap.size() << std::endl;
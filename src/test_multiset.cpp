@@ -1,5 +1,10 @@
+#include <algorithm>
 #include <iostream>
-#include "s21_multiset.h"
+#include <iterator>
+#include <random>
+#include <set>
+#include <vector>
+#include "multiset.h"
 
 int main() {
   // Создаем объект multiset
@@ -110,6 +115,138 @@ int main() {
   ms.print_tree();
   std::cout << std::endl;
 
+  // Много повторов одного ключа хранятся в одном узле
+  binary_tree::multiset<int> hot = {5, 1, 9};
+  for (int i = 0; i < 100000; ++i) hot.insert(7);
+  std::cout << "hot size: " << hot.size() << ", count of 7: " << hot.count(7)
+            << std::endl;
+  hot.erase(hot.find(7));
+  std::cout << "after erasing one 7: " << hot.count(7) << std::endl;
+  std::cout << "erase all 7: " << hot.erase(7) << ", size: " << hot.size()
+            << std::endl;
+  hot.insert(5);
+  std::cout << "hot contents: ";
+  for (auto it = hot.begin(); it != hot.end(); ++it) {
+    std::cout << *it << " ";
+  }
+  std::cout << std::endl;
+  std::cout << "reverse: ";
+  for (auto it = hot.end(); it != hot.begin();) {
+    std::cout << *--it << " ";
+  }
+  std::cout << std::endl;
+
+  // Сборка из упорядоченного входа с повторами: повторы ложатся в один
+  // узел, дерево корректно и совпадает с std::multiset
+  bool ok = true;
+  for (int n = 0; n <= 200 && ok; ++n) {
+    std::vector<int> keys;
+    for (int i = 0; i < n; ++i) keys.insert(keys.end(), 1 + i % 4, i);
+    binary_tree::multiset<int> built(keys.begin(), keys.end());
+    std::multiset<int> model(keys.begin(), keys.end());
+    ok = built.valid() && built.size() == model.size() &&
+         std::equal(built.begin(), built.end(), model.begin(), model.end());
+  }
+  std::cout << "bulk build with repeats: " << ok << std::endl;
+  if (!ok) return 1;
+
+  // Node handle несет ровно один элемент: extract уменьшает счетчик узла на
+  // один, insert добавляет один повтор, веса порядковой статистики сходятся
+  {
+    binary_tree::multiset<int> source = {1, 2, 2, 2, 3};
+    binary_tree::multiset<int> target = {2, 4, 4};
+    auto handle = source.extract(2);
+    ok = !handle.empty() && handle.value() == 2 && source.count(2) == 2 &&
+         source.size() == 4 && source.valid();
+    target.insert(std::move(handle));
+    ok = ok && handle.empty() && target.count(2) == 2 && target.size() == 4;
+    // Ключ вынутого узла меняется перед вставкой
+    handle = source.extract(source.find(3));
+    handle.value() = 5;
+    target.insert(std::move(handle));
+    handle = source.extract(2);
+    handle.value() = 4;
+    target.insert(std::move(handle));
+    std::multiset<int> model = {2, 2, 4, 4, 4, 5};
+    ok = ok && target.valid() && source.valid() && source.size() == 2 &&
+         target.size() == model.size() &&
+         std::equal(target.begin(), target.end(), model.begin(), model.end());
+    for (size_t k = 0; k < model.size() && ok; ++k)
+      ok = *target.nth(k) == *std::next(model.begin(), k);
+    ok = ok && target.rank(5) == 5 && target.count_range(3, 6) == 4;
+  }
+  std::cout << "node handle moves one element: " << ok << std::endl;
+  if (!ok) return 1;
+
+  // Операции над мультимножествами против std::set_* и std::merge на
+  // отсортированных диапазонах с повторами: ключ входит max(a, b), min(a, b),
+  // a - b, |a - b| и a + b раз, other пуст, веса узлов сходятся
+  {
+    std::mt19937 rng(22);
+    auto check = [&ok](auto ours, auto other, const std::multiset<int> &a,
+                       const std::multiset<int> &b, auto operation,
+                       auto algorithm) {
+      std::vector<int> expected;
+      algorithm(a.begin(), a.end(), b.begin(), b.end(),
+                std::back_inserter(expected));
+      operation(ours, other);
+      ok = ok && ours.valid() && other.empty() && other.valid() &&
+           ours.size() == expected.size() &&
+           std::equal(ours.begin(), ours.end(), expected.begin(),
+                      expected.end());
+      for (size_t k = 0; k < expected.size() && ok; k += 7)
+        ok = *ours.nth(k) == expected[k];
+    };
+    for (int round = 0; round < 60 && ok; ++round) {
+      std::multiset<int> a, b;
+      int range = 5 + round * 5;
+      int size_a = rng() % (round * 10 + 1), size_b = rng() % (round * 10 + 1);
+      for (int i = 0; i < size_a; ++i) a.insert(rng() % range);
+      for (int i = 0; i < size_b; ++i) b.insert(rng() % range);
+      auto run = [&](auto tag) {
+        using Set = decltype(tag);
+        Set ours(a.begin(), a.end()), other(b.begin(), b.end());
+        check(ours, other, a, b, [](Set &x, Set &y) { x.set_union(y); },
+              [](auto... args) { return std::set_union(args...); });
+        check(ours, other, a, b,
+              [](Set &x, Set &y) { x.set_intersection(y); },
+              [](auto... args) { return std::set_intersection(args...); });
+        check(ours, other, a, b,
+              [](Set &x, Set &y) { x.set_difference(y); },
+              [](auto... args) { return std::set_difference(args...); });
+        check(ours, other, a, b,
+              [](Set &x, Set &y) { x.symmetric_difference(y); },
+              [](auto... args) {
+                return std::set_symmetric_difference(args...);
+              });
+        check(ours, other, a, b, [](Set &x, Set &y) { x.merge(y); },
+              [](auto... args) { return std::merge(args...); });
+      };
+      run(binary_tree::multiset<int>());
+      run(binary_tree::threaded::multiset<int>());
+    }
+  }
+  std::cout << "multiset algebra against std::set_*: " << ok << std::endl;
+  if (!ok) return 1;
+
+  // join складывает повторы общего ключа на стыке в один узел, а при
+  // пересечении диапазонов работает как merge
+  {
+    binary_tree::multiset<int> left = {1, 2, 2}, right = {2, 3};
+    left.join(right);
+    std::multiset<int> model = {1, 2, 2, 2, 3};
+    ok = left.valid() && right.empty() && left.count(2) == 3 &&
+         left.size() == model.size() &&
+         std::equal(left.begin(), left.end(), model.begin(), model.end());
+    binary_tree::multiset<int> wide = {1, 5, 5, 9}, inner = {3, 5, 7};
+    wide.join(inner);
+    model = {1, 3, 5, 5, 5, 7, 9};
+    ok = ok && wide.valid() && inner.empty() && wide.count(5) == 3 &&
+         wide.size() == model.size() &&
+         std::equal(wide.begin(), wide.end(), model.begin(), model.end());
+  }
+  std::cout << "join with a shared boundary key: " << ok << std::endl;
+  if (!ok) return 1;
 
   return 0;
 }
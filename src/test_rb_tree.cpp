@@ -1,4 +1,6 @@
 #include <iostream>
+#include <random>
+#include <set>
 #include "rb_tree.h"
 
 using std::cout;
@@ -90,5 +92,79 @@ int main() {
     cout << "Swapped Tree after swap:" << endl;
     swappedTree.print();
 
+    // Проверка инвариантов: случайные вставки и удаления (по ключу, по
+    // итератору и узлов с двумя сыновьями) сверяются с std::set
+    {
+        std::mt19937 rng(2);
+        rb_tree::RB_Tree<int> tree;
+        std::set<int> model;
+        bool ok = true;
+        for (int i = 0; i < 20000 && ok; ++i) {
+            int key = rng() % 500;
+            int op = rng() % 4;
+            if (op < 2) {
+                tree[key];
+                model.insert(key);
+            } else if (op == 2) {
+                ok = tree.erase(key) == model.erase(key);
+            } else if (!model.empty()) {
+                auto it = tree.lower_bound(key);
+                if (it == tree.end()) it = tree.begin();
+                model.erase(*it);
+                tree.erase(it);
+            }
+            if (i % 50 == 0)
+                ok = ok && tree.valid() && tree.size() == model.size();
+        }
+        auto it = tree.begin();
+        for (int key : model) {
+            if (it == tree.end() || *it != key) ok = false;
+            if (it != tree.end()) ++it;
+        }
+        while (!model.empty() && ok) {
+            tree.remove(*model.begin());
+            model.erase(model.begin());
+            ok = tree.valid() && tree.size() == model.size();
+        }
+        cout << "Random insert/erase keeps RB invariants: "
+             << (ok ? "Yes" : "No") << endl;
+        if (!ok) return 1;
+    }
+
+    // Цвет хранится в бите указателя на отца: узел состоит из данных и трех
+    // указателей, а отцы и цвета верны после каждой вставки и удаления
+    {
+        using node = rb_tree::Node<int>;
+        bool ok = sizeof(node) == 4 * sizeof(node *);
+        rb_tree::RB_Tree<int> tree;
+        for (int i = 0; i < 300 && ok; ++i) {
+            tree[i % 2 ? 299 - i / 2 : i / 2];
+            ok = tree.valid();
+        }
+        for (int i = 0; i < 300 && ok; ++i) {
+            tree.erase(i);
+            ok = tree.valid() && tree.size() == size_t(299 - i);
+        }
+        cout << "Packed color bit keeps RB invariants: "
+             << (ok ? "Yes" : "No") << endl;
+        if (!ok) return 1;
+    }
+
+    // Вставка за один спуск: повторный ключ не добавляет узел, а operator[]
+    // возвращает данные уже существующего элемента
+    {
+        rb_tree::RB_Tree<int> dup = {3, 1, 3, 2, 1};
+        rb_tree::RB_Tree<rb_tree::dataMap<string, int>> words;
+        words["one"].data = 1;
+        words["one"];
+        words["two"].data = 2;
+        bool ok = dup.valid() && dup.size() == 3 && words.valid() &&
+                  words.size() == 2 && words["one"].data == 1 &&
+                  words.at("two").data == 2;
+        cout << "Unique insert keeps existing elements: "
+             << (ok ? "Yes" : "No") << endl;
+        if (!ok) return 1;
+    }
+
     return 0;
 }
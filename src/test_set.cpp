@@ -1,7 +1,52 @@
+#include <cstdlib>
 #include <iostream>
+#include <new>
 
+#include "btree_set.h"
+#include "flat_set.h"
 #include "set.h"
 #include <set>
+#include <algorithm>
+#include <iterator>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Дерево корректно и совпадает с моделью: инварианты, размер и порядок
+template <typename Set, typename Model>
+bool sameAs(const Set &tree, const Model &model) {
+  return tree.valid() && tree.size() == model.size() &&
+         std::equal(tree.begin(), tree.end(), model.begin(), model.end());
+}
+
+// Счетчики глобальных new и delete: по ним видно, когда пул берет у системы
+// новый кусок и когда возвращает куски. noinline не дает GCC увидеть malloc
+// внутри new и ложно предупредить о несовпадении new и delete
+static size_t allocations = 0;
+static size_t deallocations = 0;
+
+[[gnu::noinline]] void *operator new(std::size_t size) {
+  ++allocations;
+  if (void *ptr = std::malloc(size ? size : 1)) return ptr;
+  throw std::bad_alloc();
+}
+
+// Временные буферы стандартных алгоритмов берутся через nothrow-версию
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+  ++allocations;
+  return std::malloc(size ? size : 1);
+}
+
+void operator delete(void *ptr) noexcept {
+  if (ptr) ++deallocations;
+  std::free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept {
+  if (ptr) ++deallocations;
+  std::free(ptr);
+}
 
 int main() {
   
@@ -194,6 +239,458 @@ int main() {
    
    std:: cout << std::endl;
 
+ }
+
+  {
+   // удаление без перестроения дерева: итераторы на остальные узлы живы
+   binary_tree::set<int> our_set = {8, 3, 10, 1, 6, 14, 4, 7, 13};
+   std::set<int> std_set = {8, 3, 10, 1, 6, 14, 4, 7, 13};
+   auto keep = our_set.find(7);
+   our_set.erase(our_set.find(8));
+   our_set.erase(our_set.find(3));
+   our_set.erase(our_set.find(13));
+   std_set.erase(8);
+   std_set.erase(3);
+   std_set.erase(13);
+   our_set.print_tree();
+   std:: cout << std::endl;
+   std:: cout << "still valid: " << *keep << std::endl;
+   auto our_it = our_set.begin();
+   auto std_it = std_set.begin();
+   for (; our_it != our_set.end(); ++our_it, ++std_it) {
+    std::cout << *our_it << " == " << *std_it << std::endl;
+   }
+   std:: cout << std::endl;
+ }
+
+  {
+   // границы диапазонов
+   const binary_tree::set<int> our_set = {10, 20, 30, 40};
+   const std::set<int> std_set = {10, 20, 30, 40};
+   std:: cout << *our_set.lower_bound(20) << " : " << *std_set.lower_bound(20) << std::endl;
+   std:: cout << *our_set.upper_bound(20) << " : " << *std_set.upper_bound(20) << std::endl;
+   std:: cout << "floor(25): " << *our_set.floor(25) << std::endl;
+   std:: cout << "ceiling(25): " << *our_set.ceiling(25) << std::endl;
+   std:: cout << std::endl;
+ }
+
+  {
+   // операции над множествами
+   binary_tree::set<int> our_a = {1, 2, 3, 4, 5, 6};
+   binary_tree::set<int> our_b = {4, 5, 6, 7, 8};
+   std::set<int> std_a = {1, 2, 3, 4, 5, 6};
+   std::set<int> std_b = {4, 5, 6, 7, 8};
+   std::vector<int> std_result;
+   std::set_intersection(std_a.begin(), std_a.end(), std_b.begin(),
+                         std_b.end(), std::back_inserter(std_result));
+   our_a.set_intersection(our_b);
+   auto std_it = std_result.begin();
+   for (auto our_it = our_a.begin(); our_it != our_a.end(); ++our_it, ++std_it) {
+    std::cout << *our_it << " == " << *std_it << std::endl;
+   }
+   std:: cout << "other size: " << our_b.size() << std::endl;
+   std:: cout << std::endl;
+ }
+
+  {
+   // Операции над множествами против std::set_* на случайных входах разной
+   // плотности: результат корректен, other пуст
+   std::mt19937 rng(10);
+   bool ok = true;
+   auto check = [&ok](auto our_a, auto our_b, const std::set<int> &a,
+                      const std::set<int> &b, auto operation, auto algorithm) {
+    std::set<int> expected;
+    algorithm(a.begin(), a.end(), b.begin(), b.end(),
+              std::inserter(expected, expected.end()));
+    operation(our_a, our_b);
+    ok = ok && sameAs(our_a, expected) && our_b.empty() && our_b.valid();
+   };
+   for (int round = 0; round < 60 && ok; ++round) {
+    std::set<int> a, b;
+    int range = 10 + round * 20;
+    for (int i = rng() % (round * 8 + 1); i > 0; --i) a.insert(rng() % range);
+    for (int i = rng() % (round * 8 + 1); i > 0; --i) b.insert(rng() % range);
+    auto run = [&](auto tag) {
+     using Set = decltype(tag);
+     Set our_a(a.begin(), a.end()), our_b(b.begin(), b.end());
+     check(our_a, our_b, a, b,
+           [](Set &x, Set &y) { x.set_union(y); },
+           [](auto... args) { return std::set_union(args...); });
+     check(our_a, our_b, a, b,
+           [](Set &x, Set &y) { x.set_intersection(y); },
+           [](auto... args) { return std::set_intersection(args...); });
+     check(our_a, our_b, a, b,
+           [](Set &x, Set &y) { x.set_difference(y); },
+           [](auto... args) { return std::set_difference(args...); });
+     check(our_a, our_b, a, b,
+           [](Set &x, Set &y) { x.symmetric_difference(y); },
+           [](auto... args) { return std::set_symmetric_difference(args...); });
+     check(our_a, our_b, a, b, [](Set &x, Set &y) { x.merge(y); },
+           [](auto... args) { return std::set_union(args...); });
+    };
+    run(binary_tree::set<int>());
+    run(binary_tree::threaded::set<int>());
+   }
+   std:: cout << "set algebra against std::set_*: " << ok << std::endl;
+   std:: cout << std::endl;
+   if (!ok) return 1;
+ }
+
+  {
+   // узлы из собственного пула с повторным использованием удаленных
+   // reserve() берет кусок сразу, вставки после него не обращаются к системе
+   binary_tree::set<int, binary_tree::slab_allocator<int>> pooled;
+   size_t before = allocations;
+   pooled.reserve(100);
+   bool ok = allocations > before;
+   before = allocations;
+   for (int i = 0; i < 100; ++i) pooled.insert(i);
+   ok = ok && allocations == before;
+   std:: cout << "reserve avoids new chunks: " << ok << std::endl;
+   if (!ok) return 1;
+
+   // новые узлы занимают ячейки удаленных из списка свободных
+   // (удаление может переложить ключ в другой узел, поэтому сравниваются
+   // множества адресов узлов, а не адреса отдельных ключей)
+   std::set<const int *> cells;
+   for (const int &key : pooled) cells.insert(&key);
+   before = allocations;
+   for (int i = 0; i < 100; i += 2) pooled.erase(pooled.find(i));
+   for (int i = 100; i < 150; ++i) pooled.insert(i);
+   ok = allocations == before && pooled.size() == 100 && pooled.valid();
+   for (const int &key : pooled) ok = ok && cells.erase(&key);
+   ok = ok && cells.empty();
+   std:: cout << "erased nodes are reused: " << ok << std::endl;
+   if (!ok) return 1;
+
+   // clear() единственного владельца пула возвращает куски целиком
+   size_t released = deallocations;
+   pooled.clear();
+   ok = pooled.empty() && pooled.valid() && deallocations > released &&
+        allocations == before;
+   pooled.insert(1);
+   ok = ok && allocations > before && pooled.size() == 1;
+   std:: cout << "clear releases chunks: " << ok << std::endl;
+   std:: cout << std::endl;
+   if (!ok) return 1;
+ }
+
+  {
+   // заглавный узел: после случайных вставок, удалений и clear() begin() и
+   // --end() указывают на минимум и максимум, инварианты сохраняются
+   std::mt19937 rng(3);
+   binary_tree::set<int> our_set;
+   std::set<int> std_set;
+   bool ok = true;
+   for (int i = 0; i < 20000 && ok; ++i) {
+    int key = rng() % 1000;
+    int op = rng() % 8;
+    if (op < 4) {
+     our_set.insert(key);
+     std_set.insert(key);
+    } else if (op < 7) {
+     our_set.erase(key);
+     std_set.erase(key);
+    } else if (auto it = our_set.lower_bound(key); it != our_set.end()) {
+     std_set.erase(*it);
+     our_set.erase(it);
+    }
+    if (i == 10000) {
+     our_set.clear();
+     std_set.clear();
+     ok = ok && sameAs(our_set, std_set) && our_set.begin() == our_set.end();
+    }
+    if (i % 50 == 0 && !std_set.empty())
+     ok = ok && sameAs(our_set, std_set) &&
+          *our_set.begin() == *std_set.begin() &&
+          *--our_set.end() == *std_set.rbegin();
+   }
+   std:: cout << "header and invariants after random ops: " << ok << std::endl;
+   std:: cout << std::endl;
+   if (!ok) return 1;
+ }
+
+  {
+   // вставка с подсказкой: верная подсказка (lower_bound), неверная
+   // (begin(), end(), случайная позиция) и повтор ключа дают тот же
+   // результат, что и обычная вставка
+   std::mt19937 rng(7);
+   binary_tree::set<int> our_set;
+   std::set<int> std_set;
+   bool ok = true;
+   for (int i = 0; i < 20000 && ok; ++i) {
+    int key = rng() % 3000;
+    binary_tree::set<int>::const_iterator hint = our_set.end();
+    switch (rng() % 4) {
+     case 0: hint = our_set.lower_bound(key); break;
+     case 1: hint = our_set.begin(); break;
+     case 2: hint = our_set.end(); break;
+     default: hint = our_set.lower_bound(int(rng() % 3000)); break;
+    }
+    auto it = rng() % 2 ? our_set.insert(hint, key)
+                        : our_set.emplace_hint(hint, key);
+    std_set.insert(key);
+    ok = it != our_set.end() && *it == key;
+    if (i % 50 == 0) ok = ok && sameAs(our_set, std_set);
+   }
+   ok = ok && sameAs(our_set, std_set);
+   std:: cout << "hinted insert with right and wrong hints: " << ok
+              << std::endl;
+   std:: cout << std::endl;
+   if (!ok) return 1;
+ }
+
+  {
+   // сборка за O(n): для всех размеров до 300 дерево из упорядоченного
+   // входа, входа с повторами и неупорядоченного входа корректно, а
+   // assign_sorted заменяет прежнее содержимое
+   std::mt19937 rng(8);
+   bool ok = true;
+   for (int n = 0; n <= 300 && ok; ++n) {
+    std::vector<int> sorted(n), repeated, shuffled;
+    for (int i = 0; i < n; ++i) sorted[i] = 2 * i;
+    for (int key : sorted) repeated.insert(repeated.end(), 1 + rng() % 3, key);
+    shuffled = repeated;
+    std::shuffle(shuffled.begin(), shuffled.end(), rng);
+    std::set<int> std_set(sorted.begin(), sorted.end());
+    binary_tree::set<int> a(sorted.begin(), sorted.end());
+    binary_tree::set<int> b(repeated.begin(), repeated.end());
+    binary_tree::set<int> c(shuffled.begin(), shuffled.end());
+    binary_tree::set<int> d = {7, 3, 5};
+    d.assign_sorted(sorted.begin(), sorted.end());
+    ok = sameAs(a, std_set) && sameAs(b, std_set) && sameAs(c, std_set) &&
+         sameAs(d, std_set);
+   }
+   binary_tree::set<int> listed = {9, 1, 5, 1, 3};
+   ok = ok && sameAs(listed, std::set<int>{1, 3, 5, 9});
+   std:: cout << "bulk build for sizes 0..300: " << ok << std::endl;
+   std:: cout << std::endl;
+   if (!ok) return 1;
+ }
+
+  {
+   // цвет в младшем бите указателя на отца: узел без отдельного поля цвета,
+   // а после поворотов при вставке и удалении по возрастанию, убыванию и
+   // вразброс отцы и цвета сходятся после каждой операции
+   using node = binary_tree::Node<int, int>;
+   bool ok = sizeof(node) ==
+             2 * sizeof(int) + 3 * sizeof(node *) + sizeof(size_t);
+   std::vector<char> ascending, zigzag;
+   for (int i = 0; i < 120; ++i) ascending.push_back(char(i));
+   for (int i = 0; i < 60; ++i) {
+    zigzag.push_back(char(i));
+    zigzag.push_back(char(119 - i));
+   }
+   std::vector<char> descending(ascending.rbegin(), ascending.rend());
+   for (const auto *order : {&ascending, &descending, &zigzag}) {
+    binary_tree::set<char> our_set;
+    std::set<char> std_set;
+    for (char key : *order) {
+     our_set.insert(key);
+     std_set.insert(key);
+     ok = ok && sameAs(our_set, std_set);
+    }
+    for (const auto *erase_order : {&ascending, &zigzag}) {
+     binary_tree::set<char> left = our_set;
+     std::set<char> std_left = std_set;
+     for (char key : *erase_order) {
+      left.erase(key);
+      std_left.erase(key);
+      ok = ok && sameAs(left, std_left);
+     }
+    }
+   }
+   std:: cout << "packed color bit after rotations: " << ok << std::endl;
+   std:: cout << std::endl;
+   if (!ok) return 1;
+ }
+
+  {
+   // операции flat_set с самим собой: объединение и пересечение ничего не
+   // меняют, разности дают пустое множество
+   binary_tree::flat_set<int> self = {3, 1, 2};
+   self.merge(self);
+   self.set_union(self);
+   self.set_intersection(self);
+   self.join(self);
+   bool ok = self.size() == 3 && self.contains(2);
+   auto difference = self, symmetric = self;
+   difference.set_difference(difference);
+   symmetric.symmetric_difference(symmetric);
+   ok = ok && difference.empty() && symmetric.empty();
+   std:: cout << "flat_set self operations: " << ok << std::endl;
+   std:: cout << std::endl;
+   if (!ok) return 1;
+ }
+
+  {
+   // merge с пересекающимися ключами: повторов нет, порядок сохранен, other
+   // пуст, слияние с самим собой ничего не меняет
+   binary_tree::set<int> our_set;
+   binary_tree::threaded::set<int> threaded_set;
+   binary_tree::set<int> our_other;
+   binary_tree::threaded::set<int> threaded_other;
+   std::set<int> model;
+   for (int i = 0; i < 300; i += 2) {
+    our_set.insert(i);
+    threaded_set.insert(i);
+    model.insert(i);
+   }
+   for (int i = 0; i < 450; i += 3) {
+    our_other.insert(i);
+    threaded_other.insert(i);
+    model.insert(i);
+   }
+   our_set.merge(our_other);
+   our_set.merge(our_set);
+   threaded_set.merge(threaded_other);
+   threaded_set.merge(threaded_set);
+   std::vector<int> backward;
+   for (auto it = threaded_set.end(); it != threaded_set.begin();)
+    backward.push_back(*--it);
+   bool ok = sameAs(our_set, model) && sameAs(threaded_set, model) &&
+             our_other.empty() && threaded_other.empty() &&
+             std::equal(backward.begin(), backward.end(), model.rbegin(),
+                        model.rend());
+   std:: cout << "merge with overlapping keys: " << ok << std::endl;
+   std:: cout << std::endl;
+   if (!ok) return 1;
+ }
+
+  {
+   // итератор btree_set стандартный: из него строится vector, а алгоритмы
+   // получают настоящую ссылку на ключ
+   using btree_set = binary_tree::btree_set<int>;
+   btree_set keys;
+   for (int i = 0; i < 500; ++i) keys.insert((i * 37) % 500);
+   std::vector<int> sorted(keys.begin(), keys.end());
+   bool ok = sorted.size() == 500 &&
+             std::is_sorted(sorted.begin(), sorted.end()) &&
+             std::distance(keys.begin(), keys.end()) == 500 &&
+             std::find(keys.begin(), keys.end(), 250) != keys.end() &&
+             &*keys.find(250) == &*keys.find(250) &&
+             std::is_same_v<
+                 std::iterator_traits<btree_set::iterator>::reference,
+                 const int &>;
+   std:: cout << "btree_set standard iterator: " << ok << std::endl;
+   std:: cout << std::endl;
+   if (!ok) return 1;
+ }
+
+  {
+   // merge на B+-дереве: повторов нет, порядок сохранен, other пуст
+   binary_tree::btree_set<int> our_set, our_other;
+   std::set<int> model;
+   for (int i = 0; i < 500; i += 2) {
+    our_set.insert(i);
+    model.insert(i);
+   }
+   for (int i = 0; i < 750; i += 3) {
+    our_other.insert(i);
+    model.insert(i);
+   }
+   our_set.merge(our_other);
+   our_set.merge(our_set);
+   bool ok = our_other.empty() && our_set.size() == model.size() &&
+             std::equal(our_set.begin(), our_set.end(), model.begin(),
+                        model.end());
+   std:: cout << "btree_set merge: " << ok << std::endl;
+   std:: cout << std::endl;
+   if (!ok) return 1;
+ }
+
+  {
+   // B+-дерево с Compare: по убыванию для std::greater, поиск по
+   // string_view для std::less<>
+   binary_tree::btree_set<int, std::allocator<int>, std::greater<int>>
+       descending;
+   binary_tree::btree_set<std::string, std::allocator<std::string>,
+                          std::less<>>
+       names;
+   std::set<int, std::greater<int>> model;
+   for (int i = 0; i < 1500; ++i) {
+    descending.insert((i * 347) % 1500);
+    model.insert((i * 347) % 1500);
+    names.insert("host-" + std::to_string(i));
+   }
+   std::string_view host = "host-42.example";
+   host = host.substr(0, host.find('.'));
+   bool ok = descending.valid() && names.valid() &&
+             std::equal(descending.begin(), descending.end(), model.begin(),
+                        model.end()) &&
+             *descending.lower_bound(2000) == 1499 &&
+             names.contains(host) && *names.find(host) == "host-42" &&
+             names.erase(host) == 1 && !names.contains(host);
+   std:: cout << "btree_set with greater and less<>: " << ok << std::endl;
+   std:: cout << std::endl;
+   if (!ok) return 1;
+ }
+
+  {
+   // flat_set с Compare: по убыванию для std::greater, поиск по string_view
+   // для std::less<>
+   binary_tree::flat_set<int, std::allocator<int>, std::greater<int>>
+       descending;
+   binary_tree::flat_set<int, std::allocator<int>, std::greater<int>> other;
+   binary_tree::flat_set<std::string, std::allocator<std::string>,
+                         std::less<>>
+       names = {"beta", "alpha", "gamma"};
+   std::set<int, std::greater<int>> model;
+   std::vector<int> batch;
+   for (int i = 0; i < 400; ++i) {
+    int key = (i * 97) % 400;
+    if (i % 3)
+     batch.push_back(key);
+    else
+     descending.insert(key);
+    if (key % 5 == 0) other.insert(key + 1000);
+    model.insert(key);
+    if (key % 5 == 0) model.insert(key + 1000);
+   }
+   descending.insert(batch.begin(), batch.end());
+   descending.set_union(other);
+   std::string_view name = "alpha.conf";
+   name = name.substr(0, name.find('.'));
+   bool ok = std::equal(descending.begin(), descending.end(), model.begin(),
+                        model.end()) &&
+             *descending.lower_bound(999) == 399 &&
+             descending.count_range(200, 100) == 100 &&
+             names.contains(name) && *names.find(name) == "alpha" &&
+             names.erase(name) == 1 && *names.begin() == "beta";
+   std:: cout << "flat_set with greater and less<>: " << ok << std::endl;
+   std:: cout << std::endl;
+   if (!ok) return 1;
+ }
+
+  {
+   // join с пересекающимися диапазонами ключей сводится к объединению,
+   // с непересекающимися - склеивает деревья в любом порядке
+   bool ok = true;
+   auto check = [&ok](auto joined, auto other, std::set<int> model) {
+    joined.join(other);
+    ok = ok && sameAs(joined, model) && other.empty();
+    for (int key : model) ok = ok && joined.contains(key);
+   };
+   check(binary_tree::set<int>{1, 5, 9}, binary_tree::set<int>{3, 7},
+         {1, 3, 5, 7, 9});
+   check(binary_tree::set<int>{1, 5, 9}, binary_tree::set<int>{9, 12},
+         {1, 5, 9, 12});
+   check(binary_tree::set<int>{1, 5, 9}, binary_tree::set<int>{10, 12},
+         {1, 5, 9, 10, 12});
+   check(binary_tree::set<int>{10, 12}, binary_tree::set<int>{1, 5},
+         {1, 5, 10, 12});
+   check(binary_tree::threaded::set<int>{1, 5, 9},
+         binary_tree::threaded::set<int>{3, 7}, {1, 3, 5, 7, 9});
+   check(binary_tree::threaded::set<int>{10, 12},
+         binary_tree::threaded::set<int>{1, 5}, {1, 5, 10, 12});
+   binary_tree::flat_set<int> flat = {1, 5, 9}, more = {3, 7, 9};
+   flat.join(more);
+   std::vector<int> expected = {1, 3, 5, 7, 9};
+   ok = ok && more.empty() && flat.contains(3) &&
+        std::equal(flat.begin(), flat.end(), expected.begin(), expected.end());
+   std:: cout << "join with overlapping keys: " << ok << std::endl;
+   std:: cout << std::endl;
+   if (!ok) return 1;
  }
 
   //mySet.clear();